@@ -0,0 +1,152 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "bench_common.h"
+#include "poolallocator.h"
+
+
+//! Number of rows and columns of the benchmark matrices.
+static const size_t Size = 1000000;
+
+//! Numbers of allocated elements of the benchmark matrices.
+static const size_t Allocated[] = {100000, 1000000, 10000000};
+
+//! Add a result to the report.
+/*!
+ * \param reporter collects the result.
+ * \param benchmark name of the operation.
+ * \param storage name of the storage format.
+ * \param allocated number of allocated elements processed by one run.
+ * \param runs number of runs.
+ * \param seconds average time per run in seconds.
+ */
+void add_record(BenchReporter& reporter, const char* benchmark, const char* storage, size_t allocated, size_t runs,
+                double seconds)
+{
+    BenchRecord record;
+    record.benchmark = benchmark;
+    record.storage = storage;
+    record.rows = Size;
+    record.density = static_cast<double>(allocated) / Size / Size;
+    record.allocated = allocated;
+    record.threads = 1;
+    record.operations = runs * allocated;
+    record.ns_per_op = seconds / allocated * 1e9;
+    record.nnz_per_s = allocated / seconds;
+    record.bytes_per_s = 0;
+    record.peak_rss_kb = peak_rss_kb();
+    reporter.add(record);
+}
+
+//! Benchmark construction and destruction of a matrix with the given element positions.
+/*!
+ * Construction inserts the elements one by one in the given order. Destruction is timed separately, since that is
+ * where the system allocator is called once per element as well.
+ *
+ * \param reporter collects the results.
+ * \param options command line options.
+ * \param storage name of the storage format.
+ * \param keys positions of the elements.
+ */
+template <typename Matrix>
+void bench_allocator(BenchReporter& reporter, const BenchOptions& options, const char* storage,
+                     const std::vector<std::pair<size_t, size_t>>& keys)
+{
+    reset_peak_rss();
+
+    std::chrono::duration<double> construction(0);
+    std::chrono::duration<double> destruction(0);
+    size_t runs = 0;
+    do
+    {
+        const auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<Matrix> m(new Matrix);
+        for (const auto& key : keys)
+        {
+            (*m)(key.first, key.second) = 1.0;
+        }
+        const auto built = std::chrono::steady_clock::now();
+        m.reset();
+        const auto end = std::chrono::steady_clock::now();
+
+        construction += built - start;
+        destruction += end - built;
+        ++runs;
+    } while ((construction + destruction).count() < options.min_time);
+
+    add_record(reporter, "construction", storage, keys.size(), runs, construction.count() / runs);
+    add_record(reporter, "destruction", storage, keys.size(), runs, destruction.count() / runs);
+}
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    options.max_nnz = 10000000;
+    try
+    {
+        options.parse(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\nusage: %s [--format csv|json] [--output file] [--csv file] [--json file] "
+                             "[--min-time seconds] [--max-nnz count]\n", e.what(), argv[0]);
+        return 1;
+    }
+
+    BenchReporter reporter;
+    for (const size_t allocated : Allocated)
+    {
+        if (allocated > options.max_nnz)
+        {
+            continue;
+        }
+
+        // Distinct positions in random order.
+        std::mt19937_64 generator(1);
+        std::uniform_int_distribution<size_t> index(0, Size - 1);
+        std::vector<std::pair<size_t, size_t>> keys;
+        keys.reserve(allocated);
+        while (keys.size() < allocated)
+        {
+            while (keys.size() < allocated)
+            {
+                keys.emplace_back(index(generator), index(generator));
+            }
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        }
+        std::shuffle(keys.begin(), keys.end(), generator);
+
+        bench_allocator<SparseMatrix<Size, Size, double>>(reporter, options, "map", keys);
+        bench_allocator<SparseMatrix<Size, Size, double, size_t, PoolAllocator<double>>>(reporter, options,
+                                                                                          "map-pool", keys);
+    }
+    reporter.write(options);
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bench_common.h"
+#include "sparsematrixbuilder.h"
+#include "threadpool.h"
+
+
+//! Number of rows and columns of the benchmark matrices.
+static const size_t Size = 1000000;
+
+//! Time an assembly and add the result to the report.
+/*!
+ * \param reporter collects the result.
+ * \param options command line options.
+ * \param storage name of the storage format and mode of assembly.
+ * \param threads number of threads used by the assembly.
+ * \param triplets number of assembled triplets.
+ * \param assembly callable that assembles the matrix once.
+ */
+template <typename Assembly>
+void time_assembly(BenchReporter& reporter, const BenchOptions& options, const char* storage, size_t threads,
+                   size_t triplets, const Assembly& assembly)
+{
+    reset_peak_rss();
+
+    size_t runs;
+    const double seconds = time_operation(options.min_time, assembly, runs);
+
+    BenchRecord record;
+    record.benchmark = "assembly";
+    record.storage = storage;
+    record.rows = Size;
+    record.density = static_cast<double>(triplets) / Size / Size;
+    record.allocated = triplets;
+    record.threads = threads;
+    record.operations = runs;
+    record.ns_per_op = seconds * 1e9;
+    record.nnz_per_s = triplets / seconds;
+    record.bytes_per_s = 0;
+    record.peak_rss_kb = peak_rss_kb();
+    reporter.add(record);
+}
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    options.max_nnz = 10000000;
+    try
+    {
+        options.parse(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\nusage: %s [--format csv|json] [--output file] [--csv file] [--json file] "
+                             "[--min-time seconds] [--max-nnz count]\n", e.what(), argv[0]);
+        return 1;
+    }
+
+    // Triplets at random positions, in random order; about one in ten positions is drawn more than once.
+    const size_t triplets = options.max_nnz;
+    SparseMatrixBuilder<Size, Size, double> builder;
+    builder.reserve(triplets);
+    {
+        std::mt19937_64 generator(1);
+        std::uniform_int_distribution<size_t> index(0, Size - 1);
+        std::uniform_real_distribution<double> value(0.5, 1.5);
+        for (size_t n = 0; n < triplets; ++n)
+        {
+            builder.add(index(generator), index(generator), value(generator));
+        }
+        for (size_t n = 0; n < triplets / 10; ++n)
+        {
+            builder.add(index(generator) % 1000, index(generator) % 1000, value(generator));
+        }
+    }
+
+    BenchReporter reporter;
+    time_assembly(reporter, options, "csr", 1, builder.size(), [&]() { builder.build_csr(); });
+
+    // Scaling with the number of threads: powers of two and the number of hardware threads.
+    const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> thread_counts;
+    for (size_t threads = 1; threads < max_threads; threads *= 2)
+    {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    for (const size_t threads : thread_counts)
+    {
+        ThreadPool pool(threads);
+        time_assembly(reporter, options, "csr-parallel", threads, builder.size(),
+                      [&]() { builder.build_csr(pool); });
+    }
+
+    reporter.write(options);
+
+    return 0;
+}
@@ -0,0 +1,337 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "sparsematrix.h"
+
+
+//! Result of a single benchmark
+struct BenchRecord
+{
+    //! Name of the benchmarked operation.
+    std::string benchmark;
+
+    //! Storage format of the matrix.
+    std::string storage;
+
+    //! Number of rows (and columns) of the matrix.
+    size_t rows;
+
+    //! Fraction of allocated elements.
+    double density;
+
+    //! Number of allocated elements of the operand(s).
+    size_t allocated;
+
+    //! Number of threads used.
+    size_t threads;
+
+    //! Number of timed operations.
+    size_t operations;
+
+    //! Average time per operation in nanoseconds.
+    double ns_per_op;
+
+    //! Allocated elements processed per second.
+    double nnz_per_s;
+
+    //! Bytes of matrix storage read per second, if applicable (otherwise zero).
+    double bytes_per_s;
+
+    //! Peak resident set size during the benchmark, in kilobytes.
+    size_t peak_rss_kb;
+};
+
+//! Reset the peak resident set size.
+/*!
+ * On Linux, the high-water mark of the resident set size can be reset, so that it can be measured per benchmark. On
+ * other systems this has no effect and the peak of the whole process is reported instead.
+ */
+inline void reset_peak_rss()
+{
+#if defined(__linux__)
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+#endif
+}
+
+//! Peak resident set size in kilobytes since the last reset_peak_rss().
+inline size_t peak_rss_kb()
+{
+#if defined(__linux__)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+        {
+            return std::strtoul(line.c_str() + 6, nullptr, 10);
+        }
+    }
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+//! Time an operation.
+/*!
+ * Runs the operation at least once and then repeatedly until the total run time reaches the given minimum.
+ *
+ * \param seconds minimum total run time.
+ * \param operation callable that runs the operation once.
+ * \param runs output: number of runs.
+ * \return the average time per run in seconds.
+ */
+template <typename Operation>
+double time_operation(double seconds, const Operation& operation, size_t& runs)
+{
+    runs = 0;
+    const auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed(0);
+    do
+    {
+        operation();
+        ++runs;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < seconds);
+
+    return elapsed.count() / runs;
+}
+
+//! Command line options shared by the benchmarks
+struct BenchOptions
+{
+    //! Output format, "csv" or "json".
+    std::string format = "csv";
+
+    //! Output file; empty for stdout.
+    std::string output;
+
+    //! File to write the results to as CSV, in addition to the output; empty for none.
+    std::string csv_output;
+
+    //! File to write the results to as JSON, in addition to the output; empty for none.
+    std::string json_output;
+
+    //! Minimum run time per benchmark in seconds.
+    double min_time = 0.2;
+
+    //! Largest number of allocated elements per matrix.
+    size_t max_nnz = 1000000;
+
+    //! Parse the command line.
+    /*!
+     * Recognized options are --format csv|json, --output <file>, --csv <file>, --json <file>, --min-time <seconds>
+     * and --max-nnz <count>. Throws std::invalid_argument for anything else.
+     */
+    void parse(int argc, char* argv[])
+    {
+        for (int n = 1; n < argc; ++n)
+        {
+            const std::string option = argv[n];
+            if (n + 1 >= argc)
+            {
+                throw std::invalid_argument("missing value for " + option);
+            }
+
+            const char* value = argv[++n];
+            if (option == "--format")
+            {
+                format = value;
+            }
+            else if (option == "--output")
+            {
+                output = value;
+            }
+            else if (option == "--csv")
+            {
+                csv_output = value;
+            }
+            else if (option == "--json")
+            {
+                json_output = value;
+            }
+            else if (option == "--min-time")
+            {
+                min_time = std::atof(value);
+            }
+            else if (option == "--max-nnz")
+            {
+                max_nnz = std::strtoul(value, nullptr, 10);
+            }
+            else
+            {
+                throw std::invalid_argument("unknown option " + option);
+            }
+        }
+    }
+};
+
+//! Collects benchmark results and writes them as CSV or JSON
+class BenchReporter
+{
+    private:
+        //! Collected results.
+        std::vector<BenchRecord> _records;
+
+    public:
+        //! Add a result; a short summary is printed to stderr as progress indication.
+        void add(const BenchRecord& record)
+        {
+            std::fprintf(stderr, "%-14s %-6s rows=%-8zu density=%-8g threads=%-3zu %14.1f ns/op %12.4g nnz/s\n",
+                         record.benchmark.c_str(), record.storage.c_str(), record.rows, record.density,
+                         record.threads, record.ns_per_op, record.nnz_per_s);
+            _records.push_back(record);
+        }
+
+        //! Write all results as CSV, with a header line.
+        void write_csv(std::FILE* out) const
+        {
+            std::fprintf(out, "benchmark,storage,rows,density,allocated,threads,operations,ns_per_op,nnz_per_s,"
+                              "bytes_per_s,peak_rss_kb\n");
+            for (const auto& r : _records)
+            {
+                std::fprintf(out, "%s,%s,%zu,%g,%zu,%zu,%zu,%.3f,%.6g,%.6g,%zu\n", r.benchmark.c_str(),
+                             r.storage.c_str(), r.rows, r.density, r.allocated, r.threads, r.operations, r.ns_per_op,
+                             r.nnz_per_s, r.bytes_per_s, r.peak_rss_kb);
+            }
+        }
+
+        //! Write all results as a JSON array of objects.
+        void write_json(std::FILE* out) const
+        {
+            std::fprintf(out, "[\n");
+            for (size_t n = 0; n < _records.size(); ++n)
+            {
+                const auto& r = _records[n];
+                std::fprintf(out, "  {\"benchmark\": \"%s\", \"storage\": \"%s\", \"rows\": %zu, \"density\": %g, "
+                                  "\"allocated\": %zu, \"threads\": %zu, \"operations\": %zu, \"ns_per_op\": %.3f, "
+                                  "\"nnz_per_s\": %.6g, \"bytes_per_s\": %.6g, \"peak_rss_kb\": %zu}%s\n",
+                             r.benchmark.c_str(), r.storage.c_str(), r.rows, r.density, r.allocated, r.threads,
+                             r.operations, r.ns_per_op, r.nnz_per_s, r.bytes_per_s, r.peak_rss_kb,
+                             n + 1 < _records.size() ? "," : "");
+            }
+            std::fprintf(out, "]\n");
+        }
+
+        //! Write all results in the given format ("csv" or "json") to a file, or to stdout if the path is empty.
+        void write(const std::string& format, const std::string& path) const
+        {
+            std::FILE* out = path.empty() ? stdout : std::fopen(path.c_str(), "w");
+            if (out == nullptr)
+            {
+                throw std::runtime_error("cannot open " + path);
+            }
+
+            if (format == "json")
+            {
+                write_json(out);
+            }
+            else
+            {
+                write_csv(out);
+            }
+
+            if (out != stdout)
+            {
+                std::fclose(out);
+            }
+        }
+
+        //! Write all results to the files given on the command line.
+        /*!
+         * Results are written as CSV and JSON to the files given with --csv and --json, so that both hold the same
+         * measurements. They are written in the format given with --format to the file given with --output, or to
+         * stdout if neither --output, --csv nor --json is given.
+         */
+        void write(const BenchOptions& options) const
+        {
+            if (!options.csv_output.empty())
+            {
+                write("csv", options.csv_output);
+            }
+            if (!options.json_output.empty())
+            {
+                write("json", options.json_output);
+            }
+            if (!options.output.empty() || (options.csv_output.empty() && options.json_output.empty()))
+            {
+                write(options.format, options.output);
+            }
+        }
+};
+
+//! Random matrix.
+/*!
+ * Creates a matrix with allocated elements at uniformly distributed positions. Duplicate positions are drawn again,
+ * so the matrix has exactly the requested number of allocated elements.
+ *
+ * \param allocated number of allocated elements.
+ * \param seed seed for the random number generator.
+ * \return the matrix.
+ */
+template <size_t M, size_t N, typename T>
+SparseMatrix<M, N, T> random_matrix(size_t allocated, unsigned seed)
+{
+    std::mt19937_64 generator(seed);
+    std::uniform_int_distribution<size_t> row(0, M - 1);
+    std::uniform_int_distribution<size_t> column(0, N - 1);
+    std::uniform_real_distribution<double> value(0.5, 1.5);
+
+    SparseMatrix<M, N, T> matrix;
+    for (size_t n = 0; n < allocated; ++n)
+    {
+        size_t i, j;
+        do
+        {
+            i = row(generator);
+            j = column(generator);
+        } while (matrix.peek(i, j));
+
+        matrix(i, j) = static_cast<T>(value(generator));
+    }
+    return matrix;
+}
+
+#endif  // BENCH_COMMON_H
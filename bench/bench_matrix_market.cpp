@@ -0,0 +1,176 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <vector>
+
+#include "bench_common.h"
+#include "binarymatrix.h"
+#include "matrixmarket.h"
+#include "sparsematrixbuilder.h"
+
+
+//! Number of rows and columns of the benchmark matrix.
+static const size_t Size = 1000000;
+
+//! Name of the file that is written and read.
+static const char* Filename = "bench_matrix_market.mtx";
+
+//! Name of the binary file that is written and mapped.
+static const char* BinaryFilename = "bench_matrix_market.bin";
+
+//! Time reading or writing the file and add the result to the report.
+/*!
+ * \param reporter collects the result.
+ * \param options command line options.
+ * \param benchmark name of the operation.
+ * \param storage name of the method.
+ * \param allocated number of elements in the file.
+ * \param bytes size of the file in bytes.
+ * \param operation callable that reads or writes the file once.
+ */
+template <typename Operation>
+void time_file(BenchReporter& reporter, const BenchOptions& options, const char* benchmark, const char* storage,
+               size_t allocated, size_t bytes, const Operation& operation)
+{
+    reset_peak_rss();
+
+    size_t runs;
+    const double seconds = time_operation(options.min_time, operation, runs);
+
+    BenchRecord record;
+    record.benchmark = benchmark;
+    record.storage = storage;
+    record.rows = Size;
+    record.density = static_cast<double>(allocated) / Size / Size;
+    record.allocated = allocated;
+    record.threads = 1;
+    record.operations = runs;
+    record.ns_per_op = seconds * 1e9;
+    record.nnz_per_s = allocated / seconds;
+    record.bytes_per_s = bytes / seconds;
+    record.peak_rss_kb = peak_rss_kb();
+    reporter.add(record);
+}
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    try
+    {
+        options.parse(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\nusage: %s [--format csv|json] [--output file] [--csv file] [--json file] "
+                             "[--min-time seconds] [--max-nnz count]\n", e.what(), argv[0]);
+        return 1;
+    }
+
+    const SparseMatrix<Size, Size, double> s = random_matrix<Size, Size, double>(options.max_nnz, 1);
+    const size_t allocated = s.allocated();
+
+    BenchReporter reporter;
+    write_matrix_market(Filename, s);
+    std::FILE* file = std::fopen(Filename, "rb");
+    std::fseek(file, 0, SEEK_END);
+    const size_t bytes = std::ftell(file);
+    std::fclose(file);
+
+    time_file(reporter, options, "mtx-write", "writer", allocated, bytes, [&]() { write_matrix_market(Filename, s); });
+
+    // Reading the file without parsing it; the file is usually in the page cache, so this is the speed of memory.
+    std::vector<char> buffer(1 << 20);
+    size_t checksum = 0;
+    time_file(reporter, options, "mtx-read", "fread", allocated, bytes, [&]()
+    {
+        std::FILE* f = std::fopen(Filename, "rb");
+        for (size_t count; (count = std::fread(buffer.data(), 1, buffer.size(), f)) != 0;)
+        {
+            checksum += static_cast<unsigned char>(buffer[count - 1]);
+        }
+        std::fclose(f);
+    });
+
+    time_file(reporter, options, "mtx-read", "iostream", allocated, bytes, [&]()
+    {
+        std::ifstream f(Filename);
+        std::string line;
+        std::getline(f, line);
+        size_t rows, cols, entries;
+        f >> rows >> cols >> entries;
+        SparseMatrixBuilder<Size, Size, double> builder;
+        builder.reserve(entries);
+        size_t i, j;
+        double value;
+        while (f >> i >> j >> value)
+        {
+            builder.add(i - 1, j - 1, value);
+        }
+        checksum += builder.size();
+    });
+
+    time_file(reporter, options, "mtx-read", "reader", allocated, bytes, [&]()
+    {
+        SparseMatrixBuilder<Size, Size, double> builder;
+        MatrixMarketReader(Filename).read(builder);
+        checksum += builder.size();
+    });
+
+    // The binary format is mapped instead of read; opening only checks the header, the first product reads the
+    // elements.
+    const CsrMatrix<Size, Size, double> c(s);
+    write_binary(BinaryFilename, c);
+    file = std::fopen(BinaryFilename, "rb");
+    std::fseek(file, 0, SEEK_END);
+    const size_t binary_bytes = std::ftell(file);
+    std::fclose(file);
+
+    time_file(reporter, options, "bin-write", "writer", allocated, binary_bytes, [&]()
+    {
+        write_binary(BinaryFilename, c);
+    });
+
+    time_file(reporter, options, "bin-read", "mmap", allocated, binary_bytes, [&]()
+    {
+        MappedCsrMatrix<double> m(BinaryFilename);
+        checksum += m.allocated();
+    });
+
+    std::vector<double> x(Size, 1.0);
+    std::vector<double> y(Size);
+    time_file(reporter, options, "bin-read", "mmap+spmv", allocated, binary_bytes, [&]()
+    {
+        MappedCsrMatrix<double> m(BinaryFilename);
+        m.multiply(x, y);
+        checksum += static_cast<size_t>(y[0]);
+    });
+
+    std::remove(Filename);
+    std::remove(BinaryFilename);
+    if (checksum == 0)
+    {
+        std::printf("%zu\n", checksum);
+    }
+    reporter.write(options);
+
+    return 0;
+}
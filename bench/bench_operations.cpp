@@ -0,0 +1,243 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "bench_common.h"
+#include "csrmatrix.h"
+#include "sparsematrixbuilder.h"
+
+
+//! Densities (fractions of allocated elements) of the benchmark matrices.
+static const double Densities[] = {1e-5, 1e-4, 1e-3, 1e-2};
+
+//! Run a benchmark and add the result to the report.
+/*!
+ * \param reporter collects the result.
+ * \param options command line options.
+ * \param benchmark name of the operation.
+ * \param storage name of the storage format.
+ * \param rows number of rows of the matrix.
+ * \param density density of the matrix.
+ * \param allocated number of allocated elements processed by one run.
+ * \param per_run number of operations in one run (for reporting time per operation).
+ * \param operation callable that runs the operation once.
+ */
+template <typename Operation>
+void run_benchmark(BenchReporter& reporter, const BenchOptions& options, const char* benchmark, const char* storage,
+                   size_t rows, double density, size_t allocated, size_t per_run, const Operation& operation)
+{
+    reset_peak_rss();
+
+    size_t runs;
+    const double seconds = time_operation(options.min_time, operation, runs);
+
+    BenchRecord record;
+    record.benchmark = benchmark;
+    record.storage = storage;
+    record.rows = rows;
+    record.density = density;
+    record.allocated = allocated;
+    record.threads = 1;
+    record.operations = runs * per_run;
+    record.ns_per_op = seconds / per_run * 1e9;
+    record.nnz_per_s = allocated / seconds;
+    record.bytes_per_s = 0;
+    record.peak_rss_kb = peak_rss_kb();
+    reporter.add(record);
+}
+
+//! Benchmark all operations for square matrices of a given size, for all densities.
+template <size_t Size>
+void bench_size(BenchReporter& reporter, const BenchOptions& options)
+{
+    typedef SparseMatrix<Size, Size, double> Matrix;
+    typedef CsrMatrix<Size, Size, double> Compressed;
+
+    for (const double density : Densities)
+    {
+        const size_t allocated = static_cast<size_t>(density * Size * Size);
+        if (allocated == 0 || allocated > options.max_nnz)
+        {
+            std::fprintf(stderr, "skipped: rows=%zu density=%g (%zu elements, --max-nnz %zu)\n", Size, density,
+                         allocated, options.max_nnz);
+            continue;
+        }
+
+        const Matrix a = random_matrix<Size, Size, double>(allocated, 1);
+        const Matrix b = random_matrix<Size, Size, double>(allocated, 2);
+        const Compressed ca(a);
+        const Compressed cb(b);
+
+        // Positions of the allocated elements, in random order.
+        std::vector<std::pair<size_t, size_t>> keys;
+        keys.reserve(allocated);
+        for (auto elem = a.cbegin(); elem != a.cend(); ++elem)
+        {
+            keys.push_back(elem->first);
+        }
+        std::shuffle(keys.begin(), keys.end(), std::mt19937_64(3));
+
+        run_benchmark(reporter, options, "construction", "map", Size, density, allocated, allocated, [&]()
+        {
+            Matrix m;
+            for (const auto& key : keys)
+            {
+                m(key.first, key.second) = 1.0;
+            }
+        });
+        run_benchmark(reporter, options, "conversion", "csr", Size, density, allocated, allocated, [&]()
+        {
+            Compressed m(a);
+        });
+
+        // Construction from the same elements in one batch.
+        run_benchmark(reporter, options, "assembly", "map", Size, density, allocated, allocated, [&]()
+        {
+            SparseMatrixBuilder<Size, Size, double> builder;
+            builder.reserve(keys.size());
+            for (const auto& key : keys)
+            {
+                builder.add(key.first, key.second, 1.0);
+            }
+            Matrix m = builder.build();
+        });
+        run_benchmark(reporter, options, "assembly", "csr", Size, density, allocated, allocated, [&]()
+        {
+            SparseMatrixBuilder<Size, Size, double> builder;
+            builder.reserve(keys.size());
+            for (const auto& key : keys)
+            {
+                builder.add(key.first, key.second, 1.0);
+            }
+            Compressed m = builder.build_csr();
+        });
+
+        double sum = 0;
+        run_benchmark(reporter, options, "access", "map", Size, density, allocated, allocated, [&]()
+        {
+            Matrix& m = const_cast<Matrix&>(a);
+            for (const auto& key : keys)
+            {
+                sum += m(key.first, key.second);
+            }
+        });
+        run_benchmark(reporter, options, "access", "csr", Size, density, allocated, allocated, [&]()
+        {
+            for (const auto& key : keys)
+            {
+                sum += ca(key.first, key.second);
+            }
+        });
+
+        run_benchmark(reporter, options, "addition", "map", Size, density, 2 * allocated, 1, [&]()
+        {
+            Matrix m(a);
+            m += b;
+        });
+        run_benchmark(reporter, options, "addition", "csr", Size, density, 2 * allocated, 1, [&]()
+        {
+            Compressed m(ca);
+            m += cb;
+        });
+
+        run_benchmark(reporter, options, "scaling", "map", Size, density, allocated, 1, [&]()
+        {
+            Matrix m = 2.0 * a;
+        });
+        run_benchmark(reporter, options, "scaling", "csr", Size, density, allocated, 1, [&]()
+        {
+            Compressed m = 2.0 * ca;
+        });
+
+        // A chain of additions and scalings, which is evaluated in a single pass for map storage.
+        run_benchmark(reporter, options, "expression", "map", Size, density, 3 * allocated, 1, [&]()
+        {
+            Matrix m = 2.0 * a + b - 0.5 * a;
+        });
+        run_benchmark(reporter, options, "expression", "csr", Size, density, 3 * allocated, 1, [&]()
+        {
+            Compressed m = 2.0 * ca + cb - 0.5 * ca;
+        });
+
+        // The number of multiplications grows with the square of the density; skip products that take too long.
+        const double multiplications = allocated * density * Size;
+        if (multiplications <= 10.0 * options.max_nnz)
+        {
+            run_benchmark(reporter, options, "multiplication", "map", Size, density, 2 * allocated, 1, [&]()
+            {
+                Matrix m = a * b;
+            });
+            run_benchmark(reporter, options, "multiplication", "csr", Size, density, 2 * allocated, 1, [&]()
+            {
+                Compressed m = ca * cb;
+            });
+        }
+        else
+        {
+            std::fprintf(stderr, "skipped: multiplication rows=%zu density=%g (%g multiplications)\n", Size, density,
+                         multiplications);
+        }
+
+        run_benchmark(reporter, options, "transpose", "map", Size, density, allocated, 1, [&]()
+        {
+            Matrix m = const_cast<Matrix&>(a).transpose();
+        });
+        run_benchmark(reporter, options, "transpose", "csr", Size, density, allocated, 1, [&]()
+        {
+            Compressed m = ca.transpose();
+        });
+
+        // Keep the result of the element access alive.
+        if (sum < 0)
+        {
+            std::printf("%g\n", sum);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    options.max_nnz = 10000000;
+    try
+    {
+        options.parse(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\nusage: %s [--format csv|json] [--output file] [--csv file] [--json file] "
+                             "[--min-time seconds] [--max-nnz count]\n", e.what(), argv[0]);
+        return 1;
+    }
+
+    BenchReporter reporter;
+    bench_size<1000>(reporter, options);
+    bench_size<10000>(reporter, options);
+    bench_size<100000>(reporter, options);
+    bench_size<1000000>(reporter, options);
+    reporter.write(options);
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "bench_common.h"
+#include "csrmatrix.h"
+#include "threadpool.h"
+#include "triangularsolve.h"
+
+
+//! Number of rows and columns of the benchmark matrices.
+static const size_t Size = 100000;
+
+//! Time an operation on a triangular matrix and add the result to the report.
+/*!
+ * \param reporter collects the result.
+ * \param options command line options.
+ * \param benchmark name of the matrix.
+ * \param method name of the solve method.
+ * \param threads number of threads used by the operation.
+ * \param allocated number of allocated elements of the matrix.
+ * \param operation callable that runs the operation once.
+ */
+template <typename Operation>
+void time_solve(BenchReporter& reporter, const BenchOptions& options, const char* benchmark, const char* method,
+                size_t threads, size_t allocated, const Operation& operation)
+{
+    reset_peak_rss();
+
+    size_t runs;
+    const double seconds = time_operation(options.min_time, operation, runs);
+
+    BenchRecord record;
+    record.benchmark = benchmark;
+    record.storage = method;
+    record.rows = Size;
+    record.density = static_cast<double>(allocated) / Size / Size;
+    record.allocated = allocated;
+    record.threads = threads;
+    record.operations = runs;
+    record.ns_per_op = seconds * 1e9;
+    record.nnz_per_s = allocated / seconds;
+    record.bytes_per_s = allocated * (sizeof(double) + sizeof(size_t)) / seconds;
+    record.peak_rss_kb = peak_rss_kb();
+    reporter.add(record);
+}
+
+//! Benchmark the solve of a lower triangular system.
+/*!
+ * Times the analysis of the level schedule, a solve without a schedule, and solves with the schedule on one thread
+ * and on all hardware threads.
+ *
+ * \param reporter collects the results.
+ * \param options command line options.
+ * \param benchmark name of the matrix.
+ * \param a lower triangular matrix.
+ */
+void bench_solve(BenchReporter& reporter, const BenchOptions& options, const char* benchmark,
+                 const CsrMatrix<Size, Size, double>& a)
+{
+    const LevelSchedule<Size> schedule(a, Triangle::Lower);
+    std::fprintf(stderr, "%s: %zu levels, %.1f rows per level\n", benchmark, schedule.levels(),
+                 schedule.parallelism());
+
+    std::vector<double> b(Size, 1.0);
+    std::vector<double> x(Size);
+    time_solve(reporter, options, benchmark, "analysis", 1, a.allocated(), [&]()
+    {
+        LevelSchedule<Size> s(a, Triangle::Lower);
+    });
+    time_solve(reporter, options, benchmark, "serial", 1, a.allocated(), [&]()
+    {
+        triangular_solve(a, Triangle::Lower, b, x);
+    });
+    time_solve(reporter, options, benchmark, "schedule", 1, a.allocated(), [&]()
+    {
+        triangular_solve(a, schedule, b, x);
+    });
+
+    const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool pool(threads);
+    time_solve(reporter, options, benchmark, "schedule-pool", threads, a.allocated(), [&]()
+    {
+        triangular_solve(pool, a, schedule, b, x);
+    });
+}
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    try
+    {
+        options.parse(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\nusage: %s [--format csv|json] [--output file] [--csv file] [--json file] "
+                             "[--min-time seconds] [--max-nnz count]\n", e.what(), argv[0]);
+        return 1;
+    }
+
+    BenchReporter reporter;
+
+    // Lower triangle of a five-point stencil on a 250 x 400 grid: the levels are the anti-diagonals of the grid.
+    const size_t width = 250;
+    SparseMatrix<Size, Size, double> stencil;
+    for (size_t i = 0; i < Size; ++i)
+    {
+        stencil(i, i) = 4.0;
+        if (i % width != 0)
+        {
+            stencil(i, i - 1) = -1.0;
+        }
+        if (i >= width)
+        {
+            stencil(i, i - width) = -1.0;
+        }
+    }
+    bench_solve(reporter, options, "solve-stencil5", CsrMatrix<Size, Size, double>(stencil));
+
+    // Lower triangle of a matrix with uniformly distributed elements, with a dominant diagonal.
+    const size_t allocated = std::min<size_t>(options.max_nnz, Size * 10);
+    const SparseMatrix<Size, Size, double> r = random_matrix<Size, Size, double>(allocated, 1);
+    SparseMatrix<Size, Size, double> random;
+    for (auto elem = r.cbegin(); elem != r.cend(); ++elem)
+    {
+        if (elem->first.second < elem->first.first)
+        {
+            random(elem->first.first, elem->first.second) = elem->second;
+        }
+    }
+    for (size_t i = 0; i < Size; ++i)
+    {
+        random(i, i) = 10.0;
+    }
+    bench_solve(reporter, options, "solve-uniform", CsrMatrix<Size, Size, double>(random));
+
+    reporter.write(options);
+
+    return 0;
+}
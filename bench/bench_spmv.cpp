@@ -0,0 +1,379 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_common.h"
+#include "bsrmatrix.h"
+#include "csrmatrix.h"
+#include "diamatrix.h"
+#include "sellmatrix.h"
+#include "symmetricmatrix.h"
+#include "threadpool.h"
+
+
+//! Number of rows and columns of the benchmark matrices.
+static const size_t Size = 100000;
+
+//! Time a matrix-vector product and add the result to the report.
+/*!
+ * The bandwidth is computed from the bytes of matrix storage read by one product.
+ *
+ * \param reporter collects the result.
+ * \param options command line options.
+ * \param benchmark name of the matrix.
+ * \param storage name of the storage format and work distribution.
+ * \param threads number of threads used by the product.
+ * \param allocated number of allocated elements of the matrix.
+ * \param bytes number of bytes of matrix storage read by one product.
+ * \param product callable that computes one product.
+ */
+template <typename Product>
+void time_spmv(BenchReporter& reporter, const BenchOptions& options, const char* benchmark, const char* storage,
+               size_t threads, size_t allocated, size_t bytes, const Product& product)
+{
+    reset_peak_rss();
+
+    size_t runs;
+    const double seconds = time_operation(options.min_time, product, runs);
+
+    BenchRecord record;
+    record.benchmark = benchmark;
+    record.storage = storage;
+    record.rows = Size;
+    record.density = static_cast<double>(allocated) / Size / Size;
+    record.allocated = allocated;
+    record.threads = threads;
+    record.operations = runs;
+    record.ns_per_op = seconds * 1e9;
+    record.nnz_per_s = allocated / seconds;
+    record.bytes_per_s = bytes / seconds;
+    record.peak_rss_kb = peak_rss_kb();
+    reporter.add(record);
+}
+
+//! Benchmark all matrix-vector products for a matrix.
+/*!
+ * \param reporter collects the results.
+ * \param options command line options.
+ * \param name label for the matrix.
+ * \param s matrix in map storage.
+ */
+void bench_matrix(BenchReporter& reporter, const BenchOptions& options, const char* name,
+                  const SparseMatrix<Size, Size, double>& s)
+{
+    CsrMatrix<Size, Size, double> c(s);
+
+    // Bytes of storage read by one product: values, indices and row pointers.
+    const size_t bytes = c.allocated() * (sizeof(double) + sizeof(size_t)) + (Size + 1) * sizeof(size_t);
+
+    std::vector<double> x(Size, 1.0);
+    std::vector<double> y(Size);
+
+    time_spmv(reporter, options, name, "map", 1, s.allocated(), bytes, [&]() { s.multiply(x, y); });
+    time_spmv(reporter, options, name, "csr", 1, c.allocated(), bytes, [&]() { c.multiply(x, y); });
+
+    // Kernels per instruction set, for double and float values with 64-bit and 32-bit indices.
+    const std::vector<uint32_t> col_idx32(c.col_idx().cbegin(), c.col_idx().cend());
+    const std::vector<float> values32(c.values().cbegin(), c.values().cend());
+    const std::vector<float> x32(Size, 1.0f);
+    std::vector<float> y32(Size);
+    const size_t bytes32 = c.allocated() * (sizeof(float) + sizeof(uint32_t)) + (Size + 1) * sizeof(size_t);
+    for (const SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Avx512})
+    {
+        if (level > simd_level())
+        {
+            continue;
+        }
+
+        const std::string suffix = level == SimdLevel::Scalar ? "scalar" : level == SimdLevel::Avx2 ? "avx2" : "avx512";
+        time_spmv(reporter, options, name, ("csr-double-" + suffix).c_str(), 1, c.allocated(), bytes, [&]()
+        {
+            sparsematrix_detail::csr_spmv_level(level, 0, Size, c.row_ptr().data(), c.col_idx().data(),
+                                                c.values().data(), 1.0, x.data(), 0.0, y.data());
+        });
+        time_spmv(reporter, options, name, ("csr-float32-" + suffix).c_str(), 1, c.allocated(), bytes32, [&]()
+        {
+            sparsematrix_detail::csr_spmv_level(level, 0, Size, c.row_ptr().data(), col_idx32.data(),
+                                                values32.data(), 1.0f, x32.data(), 0.0f, y32.data());
+        });
+    }
+
+    // Sliced ELLPACK storage with chunks of one AVX-512 vector, per instruction set. The bandwidth includes padding.
+    const SellMatrix<Size, Size, double, size_t, 8> sell(c);
+    SparseMatrix<Size, Size, float, uint32_t> s32;
+    for (auto elem = s.cbegin(); elem != s.cend(); ++elem)
+    {
+        s32(elem->first.first, elem->first.second) = static_cast<float>(elem->second);
+    }
+    const SellMatrix<Size, Size, float, uint32_t, 16> sell32(s32);
+    const size_t sell_bytes = sell.stored() * (sizeof(double) + sizeof(size_t)) + Size * sizeof(size_t);
+    const size_t sell_bytes32 = sell32.stored() * (sizeof(float) + sizeof(uint32_t)) + Size * sizeof(uint32_t);
+    std::fprintf(stderr, "%s: SELL-8 padding %.1f%%, SELL-16 padding %.1f%%\n", name, 100 * sell.padding_overhead(),
+                 100 * sell32.padding_overhead());
+    for (const SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Avx512})
+    {
+        if (level > simd_level())
+        {
+            continue;
+        }
+
+        const std::string suffix = level == SimdLevel::Scalar ? "scalar" : level == SimdLevel::Avx2 ? "avx2" : "avx512";
+        time_spmv(reporter, options, name, ("sell-double-" + suffix).c_str(), 1, c.allocated(), sell_bytes, [&]()
+        {
+            sparsematrix_detail::sell_spmv_level<8>(level, 0, sell.chunk_ptr().size() - 1, Size,
+                                                    sell.chunk_ptr().data(), sell.perm().data(),
+                                                    sell.col_idx().data(), sell.values().data(), 1.0, x.data(), 0.0,
+                                                    y.data());
+        });
+        time_spmv(reporter, options, name, ("sell-float32-" + suffix).c_str(), 1, c.allocated(), sell_bytes32, [&]()
+        {
+            sparsematrix_detail::sell_spmv_level<16>(level, 0, sell32.chunk_ptr().size() - 1, Size,
+                                                     sell32.chunk_ptr().data(), sell32.perm().data(),
+                                                     sell32.col_idx().data(), sell32.values().data(), 1.0f,
+                                                     x32.data(), 0.0f, y32.data());
+        });
+    }
+
+    // Scaling of the parallel product with the number of threads: powers of two and the number of hardware threads.
+    const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> thread_counts;
+    for (size_t threads = 1; threads < max_threads; threads *= 2)
+    {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    for (const size_t threads : thread_counts)
+    {
+        ThreadPool pool(threads);
+        time_spmv(reporter, options, name, "csr-rows", threads, c.allocated(), bytes,
+                  [&]() { c.multiply(pool, x, y); });
+        time_spmv(reporter, options, name, "csr-path", threads, c.allocated(), bytes,
+                  [&]() { c.multiply(pool, x, y, Partitioning::MergePath); });
+    }
+
+    // Products with a block of dense vectors: one sparse-dense product against one matrix-vector product per column.
+    // The bandwidth includes reading B and writing C once.
+    const size_t k = 64;
+    std::vector<double> b(Size * k, 1.0);
+    std::vector<double> out(Size * k);
+    const size_t spmm_bytes = bytes + 2 * Size * k * sizeof(double);
+    const std::string spmm_name = std::string(name) + "-spmm64";
+    time_spmv(reporter, options, spmm_name.c_str(), "csr-spmv", 1, c.allocated(), spmm_bytes, [&]()
+    {
+        for (size_t j = 0; j < k; ++j)
+        {
+            c.multiply(b.data() + j * Size, out.data() + j * Size);
+        }
+    });
+    time_spmv(reporter, options, spmm_name.c_str(), "csr-row-major", 1, c.allocated(), spmm_bytes,
+              [&]() { c.multiply(k, b, out); });
+    time_spmv(reporter, options, spmm_name.c_str(), "csr-col-major", 1, c.allocated(), spmm_bytes,
+              [&]() { c.multiply(k, b, out, DenseLayout::ColumnMajor); });
+}
+
+//! Benchmark block storage for a matrix made of dense 4 x 4 blocks.
+/*!
+ * Compares compressed row storage with block storage for the same matrix, for a matrix-vector product and a product
+ * with a block of 64 vectors.
+ *
+ * \param reporter collects the results.
+ * \param options command line options.
+ * \param allocated number of elements of the matrix.
+ */
+void bench_blocks(BenchReporter& reporter, const BenchOptions& options, size_t allocated)
+{
+    const size_t B = 4;
+    const SparseMatrix<Size / B, Size / B, double> nodes = random_matrix<Size / B, Size / B, double>(
+        allocated / (B * B), 3);
+    SparseMatrix<Size, Size, double> s;
+    for (auto elem = nodes.cbegin(); elem != nodes.cend(); ++elem)
+    {
+        for (size_t i = 0; i < B; ++i)
+        {
+            for (size_t j = 0; j < B; ++j)
+            {
+                s(elem->first.first * B + i, elem->first.second * B + j) = elem->second + i + j;
+            }
+        }
+    }
+
+    const CsrMatrix<Size, Size, double> c(s);
+    const BsrMatrix<Size, Size, B, double> b4(c);
+    std::fprintf(stderr, "spmv-blocks4: recommended block size %zu\n", recommend_block_size(c));
+
+    const size_t bytes = c.allocated() * (sizeof(double) + sizeof(size_t)) + (Size + 1) * sizeof(size_t);
+    const size_t bsr_bytes = b4.allocated() * sizeof(double) + b4.blocks() * sizeof(size_t) +
+                             (Size / B + 1) * sizeof(size_t);
+
+    std::vector<double> x(Size, 1.0);
+    std::vector<double> y(Size);
+    time_spmv(reporter, options, "spmv-blocks4", "csr", 1, c.allocated(), bytes, [&]() { c.multiply(x, y); });
+    time_spmv(reporter, options, "spmv-blocks4", "bsr-4", 1, c.allocated(), bsr_bytes, [&]() { b4.multiply(x, y); });
+
+    const size_t k = 64;
+    std::vector<double> dense(Size * k, 1.0);
+    std::vector<double> out(Size * k);
+    time_spmv(reporter, options, "spmv-blocks4-spmm64", "csr-row-major", 1, c.allocated(),
+              bytes + 2 * Size * k * sizeof(double), [&]() { c.multiply(k, dense, out); });
+    time_spmv(reporter, options, "spmv-blocks4-spmm64", "bsr-4-row-major", 1, c.allocated(),
+              bsr_bytes + 2 * Size * k * sizeof(double), [&]() { b4.multiply(k, dense, out); });
+}
+
+//! Benchmark diagonal storage for a five-point stencil on a 250 x 400 grid.
+/*!
+ * Compares compressed row storage with diagonal storage for the same matrix.
+ *
+ * \param reporter collects the results.
+ * \param options command line options.
+ */
+void bench_stencil(BenchReporter& reporter, const BenchOptions& options)
+{
+    const size_t width = 250;
+    SparseMatrix<Size, Size, double> s;
+    for (size_t i = 0; i < Size; ++i)
+    {
+        s(i, i) = 4.0;
+        if (i % width != 0)
+        {
+            s(i, i - 1) = -1.0;
+        }
+        if (i % width != width - 1)
+        {
+            s(i, i + 1) = -1.0;
+        }
+        if (i >= width)
+        {
+            s(i, i - width) = -1.0;
+        }
+        if (i + width < Size)
+        {
+            s(i, i + width) = -1.0;
+        }
+    }
+
+    const CsrMatrix<Size, Size, double> c(s);
+    const DiaMatrix<Size, Size, double> d(c);
+
+    const size_t bytes = c.allocated() * (sizeof(double) + sizeof(size_t)) + (Size + 1) * sizeof(size_t);
+    const size_t dia_bytes = d.values().size() * sizeof(double);
+
+    std::vector<double> x(Size, 1.0);
+    std::vector<double> y(Size);
+    time_spmv(reporter, options, "spmv-stencil5", "csr", 1, c.allocated(), bytes, [&]() { c.multiply(x, y); });
+    time_spmv(reporter, options, "spmv-stencil5", "dia", 1, c.allocated(), dia_bytes, [&]() { d.multiply(x, y); });
+}
+
+//! Benchmark symmetric storage for a random symmetric matrix.
+/*!
+ * Compares compressed row storage of both triangles with symmetric storage of the upper triangle for the same matrix,
+ * on one thread and on all hardware threads. The symmetric product has no vectorized kernel, so the scalar CSR kernel
+ * is timed as well.
+ *
+ * \param reporter collects the results.
+ * \param options command line options.
+ * \param allocated number of elements of the matrix.
+ */
+void bench_symmetric(BenchReporter& reporter, const BenchOptions& options, size_t allocated)
+{
+    const CsrMatrix<Size, Size, double> half(random_matrix<Size, Size, double>(allocated / 2, 4));
+    SparseMatrix<Size, Size, double> s;
+    for (size_t i = 0; i < Size; ++i)
+    {
+        for (size_t n = half.row_ptr()[i]; n < half.row_ptr()[i + 1]; ++n)
+        {
+            s(i, half.col_idx()[n]) = half.values()[n];
+            s(half.col_idx()[n], i) = half.values()[n];
+        }
+    }
+
+    const CsrMatrix<Size, Size, double> c(s);
+    const SymmetricMatrix<Size, double> m(c);
+
+    const size_t bytes = c.allocated() * (sizeof(double) + sizeof(size_t)) + (Size + 1) * sizeof(size_t);
+    const size_t sym_bytes = m.allocated() * (sizeof(double) + sizeof(size_t)) + (Size + 1) * sizeof(size_t);
+
+    std::vector<double> x(Size, 1.0);
+    std::vector<double> y(Size);
+    time_spmv(reporter, options, "spmv-symmetric", "csr", 1, c.allocated(), bytes, [&]() { c.multiply(x, y); });
+    time_spmv(reporter, options, "spmv-symmetric", "csr-double-scalar", 1, c.allocated(), bytes, [&]()
+    {
+        sparsematrix_detail::csr_spmv_level(SimdLevel::Scalar, 0, Size, c.row_ptr().data(), c.col_idx().data(),
+                                            c.values().data(), 1.0, x.data(), 0.0, y.data());
+    });
+    time_spmv(reporter, options, "spmv-symmetric", "symmetric", 1, c.allocated(), sym_bytes,
+              [&]() { m.multiply(x, y); });
+
+    const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool pool(threads);
+    time_spmv(reporter, options, "spmv-symmetric", "csr-pool", threads, c.allocated(), bytes,
+              [&]() { c.multiply(pool, x, y); });
+    time_spmv(reporter, options, "spmv-symmetric", "symmetric-pool", threads, c.allocated(), sym_bytes,
+              [&]() { m.multiply(pool, x, y); });
+}
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    try
+    {
+        options.parse(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\nusage: %s [--format csv|json] [--output file] [--csv file] [--json file] "
+                             "[--min-time seconds] [--max-nnz count]\n", e.what(), argv[0]);
+        return 1;
+    }
+
+    BenchReporter reporter;
+
+    // Uniformly distributed elements.
+    const size_t allocated = std::min<size_t>(options.max_nnz, Size * 10);
+    bench_matrix(reporter, options, "spmv-uniform", random_matrix<Size, Size, double>(allocated, 1));
+
+    // A single dense row holding about a third of all elements.
+    SparseMatrix<Size, Size, double> skewed = random_matrix<Size, Size, double>(allocated / 5, 2);
+    for (size_t j = 0; j < Size; ++j)
+    {
+        skewed(Size / 2, j) = 1.0;
+    }
+    bench_matrix(reporter, options, "spmv-skewed", skewed);
+
+    // Dense 4 x 4 blocks, like a finite element matrix with four degrees of freedom per node.
+    bench_blocks(reporter, options, allocated);
+
+    // A banded matrix from a finite difference discretization.
+    bench_stencil(reporter, options);
+
+    // A symmetric matrix, stored in full and by its upper triangle.
+    bench_symmetric(reporter, options, allocated);
+
+    reporter.write(options);
+
+    return 0;
+}
@@ -81,16 +81,21 @@ int main(int argc, char* argv[])
     u(1, 2) = 6;
     std::cout << "u = \n" << u;
 
-    // Unitary operations return a copy.
+    // Negation, addition, subtraction and scaling return an expression, which is evaluated when it is assigned to a
+    // matrix or with eval().
     std::cout << "Unitary operations:\n";
-    std::cout << "-s = \n" << -s;
+    std::cout << "-s = \n" << (-s).eval();
     std::cout << "+s = \n" << +s;
 
-    // Binary operations also return a copy. Dimensions are check at compile time.
+    // Dimensions are check at compile time.
     std::cout << "Addition and subtraction:\n";
-    std::cout << "s + t = \n" << s + t;
-    std::cout << "s - t = \n" << s - t;
-    // std::cout << "s - u = \n" << s - u;  // invalid operands to binary expression
+    std::cout << "s + t = \n" << (s + t).eval();
+    std::cout << "s - t = \n" << (s - t).eval();
+    // std::cout << "s - u = \n" << (s - u).eval();  // invalid operands to binary expression
+
+    // Chains of additions, subtractions and scalings are evaluated in a single pass.
+    SparseMatrix<2, 2, int> v = 2 * s + t - 3 * t;
+    std::cout << "2 * s + t - 3 * t = \n" << v;
 
     std::cout << "Multiplication:\n";
     std::cout << "t * u = \n" << t * u;
@@ -0,0 +1,903 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#ifndef BINARYMATRIX_H
+#define BINARYMATRIX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "csrkernels.h"
+#include "csrmatrix.h"
+#include "sparsematrix.h"
+#include "threadpool.h"
+
+
+//! Algorithms shared by the matrix classes.
+namespace sparsematrix_detail
+{
+
+//! Identification of a binary matrix file, at the start of the header.
+static const char binary_magic[8] = {'S', 'P', 'M', 'A', 'T', 'C', 'S', 'R'};
+
+//! Version of the binary matrix format.
+static const uint32_t binary_version = 1;
+
+//! Written in native byte order, to detect files written on a machine with another byte order.
+static const uint32_t binary_byte_order = 0x01020304;
+
+//! Alignment of the arrays in a binary matrix file, in bytes (a cache line).
+static const uint64_t binary_alignment = 64;
+
+//! Header of a binary matrix file
+/*!
+ * The file starts with this header, followed by the row pointers (rows + 1 unsigned 64-bit integers), the column
+ * indices (allocated elements of the index type) and the values (allocated elements of the value type). Every array
+ * starts at a multiple of binary_alignment bytes from the start of the file; the gaps are filled with zeros. All
+ * numbers are in the byte order of the machine that wrote the file.
+ */
+struct BinaryHeader
+{
+    //! Identification of the file, equal to binary_magic.
+    char magic[8];
+
+    //! Version of the format, equal to binary_version.
+    uint32_t version;
+
+    //! Byte order marker, equal to binary_byte_order.
+    uint32_t byte_order;
+
+    //! Size of a column index in bytes.
+    uint32_t index_bytes;
+
+    //! Type of the values, see binary_value_type().
+    uint32_t value_type;
+
+    //! Number of rows.
+    uint64_t rows;
+
+    //! Number of columns.
+    uint64_t cols;
+
+    //! Number of allocated elements.
+    uint64_t allocated;
+
+    //! Offset of the row pointers from the start of the file, in bytes.
+    uint64_t row_ptr_offset;
+
+    //! Offset of the column indices from the start of the file, in bytes.
+    uint64_t col_idx_offset;
+
+    //! Offset of the values from the start of the file, in bytes.
+    uint64_t values_offset;
+};
+
+//! Code of a value type in a binary matrix file
+/*!
+ * The code is the kind of number (1 for floating point, 2 for signed and 3 for unsigned integers) times 256, plus the
+ * size in bytes. Other types, and floating point types other than float and double, have code zero and cannot be
+ * stored.
+ *
+ * \return the code of T.
+ */
+template <typename T>
+constexpr uint32_t binary_value_type()
+{
+    return std::is_floating_point<T>::value
+               ? ((sizeof(T) == 4 || sizeof(T) == 8) ? 0x100 + sizeof(T) : 0)
+               : std::is_integral<T>::value
+                     ? (std::is_signed<T>::value ? 0x200 : 0x300) + sizeof(T)
+                     : 0;
+}
+
+//! Offset of the next aligned array.
+/*!
+ * \param offset end of the previous array.
+ * \return offset rounded up to a multiple of binary_alignment.
+ */
+inline uint64_t binary_align(uint64_t offset)
+{
+    return (offset + binary_alignment - 1) / binary_alignment * binary_alignment;
+}
+
+//! Writer of a binary matrix file
+/*!
+ * Writes the header and the arrays in order, with std::fwrite. Small pieces of data are collected in a buffer first.
+ */
+class BinaryWriter
+{
+    private:
+        //! The file.
+        std::FILE* _file;
+
+        //! Buffer.
+        std::vector<char> _buffer;
+
+        //! End of the data in the buffer.
+        size_t _end;
+
+        //! Number of bytes written so far, including the buffer.
+        uint64_t _offset;
+
+        //! Write the buffer to the file.
+        void flush()
+        {
+            if (_end > 0 && std::fwrite(_buffer.data(), 1, _end, _file) != _end)
+            {
+                throw std::runtime_error("write error");
+            }
+            _end = 0;
+        }
+
+    public:
+        //! Constructor; creates the file.
+        /*!
+         * Throws std::runtime_error if the file cannot be created.
+         *
+         * \param filename name of the file.
+         */
+        explicit BinaryWriter(const std::string& filename)
+            : _file(std::fopen(filename.c_str(), "wb")), _buffer(1 << 16), _end(0), _offset(0)
+        {
+            if (_file == nullptr)
+            {
+                throw std::runtime_error("cannot create " + filename);
+            }
+        }
+
+        //! Writers cannot be copied.
+        BinaryWriter(const BinaryWriter&) = delete;
+
+        //! Writers cannot be copied.
+        BinaryWriter& operator=(const BinaryWriter&) = delete;
+
+        //! Destructor; closes the file if close() was not called, ignoring errors.
+        ~BinaryWriter()
+        {
+            if (_file != nullptr)
+            {
+                std::fclose(_file);
+            }
+        }
+
+        //! Write data.
+        /*!
+         * Data that does not fit in the buffer is written directly.
+         *
+         * \param data the data.
+         * \param bytes number of bytes.
+         */
+        void write(const void* data, size_t bytes)
+        {
+            if (bytes == 0)
+            {
+                return;
+            }
+            if (_end + bytes > _buffer.size())
+            {
+                flush();
+            }
+            if (bytes > _buffer.size())
+            {
+                if (std::fwrite(data, 1, bytes, _file) != bytes)
+                {
+                    throw std::runtime_error("write error");
+                }
+            }
+            else
+            {
+                std::memcpy(_buffer.data() + _end, data, bytes);
+                _end += bytes;
+            }
+            _offset += bytes;
+        }
+
+        //! Write a single value.
+        /*!
+         * \param value the value.
+         */
+        template <typename V>
+        void put(const V& value)
+        {
+            write(&value, sizeof(V));
+        }
+
+        //! Pad with zeros up to an offset.
+        /*!
+         * \param offset offset from the start of the file, at or after the current position.
+         */
+        void pad(uint64_t offset)
+        {
+            static const char zeros[binary_alignment] = {};
+            while (_offset < offset)
+            {
+                write(zeros, static_cast<size_t>(std::min(offset - _offset, binary_alignment)));
+            }
+        }
+
+        //! Flush the buffer and close the file.
+        /*!
+         * Throws std::runtime_error if not all data could be written.
+         */
+        void close()
+        {
+            flush();
+            const int result = std::fclose(_file);
+            _file = nullptr;
+            if (result != 0)
+            {
+                throw std::runtime_error("write error");
+            }
+        }
+};
+
+//! Header of a binary matrix file with the given contents.
+/*!
+ * \param rows number of rows.
+ * \param cols number of columns.
+ * \param allocated number of allocated elements.
+ * \return the header, with the arrays at aligned offsets.
+ */
+template <typename T, typename I>
+BinaryHeader binary_header(size_t rows, size_t cols, size_t allocated)
+{
+    static_assert(binary_value_type<T>() != 0, "value type cannot be stored in binary format");
+
+    BinaryHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, binary_magic, sizeof(header.magic));
+    header.version = binary_version;
+    header.byte_order = binary_byte_order;
+    header.index_bytes = sizeof(I);
+    header.value_type = binary_value_type<T>();
+    header.rows = rows;
+    header.cols = cols;
+    header.allocated = allocated;
+    header.row_ptr_offset = binary_align(sizeof(BinaryHeader));
+    header.col_idx_offset = binary_align(header.row_ptr_offset + (header.rows + 1) * sizeof(uint64_t));
+    header.values_offset = binary_align(header.col_idx_offset + header.allocated * sizeof(I));
+    return header;
+}
+
+}  // namespace sparsematrix_detail
+
+
+//! Read-only view of a sparse matrix in a memory-mapped binary file, of type T, in Compressed Sparse Row (CSR) format
+/*!
+ * Binary files are written with write_binary(). They hold the CSR arrays of a matrix, exactly as they are laid out in
+ * memory, so opening a file does not read or convert it: the file is mapped into memory and the arrays are used in
+ * place. Only the header is checked when the file is opened; the pages with the elements are read by the operating
+ * system when they are first accessed, and they can be shared by all processes that map the same file. Opening a
+ * file therefore takes about the same time for any size of matrix.
+ *
+ * The dimensions are read from the file, like the dimensions of a DynamicSparseMatrix are set at runtime. The value
+ * type T and index type I must match the types that were written. Only the first and last row pointer are checked
+ * when the file is opened; call validate() to check all arrays of a file that may be corrupt before using it, since
+ * invalid arrays make element access and products read outside the file. The file must not be changed while it is
+ * mapped.
+ *
+ * Mapping uses the POSIX mmap() call.
+ */
+template <typename T, typename I = size_t>
+class MappedCsrMatrix
+{
+    static_assert(std::is_integral<I>::value && std::is_unsigned<I>::value, "index type must be unsigned integer");
+    static_assert(sparsematrix_detail::binary_value_type<T>() != 0, "value type cannot be stored in binary format");
+    static_assert(sizeof(size_t) == sizeof(uint64_t), "row pointers can only be mapped with 64-bit size_t");
+
+    private:
+        //! Start of the mapped file.
+        void* _data;
+
+        //! Size of the mapped file in bytes.
+        size_t _bytes;
+
+        //! Number of rows.
+        size_t _rows;
+
+        //! Number of columns.
+        size_t _cols;
+
+        //! Row pointers in the mapped file.
+        const size_t* _row_ptr;
+
+        //! Column indices in the mapped file.
+        const I* _col_idx;
+
+        //! Values in the mapped file.
+        const T* _values;
+
+        //! Check the header of the mapped file and locate the arrays.
+        /*!
+         * Throws std::runtime_error if the file is not a binary matrix file of type T and index type I, or if it is
+         * truncated.
+         */
+        void check_header()
+        {
+            if (_bytes < sizeof(sparsematrix_detail::BinaryHeader))
+            {
+                throw std::runtime_error("not a binary matrix file");
+            }
+
+            sparsematrix_detail::BinaryHeader header;
+            std::memcpy(&header, _data, sizeof(header));
+            if (std::memcmp(header.magic, sparsematrix_detail::binary_magic, sizeof(header.magic)) != 0)
+            {
+                throw std::runtime_error("not a binary matrix file");
+            }
+            if (header.version != sparsematrix_detail::binary_version)
+            {
+                throw std::runtime_error("unsupported binary matrix version");
+            }
+            if (header.byte_order != sparsematrix_detail::binary_byte_order)
+            {
+                throw std::runtime_error("binary matrix file has different byte order");
+            }
+            if (header.index_bytes != sizeof(I) || header.value_type != sparsematrix_detail::binary_value_type<T>())
+            {
+                throw std::runtime_error("binary matrix file has different index or value type");
+            }
+            if (!sparsematrix_detail::index_fits<I>(header.rows) || !sparsematrix_detail::index_fits<I>(header.cols))
+            {
+                throw std::runtime_error("matrix dimensions exceed index type");
+            }
+
+            // Every array must be aligned and lie within the file; sizes are compared by division to avoid overflow.
+            if (header.row_ptr_offset % alignof(size_t) != 0 || header.col_idx_offset % alignof(I) != 0 ||
+                header.values_offset % alignof(T) != 0 || header.row_ptr_offset > _bytes ||
+                header.col_idx_offset > _bytes || header.values_offset > _bytes ||
+                (_bytes - header.row_ptr_offset) / sizeof(size_t) <= header.rows ||
+                (_bytes - header.col_idx_offset) / sizeof(I) < header.allocated ||
+                (_bytes - header.values_offset) / sizeof(T) < header.allocated)
+            {
+                throw std::runtime_error("binary matrix file is truncated");
+            }
+
+            _rows = static_cast<size_t>(header.rows);
+            _cols = static_cast<size_t>(header.cols);
+            _row_ptr = reinterpret_cast<const size_t*>(static_cast<const char*>(_data) + header.row_ptr_offset);
+            _col_idx = reinterpret_cast<const I*>(static_cast<const char*>(_data) + header.col_idx_offset);
+            _values = reinterpret_cast<const T*>(static_cast<const char*>(_data) + header.values_offset);
+
+            if (_row_ptr[0] != 0 || _row_ptr[_rows] != header.allocated)
+            {
+                throw std::runtime_error("binary matrix file is corrupt");
+            }
+        }
+
+        //! Unmap the file.
+        void unmap()
+        {
+            if (_data != nullptr)
+            {
+                ::munmap(_data, _bytes);
+                _data = nullptr;
+            }
+        }
+
+    public:
+        //! Constructor; maps a file.
+        /*!
+         * Maps a file that was written by write_binary() for a matrix of type T and index type I. Only the header is
+         * read. Throws std::runtime_error if the file cannot be opened or mapped, or if the header does not match.
+         *
+         * \param filename name of the file.
+         */
+        explicit MappedCsrMatrix(const std::string& filename)
+            : _data(nullptr), _bytes(0), _rows(0), _cols(0), _row_ptr(nullptr), _col_idx(nullptr), _values(nullptr)
+        {
+            const int fd = ::open(filename.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                throw std::runtime_error("cannot open " + filename);
+            }
+
+            struct stat status;
+            if (fstat(fd, &status) != 0)
+            {
+                ::close(fd);
+                throw std::runtime_error("cannot open " + filename);
+            }
+            _bytes = static_cast<size_t>(status.st_size);
+            if (_bytes < sizeof(sparsematrix_detail::BinaryHeader))
+            {
+                ::close(fd);
+                throw std::runtime_error("not a binary matrix file");
+            }
+
+            // The mapping keeps its own reference to the file, so the descriptor is not needed afterwards.
+            void* data = ::mmap(nullptr, _bytes, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (data == MAP_FAILED)
+            {
+                throw std::runtime_error("cannot map " + filename);
+            }
+            _data = data;
+
+            try
+            {
+                check_header();
+            }
+            catch (...)
+            {
+                unmap();
+                throw;
+            }
+        }
+
+        //! Mapped matrices cannot be copied; convert with to_csr() instead.
+        MappedCsrMatrix(const MappedCsrMatrix&) = delete;
+
+        //! Mapped matrices cannot be copied.
+        MappedCsrMatrix& operator=(const MappedCsrMatrix&) = delete;
+
+        //! Move-constructor; the mapping is transferred and other is left without elements.
+        MappedCsrMatrix(MappedCsrMatrix&& other)
+            : _data(other._data), _bytes(other._bytes), _rows(other._rows), _cols(other._cols),
+              _row_ptr(other._row_ptr), _col_idx(other._col_idx), _values(other._values)
+        {
+            other._data = nullptr;
+            other._bytes = 0;
+            other._rows = 0;
+            other._cols = 0;
+            other._row_ptr = nullptr;
+            other._col_idx = nullptr;
+            other._values = nullptr;
+        }
+
+        //! Move-assignment; the mapping is transferred and other is left without elements.
+        MappedCsrMatrix& operator=(MappedCsrMatrix&& other)
+        {
+            if (this != &other)
+            {
+                unmap();
+                std::swap(_data, other._data);
+                std::swap(_bytes, other._bytes);
+                std::swap(_rows, other._rows);
+                std::swap(_cols, other._cols);
+                std::swap(_row_ptr, other._row_ptr);
+                std::swap(_col_idx, other._col_idx);
+                std::swap(_values, other._values);
+            }
+            return *this;
+        }
+
+        //! Destructor; unmaps the file.
+        ~MappedCsrMatrix()
+        {
+            unmap();
+        }
+
+        //! Conversion to compressed storage with fixed dimensions.
+        /*!
+         * Create a CsrMatrix with a copy of the allocated elements. This reads the whole file.
+         * Throws std::out_of_range if the size of this matrix is not M x N, or if the arrays in the file are not valid
+         * compressed row storage.
+         *
+         * \return the matrix in compressed storage.
+         */
+        template <size_t M, size_t N>
+        CsrMatrix<M, N, T, I> to_csr() const
+        {
+            if (_rows != M || _cols != N)
+            {
+                throw std::out_of_range("dimension mismatch");
+            }
+
+            return CsrMatrix<M, N, T, I>(std::vector<size_t>(_row_ptr, _row_ptr + M + 1),
+                                         std::vector<I>(_col_idx, _col_idx + allocated()),
+                                         std::vector<T>(_values, _values + allocated()));
+        }
+
+        //! Number of rows.
+        size_t rows() const
+        {
+            return _rows;
+        }
+
+        //! Number of columns.
+        size_t cols() const
+        {
+            return _cols;
+        }
+
+        //! Read an element at index (i,j).
+        /*!
+         * Read an individual element at row i and column j; elements that are not allocated read as zero.
+         * Throws std::out_of_range if either i or j exceeds the respective matrix dimension.
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return the value of the element at (i,j).
+         */
+        T operator()(size_t i, size_t j) const
+        {
+            if (i >= _rows || j >= _cols)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            const I* first = _col_idx + _row_ptr[i];
+            const I* last = _col_idx + _row_ptr[i + 1];
+            const I* pos = std::lower_bound(first, last, j);
+            if (pos == last || *pos != j)
+            {
+                return T(0);
+            }
+            return _values[pos - _col_idx];
+        }
+
+        //! Size of the matrix.
+        /*!
+         * Gives the size of the matrix as the number of elements, rows() x cols().
+         *
+         * \return the matrix size.
+         */
+        size_t size() const
+        {
+            return _rows * _cols;
+        }
+
+        //! Number of allocated elements.
+        /*!
+         * Get the number of allocated (stored) elements. This takes constant time.
+         *
+         * \return the number of allocated elements.
+         */
+        size_t allocated() const
+        {
+            return _rows == 0 ? 0 : _row_ptr[_rows];
+        }
+
+        //! Size of the mapped file.
+        /*!
+         * The mapped pages are not part of the memory used by the process until they are accessed, and they can be
+         * dropped and read again by the operating system.
+         *
+         * \return the size of the file in bytes.
+         */
+        size_t mapped_bytes() const
+        {
+            return _bytes;
+        }
+
+        //! Memory footprint.
+        /*!
+         * Get the memory used by the matrix: the size of this object plus the length of the mapping. Pages of the
+         * mapping that have not been accessed are counted as well, although they take no memory yet.
+         *
+         * \sa mapped_bytes()
+         *
+         * \return the memory footprint in bytes.
+         */
+        size_t memory_bytes() const
+        {
+            return sizeof(*this) + _bytes;
+        }
+
+        //! Check the arrays of the mapped file.
+        /*!
+         * Checks that the row pointers are non-decreasing and that the column indices within every row are strictly
+         * increasing and less than cols(), so that element access and products stay within the file. This reads the
+         * row pointers and column indices of the whole file.
+         * Throws std::runtime_error if the arrays are not valid compressed row storage.
+         */
+        void validate() const
+        {
+            for (size_t i = 0; i < _rows; ++i)
+            {
+                if (_row_ptr[i + 1] < _row_ptr[i])
+                {
+                    throw std::runtime_error("binary matrix file is corrupt");
+                }
+            }
+            for (size_t i = 0; i < _rows; ++i)
+            {
+                for (size_t n = _row_ptr[i]; n < _row_ptr[i + 1]; ++n)
+                {
+                    if (_col_idx[n] >= _cols || (n > _row_ptr[i] && _col_idx[n] <= _col_idx[n - 1]))
+                    {
+                        throw std::runtime_error("binary matrix file is corrupt");
+                    }
+                }
+            }
+        }
+
+        //! Peek if an element is allocated.
+        /*!
+         * Check if the element is stored. This is a binary search within row i.
+         * Throws std::out_of_range if either i or j exceeds the respective matrix dimension.
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return Boolean value indicating if the element is allocated.
+         */
+        bool peek(size_t i, size_t j) const
+        {
+            if (i >= _rows || j >= _cols)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            return std::binary_search(_col_idx + _row_ptr[i], _col_idx + _row_ptr[i + 1], j);
+        }
+
+        //! Row pointers (rows() + 1 elements); row i occupies positions [row_ptr()[i], row_ptr()[i + 1]).
+        const size_t* row_ptr() const
+        {
+            return _row_ptr;
+        }
+
+        //! Column indices of the allocated elements, in row-major order.
+        const I* col_idx() const
+        {
+            return _col_idx;
+        }
+
+        //! Values of the allocated elements, in row-major order.
+        const T* values() const
+        {
+            return _values;
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y for a dense vector x of cols() elements and a dense vector y of rows()
+         * elements, like CsrMatrix::multiply(). If beta is zero, y is not read. No memory is allocated.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector (cols() elements).
+         * \param beta scaling factor for y.
+         * \param y output vector (rows() elements).
+         */
+        void multiply(const T alpha, const T* x, const T beta, T* y) const
+        {
+            sparsematrix_detail::csr_spmv(0, _rows, _row_ptr, _col_idx, _values, alpha, x, beta, y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x for a dense vector x of cols() elements and a dense vector y of rows() elements.
+         *
+         * \param x input vector (cols() elements).
+         * \param y output vector (rows() elements).
+         */
+        void multiply(const T* x, T* y) const
+        {
+            multiply(T(1), x, T(0), y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y. The vectors are not resized.
+         * Throws std::out_of_range if x does not have cols() elements or y does not have rows() elements.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(const T alpha, const std::vector<T>& x, const T beta, std::vector<T>& y) const
+        {
+            if (x.size() != _cols || y.size() != _rows)
+            {
+                throw std::out_of_range("vector size mismatch");
+            }
+
+            multiply(alpha, x.data(), beta, y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x. The vectors are not resized.
+         * Throws std::out_of_range if x does not have cols() elements or y does not have rows() elements.
+         *
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(const std::vector<T>& x, std::vector<T>& y) const
+        {
+            multiply(T(1), x, T(0), y);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y like CsrMatrix::multiply(), using the threads of a pool. Every thread
+         * faults in the pages of its own part of the file on first use.
+         *
+         * \param pool threads to use.
+         * \param alpha scaling factor for A * x.
+         * \param x input vector (cols() elements).
+         * \param beta scaling factor for y.
+         * \param y output vector (rows() elements).
+         * \param partitioning work distribution over the threads.
+         */
+        void multiply(ThreadPool& pool, const T alpha, const T* x, const T beta, T* y,
+                      Partitioning partitioning = Partitioning::Rows) const
+        {
+            sparsematrix_detail::csr_spmv_parallel(pool, _rows, _row_ptr, _col_idx, _values, alpha, x, beta, y,
+                                                   partitioning);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y, using the threads of a pool. The vectors are not resized.
+         * Throws std::out_of_range if x does not have cols() elements or y does not have rows() elements.
+         *
+         * \param pool threads to use.
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         * \param partitioning work distribution over the threads.
+         */
+        void multiply(ThreadPool& pool, const T alpha, const std::vector<T>& x, const T beta, std::vector<T>& y,
+                      Partitioning partitioning = Partitioning::Rows) const
+        {
+            if (x.size() != _cols || y.size() != _rows)
+            {
+                throw std::out_of_range("vector size mismatch");
+            }
+
+            multiply(pool, alpha, x.data(), beta, y.data(), partitioning);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = A * x, using the threads of a pool. The vectors are not resized.
+         * Throws std::out_of_range if x does not have cols() elements or y does not have rows() elements.
+         *
+         * \param pool threads to use.
+         * \param x input vector.
+         * \param y output vector.
+         * \param partitioning work distribution over the threads.
+         */
+        void multiply(ThreadPool& pool, const std::vector<T>& x, std::vector<T>& y,
+                      Partitioning partitioning = Partitioning::Rows) const
+        {
+            multiply(pool, T(1), x, T(0), y, partitioning);
+        }
+
+        //! Sparse matrix-dense matrix product.
+        /*!
+         * Computes C = alpha * A * B + beta * C for a dense matrix B with cols() rows and k columns and a dense matrix
+         * C with rows() rows and k columns, like CsrMatrix::multiply(k, alpha, b, ldb, beta, c, ldc, layout).
+         * Throws std::out_of_range if a leading dimension is too small.
+         *
+         * \param k number of columns of B and C.
+         * \param alpha scaling factor for A * B.
+         * \param b input matrix (cols() x k).
+         * \param ldb leading dimension of B.
+         * \param beta scaling factor for C.
+         * \param c output matrix (rows() x k).
+         * \param ldc leading dimension of C.
+         * \param layout storage order of B and C.
+         */
+        void multiply(size_t k, const T alpha, const T* b, size_t ldb, const T beta, T* c, size_t ldc,
+                      DenseLayout layout = DenseLayout::RowMajor) const
+        {
+            sparsematrix_detail::csr_spmm_dense<T, I>(nullptr, _rows, _cols, _row_ptr, _col_idx, _values, k, alpha, b,
+                                                      ldb, beta, c, ldc, layout);
+        }
+
+        //! Parallel sparse matrix-dense matrix product.
+        /*!
+         * Computes C = alpha * A * B + beta * C like multiply(k, alpha, b, ldb, beta, c, ldc, layout), using the
+         * threads of a pool.
+         *
+         * \param pool threads to use.
+         * \param k number of columns of B and C.
+         * \param alpha scaling factor for A * B.
+         * \param b input matrix (cols() x k).
+         * \param ldb leading dimension of B.
+         * \param beta scaling factor for C.
+         * \param c output matrix (rows() x k).
+         * \param ldc leading dimension of C.
+         * \param layout storage order of B and C.
+         */
+        void multiply(ThreadPool& pool, size_t k, const T alpha, const T* b, size_t ldb, const T beta, T* c,
+                      size_t ldc, DenseLayout layout = DenseLayout::RowMajor) const
+        {
+            sparsematrix_detail::csr_spmm_dense<T, I>(&pool, _rows, _cols, _row_ptr, _col_idx, _values, k, alpha, b,
+                                                      ldb, beta, c, ldc, layout);
+        }
+};
+
+
+//! Write a matrix in compressed row storage in binary format.
+/*!
+ * The file can be mapped with MappedCsrMatrix<T, I>. Throws std::runtime_error if the file cannot be written.
+ *
+ * \param filename name of the file.
+ * \param matrix the matrix.
+ */
+template <size_t M, size_t N, typename T, typename I>
+void write_binary(const std::string& filename, const CsrMatrix<M, N, T, I>& matrix)
+{
+    const sparsematrix_detail::BinaryHeader header =
+        sparsematrix_detail::binary_header<T, I>(M, N, matrix.allocated());
+
+    sparsematrix_detail::BinaryWriter writer(filename);
+    writer.put(header);
+    writer.pad(header.row_ptr_offset);
+    for (const size_t n : matrix.row_ptr())
+    {
+        writer.put(static_cast<uint64_t>(n));
+    }
+    writer.pad(header.col_idx_offset);
+    writer.write(matrix.col_idx().data(), matrix.allocated() * sizeof(I));
+    writer.pad(header.values_offset);
+    writer.write(matrix.values().data(), matrix.allocated() * sizeof(T));
+    writer.close();
+}
+
+//! Write a matrix in binary format.
+/*!
+ * Like write_binary() for CsrMatrix. The map is traversed once per array, without converting the whole matrix.
+ *
+ * \param filename name of the file.
+ * \param matrix the matrix.
+ */
+template <size_t M, size_t N, typename T, typename I, typename Alloc>
+void write_binary(const std::string& filename, const SparseMatrix<M, N, T, I, Alloc>& matrix)
+{
+    const sparsematrix_detail::BinaryHeader header =
+        sparsematrix_detail::binary_header<T, I>(M, N, matrix.allocated());
+
+    // Row pointers from the number of elements per row.
+    std::vector<uint64_t> row_ptr(M + 1, 0);
+    for (auto elem = matrix.cbegin(); elem != matrix.cend(); ++elem)
+    {
+        ++row_ptr[elem->first.first + 1];
+    }
+    for (size_t i = 0; i < M; ++i)
+    {
+        row_ptr[i + 1] += row_ptr[i];
+    }
+
+    sparsematrix_detail::BinaryWriter writer(filename);
+    writer.put(header);
+    writer.pad(header.row_ptr_offset);
+    writer.write(row_ptr.data(), row_ptr.size() * sizeof(uint64_t));
+    writer.pad(header.col_idx_offset);
+    for (auto elem = matrix.cbegin(); elem != matrix.cend(); ++elem)
+    {
+        writer.put(static_cast<I>(elem->first.second));
+    }
+    writer.pad(header.values_offset);
+    for (auto elem = matrix.cbegin(); elem != matrix.cend(); ++elem)
+    {
+        writer.put(static_cast<T>(elem->second));
+    }
+    writer.close();
+}
+
+#endif  // BINARYMATRIX_H
@@ -0,0 +1,906 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#ifndef BSRMATRIX_H
+#define BSRMATRIX_H
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "csrkernels.h"
+#include "csrmatrix.h"
+#include "sparsematrix.h"
+#include "threadpool.h"
+
+
+//! Algorithms shared by the matrix classes.
+namespace sparsematrix_detail
+{
+
+//! Sparse matrix-vector product in BSR format.
+/*!
+ * Computes y = alpha * A * x + beta * y for the block rows [first, last) of a matrix A in BSR format with blocks of
+ * B x B elements. Block row r occupies positions [row_ptr[r], row_ptr[r + 1]) of col_idx, which holds block columns;
+ * the elements of block n are values[n * B * B, (n + 1) * B * B), in row-major order. The block size is a compile-time
+ * constant, so the loops over a block are unrolled and the B sums of a block row are kept in registers. If beta is
+ * zero, y is not read, so it does not need to be initialized.
+ *
+ * \param first first block row to compute.
+ * \param last one past the last block row to compute.
+ * \param row_ptr block row pointers of A.
+ * \param col_idx block column indices of A.
+ * \param values values of A.
+ * \param alpha scaling factor for A * x.
+ * \param x input vector (N elements).
+ * \param beta scaling factor for y.
+ * \param y output vector (M elements).
+ */
+template <size_t B, typename T, typename I>
+void bsr_spmv(size_t first, size_t last, const size_t* row_ptr, const I* col_idx, const T* values, const T alpha,
+              const T* x, const T beta, T* y)
+{
+    for (size_t r = first; r < last; ++r)
+    {
+        T sum[B] = {};
+        for (size_t n = row_ptr[r]; n < row_ptr[r + 1]; ++n)
+        {
+            const T* block = values + n * B * B;
+            const T* x_n = x + col_idx[n] * B;
+            for (size_t i = 0; i < B; ++i)
+            {
+                for (size_t j = 0; j < B; ++j)
+                {
+                    sum[i] += block[i * B + j] * x_n[j];
+                }
+            }
+        }
+
+        T* y_r = y + r * B;
+        for (size_t i = 0; i < B; ++i)
+        {
+            y_r[i] = (beta == T(0)) ? alpha * sum[i] : alpha * sum[i] + beta * y_r[i];
+        }
+    }
+}
+
+//! Sparse matrix-dense matrix product in BSR format for a block of columns.
+/*!
+ * Computes C = alpha * A * B + beta * C for the block rows [first, last) of a matrix A in BSR format and the columns
+ * [0, width) of dense matrices B and C; see bsr_spmm(). The B x W sums of a block row are kept in local variables.
+ *
+ * \param first first block row to compute.
+ * \param last one past the last block row to compute.
+ * \param row_ptr block row pointers of A.
+ * \param col_idx block column indices of A.
+ * \param values values of A.
+ * \param width number of columns, at most W.
+ * \param alpha scaling factor for A * B.
+ * \param b first column of the block of B.
+ * \param b_row distance between rows of B.
+ * \param b_col distance between columns of B.
+ * \param beta scaling factor for C.
+ * \param c first column of the block of C.
+ * \param c_row distance between rows of C.
+ * \param c_col distance between columns of C.
+ */
+template <size_t B, size_t W, typename T, typename I>
+void bsr_spmm_block(size_t first, size_t last, const size_t* row_ptr, const I* col_idx, const T* values, size_t width,
+                    const T alpha, const T* b, size_t b_row, size_t b_col, const T beta, T* c, size_t c_row,
+                    size_t c_col)
+{
+    for (size_t r = first; r < last; ++r)
+    {
+        T sum[B][W] = {};
+        if (width == W && b_col == 1)
+        {
+            // Full block of contiguous columns; the fixed trip counts let the compiler vectorize the loops.
+            for (size_t n = row_ptr[r]; n < row_ptr[r + 1]; ++n)
+            {
+                const T* block = values + n * B * B;
+                const T* b_n = b + col_idx[n] * B * b_row;
+                for (size_t j = 0; j < B; ++j)
+                {
+                    const T* b_j = b_n + j * b_row;
+                    for (size_t i = 0; i < B; ++i)
+                    {
+                        const T a = block[i * B + j];
+                        for (size_t l = 0; l < W; ++l)
+                        {
+                            sum[i][l] += a * b_j[l];
+                        }
+                    }
+                }
+            }
+        }
+        else
+        {
+            for (size_t n = row_ptr[r]; n < row_ptr[r + 1]; ++n)
+            {
+                const T* block = values + n * B * B;
+                const T* b_n = b + col_idx[n] * B * b_row;
+                for (size_t j = 0; j < B; ++j)
+                {
+                    const T* b_j = b_n + j * b_row;
+                    for (size_t i = 0; i < B; ++i)
+                    {
+                        const T a = block[i * B + j];
+                        for (size_t l = 0; l < width; ++l)
+                        {
+                            sum[i][l] += a * b_j[l * b_col];
+                        }
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < B; ++i)
+        {
+            T* c_i = c + (r * B + i) * c_row;
+            for (size_t l = 0; l < width; ++l)
+            {
+                c_i[l * c_col] = (beta == T(0)) ? alpha * sum[i][l] : alpha * sum[i][l] + beta * c_i[l * c_col];
+            }
+        }
+    }
+}
+
+//! Sparse matrix-dense matrix product in BSR format.
+/*!
+ * Computes C = alpha * A * B + beta * C for the block rows [first, last) of a matrix A in BSR format and dense matrices
+ * B and C with k columns, stored with the given distances between rows and columns like for csr_spmm(). Every block of
+ * A is used for spmm_block columns at once if the rows of B are contiguous, and for spmm_block_strided columns
+ * otherwise. If beta is zero, C is not read.
+ *
+ * \param first first block row to compute.
+ * \param last one past the last block row to compute.
+ * \param row_ptr block row pointers of A.
+ * \param col_idx block column indices of A.
+ * \param values values of A.
+ * \param k number of columns of B and C.
+ * \param alpha scaling factor for A * B.
+ * \param b input matrix (N x k).
+ * \param b_row distance between rows of B.
+ * \param b_col distance between columns of B.
+ * \param beta scaling factor for C.
+ * \param c output matrix (M x k).
+ * \param c_row distance between rows of C.
+ * \param c_col distance between columns of C.
+ */
+template <size_t B, typename T, typename I>
+void bsr_spmm(size_t first, size_t last, const size_t* row_ptr, const I* col_idx, const T* values, size_t k,
+              const T alpha, const T* b, size_t b_row, size_t b_col, const T beta, T* c, size_t c_row, size_t c_col)
+{
+    if (b_col == 1)
+    {
+        for (size_t r = first; r < last; ++r)
+        {
+            for (size_t j = 0; j < k; j += spmm_block)
+            {
+                bsr_spmm_block<B, spmm_block>(r, r + 1, row_ptr, col_idx, values, std::min(spmm_block, k - j), alpha,
+                                              b + j, b_row, b_col, beta, c + j * c_col, c_row, c_col);
+            }
+        }
+    }
+    else
+    {
+        for (size_t j = 0; j < k; j += spmm_block_strided)
+        {
+            bsr_spmm_block<B, spmm_block_strided>(first, last, row_ptr, col_idx, values,
+                                                  std::min(spmm_block_strided, k - j), alpha, b + j * b_col, b_row,
+                                                  b_col, beta, c + j * c_col, c_row, c_col);
+        }
+    }
+}
+
+}  // namespace sparsematrix_detail
+
+
+//! Fill of a matrix in BSR format with a given block size.
+struct BlockFill
+{
+    //! Number of rows and columns of a block.
+    size_t block_size;
+
+    //! Number of blocks that hold at least one allocated element.
+    size_t blocks;
+
+    //! Stored elements per allocated element (1 if every block is full).
+    double fill_ratio;
+
+    //! Bytes of storage read by a matrix-vector product: values, block column indices and block row pointers.
+    size_t storage_bytes;
+};
+
+
+//! Representation of a sparse matrix with M rows and N columns, of type T, in Block Sparse Row (BSR) format
+/*!
+ * This class represents a sparse matrix as a CSR matrix of dense blocks of B x B elements. A block is stored if any of
+ * its elements is allocated, with zeros for the other elements (the fill). Only one column index is stored per block
+ * and one row pointer per block row, so the index overhead is B x B times smaller than for CsrMatrix, and the products
+ * work on whole blocks with unrolled loops. This pays off for matrices whose elements come in dense blocks, like
+ * finite element matrices with several degrees of freedom per node; see block_fill() to choose a block size.
+ *
+ * The format is read-only, like CsrMatrix. Build a SparseMatrix or CsrMatrix and convert it instead. M and N must be
+ * multiples of B.
+ */
+template <size_t M, size_t N, size_t B, typename T, typename I = size_t>
+class BsrMatrix
+{
+    static_assert(std::is_integral<I>::value && std::is_unsigned<I>::value, "index type must be unsigned integer");
+    static_assert(sparsematrix_detail::index_fits<I>(M) && sparsematrix_detail::index_fits<I>(N),
+                  "matrix dimensions exceed index type");
+    static_assert(B > 0 && M % B == 0 && N % B == 0, "matrix dimensions must be multiples of the block size");
+
+    private:
+        //! Number of block rows.
+        static constexpr size_t block_rows = M / B;
+
+        //! Number of block columns.
+        static constexpr size_t block_cols = N / B;
+
+        //! Block row pointers; block row r occupies positions [_row_ptr[r], _row_ptr[r + 1]) of _col_idx.
+        std::vector<size_t> _row_ptr;
+
+        //! Block column indices of the stored blocks, sorted within every block row.
+        std::vector<I> _col_idx;
+
+        //! Elements of the stored blocks, B x B per block in row-major order.
+        std::vector<T> _values;
+
+        //! Find the element at (i,j).
+        /*!
+         * Binary search for the block that holds the element.
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return the position of the element, or the size of the storage if its block is not stored.
+         */
+        size_t find(size_t i, size_t j) const
+        {
+            const auto first = _col_idx.cbegin() + _row_ptr[i / B];
+            const auto last = _col_idx.cbegin() + _row_ptr[i / B + 1];
+            const auto pos = std::lower_bound(first, last, j / B);
+            if (pos == last || *pos != j / B)
+            {
+                return _values.size();
+            }
+            return static_cast<size_t>(pos - _col_idx.cbegin()) * B * B + (i % B) * B + j % B;
+        }
+
+        //! Sparse matrix-dense matrix product, on the threads of a pool or serially if pool is nullptr.
+        void spmm(ThreadPool* pool, size_t k, const T alpha, const T* b, size_t ldb, const T beta, T* c, size_t ldc,
+                  DenseLayout layout) const
+        {
+            const bool row_major = layout == DenseLayout::RowMajor;
+            if (ldb < (row_major ? k : N) || ldc < (row_major ? k : M))
+            {
+                throw std::out_of_range("leading dimension too small");
+            }
+
+            const size_t b_row = row_major ? ldb : 1;
+            const size_t b_col = row_major ? 1 : ldb;
+            const size_t c_row = row_major ? ldc : 1;
+            const size_t c_col = row_major ? 1 : ldc;
+
+            const size_t* row_ptr = _row_ptr.data();
+            const I* col_idx = _col_idx.data();
+            const T* values = _values.data();
+            if (pool == nullptr)
+            {
+                sparsematrix_detail::bsr_spmm<B>(0, block_rows, row_ptr, col_idx, values, k, alpha, b, b_row, b_col,
+                                                 beta, c, c_row, c_col);
+                return;
+            }
+
+            const size_t parts = pool->size();
+            pool->run(parts, [=](size_t part)
+            {
+                const size_t first = sparsematrix_detail::csr_partition(row_ptr, block_rows, part, parts);
+                const size_t last = sparsematrix_detail::csr_partition(row_ptr, block_rows, part + 1, parts);
+                sparsematrix_detail::bsr_spmm<B>(first, last, row_ptr, col_idx, values, k, alpha, b, b_row, b_col,
+                                                 beta, c, c_row, c_col);
+            });
+        }
+
+    public:
+        //! Default constructor.
+        BsrMatrix() : _row_ptr(block_rows + 1, 0)
+        {
+        }
+
+        //! Conversion from compressed row storage.
+        /*!
+         * Create an instance from a CsrMatrix. Every block row is built in a single pass over its B rows: the blocks
+         * that are touched are collected, sorted and then filled.
+         *
+         * \param other matrix to be converted.
+         */
+        explicit BsrMatrix(const CsrMatrix<M, N, T, I>& other) : _row_ptr(block_rows + 1, 0)
+        {
+            const std::vector<size_t>& row_ptr = other.row_ptr();
+            const std::vector<I>& col_idx = other.col_idx();
+
+            // Position of every block column in the current block row, or npos if it is not touched.
+            const size_t npos = std::numeric_limits<size_t>::max();
+            std::vector<size_t> slot(block_cols, npos);
+            std::vector<size_t> touched;
+
+            for (size_t r = 0; r < block_rows; ++r)
+            {
+                for (size_t n = row_ptr[r * B]; n < row_ptr[(r + 1) * B]; ++n)
+                {
+                    const size_t c = col_idx[n] / B;
+                    if (slot[c] == npos)
+                    {
+                        slot[c] = 0;
+                        touched.push_back(c);
+                    }
+                }
+
+                std::sort(touched.begin(), touched.end());
+                for (const size_t c : touched)
+                {
+                    slot[c] = _col_idx.size();
+                    _col_idx.push_back(static_cast<I>(c));
+                }
+                _values.resize(_col_idx.size() * B * B, T(0));
+
+                for (size_t i = r * B; i < (r + 1) * B; ++i)
+                {
+                    for (size_t n = row_ptr[i]; n < row_ptr[i + 1]; ++n)
+                    {
+                        const size_t j = col_idx[n];
+                        _values[slot[j / B] * B * B + (i % B) * B + j % B] = other.values()[n];
+                    }
+                }
+
+                for (const size_t c : touched)
+                {
+                    slot[c] = npos;
+                }
+                touched.clear();
+                _row_ptr[r + 1] = _col_idx.size();
+            }
+        }
+
+        //! Conversion from map storage.
+        /*!
+         * Create an instance from a SparseMatrix, via compressed row storage.
+         *
+         * \param other matrix to be converted.
+         */
+        template <typename Alloc>
+        explicit BsrMatrix(const SparseMatrix<M, N, T, I, Alloc>& other) : BsrMatrix(CsrMatrix<M, N, T, I>(other))
+        {
+        }
+
+        //! Conversion to compressed row storage.
+        /*!
+         * Create a CsrMatrix with the non-zero elements of the stored blocks. Zero elements, including the fill of the
+         * blocks, are not allocated in the result.
+         *
+         * \return the matrix in compressed row storage.
+         */
+        CsrMatrix<M, N, T, I> to_csr() const
+        {
+            std::vector<size_t> row_ptr(M + 1, 0);
+            std::vector<I> col_idx;
+            std::vector<T> values;
+            for (size_t i = 0; i < M; ++i)
+            {
+                for (size_t n = _row_ptr[i / B]; n < _row_ptr[i / B + 1]; ++n)
+                {
+                    for (size_t j = 0; j < B; ++j)
+                    {
+                        const T& v = _values[n * B * B + (i % B) * B + j];
+                        if (v != T(0))
+                        {
+                            col_idx.push_back(static_cast<I>(_col_idx[n] * B + j));
+                            values.push_back(v);
+                        }
+                    }
+                }
+                row_ptr[i + 1] = col_idx.size();
+            }
+
+            return CsrMatrix<M, N, T, I>(std::move(row_ptr), std::move(col_idx), std::move(values));
+        }
+
+        //! Conversion to map storage.
+        /*!
+         * Create a SparseMatrix with the non-zero elements of the stored blocks.
+         *
+         * \return the matrix in map storage.
+         */
+        SparseMatrix<M, N, T, I> to_sparse() const
+        {
+            return to_csr().to_sparse();
+        }
+
+        //! Read an element at index (i,j).
+        /*!
+         * Read an individual element at row i and column j. The storage is read-only, so a copy of the value is
+         * returned; elements outside the stored blocks read as zero.
+         * Throws std::out_of_range if either i or j exceeds the respective matrix dimension.
+         *
+         * \sa peek()
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return the value of the element at (i,j).
+         */
+        T operator()(size_t i, size_t j) const
+        {
+            if (i >= M || j >= N)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            const size_t pos = find(i, j);
+            return pos == _values.size() ? T(0) : _values[pos];
+        }
+
+        //! Size of the matrix.
+        /*!
+         * Gives the size of the matrix as the number of elements. By definition, this is equal to M x N.
+         *
+         * \sa allocated()
+         *
+         * \return the matrix size.
+         */
+        size_t size() const
+        {
+            return M * N;
+        }
+
+        //! Number of allocated elements.
+        /*!
+         * Get the number of allocated elements: all elements of the stored blocks, including the fill. This takes
+         * constant time.
+         *
+         * \sa blocks(), fill_ratio()
+         *
+         * \return the number of allocated elements.
+         */
+        size_t allocated() const
+        {
+            return _values.size();
+        }
+
+        //! Number of stored blocks.
+        size_t blocks() const
+        {
+            return _col_idx.size();
+        }
+
+        //! Fill ratio.
+        /*!
+         * Get the number of allocated elements per non-zero element. This is 1 if all stored blocks are dense; every
+         * fill element costs as much as a non-zero element in a product. This is a pass over the stored values.
+         *
+         * \return allocated() divided by the number of non-zero elements, or 1 if there are none.
+         */
+        double fill_ratio() const
+        {
+            const size_t zeros = static_cast<size_t>(std::count(_values.cbegin(), _values.cend(), T(0)));
+            const size_t nonzeros = _values.size() - zeros;
+            return nonzeros == 0 ? 1.0 : static_cast<double>(_values.size()) / static_cast<double>(nonzeros);
+        }
+
+        //! Memory footprint.
+        /*!
+         * Get the memory used by the matrix: the size of this object plus the capacity of the three storage arrays.
+         * The overhead of the memory allocator is not included.
+         *
+         * \sa allocated()
+         *
+         * \return the memory footprint in bytes.
+         */
+        size_t memory_bytes() const
+        {
+            return sizeof(*this) + sparsematrix_detail::vector_memory_bytes(_row_ptr) +
+                   sparsematrix_detail::vector_memory_bytes(_col_idx) +
+                   sparsematrix_detail::vector_memory_bytes(_values);
+        }
+
+        //! Peek if an element is allocated.
+        /*!
+         * Check if the element is stored, which is the case for all elements of a stored block. This is a binary
+         * search within the block row of i.
+         * Throws std::out_of_range if either i or j exceeds the respective matrix dimension.
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return Boolean value indicating if the element is allocated.
+         */
+        bool peek(size_t i, size_t j) const
+        {
+            if (i >= M || j >= N)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            return find(i, j) != _values.size();
+        }
+
+        //! Block row pointers (M / B + 1 elements); block row r occupies [row_ptr()[r], row_ptr()[r + 1]).
+        const std::vector<size_t>& row_ptr() const
+        {
+            return _row_ptr;
+        }
+
+        //! Block column indices of the stored blocks, in row-major order.
+        const std::vector<I>& col_idx() const
+        {
+            return _col_idx;
+        }
+
+        //! Elements of the stored blocks, B x B per block in row-major order.
+        const std::vector<T>& values() const
+        {
+            return _values;
+        }
+
+        //! Check for equality.
+        /*!
+         * Check for equality by comparing the internal storage. This is a strict comparison that also considers
+         * sparseness.
+         *
+         * \param rhs right-hand side of the equality test.
+         * \return Boolean value indicating equality.
+         */
+        bool operator==(const BsrMatrix& rhs) const
+        {
+            return _row_ptr == rhs._row_ptr && _col_idx == rhs._col_idx && _values == rhs._values;
+        }
+
+        //! Check for inequality.
+        /*!
+         * Check for inequality by comparing the internal storage.
+         *
+         * \param rhs right-hand side of the inequality test.
+         * \return Boolean value indicating inequality.
+         */
+        bool operator!=(const BsrMatrix& rhs) const
+        {
+            return !(*this == rhs);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y for a dense vector x of N elements and a dense vector y of M elements.
+         * Every block is multiplied with B elements of x in registers.
+         * If beta is zero, y is not read, so it does not need to be initialized. No memory is allocated.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector (N elements).
+         * \param beta scaling factor for y.
+         * \param y output vector (M elements).
+         */
+        void multiply(const T alpha, const T* x, const T beta, T* y) const
+        {
+            sparsematrix_detail::bsr_spmv<B>(0, block_rows, _row_ptr.data(), _col_idx.data(), _values.data(), alpha, x,
+                                             beta, y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x for a dense vector x of N elements and a dense vector y of M elements.
+         *
+         * \param x input vector (N elements).
+         * \param y output vector (M elements).
+         */
+        void multiply(const T* x, T* y) const
+        {
+            multiply(T(1), x, T(0), y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y, with sizes of x and y checked at compile time.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(const T alpha, const std::array<T, N>& x, const T beta, std::array<T, M>& y) const
+        {
+            multiply(alpha, x.data(), beta, y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x, with sizes of x and y checked at compile time.
+         *
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(const std::array<T, N>& x, std::array<T, M>& y) const
+        {
+            multiply(T(1), x.data(), T(0), y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(const T alpha, const std::vector<T>& x, const T beta, std::vector<T>& y) const
+        {
+            if (x.size() != N || y.size() != M)
+            {
+                throw std::out_of_range("vector size mismatch");
+            }
+
+            multiply(alpha, x.data(), beta, y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(const std::vector<T>& x, std::vector<T>& y) const
+        {
+            multiply(T(1), x, T(0), y);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y like multiply(alpha, x, beta, y), using the threads of a pool. The
+         * block rows are split into one part per thread, with roughly equal numbers of blocks. No memory is allocated.
+         *
+         * \param pool threads to use.
+         * \param alpha scaling factor for A * x.
+         * \param x input vector (N elements).
+         * \param beta scaling factor for y.
+         * \param y output vector (M elements).
+         */
+        void multiply(ThreadPool& pool, const T alpha, const T* x, const T beta, T* y) const
+        {
+            const size_t* row_ptr = _row_ptr.data();
+            const I* col_idx = _col_idx.data();
+            const T* values = _values.data();
+            const size_t parts = pool.size();
+            pool.run(parts, [=](size_t part)
+            {
+                const size_t first = sparsematrix_detail::csr_partition(row_ptr, block_rows, part, parts);
+                const size_t last = sparsematrix_detail::csr_partition(row_ptr, block_rows, part + 1, parts);
+                sparsematrix_detail::bsr_spmv<B>(first, last, row_ptr, col_idx, values, alpha, x, beta, y);
+            });
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = A * x like multiply(x, y), using the threads of a pool.
+         *
+         * \param pool threads to use.
+         * \param x input vector (N elements).
+         * \param y output vector (M elements).
+         */
+        void multiply(ThreadPool& pool, const T* x, T* y) const
+        {
+            multiply(pool, T(1), x, T(0), y);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = A * x, using the threads of a pool. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param pool threads to use.
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(ThreadPool& pool, const std::vector<T>& x, std::vector<T>& y) const
+        {
+            if (x.size() != N || y.size() != M)
+            {
+                throw std::out_of_range("vector size mismatch");
+            }
+
+            multiply(pool, T(1), x.data(), T(0), y.data());
+        }
+
+        //! Sparse matrix-dense matrix product.
+        /*!
+         * Computes C = alpha * A * B + beta * C for a dense matrix B with N rows and k columns and a dense matrix C
+         * with M rows and k columns, stored in the given layout with leading dimensions ldb and ldc, like
+         * CsrMatrix::multiply(). Every block of A is read once per block of columns and applied to them in registers.
+         * If beta is zero, C is not read. No memory is allocated.
+         * Throws std::out_of_range if a leading dimension is smaller than a row (row-major) or a column
+         * (column-major) of the matrix.
+         *
+         * \param k number of columns of B and C.
+         * \param alpha scaling factor for A * B.
+         * \param b input matrix (N x k).
+         * \param ldb leading dimension of B.
+         * \param beta scaling factor for C.
+         * \param c output matrix (M x k).
+         * \param ldc leading dimension of C.
+         * \param layout storage order of B and C.
+         */
+        void multiply(size_t k, const T alpha, const T* b, size_t ldb, const T beta, T* c, size_t ldc,
+                      DenseLayout layout = DenseLayout::RowMajor) const
+        {
+            spmm(nullptr, k, alpha, b, ldb, beta, c, ldc, layout);
+        }
+
+        //! Sparse matrix-dense matrix product.
+        /*!
+         * Computes C = A * B for dense matrices B (N x k) and C (M x k) without gaps between rows or columns. The
+         * vectors are not resized.
+         * Throws std::out_of_range if b does not have N x k elements or c does not have M x k elements.
+         *
+         * \param k number of columns of B and C.
+         * \param b input matrix.
+         * \param c output matrix.
+         * \param layout storage order of B and C.
+         */
+        void multiply(size_t k, const std::vector<T>& b, std::vector<T>& c,
+                      DenseLayout layout = DenseLayout::RowMajor) const
+        {
+            if (b.size() != N * k || c.size() != M * k)
+            {
+                throw std::out_of_range("matrix size mismatch");
+            }
+
+            const bool row_major = layout == DenseLayout::RowMajor;
+            multiply(k, T(1), b.data(), row_major ? k : N, T(0), c.data(), row_major ? k : M, layout);
+        }
+
+        //! Parallel sparse matrix-dense matrix product.
+        /*!
+         * Computes C = alpha * A * B + beta * C like multiply(k, alpha, b, ldb, beta, c, ldc, layout), using the
+         * threads of a pool. The block rows are split into one part per thread, with roughly equal numbers of blocks.
+         *
+         * \param pool threads to use.
+         * \param k number of columns of B and C.
+         * \param alpha scaling factor for A * B.
+         * \param b input matrix (N x k).
+         * \param ldb leading dimension of B.
+         * \param beta scaling factor for C.
+         * \param c output matrix (M x k).
+         * \param ldc leading dimension of C.
+         * \param layout storage order of B and C.
+         */
+        void multiply(ThreadPool& pool, size_t k, const T alpha, const T* b, size_t ldb, const T beta, T* c,
+                      size_t ldc, DenseLayout layout = DenseLayout::RowMajor) const
+        {
+            spmm(&pool, k, alpha, b, ldb, beta, c, ldc, layout);
+        }
+};
+
+template <size_t M, size_t N, size_t B, typename T, typename I>
+constexpr size_t BsrMatrix<M, N, B, T, I>::block_rows;
+
+template <size_t M, size_t N, size_t B, typename T, typename I>
+constexpr size_t BsrMatrix<M, N, B, T, I>::block_cols;
+
+
+//! Fill of a matrix for candidate block sizes.
+/*!
+ * Counts the blocks that BSR storage of a matrix would need for every candidate block size, without converting it.
+ * Block sizes that do not divide both dimensions of the matrix are skipped. The storage bytes of a block size are a
+ * good estimate of the cost of a matrix-vector product, because the product is limited by memory bandwidth: larger
+ * blocks store fewer indices but more fill. Block size 1 is the same as CSR storage.
+ *
+ * \sa recommend_block_size()
+ *
+ * \param other matrix to analyse.
+ * \param sizes candidate block sizes.
+ * \return the fill for every candidate that divides both dimensions, in the order of sizes.
+ */
+template <size_t M, size_t N, typename T, typename I>
+std::vector<BlockFill> block_fill(const CsrMatrix<M, N, T, I>& other,
+                                  const std::vector<size_t>& sizes = {1, 2, 3, 4, 5, 6, 8})
+{
+    const std::vector<size_t>& row_ptr = other.row_ptr();
+    const std::vector<I>& col_idx = other.col_idx();
+
+    std::vector<BlockFill> result;
+    for (const size_t b : sizes)
+    {
+        if (b == 0 || M % b != 0 || N % b != 0)
+        {
+            continue;
+        }
+
+        // Last block row that touched every block column, plus one; zero if none did yet.
+        std::vector<size_t> seen(N / b, 0);
+        size_t blocks = 0;
+        for (size_t r = 0; r < M / b; ++r)
+        {
+            for (size_t n = row_ptr[r * b]; n < row_ptr[(r + 1) * b]; ++n)
+            {
+                const size_t c = col_idx[n] / b;
+                if (seen[c] != r + 1)
+                {
+                    seen[c] = r + 1;
+                    ++blocks;
+                }
+            }
+        }
+
+        BlockFill fill;
+        fill.block_size = b;
+        fill.blocks = blocks;
+        fill.fill_ratio = other.allocated() == 0 ? 1.0 : static_cast<double>(blocks * b * b) / other.allocated();
+        fill.storage_bytes = blocks * (b * b * sizeof(T) + sizeof(I)) + (M / b + 1) * sizeof(size_t);
+        result.push_back(fill);
+    }
+
+    return result;
+}
+
+//! Fill of a matrix for candidate block sizes.
+/*!
+ * Like block_fill() for compressed row storage, for a matrix in map storage.
+ *
+ * \param other matrix to analyse.
+ * \param sizes candidate block sizes.
+ * \return the fill for every candidate that divides both dimensions, in the order of sizes.
+ */
+template <size_t M, size_t N, typename T, typename I, typename Alloc>
+std::vector<BlockFill> block_fill(const SparseMatrix<M, N, T, I, Alloc>& other,
+                                  const std::vector<size_t>& sizes = {1, 2, 3, 4, 5, 6, 8})
+{
+    return block_fill(CsrMatrix<M, N, T, I>(other), sizes);
+}
+
+//! Recommended block size.
+/*!
+ * Gives the candidate block size with the smallest storage (see block_fill()); the smaller block size if two are
+ * equal. A result of 1 means that CSR storage is expected to be faster than BSR storage for this matrix.
+ *
+ * \param other matrix to analyse.
+ * \param sizes candidate block sizes.
+ * \return the recommended block size, or 1 if no candidate divides both dimensions.
+ */
+template <typename Matrix>
+size_t recommend_block_size(const Matrix& other, const std::vector<size_t>& sizes = {1, 2, 3, 4, 5, 6, 8})
+{
+    size_t best = 1;
+    size_t best_bytes = std::numeric_limits<size_t>::max();
+    for (const BlockFill& fill : block_fill(other, sizes))
+    {
+        if (fill.storage_bytes < best_bytes || (fill.storage_bytes == best_bytes && fill.block_size < best))
+        {
+            best = fill.block_size;
+            best_bytes = fill.storage_bytes;
+        }
+    }
+
+    return best;
+}
+
+#endif  // BSRMATRIX_H
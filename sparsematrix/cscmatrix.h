@@ -0,0 +1,402 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#ifndef CSCMATRIX_H
+#define CSCMATRIX_H
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "csrmatrix.h"
+#include "sparsematrix.h"
+
+
+//! Representation of a sparse matrix with M rows and N columns, of type T, in Compressed Sparse Column (CSC) format
+/*!
+ * This class represents a sparse matrix in Compressed Sparse Column format: the column-major counterpart of CsrMatrix.
+ * Non-zero values are stored contiguously in column-major order, together with their row indices and, for every
+ * column, the offset of its first value (column pointers). This makes column-oriented access cheap.
+ *
+ * The storage of a matrix A in CSC format is identical to the storage of A^T in CSR format. This is used to convert
+ * between the two formats: a conversion is a counting sort (O(M + N + R) for R allocated elements), and reinterpreting
+ * a matrix as the transpose in the other format does not copy anything at all.
+ *
+ * Row indices are stored as type I, like the column indices of CsrMatrix.
+ */
+template <size_t M, size_t N, typename T, typename I = size_t>
+class CscMatrix
+{
+    static_assert(std::is_integral<I>::value && std::is_unsigned<I>::value, "index type must be unsigned integer");
+    static_assert(sparsematrix_detail::index_fits<I>(M) && sparsematrix_detail::index_fits<I>(N),
+                  "matrix dimensions exceed index type");
+
+    private:
+        //! Column pointers; column j occupies positions [_col_ptr[j], _col_ptr[j + 1]) of _row_idx and _values.
+        std::vector<size_t> _col_ptr;
+
+        //! Row indices of the stored values, sorted within every column.
+        std::vector<I> _row_idx;
+
+        //! Stored values in column-major order.
+        std::vector<T> _values;
+
+        //! All matrix sizes have access to each others internal storage.
+        template <size_t, size_t, typename, typename> friend class CscMatrix;
+
+    public:
+        //! Default constructor.
+        CscMatrix() : _col_ptr(N + 1, 0)
+        {
+        }
+
+        //! Copy-constructor
+        /*!
+         * Create a copy of an existing instance.
+         *
+         * \param other object to be copied.
+         */
+        CscMatrix(const CscMatrix& other) = default;
+
+        //! Move-constructor.
+        CscMatrix(CscMatrix&& other) = default;
+
+        //! Copy-assignment.
+        CscMatrix& operator=(const CscMatrix& other) = default;
+
+        //! Move-assignment.
+        CscMatrix& operator=(CscMatrix&& other) = default;
+
+        //! Conversion from map storage.
+        /*!
+         * Create an instance from a SparseMatrix with a counting sort on the column indices. The map is visited in
+         * row-major order, so the row indices end up sorted within every column.
+         *
+         * \param other matrix to be converted.
+         */
+        template <typename Alloc>
+        explicit CscMatrix(const SparseMatrix<M, N, T, I, Alloc>& other) : _col_ptr(N + 1, 0)
+        {
+            _row_idx.resize(other.allocated());
+            _values.resize(other.allocated());
+
+            // Count the elements in every column and turn the counts into offsets.
+            for (auto elem = other.cbegin(); elem != other.cend(); ++elem)
+            {
+                ++_col_ptr[elem->first.second + 1];
+            }
+            for (size_t j = 0; j < N; ++j)
+            {
+                _col_ptr[j + 1] += _col_ptr[j];
+            }
+
+            std::vector<size_t> next(_col_ptr.cbegin(), _col_ptr.cend() - 1);
+            for (auto elem = other.cbegin(); elem != other.cend(); ++elem)
+            {
+                const size_t pos = next[elem->first.second]++;
+                _row_idx[pos] = elem->first.first;
+                _values[pos] = elem->second;
+            }
+        }
+
+        //! Conversion from compressed row storage.
+        /*!
+         * Create an instance from a CsrMatrix. The CSC storage of A is the CSR storage of A^T, which is obtained with
+         * a counting sort.
+         *
+         * \param other matrix to be converted.
+         */
+        explicit CscMatrix(const CsrMatrix<M, N, T, I>& other) : CscMatrix(from_transposed(other.transpose()))
+        {
+        }
+
+        //! Reinterpret compressed row storage as the transpose.
+        /*!
+         * Takes over the storage of a matrix B in CSR format and returns it as B^T in CSC format. No elements are
+         * copied or moved; B is left empty.
+         *
+         * \param other matrix B to take the storage from.
+         * \return B^T.
+         */
+        static CscMatrix from_transposed(CsrMatrix<N, M, T, I>&& other)
+        {
+            CscMatrix lhs;
+            lhs._col_ptr.swap(other._row_ptr);
+            lhs._row_idx.swap(other._col_idx);
+            lhs._values.swap(other._values);
+            return lhs;
+        }
+
+        //! Reinterpret as compressed row storage of the transpose.
+        /*!
+         * Hands over the storage of this matrix A as A^T in CSR format. No elements are copied or moved; A is left
+         * empty.
+         *
+         * \return A^T.
+         */
+        CsrMatrix<N, M, T, I> release_transposed()
+        {
+            CsrMatrix<N, M, T, I> lhs;
+            lhs._row_ptr.swap(_col_ptr);
+            lhs._col_idx.swap(_row_idx);
+            lhs._values.swap(_values);
+            return lhs;
+        }
+
+        //! Conversion to compressed row storage.
+        /*!
+         * Create a CsrMatrix with the same allocated elements, with a counting sort on the row indices.
+         *
+         * \return the matrix in CSR format.
+         */
+        CsrMatrix<M, N, T, I> to_csr() const
+        {
+            CsrMatrix<M, N, T, I> lhs;
+            lhs._col_idx.resize(_row_idx.size());
+            lhs._values.resize(_values.size());
+
+            // Count the elements in every row and turn the counts into offsets.
+            for (const size_t i : _row_idx)
+            {
+                ++lhs._row_ptr[i + 1];
+            }
+            for (size_t i = 0; i < M; ++i)
+            {
+                lhs._row_ptr[i + 1] += lhs._row_ptr[i];
+            }
+
+            // Columns are visited in order, so the column indices end up sorted within every row.
+            std::vector<size_t> next(lhs._row_ptr.cbegin(), lhs._row_ptr.cend() - 1);
+            for (size_t j = 0; j < N; ++j)
+            {
+                for (size_t n = _col_ptr[j]; n < _col_ptr[j + 1]; ++n)
+                {
+                    const size_t pos = next[_row_idx[n]]++;
+                    lhs._col_idx[pos] = static_cast<I>(j);
+                    lhs._values[pos] = _values[n];
+                }
+            }
+
+            return lhs;
+        }
+
+        //! Conversion to map storage.
+        /*!
+         * Create a SparseMatrix with the same allocated elements.
+         *
+         * \return the matrix in map storage.
+         */
+        SparseMatrix<M, N, T, I> to_sparse() const
+        {
+            return to_csr().to_sparse();
+        }
+
+        //! Read an element at index (i,j).
+        /*!
+         * Read an individual element at row i and column j. The storage is read-only, so a copy of the value is
+         * returned; elements that are not allocated read as zero.
+         * Throws std::out_of_range if either i or j exceeds the respective matrix dimension.
+         *
+         * \sa peek()
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return the value of the element at (i,j).
+         */
+        T operator()(size_t i, size_t j) const
+        {
+            if (i >= M || j >= N)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            const auto first = _row_idx.cbegin() + _col_ptr[j];
+            const auto last = _row_idx.cbegin() + _col_ptr[j + 1];
+            const auto pos = std::lower_bound(first, last, i);
+            if (pos == last || *pos != i)
+            {
+                return T(0);
+            }
+            return _values[pos - _row_idx.cbegin()];
+        }
+
+        //! Size of the matrix.
+        /*!
+         * Gives the size of the matrix as the number of elements. By definition, this is equal to M x N.
+         *
+         * \sa allocated()
+         *
+         * \return the matrix size.
+         */
+        size_t size() const
+        {
+            return M * N;
+        }
+
+        //! Number of allocated elements.
+        /*!
+         * Get the number of allocated (stored) elements. This takes constant time.
+         *
+         * \sa size()
+         *
+         * \return the number of allocated elements.
+         */
+        size_t allocated() const
+        {
+            return _values.size();
+        }
+
+        //! Memory footprint.
+        /*!
+         * Get the memory used by the matrix: the size of this object plus the capacity of the three storage arrays.
+         * The overhead of the memory allocator is not included.
+         *
+         * \sa allocated()
+         *
+         * \return the memory footprint in bytes.
+         */
+        size_t memory_bytes() const
+        {
+            return sizeof(*this) + sparsematrix_detail::vector_memory_bytes(_col_ptr) +
+                   sparsematrix_detail::vector_memory_bytes(_row_idx) +
+                   sparsematrix_detail::vector_memory_bytes(_values);
+        }
+
+        //! Peek if an element is allocated.
+        /*!
+         * Check if the element is stored. This is a binary search within column j.
+         * Throws std::out_of_range if either i or j exceeds the respective matrix dimension.
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return Boolean value indicating if the element is allocated.
+         */
+        bool peek(size_t i, size_t j) const
+        {
+            if (i >= M || j >= N)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            return std::binary_search(_row_idx.cbegin() + _col_ptr[j], _row_idx.cbegin() + _col_ptr[j + 1], i);
+        }
+
+        //! Column pointers (N + 1 elements); column j occupies positions [col_ptr()[j], col_ptr()[j + 1]).
+        const std::vector<size_t>& col_ptr() const
+        {
+            return _col_ptr;
+        }
+
+        //! Row indices of the allocated elements, in column-major order.
+        const std::vector<I>& row_idx() const
+        {
+            return _row_idx;
+        }
+
+        //! Values of the allocated elements, in column-major order.
+        const std::vector<T>& values() const
+        {
+            return _values;
+        }
+
+        //! Extract a column.
+        /*!
+         * Returns column j as a column vector.
+         * Throws std::out_of_range if j exceeds the number of columns.
+         *
+         * \param j column index.
+         * \return A(:,j).
+         */
+        SparseMatrix<M, 1, T, I> column(size_t j) const
+        {
+            if (j >= N)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            SparseMatrix<M, 1, T, I> lhs;
+            for (size_t n = _col_ptr[j]; n < _col_ptr[j + 1]; ++n)
+            {
+                lhs(_row_idx[n], 0) = _values[n];
+            }
+            return lhs;
+        }
+
+        //! Column scaling.
+        /*!
+         * Scales every element in column j, i.e. A(:,j) *= s.
+         * Throws std::out_of_range if j exceeds the number of columns.
+         *
+         * \param j column index.
+         * \param s scaling factor.
+         */
+        void scale_column(size_t j, const T s)
+        {
+            if (j >= N)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            for (size_t n = _col_ptr[j]; n < _col_ptr[j + 1]; ++n)
+            {
+                _values[n] *= s;
+            }
+        }
+
+        //! Check for equality.
+        /*!
+         * Check for equality by comparing the internal storage. As for SparseMatrix, this is a strict comparison that
+         * also considers sparseness.
+         *
+         * \param rhs right-hand side of the equality test.
+         * \return Boolean value indicating equality.
+         */
+        bool operator==(const CscMatrix& rhs) const
+        {
+            return _col_ptr == rhs._col_ptr && _row_idx == rhs._row_idx && _values == rhs._values;
+        }
+
+        //! Check for inequality.
+        /*!
+         * Check for inequality by comparing the internal storage. As for SparseMatrix, this is a strict comparison
+         * that also considers sparseness.
+         *
+         * \param rhs right-hand side of the inequality test.
+         * \return Boolean value indicating inequality.
+         */
+        bool operator!=(const CscMatrix& rhs) const
+        {
+            return !(*this == rhs);
+        }
+
+        //! Transpose.
+        /*!
+         * Returns a copy of the matrix with rows and columns swapped. The CSC storage of A^T is the CSR storage of A.
+         *
+         * \return A^T.
+         */
+        CscMatrix<N, M, T, I> transpose() const
+        {
+            return CscMatrix<N, M, T, I>::from_transposed(to_csr());
+        }
+
+};
+
+#endif  // CSCMATRIX_H
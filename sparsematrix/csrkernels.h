@@ -0,0 +1,402 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#ifndef CSRKERNELS_H
+#define CSRKERNELS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+#include "simdkernels.h"
+
+
+//! Computational kernels that operate directly on compressed row storage arrays.
+/*!
+ * These kernels are shared by all classes that use CSR storage. They take raw pointers, never allocate memory and
+ * operate on a range of rows, so that they can also be used to process a matrix in parts.
+ */
+namespace sparsematrix_detail
+{
+
+//! Sparse matrix-vector product without explicit vectorization.
+/*!
+ * Computes y(i) = alpha * A(i,:) * x + beta * y(i) for the rows i in [first, last) of a matrix A in CSR format. Every
+ * allocated element is read exactly once. If beta is zero, y is not read, so it does not need to be initialized.
+ *
+ * \param first first row to compute.
+ * \param last one past the last row to compute.
+ * \param row_ptr row pointers of A.
+ * \param col_idx column indices of A.
+ * \param values values of A.
+ * \param alpha scaling factor for A * x.
+ * \param x input vector (N elements).
+ * \param beta scaling factor for y.
+ * \param y output vector (M elements).
+ */
+template <typename T, typename I>
+void csr_spmv_scalar(size_t first, size_t last, const size_t* row_ptr, const I* col_idx, const T* values,
+                     const T alpha, const T* x, const T beta, T* y)
+{
+    if (beta == T(0))
+    {
+        for (size_t i = first; i < last; ++i)
+        {
+            T sum = 0;
+            for (size_t n = row_ptr[i]; n < row_ptr[i + 1]; ++n)
+            {
+                sum += values[n] * x[col_idx[n]];
+            }
+            y[i] = alpha * sum;
+        }
+    }
+    else
+    {
+        for (size_t i = first; i < last; ++i)
+        {
+            T sum = 0;
+            for (size_t n = row_ptr[i]; n < row_ptr[i + 1]; ++n)
+            {
+                sum += values[n] * x[col_idx[n]];
+            }
+            y[i] = alpha * sum + beta * y[i];
+        }
+    }
+}
+
+//! Sparse matrix-vector product with a given instruction set.
+/*!
+ * Like csr_spmv(), with the kernel for the given instruction set, which must be supported by the processor (see
+ * simd_level()). Types without a vectorized kernel use the scalar kernel.
+ */
+template <typename T, typename I>
+void csr_spmv_level(SimdLevel level, size_t first, size_t last, const size_t* row_ptr, const I* col_idx,
+                    const T* values, const T alpha, const T* x, const T beta, T* y, std::false_type)
+{
+    (void)level;
+    csr_spmv_scalar(first, last, row_ptr, col_idx, values, alpha, x, beta, y);
+}
+
+//! Sparse matrix-vector product with a given instruction set, for types with vectorized kernels.
+template <typename T, typename I>
+void csr_spmv_level(SimdLevel level, size_t first, size_t last, const size_t* row_ptr, const I* col_idx,
+                    const T* values, const T alpha, const T* x, const T beta, T* y, std::true_type)
+{
+#ifdef SPARSEMATRIX_X86_SIMD
+    if (level == SimdLevel::Avx512)
+    {
+        csr_spmv_avx512(first, last, row_ptr, col_idx, values, alpha, x, beta, y);
+        return;
+    }
+    if (level == SimdLevel::Avx2)
+    {
+        csr_spmv_avx2(first, last, row_ptr, col_idx, values, alpha, x, beta, y);
+        return;
+    }
+#endif
+    (void)level;
+    csr_spmv_scalar(first, last, row_ptr, col_idx, values, alpha, x, beta, y);
+}
+
+//! Sparse matrix-vector product with a given instruction set.
+template <typename T, typename I>
+void csr_spmv_level(SimdLevel level, size_t first, size_t last, const size_t* row_ptr, const I* col_idx,
+                    const T* values, const T alpha, const T* x, const T beta, T* y)
+{
+    csr_spmv_level(level, first, last, row_ptr, col_idx, values, alpha, x, beta, y, simd_spmv_supported<T, I>());
+}
+
+//! Sparse matrix-vector product.
+/*!
+ * Computes y(i) = alpha * A(i,:) * x + beta * y(i) for the rows i in [first, last) of a matrix A in CSR format. Every
+ * allocated element is read exactly once. If beta is zero, y is not read, so it does not need to be initialized.
+ *
+ * For float and double values with 32-bit or 64-bit indices, the rows are processed with the vector instructions of
+ * the processor (see simd_level()); the order in which the elements of a row are summed then differs from the scalar
+ * kernel, which can change the rounding of the result.
+ *
+ * \param first first row to compute.
+ * \param last one past the last row to compute.
+ * \param row_ptr row pointers of A.
+ * \param col_idx column indices of A.
+ * \param values values of A.
+ * \param alpha scaling factor for A * x.
+ * \param x input vector (N elements).
+ * \param beta scaling factor for y.
+ * \param y output vector (M elements).
+ */
+template <typename T, typename I>
+void csr_spmv(size_t first, size_t last, const size_t* row_ptr, const I* col_idx, const T* values,
+              const T alpha, const T* x, const T beta, T* y)
+{
+    csr_spmv_level(simd_level(), first, last, row_ptr, col_idx, values, alpha, x, beta, y);
+}
+
+//! Number of columns of a dense matrix that are computed together by csr_spmm(), if the rows of B are contiguous.
+static const size_t spmm_block = 16;
+
+//! Number of columns of a dense matrix that are computed together by csr_spmm(), if the columns of B are contiguous.
+static const size_t spmm_block_strided = 4;
+
+//! Sparse matrix-dense matrix product for a block of columns.
+/*!
+ * Computes C(i,j) = alpha * A(i,:) * B(:,j) + beta * C(i,j) for the rows i in [first, last) of a matrix A in CSR format
+ * and the columns j in [0, width) of dense matrices B and C; see csr_spmm(). The sums are kept in local variables.
+ *
+ * \param first first row to compute.
+ * \param last one past the last row to compute.
+ * \param row_ptr row pointers of A.
+ * \param col_idx column indices of A.
+ * \param values values of A.
+ * \param width number of columns, at most W.
+ * \param alpha scaling factor for A * B.
+ * \param b first column of the block of B.
+ * \param b_row distance between rows of B.
+ * \param b_col distance between columns of B.
+ * \param beta scaling factor for C.
+ * \param c first column of the block of C.
+ * \param c_row distance between rows of C.
+ * \param c_col distance between columns of C.
+ */
+template <size_t W, typename T, typename I>
+void csr_spmm_block(size_t first, size_t last, const size_t* row_ptr, const I* col_idx, const T* values, size_t width,
+                    const T alpha, const T* b, size_t b_row, size_t b_col, const T beta, T* c, size_t c_row,
+                    size_t c_col)
+{
+    for (size_t i = first; i < last; ++i)
+    {
+        T sum[W] = {};
+        if (width == W && b_col == 1)
+        {
+            // Full block of contiguous columns; the fixed trip count lets the compiler vectorize the loop.
+            for (size_t n = row_ptr[i]; n < row_ptr[i + 1]; ++n)
+            {
+                const T a = values[n];
+                const T* b_n = b + col_idx[n] * b_row;
+                for (size_t l = 0; l < W; ++l)
+                {
+                    sum[l] += a * b_n[l];
+                }
+            }
+        }
+        else
+        {
+            for (size_t n = row_ptr[i]; n < row_ptr[i + 1]; ++n)
+            {
+                const T a = values[n];
+                const T* b_n = b + col_idx[n] * b_row;
+                for (size_t l = 0; l < width; ++l)
+                {
+                    sum[l] += a * b_n[l * b_col];
+                }
+            }
+        }
+
+        T* c_i = c + i * c_row;
+        if (beta == T(0))
+        {
+            for (size_t l = 0; l < width; ++l)
+            {
+                c_i[l * c_col] = alpha * sum[l];
+            }
+        }
+        else
+        {
+            for (size_t l = 0; l < width; ++l)
+            {
+                c_i[l * c_col] = alpha * sum[l] + beta * c_i[l * c_col];
+            }
+        }
+    }
+}
+
+//! Sparse matrix-dense matrix product.
+/*!
+ * Computes C(i,:) = alpha * A(i,:) * B + beta * C(i,:) for the rows i in [first, last) of a matrix A in CSR format and
+ * dense matrices B and C with k columns. Element (r,j) of B is b[r * b_row + j * b_col] and element (i,j) of C is
+ * c[i * c_row + j * c_col], so that both row-major and column-major storage can be used. Every allocated element of A
+ * that is read is used for a block of columns at once. If beta is zero, C is not read.
+ *
+ * If the rows of B are contiguous, every row of A is used for all blocks of spmm_block columns before moving on to the
+ * next row. A row stays in cache, so A is read from memory only once for all k columns, and the elements of B that are
+ * read for an element of A are a single contiguous piece of a row. If the columns of B are contiguous instead, every
+ * element of A needs one cache line of B per column. The columns are then computed in smaller blocks of
+ * spmm_block_strided, for all rows at once, so that the columns of B that are in use stay in cache; A is read once per
+ * block.
+ *
+ * \param first first row to compute.
+ * \param last one past the last row to compute.
+ * \param row_ptr row pointers of A.
+ * \param col_idx column indices of A.
+ * \param values values of A.
+ * \param k number of columns of B and C.
+ * \param alpha scaling factor for A * B.
+ * \param b input matrix (N x k).
+ * \param b_row distance between rows of B.
+ * \param b_col distance between columns of B.
+ * \param beta scaling factor for C.
+ * \param c output matrix (M x k).
+ * \param c_row distance between rows of C.
+ * \param c_col distance between columns of C.
+ */
+template <typename T, typename I>
+void csr_spmm(size_t first, size_t last, const size_t* row_ptr, const I* col_idx, const T* values, size_t k,
+              const T alpha, const T* b, size_t b_row, size_t b_col, const T beta, T* c, size_t c_row, size_t c_col)
+{
+    if (b_col == 1)
+    {
+        for (size_t i = first; i < last; ++i)
+        {
+            for (size_t j = 0; j < k; j += spmm_block)
+            {
+                csr_spmm_block<spmm_block>(i, i + 1, row_ptr, col_idx, values, std::min(spmm_block, k - j), alpha,
+                                           b + j, b_row, b_col, beta, c + j * c_col, c_row, c_col);
+            }
+        }
+    }
+    else
+    {
+        for (size_t j = 0; j < k; j += spmm_block_strided)
+        {
+            csr_spmm_block<spmm_block_strided>(first, last, row_ptr, col_idx, values,
+                                               std::min(spmm_block_strided, k - j), alpha, b + j * b_col, b_row,
+                                               b_col, beta, c + j * c_col, c_row, c_col);
+        }
+    }
+}
+
+//! Row partitioning balanced by the number of allocated elements.
+/*!
+ * Splits the rows of a matrix A in CSR format into consecutive parts that hold roughly equal numbers of allocated
+ * elements, and returns the first row of a part. Part p covers rows [csr_partition(p), csr_partition(p + 1)); the
+ * first row of part 0 is 0 and the first row of part `parts` is the number of rows. A single row is never split, so
+ * a part can hold more than its share if a row holds many elements.
+ *
+ * \param row_ptr row pointers of A.
+ * \param rows number of rows of A.
+ * \param part part number, 0 <= part <= parts.
+ * \param parts number of parts.
+ * \return the first row of the part.
+ */
+inline size_t csr_partition(const size_t* row_ptr, size_t rows, size_t part, size_t parts)
+{
+    if (part >= parts)
+    {
+        return rows;
+    }
+
+    // First row that starts at or after the share of the preceding parts, i.e. R * part / parts for R allocated
+    // elements (computed without overflow).
+    const size_t target = row_ptr[rows] / parts * part + row_ptr[rows] % parts * part / parts;
+    return std::lower_bound(row_ptr, row_ptr + rows, target) - row_ptr;
+}
+
+//! Merge-path search.
+/*!
+ * The rows and allocated elements of a matrix A in CSR format can be processed as a merge of two sorted lists: the
+ * row end offsets (row_ptr[1], ..., row_ptr[M]) and the element indices (0, ..., R - 1). Every step of the merge
+ * either consumes an element or completes a row, so there are M + R steps in total. This function finds the position
+ * in both lists after a given number of steps (a diagonal of the merge grid), with a binary search.
+ *
+ * \param row_ptr row pointers of A.
+ * \param rows number of rows M of A.
+ * \param diagonal number of merge steps, 0 <= diagonal <= M + R.
+ * \param row output: number of completed rows.
+ * \param element output: number of consumed elements.
+ */
+inline void merge_path_search(const size_t* row_ptr, size_t rows, size_t diagonal, size_t& row, size_t& element)
+{
+    const size_t allocated = row_ptr[rows];
+    size_t low = diagonal > allocated ? diagonal - allocated : 0;
+    size_t high = std::min(diagonal, rows);
+    while (low < high)
+    {
+        const size_t pivot = low + (high - low) / 2;
+        if (row_ptr[pivot + 1] <= diagonal - pivot - 1)
+        {
+            low = pivot + 1;
+        }
+        else
+        {
+            high = pivot;
+        }
+    }
+
+    row = low;
+    element = diagonal - low;
+}
+
+//! Sparse matrix-vector product over a share of the merge path.
+/*!
+ * Computes part of y = alpha * A * x + beta * y for a matrix A in CSR format, for one of several parts that each
+ * cover an equal share of the M + R merge steps (see merge_path_search()). Rows that are completed within the part are
+ * written to y. A row that is started but not completed is left for a later part; the partial sum of its elements is
+ * returned as a carry, which must be added as y(carry_row) += alpha * carry_value after all parts have completed. If
+ * the part does not end inside a row, carry_row is set to M.
+ *
+ * \param part part number, 0 <= part < parts.
+ * \param parts number of parts.
+ * \param rows number of rows M of A.
+ * \param row_ptr row pointers of A.
+ * \param col_idx column indices of A.
+ * \param values values of A.
+ * \param alpha scaling factor for A * x.
+ * \param x input vector (N elements).
+ * \param beta scaling factor for y.
+ * \param y output vector (M elements).
+ * \param carry_row output: row that is continued in the next part.
+ * \param carry_value output: partial sum of that row.
+ */
+template <typename T, typename I>
+void csr_spmv_merge_path(size_t part, size_t parts, size_t rows, const size_t* row_ptr, const I* col_idx,
+                         const T* values, const T alpha, const T* x, const T beta, T* y,
+                         size_t& carry_row, T& carry_value)
+{
+    const size_t steps = rows + row_ptr[rows];
+    const size_t first = steps / parts * part + steps % parts * part / parts;
+    const size_t last = steps / parts * (part + 1) + steps % parts * (part + 1) / parts;
+
+    size_t row, n, row_end, n_end;
+    merge_path_search(row_ptr, rows, first, row, n);
+    merge_path_search(row_ptr, rows, last, row_end, n_end);
+
+    // Complete rows; the first one may have been started by a previous part, which then adds its carry.
+    for (; row < row_end; ++row)
+    {
+        T sum = 0;
+        for (; n < row_ptr[row + 1]; ++n)
+        {
+            sum += values[n] * x[col_idx[n]];
+        }
+        y[row] = (beta == T(0)) ? alpha * sum : alpha * sum + beta * y[row];
+    }
+
+    // Elements of the row that is continued in the next part.
+    T sum = 0;
+    for (; n < n_end; ++n)
+    {
+        sum += values[n] * x[col_idx[n]];
+    }
+    carry_row = row_end;
+    carry_value = sum;
+}
+
+}  // namespace sparsematrix_detail
+
+#endif  // CSRKERNELS_H
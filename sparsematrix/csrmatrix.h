@@ -0,0 +1,1048 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#ifndef CSRMATRIX_H
+#define CSRMATRIX_H
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "csrkernels.h"
+#include "sparsematrix.h"
+#include "threadpool.h"
+
+
+template <size_t M, size_t N, typename T, typename I>
+class CscMatrix;
+
+
+//! Work distribution for parallel matrix-vector products.
+enum class Partitioning
+{
+    //! Split the rows into parts with roughly equal numbers of allocated elements; rows are never split.
+    Rows,
+
+    //! Split rows and allocated elements together into equal parts (merge path); long rows are shared by threads.
+    MergePath
+};
+
+
+//! Storage order of a dense matrix.
+enum class DenseLayout
+{
+    //! Elements of a row are contiguous; the leading dimension is the distance between rows.
+    RowMajor,
+
+    //! Elements of a column are contiguous; the leading dimension is the distance between columns.
+    ColumnMajor
+};
+
+
+//! Algorithms shared by the matrix classes.
+namespace sparsematrix_detail
+{
+
+//! Parallel sparse matrix-vector product.
+/*!
+ * Computes y = alpha * A * x + beta * y for a matrix A in CSR format, using the threads of a pool. The work is split
+ * into one part per thread, either by rows with roughly equal numbers of allocated elements or by merge path. The
+ * latter gives every thread an equal share of rows plus allocated elements, also when a few rows hold most elements;
+ * partial sums of rows that are shared by threads are added afterwards. No memory is allocated when splitting by rows.
+ *
+ * \param pool threads to use.
+ * \param rows number of rows of A.
+ * \param row_ptr row pointers of A (rows + 1 elements).
+ * \param col_idx column indices of A.
+ * \param values values of A.
+ * \param alpha scaling factor for A * x.
+ * \param x input vector.
+ * \param beta scaling factor for y.
+ * \param y output vector.
+ * \param partitioning work distribution over the threads.
+ */
+template <typename T, typename I>
+void csr_spmv_parallel(ThreadPool& pool, size_t rows, const size_t* row_ptr, const I* col_idx, const T* values,
+                       const T alpha, const T* x, const T beta, T* y, Partitioning partitioning)
+{
+    const size_t parts = pool.size();
+    if (partitioning == Partitioning::Rows)
+    {
+        pool.run(parts, [=](size_t part)
+        {
+            const size_t first = csr_partition(row_ptr, rows, part, parts);
+            const size_t last = csr_partition(row_ptr, rows, part + 1, parts);
+            csr_spmv(first, last, row_ptr, col_idx, values, alpha, x, beta, y);
+        });
+    }
+    else
+    {
+        std::vector<size_t> carry_rows(parts);
+        std::vector<T> carry_values(parts);
+        size_t* carry_row = carry_rows.data();
+        T* carry_value = carry_values.data();
+        pool.run(parts, [=](size_t part)
+        {
+            csr_spmv_merge_path(part, parts, rows, row_ptr, col_idx, values, alpha, x, beta, y, carry_row[part],
+                                carry_value[part]);
+        });
+
+        // Add the partial sums of rows that were shared with the next part.
+        for (size_t part = 0; part < parts; ++part)
+        {
+            if (carry_rows[part] < rows)
+            {
+                y[carry_rows[part]] += alpha * carry_values[part];
+            }
+        }
+    }
+}
+
+//! Sparse matrix-dense matrix product, for dense matrices in either layout.
+/*!
+ * Computes C = alpha * A * B + beta * C for a matrix A in CSR format with the given number of rows and columns, and
+ * dense matrices B and C with k columns, on the threads of a pool if one is given. The rows are split into one part
+ * per thread, with roughly equal numbers of allocated elements.
+ * Throws std::out_of_range if a leading dimension is smaller than a row (row-major) or a column (column-major).
+ *
+ * \param pool threads to use, or nullptr to compute on the calling thread.
+ * \param rows number of rows M of A.
+ * \param cols number of columns N of A.
+ * \param row_ptr row pointers of A.
+ * \param col_idx column indices of A.
+ * \param values values of A.
+ * \param k number of columns of B and C.
+ * \param alpha scaling factor for A * B.
+ * \param b input matrix (N x k).
+ * \param ldb leading dimension of B.
+ * \param beta scaling factor for C.
+ * \param c output matrix (M x k).
+ * \param ldc leading dimension of C.
+ * \param layout storage order of B and C.
+ */
+template <typename T, typename I>
+void csr_spmm_dense(ThreadPool* pool, size_t rows, size_t cols, const size_t* row_ptr, const I* col_idx,
+                    const T* values, size_t k, const T alpha, const T* b, size_t ldb, const T beta, T* c, size_t ldc,
+                    DenseLayout layout)
+{
+    const bool row_major = layout == DenseLayout::RowMajor;
+    if (ldb < (row_major ? k : cols) || ldc < (row_major ? k : rows))
+    {
+        throw std::out_of_range("leading dimension too small");
+    }
+
+    const size_t b_row = row_major ? ldb : 1;
+    const size_t b_col = row_major ? 1 : ldb;
+    const size_t c_row = row_major ? ldc : 1;
+    const size_t c_col = row_major ? 1 : ldc;
+
+    if (pool == nullptr)
+    {
+        csr_spmm(0, rows, row_ptr, col_idx, values, k, alpha, b, b_row, b_col, beta, c, c_row, c_col);
+        return;
+    }
+
+    const size_t parts = pool->size();
+    pool->run(parts, [=](size_t part)
+    {
+        const size_t first = csr_partition(row_ptr, rows, part, parts);
+        const size_t last = csr_partition(row_ptr, rows, part + 1, parts);
+        csr_spmm(first, last, row_ptr, col_idx, values, k, alpha, b, b_row, b_col, beta, c, c_row, c_col);
+    });
+}
+
+}  // namespace sparsematrix_detail
+
+
+//! Representation of a sparse matrix with M rows and N columns, of type T, in Compressed Sparse Row (CSR) format
+/*!
+ * This class represents a sparse matrix in Compressed Sparse Row format. Non-zero values are stored contiguously in
+ * row-major order in three arrays: the values, their column indices and, for every row, the offset of its first value
+ * in the other two arrays (row pointers). This is a compact and cache-friendly format for matrices that are built
+ * once and used many times, but it does not support inserting individual elements. Build a SparseMatrix and convert it
+ * instead.
+ *
+ * Column indices are stored as type I, like the indices of SparseMatrix. Row pointers are offsets into the value array
+ * and are always stored as size_t.
+ */
+template <size_t M, size_t N, typename T, typename I = size_t>
+class CsrMatrix
+{
+    static_assert(std::is_integral<I>::value && std::is_unsigned<I>::value, "index type must be unsigned integer");
+    static_assert(sparsematrix_detail::index_fits<I>(M) && sparsematrix_detail::index_fits<I>(N),
+                  "matrix dimensions exceed index type");
+
+    private:
+        //! Row pointers; row i occupies positions [_row_ptr[i], _row_ptr[i + 1]) of _col_idx and _values.
+        std::vector<size_t> _row_ptr;
+
+        //! Column indices of the stored values, sorted within every row.
+        std::vector<I> _col_idx;
+
+        //! Stored values in row-major order.
+        std::vector<T> _values;
+
+        //! All matrix sizes have access to each others internal storage (needed for multiplication and transpose).
+        template <size_t, size_t, typename, typename> friend class CsrMatrix;
+
+        //! Compressed column storage shares the layout of compressed row storage of the transpose.
+        template <size_t, size_t, typename, typename> friend class CscMatrix;
+
+        //! Batches of elements are assembled directly into compressed storage.
+        template <size_t, size_t, typename, typename> friend class SparseMatrixBuilder;
+
+        //! Element-wise combination.
+        /*!
+         * Merges the rows of this matrix and another matrix of the same size in a single pass. Elements that are
+         * allocated in both matrices are combined as op(a, b), elements that are only allocated in one of them as
+         * op(a, 0) or op(0, b). The allocated elements of the result are the union of those of both operands.
+         *
+         * \param rhs Right-hand side operand.
+         * \param op Binary operation to apply.
+         * \return the combined matrix.
+         */
+        template <typename Op>
+        CsrMatrix combine(const CsrMatrix& rhs, Op op) const
+        {
+            CsrMatrix lhs;
+            lhs._col_idx.reserve(_col_idx.size() + rhs._col_idx.size());
+            lhs._values.reserve(_values.size() + rhs._values.size());
+
+            for (size_t i = 0; i < M; ++i)
+            {
+                size_t a = _row_ptr[i];
+                size_t b = rhs._row_ptr[i];
+                const size_t a_end = _row_ptr[i + 1];
+                const size_t b_end = rhs._row_ptr[i + 1];
+                while (a < a_end || b < b_end)
+                {
+                    if (b == b_end || (a < a_end && _col_idx[a] < rhs._col_idx[b]))
+                    {
+                        lhs._col_idx.push_back(_col_idx[a]);
+                        lhs._values.push_back(op(_values[a], T(0)));
+                        ++a;
+                    }
+                    else if (a == a_end || rhs._col_idx[b] < _col_idx[a])
+                    {
+                        lhs._col_idx.push_back(rhs._col_idx[b]);
+                        lhs._values.push_back(op(T(0), rhs._values[b]));
+                        ++b;
+                    }
+                    else
+                    {
+                        lhs._col_idx.push_back(_col_idx[a]);
+                        lhs._values.push_back(op(_values[a], rhs._values[b]));
+                        ++a;
+                        ++b;
+                    }
+                }
+                lhs._row_ptr[i + 1] = lhs._col_idx.size();
+            }
+
+            return lhs;
+        }
+
+        //! Multiplication.
+        /*!
+         * Multiplies this matrix with another matrix of compatible size, row by row (Gustavson's algorithm). Only
+         * non-zero elements are stored in the result.
+         *
+         * \param rhs Right-hand side operand.
+         * \return this x rhs.
+         */
+        template <size_t P>
+        CsrMatrix<M, P, T, I> multiply_rows(const CsrMatrix<N, P, T, I>& rhs) const
+        {
+            CsrMatrix<M, P, T, I> lhs;
+
+            // Dense accumulator for a single row of the result, plus the list of columns that were touched.
+            std::vector<T> accumulator(P, T(0));
+            std::vector<bool> touched(P, false);
+            std::vector<size_t> columns;
+
+            for (size_t r = 0; r < M; ++r)
+            {
+                // For C = A * B, row C(r,:) = sum_k A(r,k) * B(k,:).
+                for (size_t n = _row_ptr[r]; n < _row_ptr[r + 1]; ++n)
+                {
+                    const size_t k = _col_idx[n];
+                    for (size_t m = rhs._row_ptr[k]; m < rhs._row_ptr[k + 1]; ++m)
+                    {
+                        const size_t c = rhs._col_idx[m];
+                        if (!touched[c])
+                        {
+                            touched[c] = true;
+                            columns.push_back(c);
+                        }
+                        accumulator[c] += _values[n] * rhs._values[m];
+                    }
+                }
+
+                std::sort(columns.begin(), columns.end());
+                for (const size_t c : columns)
+                {
+                    // Add the element only if it is non-zero.
+                    if (accumulator[c] != 0)
+                    {
+                        lhs._col_idx.push_back(static_cast<I>(c));
+                        lhs._values.push_back(accumulator[c]);
+                    }
+                    accumulator[c] = 0;
+                    touched[c] = false;
+                }
+                columns.clear();
+                lhs._row_ptr[r + 1] = lhs._col_idx.size();
+            }
+
+            return lhs;
+        }
+
+    public:
+        //! Default constructor.
+        CsrMatrix() : _row_ptr(M + 1, 0)
+        {
+        }
+
+        //! Copy-constructor
+        /*!
+         * Create a copy of an existing instance.
+         *
+         * \param other object to be copied.
+         */
+        CsrMatrix(const CsrMatrix& other) = default;
+
+        //! Move-constructor.
+        CsrMatrix(CsrMatrix&& other) = default;
+
+        //! Copy-assignment.
+        CsrMatrix& operator=(const CsrMatrix& other) = default;
+
+        //! Move-assignment.
+        CsrMatrix& operator=(CsrMatrix&& other) = default;
+
+        //! Conversion from map storage.
+        /*!
+         * Create an instance from a SparseMatrix. Its internal storage is already in row-major order, so the
+         * conversion is a single pass over the allocated elements.
+         *
+         * \param other matrix to be converted.
+         */
+        template <typename Alloc>
+        explicit CsrMatrix(const SparseMatrix<M, N, T, I, Alloc>& other) : _row_ptr(M + 1, 0)
+        {
+            _col_idx.reserve(other.allocated());
+            _values.reserve(other.allocated());
+            for (auto elem = other.cbegin(); elem != other.cend(); ++elem)
+            {
+                ++_row_ptr[elem->first.first + 1];
+                _col_idx.push_back(elem->first.second);
+                _values.push_back(elem->second);
+            }
+
+            for (size_t i = 0; i < M; ++i)
+            {
+                _row_ptr[i + 1] += _row_ptr[i];
+            }
+        }
+
+        //! Construction via initializer list.
+        /*!
+         * Create an instance by providing a (key, value)-list for the cells to be populated, like for SparseMatrix.
+         * Throws std::out_of_range if any key exceeds the matrix dimensions.
+         *
+         * \param m initializer list of (key, value) pairs.
+         */
+        CsrMatrix(std::initializer_list<std::pair<const std::pair<size_t, size_t>, T>> m)
+            : CsrMatrix(SparseMatrix<M, N, T, I>(m))
+        {
+        }
+
+        //! Construction from compressed row storage arrays.
+        /*!
+         * Takes over the three arrays of compressed row storage, for example as produced by the conversion of another
+         * storage format, without copying them. The arrays are checked in a single pass: row_ptr must have M + 1
+         * non-decreasing entries starting at zero and ending at the length of col_idx and values, and the column
+         * indices within every row must be strictly increasing and less than N. Throws std::out_of_range otherwise.
+         *
+         * \param row_ptr row pointers; row i occupies positions [row_ptr[i], row_ptr[i + 1]) of the other arrays.
+         * \param col_idx column indices of the stored values.
+         * \param values stored values in row-major order.
+         */
+        CsrMatrix(std::vector<size_t>&& row_ptr, std::vector<I>&& col_idx, std::vector<T>&& values)
+        {
+            if (row_ptr.size() != M + 1 || row_ptr[0] != 0 || row_ptr[M] != col_idx.size() ||
+                col_idx.size() != values.size())
+            {
+                throw std::out_of_range("invalid compressed row storage");
+            }
+            for (size_t i = 0; i < M; ++i)
+            {
+                if (row_ptr[i + 1] < row_ptr[i] || row_ptr[i + 1] > col_idx.size())
+                {
+                    throw std::out_of_range("invalid compressed row storage");
+                }
+                for (size_t n = row_ptr[i]; n < row_ptr[i + 1]; ++n)
+                {
+                    if (col_idx[n] >= N || (n > row_ptr[i] && col_idx[n] <= col_idx[n - 1]))
+                    {
+                        throw std::out_of_range("invalid compressed row storage");
+                    }
+                }
+            }
+
+            _row_ptr = std::move(row_ptr);
+            _col_idx = std::move(col_idx);
+            _values = std::move(values);
+        }
+
+        //! Conversion to map storage.
+        /*!
+         * Create a SparseMatrix with the same allocated elements. Elements are inserted in row-major order, which is
+         * the order of the map, so this is a single pass as well.
+         *
+         * \return the matrix in map storage.
+         */
+        SparseMatrix<M, N, T, I> to_sparse() const
+        {
+            SparseMatrix<M, N, T, I> lhs;
+            for (size_t i = 0; i < M; ++i)
+            {
+                for (size_t n = _row_ptr[i]; n < _row_ptr[i + 1]; ++n)
+                {
+                    lhs._values.emplace_hint(lhs._values.end(), lhs.key(i, _col_idx[n]), _values[n]);
+                }
+            }
+
+            return lhs;
+        }
+
+        //! Read an element at index (i,j).
+        /*!
+         * Read an individual element at row i and column j. The storage is read-only, so a copy of the value is
+         * returned; elements that are not allocated read as zero.
+         * Throws std::out_of_range if either i or j exceeds the respective matrix dimension.
+         *
+         * \sa peek()
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return the value of the element at (i,j).
+         */
+        T operator()(size_t i, size_t j) const
+        {
+            if (i >= M || j >= N)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            const auto first = _col_idx.cbegin() + _row_ptr[i];
+            const auto last = _col_idx.cbegin() + _row_ptr[i + 1];
+            const auto pos = std::lower_bound(first, last, j);
+            if (pos == last || *pos != j)
+            {
+                return T(0);
+            }
+            return _values[pos - _col_idx.cbegin()];
+        }
+
+        //! Size of the matrix.
+        /*!
+         * Gives the size of the matrix as the number of elements. By definition, this is equal to M x N.
+         *
+         * \sa allocated()
+         *
+         * \return the matrix size.
+         */
+        size_t size() const
+        {
+            return M * N;
+        }
+
+        //! Number of allocated elements.
+        /*!
+         * Get the number of allocated (stored) elements. This takes constant time.
+         *
+         * \sa size()
+         *
+         * \return the number of allocated elements.
+         */
+        size_t allocated() const
+        {
+            return _values.size();
+        }
+
+        //! Memory footprint.
+        /*!
+         * Get the memory used by the matrix: the size of this object plus the capacity of the three storage arrays.
+         * The overhead of the memory allocator is not included.
+         *
+         * \sa allocated()
+         *
+         * \return the memory footprint in bytes.
+         */
+        size_t memory_bytes() const
+        {
+            return sizeof(*this) + sparsematrix_detail::vector_memory_bytes(_row_ptr) +
+                   sparsematrix_detail::vector_memory_bytes(_col_idx) +
+                   sparsematrix_detail::vector_memory_bytes(_values);
+        }
+
+        //! Peek if an element is allocated.
+        /*!
+         * Check if the element is stored. This is a binary search within row i.
+         * Throws std::out_of_range if either i or j exceeds the respective matrix dimension.
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return Boolean value indicating if the element is allocated.
+         */
+        bool peek(size_t i, size_t j) const
+        {
+            if (i >= M || j >= N)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            return std::binary_search(_col_idx.cbegin() + _row_ptr[i], _col_idx.cbegin() + _row_ptr[i + 1], j);
+        }
+
+        //! Row pointers (M + 1 elements); row i occupies positions [row_ptr()[i], row_ptr()[i + 1]).
+        const std::vector<size_t>& row_ptr() const
+        {
+            return _row_ptr;
+        }
+
+        //! Column indices of the allocated elements, in row-major order.
+        const std::vector<I>& col_idx() const
+        {
+            return _col_idx;
+        }
+
+        //! Values of the allocated elements, in row-major order.
+        const std::vector<T>& values() const
+        {
+            return _values;
+        }
+
+        //! Check for equality.
+        /*!
+         * Check for equality by comparing the internal storage. As for SparseMatrix, this is a strict comparison that
+         * also considers sparseness.
+         *
+         * \param rhs right-hand side of the equality test.
+         * \return Boolean value indicating equality.
+         */
+        bool operator==(const CsrMatrix& rhs) const
+        {
+            return _row_ptr == rhs._row_ptr && _col_idx == rhs._col_idx && _values == rhs._values;
+        }
+
+        //! Check for inequality.
+        /*!
+         * Check for inequality by comparing the internal storage. As for SparseMatrix, this is a strict comparison
+         * that also considers sparseness.
+         *
+         * \param rhs right-hand side of the inequality test.
+         * \return Boolean value indicating inequality.
+         */
+        bool operator!=(const CsrMatrix& rhs) const
+        {
+            return !(*this == rhs);
+        }
+
+        //! Addition.
+        /*!
+         * Implements A += B, with A and B of same size and type (checked at compile time). The rows of both matrices
+         * are merged in a single pass into new storage.
+         *
+         * \param rhs Matrix to add.
+         * \return A += B.
+         */
+        CsrMatrix& operator+=(const CsrMatrix& rhs)
+        {
+            *this = combine(rhs, std::plus<T>());
+            return *this;
+        }
+
+        //! Addition.
+        /*!
+         * Implements A + B, with A and B of same size and type (checked at compile time).
+         *
+         * \param op1 First operand.
+         * \param op2 Second operand.
+         * \return A + B.
+         */
+        friend CsrMatrix operator+(const CsrMatrix& op1, const CsrMatrix& op2)
+        {
+            return op1.combine(op2, std::plus<T>());
+        }
+
+        //! Unitary plus.
+        /*!
+         * Returns the same matrix unaltered.
+         *
+         * \param rhs Any matrix A.
+         * \return A.
+         */
+        friend const CsrMatrix& operator+(const CsrMatrix& rhs)
+        {
+            return rhs;
+        }
+
+        //! Subtraction.
+        /*!
+         * Implements A -= B, with A and B of same size and type (checked at compile time).
+         *
+         * \param rhs Matrix to subtract.
+         * \return A -= B.
+         */
+        CsrMatrix& operator-=(const CsrMatrix& rhs)
+        {
+            *this = combine(rhs, std::minus<T>());
+            return *this;
+        }
+
+        //! Subtraction.
+        /*!
+         * Implements A - B, with A and B of same size and type (checked at compile time).
+         *
+         * \param op1 First operand.
+         * \param op2 Second operand.
+         * \return A - B.
+         */
+        friend CsrMatrix operator-(const CsrMatrix& op1, const CsrMatrix& op2)
+        {
+            return op1.combine(op2, std::minus<T>());
+        }
+
+        //! Unitary minus.
+        /*!
+         * Returns a copy of the input matrix with every element negated.
+         *
+         * \param rhs Any matrix A.
+         * \return -A.
+         */
+        friend CsrMatrix operator-(const CsrMatrix& rhs)
+        {
+            CsrMatrix lhs = rhs;
+            for (auto& v : lhs._values)
+            {
+                v *= -1;
+            }
+            return lhs;
+        }
+
+        //! Scaling.
+        /*!
+         * Returns a copy of the input matrix with every element scaled.
+         *
+         * \param s Scaling factor.
+         * \param op2 Any matrix A.
+         * \return s x A.
+         */
+        friend CsrMatrix operator*(const T s, const CsrMatrix& op2)
+        {
+            CsrMatrix lhs = op2;
+            for (auto& v : lhs._values)
+            {
+                v *= s;
+            }
+            return lhs;
+        }
+
+        //! Scaling.
+        /*!
+         * Returns a copy of the input matrix with every element scaled.
+         *
+         * \param op1 Any matrix A.
+         * \param s Scaling factor.
+         * \return A x s.
+         */
+        friend CsrMatrix operator*(const CsrMatrix& op1, const T s)
+        {
+            return s * op1;
+        }
+
+        //! Multiplication
+        /*!
+         * Multiplies two matrices of compatible size (checked at compile time.)
+         *
+         * \param op1 First operand.
+         * \param op2 Second operand.
+         * \return A x B.
+         */
+        template <size_t P>
+        friend CsrMatrix<M, P, T, I> operator*(const CsrMatrix<M, N, T, I>& op1, const CsrMatrix<N, P, T, I>& op2)
+        {
+            return op1.multiply_rows(op2);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y for a dense vector x of N elements and a dense vector y of M elements.
+         * The storage arrays are streamed once, from start to end.
+         * If beta is zero, y is not read, so it does not need to be initialized. No memory is allocated.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector (N elements).
+         * \param beta scaling factor for y.
+         * \param y output vector (M elements).
+         */
+        void multiply(const T alpha, const T* x, const T beta, T* y) const
+        {
+            sparsematrix_detail::csr_spmv(0, M, _row_ptr.data(), _col_idx.data(), _values.data(), alpha, x, beta, y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x for a dense vector x of N elements and a dense vector y of M elements.
+         *
+         * \param x input vector (N elements).
+         * \param y output vector (M elements).
+         */
+        void multiply(const T* x, T* y) const
+        {
+            multiply(T(1), x, T(0), y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y, with sizes of x and y checked at compile time.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(const T alpha, const std::array<T, N>& x, const T beta, std::array<T, M>& y) const
+        {
+            multiply(alpha, x.data(), beta, y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x, with sizes of x and y checked at compile time.
+         *
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(const std::array<T, N>& x, std::array<T, M>& y) const
+        {
+            multiply(T(1), x.data(), T(0), y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(const T alpha, const std::vector<T>& x, const T beta, std::vector<T>& y) const
+        {
+            if (x.size() != N || y.size() != M)
+            {
+                throw std::out_of_range("vector size mismatch");
+            }
+
+            multiply(alpha, x.data(), beta, y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(const std::vector<T>& x, std::vector<T>& y) const
+        {
+            multiply(T(1), x, T(0), y);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y like multiply(alpha, x, beta, y), using the threads of a pool. The work
+         * is split into one part per thread, either by rows with roughly equal numbers of allocated elements or by
+         * merge path. The latter gives every thread an equal share of rows plus allocated elements, also when a few
+         * rows hold most elements; partial sums of rows that are shared by threads are added afterwards.
+         * No memory is allocated when splitting by rows.
+         *
+         * \param pool threads to use.
+         * \param alpha scaling factor for A * x.
+         * \param x input vector (N elements).
+         * \param beta scaling factor for y.
+         * \param y output vector (M elements).
+         * \param partitioning work distribution over the threads.
+         */
+        void multiply(ThreadPool& pool, const T alpha, const T* x, const T beta, T* y,
+                      Partitioning partitioning = Partitioning::Rows) const
+        {
+            sparsematrix_detail::csr_spmv_parallel(pool, M, _row_ptr.data(), _col_idx.data(), _values.data(), alpha, x,
+                                                   beta, y, partitioning);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = A * x like multiply(x, y), using the threads of a pool.
+         *
+         * \param pool threads to use.
+         * \param x input vector (N elements).
+         * \param y output vector (M elements).
+         * \param partitioning work distribution over the threads.
+         */
+        void multiply(ThreadPool& pool, const T* x, T* y, Partitioning partitioning = Partitioning::Rows) const
+        {
+            multiply(pool, T(1), x, T(0), y, partitioning);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y, using the threads of a pool. Sizes of x and y are checked at compile
+         * time.
+         *
+         * \param pool threads to use.
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         * \param partitioning work distribution over the threads.
+         */
+        void multiply(ThreadPool& pool, const T alpha, const std::array<T, N>& x, const T beta,
+                      std::array<T, M>& y, Partitioning partitioning = Partitioning::Rows) const
+        {
+            multiply(pool, alpha, x.data(), beta, y.data(), partitioning);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = A * x, using the threads of a pool. Sizes of x and y are checked at compile time.
+         *
+         * \param pool threads to use.
+         * \param x input vector.
+         * \param y output vector.
+         * \param partitioning work distribution over the threads.
+         */
+        void multiply(ThreadPool& pool, const std::array<T, N>& x, std::array<T, M>& y,
+                      Partitioning partitioning = Partitioning::Rows) const
+        {
+            multiply(pool, T(1), x.data(), T(0), y.data(), partitioning);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y, using the threads of a pool. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param pool threads to use.
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         * \param partitioning work distribution over the threads.
+         */
+        void multiply(ThreadPool& pool, const T alpha, const std::vector<T>& x, const T beta,
+                      std::vector<T>& y, Partitioning partitioning = Partitioning::Rows) const
+        {
+            if (x.size() != N || y.size() != M)
+            {
+                throw std::out_of_range("vector size mismatch");
+            }
+
+            multiply(pool, alpha, x.data(), beta, y.data(), partitioning);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = A * x, using the threads of a pool. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param pool threads to use.
+         * \param x input vector.
+         * \param y output vector.
+         * \param partitioning work distribution over the threads.
+         */
+        void multiply(ThreadPool& pool, const std::vector<T>& x, std::vector<T>& y,
+                      Partitioning partitioning = Partitioning::Rows) const
+        {
+            multiply(pool, T(1), x, T(0), y, partitioning);
+        }
+
+        //! Sparse matrix-dense matrix product.
+        /*!
+         * Computes C = alpha * A * B + beta * C for a dense matrix B with N rows and k columns and a dense matrix C
+         * with M rows and k columns, both stored in the given layout with leading dimensions ldb and ldc. Every
+         * allocated element of A is read from memory once and used for all k columns, which is much faster than k
+         * matrix-vector products. If beta is zero, C is not read. No memory is allocated.
+         * Throws std::out_of_range if a leading dimension is smaller than a row (row-major) or a column
+         * (column-major) of the matrix.
+         *
+         * \param k number of columns of B and C.
+         * \param alpha scaling factor for A * B.
+         * \param b input matrix (N x k).
+         * \param ldb leading dimension of B.
+         * \param beta scaling factor for C.
+         * \param c output matrix (M x k).
+         * \param ldc leading dimension of C.
+         * \param layout storage order of B and C.
+         */
+        void multiply(size_t k, const T alpha, const T* b, size_t ldb, const T beta, T* c, size_t ldc,
+                      DenseLayout layout = DenseLayout::RowMajor) const
+        {
+            sparsematrix_detail::csr_spmm_dense<T, I>(nullptr, M, N, _row_ptr.data(), _col_idx.data(), _values.data(),
+                                                      k, alpha, b, ldb, beta, c, ldc, layout);
+        }
+
+        //! Sparse matrix-dense matrix product.
+        /*!
+         * Computes C = alpha * A * B + beta * C for dense matrices B (N x k) and C (M x k) without gaps between rows
+         * or columns. The vectors are not resized.
+         * Throws std::out_of_range if b does not have N x k elements or c does not have M x k elements.
+         *
+         * \param k number of columns of B and C.
+         * \param alpha scaling factor for A * B.
+         * \param b input matrix.
+         * \param beta scaling factor for C.
+         * \param c output matrix.
+         * \param layout storage order of B and C.
+         */
+        void multiply(size_t k, const T alpha, const std::vector<T>& b, const T beta, std::vector<T>& c,
+                      DenseLayout layout = DenseLayout::RowMajor) const
+        {
+            if (b.size() != N * k || c.size() != M * k)
+            {
+                throw std::out_of_range("matrix size mismatch");
+            }
+
+            const bool row_major = layout == DenseLayout::RowMajor;
+            multiply(k, alpha, b.data(), row_major ? k : N, beta, c.data(), row_major ? k : M, layout);
+        }
+
+        //! Sparse matrix-dense matrix product.
+        /*!
+         * Computes C = A * B for dense matrices B (N x k) and C (M x k) without gaps between rows or columns. The
+         * vectors are not resized.
+         * Throws std::out_of_range if b does not have N x k elements or c does not have M x k elements.
+         *
+         * \param k number of columns of B and C.
+         * \param b input matrix.
+         * \param c output matrix.
+         * \param layout storage order of B and C.
+         */
+        void multiply(size_t k, const std::vector<T>& b, std::vector<T>& c,
+                      DenseLayout layout = DenseLayout::RowMajor) const
+        {
+            multiply(k, T(1), b, T(0), c, layout);
+        }
+
+        //! Parallel sparse matrix-dense matrix product.
+        /*!
+         * Computes C = alpha * A * B + beta * C like multiply(k, alpha, b, ldb, beta, c, ldc, layout), using the
+         * threads of a pool. The rows are split into one part per thread, with roughly equal numbers of allocated
+         * elements.
+         *
+         * \param pool threads to use.
+         * \param k number of columns of B and C.
+         * \param alpha scaling factor for A * B.
+         * \param b input matrix (N x k).
+         * \param ldb leading dimension of B.
+         * \param beta scaling factor for C.
+         * \param c output matrix (M x k).
+         * \param ldc leading dimension of C.
+         * \param layout storage order of B and C.
+         */
+        void multiply(ThreadPool& pool, size_t k, const T alpha, const T* b, size_t ldb, const T beta, T* c,
+                      size_t ldc, DenseLayout layout = DenseLayout::RowMajor) const
+        {
+            sparsematrix_detail::csr_spmm_dense<T, I>(&pool, M, N, _row_ptr.data(), _col_idx.data(), _values.data(),
+                                                      k, alpha, b, ldb, beta, c, ldc, layout);
+        }
+
+        //! Parallel sparse matrix-dense matrix product.
+        /*!
+         * Computes C = A * B for dense matrices B (N x k) and C (M x k) without gaps between rows or columns, using
+         * the threads of a pool. The vectors are not resized.
+         * Throws std::out_of_range if b does not have N x k elements or c does not have M x k elements.
+         *
+         * \param pool threads to use.
+         * \param k number of columns of B and C.
+         * \param b input matrix.
+         * \param c output matrix.
+         * \param layout storage order of B and C.
+         */
+        void multiply(ThreadPool& pool, size_t k, const std::vector<T>& b, std::vector<T>& c,
+                      DenseLayout layout = DenseLayout::RowMajor) const
+        {
+            if (b.size() != N * k || c.size() != M * k)
+            {
+                throw std::out_of_range("matrix size mismatch");
+            }
+
+            const bool row_major = layout == DenseLayout::RowMajor;
+            multiply(pool, k, T(1), b.data(), row_major ? k : N, T(0), c.data(), row_major ? k : M, layout);
+        }
+
+        //! Transpose.
+        /*!
+         * Returns a copy of the matrix with rows and columns swapped. The elements are redistributed with a counting
+         * sort on their column index, which takes O(M + N + R) time for R allocated elements.
+         *
+         * \return A^T.
+         */
+        CsrMatrix<N, M, T, I> transpose() const
+        {
+            CsrMatrix<N, M, T, I> lhs;
+            lhs._col_idx.resize(_col_idx.size());
+            lhs._values.resize(_values.size());
+
+            // Count the elements in every column and turn the counts into offsets.
+            for (const size_t j : _col_idx)
+            {
+                ++lhs._row_ptr[j + 1];
+            }
+            for (size_t j = 0; j < N; ++j)
+            {
+                lhs._row_ptr[j + 1] += lhs._row_ptr[j];
+            }
+
+            // Rows are visited in order, so the column indices of the transpose end up sorted.
+            std::vector<size_t> next(lhs._row_ptr.cbegin(), lhs._row_ptr.cend() - 1);
+            for (size_t i = 0; i < M; ++i)
+            {
+                for (size_t n = _row_ptr[i]; n < _row_ptr[i + 1]; ++n)
+                {
+                    const size_t pos = next[_col_idx[n]]++;
+                    lhs._col_idx[pos] = static_cast<I>(i);
+                    lhs._values[pos] = _values[n];
+                }
+            }
+
+            return lhs;
+        }
+
+};
+
+#endif  // CSRMATRIX_H
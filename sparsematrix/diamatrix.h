@@ -0,0 +1,709 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#ifndef DIAMATRIX_H
+#define DIAMATRIX_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "csrmatrix.h"
+#include "sparsematrix.h"
+#include "threadpool.h"
+
+
+//! Algorithms shared by the matrix classes.
+namespace sparsematrix_detail
+{
+
+//! Number of rows that are computed together by dia_spmv().
+static const size_t dia_tile = 1024;
+
+//! Sparse matrix-vector product in DIA format.
+/*!
+ * Computes y(i) = alpha * A(i,:) * x + beta * y(i) for the rows i in [first, last) of a matrix A in DIA format. Element
+ * (i, i + offsets[d]) of A is values[d * stride + i]. The rows are processed in tiles of dia_tile rows; for every tile,
+ * every diagonal is added to a local sum as a single loop over contiguous elements of the diagonal and of x, which the
+ * compiler vectorizes. If beta is zero, y is not read, so it does not need to be initialized.
+ *
+ * \param first first row to compute.
+ * \param last one past the last row to compute.
+ * \param cols number of columns of A.
+ * \param stride distance between the diagonals in values (at least the number of rows).
+ * \param diagonals number of diagonals.
+ * \param offsets offset of every diagonal: column minus row.
+ * \param values values of A.
+ * \param alpha scaling factor for A * x.
+ * \param x input vector (N elements).
+ * \param beta scaling factor for y.
+ * \param y output vector (M elements).
+ */
+template <typename T>
+void dia_spmv(size_t first, size_t last, size_t cols, size_t stride, size_t diagonals, const std::ptrdiff_t* offsets,
+              const T* values, const T alpha, const T* x, const T beta, T* y)
+{
+    T sum[dia_tile];
+    for (size_t tile = first; tile < last; tile += dia_tile)
+    {
+        const size_t end = std::min(tile + dia_tile, last);
+        std::fill(sum, sum + (end - tile), T(0));
+
+        for (size_t d = 0; d < diagonals; ++d)
+        {
+            // Rows i of the tile for which column i + offset is inside the matrix.
+            const std::ptrdiff_t offset = offsets[d];
+            const size_t shift = static_cast<size_t>(offset);
+            const size_t lo = offset < 0 ? std::max(tile, static_cast<size_t>(-offset)) : tile;
+            const size_t hi = std::min(end, offset < 0 ? cols - shift : (cols > shift ? cols - shift : 0));
+            const T* v = values + d * stride;
+            for (size_t i = lo; i < hi; ++i)
+            {
+                sum[i - tile] += v[i] * x[i + shift];
+            }
+        }
+
+        for (size_t i = tile; i < end; ++i)
+        {
+            y[i] = (beta == T(0)) ? alpha * sum[i - tile] : alpha * sum[i - tile] + beta * y[i];
+        }
+    }
+}
+
+}  // namespace sparsematrix_detail
+
+
+//! Representation of a sparse matrix with M rows and N columns, of type T, in diagonal (DIA) format
+/*!
+ * This class represents a sparse matrix as a set of diagonals. Every stored diagonal is a contiguous array of M
+ * elements, indexed by row, plus its offset: element (i,j) is on the diagonal with offset j - i. No column indices are
+ * stored at all, and products, additions and scaling are loops over contiguous arrays. This is the most compact and
+ * fastest format for banded matrices, like stencil and tridiagonal matrices, but every element of a stored diagonal
+ * takes memory, so it is a poor fit for matrices with elements scattered over many diagonals.
+ *
+ * The diagonals are detected when converting from other storage. Like CsrMatrix, the storage is read-only: build a
+ * SparseMatrix or CsrMatrix and convert it. The index type I is the index type of those formats.
+ */
+template <size_t M, size_t N, typename T, typename I = size_t>
+class DiaMatrix
+{
+    static_assert(std::is_integral<I>::value && std::is_unsigned<I>::value, "index type must be unsigned integer");
+    static_assert(sparsematrix_detail::index_fits<I>(M) && sparsematrix_detail::index_fits<I>(N),
+                  "matrix dimensions exceed index type");
+
+    private:
+        //! Offsets of the stored diagonals (column minus row), in increasing order.
+        std::vector<std::ptrdiff_t> _offsets;
+
+        //! Stored diagonals, M elements each; element (i, i + _offsets[d]) is at position d * M + i.
+        std::vector<T> _values;
+
+        //! First row of a diagonal that is inside the matrix.
+        static size_t first_row(std::ptrdiff_t offset)
+        {
+            return offset < 0 ? static_cast<size_t>(-offset) : 0;
+        }
+
+        //! One past the last row of a diagonal that is inside the matrix.
+        static size_t last_row(std::ptrdiff_t offset)
+        {
+            return offset < 0 ? M : std::min(M, N - static_cast<size_t>(offset));
+        }
+
+        //! Find the diagonal with a given offset.
+        /*!
+         * \param offset column minus row.
+         * \return the number of the diagonal, or the number of diagonals if it is not stored.
+         */
+        size_t find(std::ptrdiff_t offset) const
+        {
+            const auto pos = std::lower_bound(_offsets.cbegin(), _offsets.cend(), offset);
+            if (pos == _offsets.cend() || *pos != offset)
+            {
+                return _offsets.size();
+            }
+            return static_cast<size_t>(pos - _offsets.cbegin());
+        }
+
+        //! Element-wise combination.
+        /*!
+         * Merges the diagonals of this matrix and another matrix of the same size. Diagonals that are stored in both
+         * matrices are combined element by element as op(a, b), diagonals that are only stored in one of them as
+         * op(a, 0) or op(0, b). The stored diagonals of the result are the union of those of both operands.
+         *
+         * \param rhs Right-hand side operand.
+         * \param op Binary operation to apply.
+         * \return the combined matrix.
+         */
+        template <typename Op>
+        DiaMatrix combine(const DiaMatrix& rhs, Op op) const
+        {
+            DiaMatrix lhs;
+            std::set_union(_offsets.cbegin(), _offsets.cend(), rhs._offsets.cbegin(), rhs._offsets.cend(),
+                           std::back_inserter(lhs._offsets));
+            lhs._values.resize(lhs._offsets.size() * M);
+
+            size_t a = 0;
+            size_t b = 0;
+            for (size_t d = 0; d < lhs._offsets.size(); ++d)
+            {
+                const bool in_a = a < _offsets.size() && _offsets[a] == lhs._offsets[d];
+                const bool in_b = b < rhs._offsets.size() && rhs._offsets[b] == lhs._offsets[d];
+                const T* va = _values.data() + a * M;
+                const T* vb = rhs._values.data() + b * M;
+                T* v = lhs._values.data() + d * M;
+                const size_t first = first_row(lhs._offsets[d]);
+                const size_t last = last_row(lhs._offsets[d]);
+                if (in_a && in_b)
+                {
+                    for (size_t i = first; i < last; ++i)
+                    {
+                        v[i] = op(va[i], vb[i]);
+                    }
+                }
+                else if (in_a)
+                {
+                    for (size_t i = first; i < last; ++i)
+                    {
+                        v[i] = op(va[i], T(0));
+                    }
+                }
+                else
+                {
+                    for (size_t i = first; i < last; ++i)
+                    {
+                        v[i] = op(T(0), vb[i]);
+                    }
+                }
+                a += in_a;
+                b += in_b;
+            }
+
+            return lhs;
+        }
+
+    public:
+        //! Default constructor.
+        DiaMatrix() = default;
+
+        //! Conversion from compressed row storage.
+        /*!
+         * Create an instance from a CsrMatrix. The stored diagonals are all diagonals that hold at least one allocated
+         * element; they are found in a first pass over the column indices and filled in a second.
+         *
+         * \param other matrix to be converted.
+         */
+        explicit DiaMatrix(const CsrMatrix<M, N, T, I>& other)
+        {
+            const std::vector<size_t>& row_ptr = other.row_ptr();
+            const std::vector<I>& col_idx = other.col_idx();
+
+            // Diagonal number of every offset, shifted by M - 1 to start at zero; zero if the offset is not used.
+            std::vector<size_t> diagonal(M + N, 0);
+            for (size_t i = 0; i < M; ++i)
+            {
+                for (size_t n = row_ptr[i]; n < row_ptr[i + 1]; ++n)
+                {
+                    diagonal[col_idx[n] + M - 1 - i] = 1;
+                }
+            }
+            for (size_t k = 0; k < M + N; ++k)
+            {
+                if (diagonal[k] != 0)
+                {
+                    diagonal[k] = _offsets.size();
+                    _offsets.push_back(static_cast<std::ptrdiff_t>(k) - static_cast<std::ptrdiff_t>(M - 1));
+                }
+            }
+
+            _values.assign(_offsets.size() * M, T(0));
+            for (size_t i = 0; i < M; ++i)
+            {
+                for (size_t n = row_ptr[i]; n < row_ptr[i + 1]; ++n)
+                {
+                    _values[diagonal[col_idx[n] + M - 1 - i] * M + i] = other.values()[n];
+                }
+            }
+        }
+
+        //! Conversion from map storage.
+        /*!
+         * Create an instance from a SparseMatrix, via compressed row storage.
+         *
+         * \param other matrix to be converted.
+         */
+        template <typename Alloc>
+        explicit DiaMatrix(const SparseMatrix<M, N, T, I, Alloc>& other) : DiaMatrix(CsrMatrix<M, N, T, I>(other))
+        {
+        }
+
+        //! Conversion to compressed row storage.
+        /*!
+         * Create a CsrMatrix with the non-zero elements of the stored diagonals. Zero elements are not allocated in the
+         * result.
+         *
+         * \return the matrix in compressed row storage.
+         */
+        CsrMatrix<M, N, T, I> to_csr() const
+        {
+            std::vector<size_t> row_ptr(M + 1, 0);
+            std::vector<I> col_idx;
+            std::vector<T> values;
+            for (size_t i = 0; i < M; ++i)
+            {
+                // Offsets are increasing, so the columns of a row are visited in order.
+                for (size_t d = 0; d < _offsets.size(); ++d)
+                {
+                    const T& v = _values[d * M + i];
+                    if (i >= first_row(_offsets[d]) && i < last_row(_offsets[d]) && v != T(0))
+                    {
+                        col_idx.push_back(static_cast<I>(i + static_cast<size_t>(_offsets[d])));
+                        values.push_back(v);
+                    }
+                }
+                row_ptr[i + 1] = col_idx.size();
+            }
+
+            return CsrMatrix<M, N, T, I>(std::move(row_ptr), std::move(col_idx), std::move(values));
+        }
+
+        //! Conversion to map storage.
+        /*!
+         * Create a SparseMatrix with the non-zero elements of the stored diagonals.
+         *
+         * \return the matrix in map storage.
+         */
+        SparseMatrix<M, N, T, I> to_sparse() const
+        {
+            return to_csr().to_sparse();
+        }
+
+        //! Read an element at index (i,j).
+        /*!
+         * Read an individual element at row i and column j. The storage is read-only, so a copy of the value is
+         * returned; elements that are not on a stored diagonal read as zero.
+         * Throws std::out_of_range if either i or j exceeds the respective matrix dimension.
+         *
+         * \sa peek()
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return the value of the element at (i,j).
+         */
+        T operator()(size_t i, size_t j) const
+        {
+            if (i >= M || j >= N)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            const size_t d = find(static_cast<std::ptrdiff_t>(j) - static_cast<std::ptrdiff_t>(i));
+            return d == _offsets.size() ? T(0) : _values[d * M + i];
+        }
+
+        //! Size of the matrix.
+        /*!
+         * Gives the size of the matrix as the number of elements. By definition, this is equal to M x N.
+         *
+         * \sa allocated()
+         *
+         * \return the matrix size.
+         */
+        size_t size() const
+        {
+            return M * N;
+        }
+
+        //! Number of allocated elements.
+        /*!
+         * Get the number of allocated elements: all elements of the matrix that are on a stored diagonal, including
+         * zeros. This takes time proportional to the number of diagonals.
+         *
+         * \sa diagonals()
+         *
+         * \return the number of allocated elements.
+         */
+        size_t allocated() const
+        {
+            size_t count = 0;
+            for (const std::ptrdiff_t offset : _offsets)
+            {
+                count += last_row(offset) - first_row(offset);
+            }
+            return count;
+        }
+
+        //! Number of stored diagonals.
+        size_t diagonals() const
+        {
+            return _offsets.size();
+        }
+
+        //! Memory footprint.
+        /*!
+         * Get the memory used by the matrix: the size of this object plus the capacity of the two storage arrays.
+         * The overhead of the memory allocator is not included.
+         *
+         * \sa allocated()
+         *
+         * \return the memory footprint in bytes.
+         */
+        size_t memory_bytes() const
+        {
+            return sizeof(*this) + sparsematrix_detail::vector_memory_bytes(_offsets) +
+                   sparsematrix_detail::vector_memory_bytes(_values);
+        }
+
+        //! Peek if an element is allocated.
+        /*!
+         * Check if the element is stored, which is the case for all elements of a stored diagonal. This is a binary
+         * search over the diagonals.
+         * Throws std::out_of_range if either i or j exceeds the respective matrix dimension.
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return Boolean value indicating if the element is allocated.
+         */
+        bool peek(size_t i, size_t j) const
+        {
+            if (i >= M || j >= N)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            return find(static_cast<std::ptrdiff_t>(j) - static_cast<std::ptrdiff_t>(i)) != _offsets.size();
+        }
+
+        //! Offsets of the stored diagonals (column minus row), in increasing order.
+        const std::vector<std::ptrdiff_t>& offsets() const
+        {
+            return _offsets;
+        }
+
+        //! Stored diagonals, M elements each; element (i, i + offsets()[d]) is at position d * M + i.
+        const std::vector<T>& values() const
+        {
+            return _values;
+        }
+
+        //! Check for equality.
+        /*!
+         * Check for equality by comparing the internal storage. This is a strict comparison that also considers the
+         * stored diagonals.
+         *
+         * \param rhs right-hand side of the equality test.
+         * \return Boolean value indicating equality.
+         */
+        bool operator==(const DiaMatrix& rhs) const
+        {
+            return _offsets == rhs._offsets && _values == rhs._values;
+        }
+
+        //! Check for inequality.
+        /*!
+         * Check for inequality by comparing the internal storage.
+         *
+         * \param rhs right-hand side of the inequality test.
+         * \return Boolean value indicating inequality.
+         */
+        bool operator!=(const DiaMatrix& rhs) const
+        {
+            return !(*this == rhs);
+        }
+
+        //! Addition.
+        /*!
+         * Implements A += B, with A and B of same size and type (checked at compile time). Diagonals are added
+         * element by element; diagonals that are only stored in B are added to A.
+         *
+         * \param rhs Matrix to add.
+         * \return A += B.
+         */
+        DiaMatrix& operator+=(const DiaMatrix& rhs)
+        {
+            if (_offsets == rhs._offsets)
+            {
+                // Same diagonals: a single stream over both arrays, in place.
+                std::transform(_values.cbegin(), _values.cend(), rhs._values.cbegin(), _values.begin(), std::plus<T>());
+            }
+            else
+            {
+                *this = combine(rhs, std::plus<T>());
+            }
+            return *this;
+        }
+
+        //! Addition.
+        /*!
+         * Implements A + B, with A and B of same size and type (checked at compile time).
+         *
+         * \param op1 First operand.
+         * \param op2 Second operand.
+         * \return A + B.
+         */
+        friend DiaMatrix operator+(const DiaMatrix& op1, const DiaMatrix& op2)
+        {
+            return op1.combine(op2, std::plus<T>());
+        }
+
+        //! Unitary plus.
+        /*!
+         * Returns the same matrix unaltered.
+         *
+         * \param rhs Any matrix A.
+         * \return A.
+         */
+        friend const DiaMatrix& operator+(const DiaMatrix& rhs)
+        {
+            return rhs;
+        }
+
+        //! Subtraction.
+        /*!
+         * Implements A -= B, with A and B of same size and type (checked at compile time).
+         *
+         * \param rhs Matrix to subtract.
+         * \return A -= B.
+         */
+        DiaMatrix& operator-=(const DiaMatrix& rhs)
+        {
+            if (_offsets == rhs._offsets)
+            {
+                std::transform(_values.cbegin(), _values.cend(), rhs._values.cbegin(), _values.begin(),
+                               std::minus<T>());
+            }
+            else
+            {
+                *this = combine(rhs, std::minus<T>());
+            }
+            return *this;
+        }
+
+        //! Subtraction.
+        /*!
+         * Implements A - B, with A and B of same size and type (checked at compile time).
+         *
+         * \param op1 First operand.
+         * \param op2 Second operand.
+         * \return A - B.
+         */
+        friend DiaMatrix operator-(const DiaMatrix& op1, const DiaMatrix& op2)
+        {
+            return op1.combine(op2, std::minus<T>());
+        }
+
+        //! Unitary minus.
+        /*!
+         * Returns a copy of the input matrix with every element negated.
+         *
+         * \param rhs Any matrix A.
+         * \return -A.
+         */
+        friend DiaMatrix operator-(const DiaMatrix& rhs)
+        {
+            DiaMatrix lhs = rhs;
+            for (auto& v : lhs._values)
+            {
+                v = -v;
+            }
+            return lhs;
+        }
+
+        //! Scaling.
+        /*!
+         * Returns a copy of the input matrix with every element scaled.
+         *
+         * \param s Scaling factor.
+         * \param op2 Any matrix A.
+         * \return s x A.
+         */
+        friend DiaMatrix operator*(const T s, const DiaMatrix& op2)
+        {
+            DiaMatrix lhs = op2;
+            for (auto& v : lhs._values)
+            {
+                v *= s;
+            }
+            return lhs;
+        }
+
+        //! Scaling.
+        /*!
+         * Returns a copy of the input matrix with every element scaled.
+         *
+         * \param op1 Any matrix A.
+         * \param s Scaling factor.
+         * \return A x s.
+         */
+        friend DiaMatrix operator*(const DiaMatrix& op1, const T s)
+        {
+            return s * op1;
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y for a dense vector x of N elements and a dense vector y of M elements.
+         * Every diagonal is applied to a tile of rows as a single loop over contiguous elements.
+         * If beta is zero, y is not read, so it does not need to be initialized. No memory is allocated.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector (N elements).
+         * \param beta scaling factor for y.
+         * \param y output vector (M elements).
+         */
+        void multiply(const T alpha, const T* x, const T beta, T* y) const
+        {
+            sparsematrix_detail::dia_spmv(0, M, N, M, _offsets.size(), _offsets.data(), _values.data(), alpha, x, beta,
+                                          y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x for a dense vector x of N elements and a dense vector y of M elements.
+         *
+         * \param x input vector (N elements).
+         * \param y output vector (M elements).
+         */
+        void multiply(const T* x, T* y) const
+        {
+            multiply(T(1), x, T(0), y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y, with sizes of x and y checked at compile time.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(const T alpha, const std::array<T, N>& x, const T beta, std::array<T, M>& y) const
+        {
+            multiply(alpha, x.data(), beta, y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x, with sizes of x and y checked at compile time.
+         *
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(const std::array<T, N>& x, std::array<T, M>& y) const
+        {
+            multiply(T(1), x.data(), T(0), y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(const T alpha, const std::vector<T>& x, const T beta, std::vector<T>& y) const
+        {
+            if (x.size() != N || y.size() != M)
+            {
+                throw std::out_of_range("vector size mismatch");
+            }
+
+            multiply(alpha, x.data(), beta, y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(const std::vector<T>& x, std::vector<T>& y) const
+        {
+            multiply(T(1), x, T(0), y);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y like multiply(alpha, x, beta, y), using the threads of a pool. Every
+         * row holds the same number of diagonals, so the rows are split into equal parts. No memory is allocated.
+         *
+         * \param pool threads to use.
+         * \param alpha scaling factor for A * x.
+         * \param x input vector (N elements).
+         * \param beta scaling factor for y.
+         * \param y output vector (M elements).
+         */
+        void multiply(ThreadPool& pool, const T alpha, const T* x, const T beta, T* y) const
+        {
+            const std::ptrdiff_t* offsets = _offsets.data();
+            const T* values = _values.data();
+            const size_t diagonals = _offsets.size();
+            const size_t parts = pool.size();
+            pool.run(parts, [=](size_t part)
+            {
+                sparsematrix_detail::dia_spmv(M * part / parts, M * (part + 1) / parts, N, M, diagonals, offsets,
+                                              values, alpha, x, beta, y);
+            });
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = A * x like multiply(x, y), using the threads of a pool.
+         *
+         * \param pool threads to use.
+         * \param x input vector (N elements).
+         * \param y output vector (M elements).
+         */
+        void multiply(ThreadPool& pool, const T* x, T* y) const
+        {
+            multiply(pool, T(1), x, T(0), y);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = A * x, using the threads of a pool. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param pool threads to use.
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(ThreadPool& pool, const std::vector<T>& x, std::vector<T>& y) const
+        {
+            if (x.size() != N || y.size() != M)
+            {
+                throw std::out_of_range("vector size mismatch");
+            }
+
+            multiply(pool, T(1), x.data(), T(0), y.data());
+        }
+};
+
+#endif  // DIAMATRIX_H
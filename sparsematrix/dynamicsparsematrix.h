@@ -0,0 +1,554 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#ifndef DYNAMICSPARSEMATRIX_H
+#define DYNAMICSPARSEMATRIX_H
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <map>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "sparsematrix.h"
+
+
+class MatrixMarketReader;
+
+
+//! Representation of a sparse matrix of type T, with dimensions set at runtime
+/*!
+ * This class is the counterpart of SparseMatrix for matrices of which the size is only known at runtime, for example
+ * when they are read from a file. Storage and operations are the same, but dimensions are checked at runtime: an
+ * operation on matrices of incompatible size throws std::out_of_range, like an index that is out of bounds.
+ *
+ * As for SparseMatrix, indices are stored as type I; the dimensions are checked against this type on construction.
+ */
+template <typename T, typename I = size_t>
+class DynamicSparseMatrix
+{
+    static_assert(std::is_integral<I>::value && std::is_unsigned<I>::value, "index type must be unsigned integer");
+
+    private:
+        //! Number of rows.
+        size_t _rows;
+
+        //! Number of columns.
+        size_t _cols;
+
+        //! Internal storage map; keys are pairs (i,j), which are sorted first by i and then by j (row-major order).
+        std::map<std::pair<I, I>, T> _values;
+
+        //! Matrices read from a file are inserted in row-major order without per-element lookups.
+        friend class MatrixMarketReader;
+
+        //! Storage key of the element at index (i,j); the indices must be in bounds.
+        static std::pair<I, I> key(size_t i, size_t j)
+        {
+            return std::pair<I, I>(static_cast<I>(i), static_cast<I>(j));
+        }
+
+        //! Check that another matrix has the same size.
+        /*!
+         * Throws std::out_of_range if the size of the other matrix differs.
+         *
+         * \param other matrix to check.
+         */
+        void check_same_size(const DynamicSparseMatrix& other) const
+        {
+            if (_rows != other._rows || _cols != other._cols)
+            {
+                throw std::out_of_range("dimension mismatch");
+            }
+        }
+
+    public:
+        //! Default constructor; creates a matrix with zero rows and columns.
+        DynamicSparseMatrix() : _rows(0), _cols(0)
+        {
+        }
+
+        //! Constructor.
+        /*!
+         * Create an empty matrix of the given size. No memory is allocated until elements are populated.
+         * Throws std::out_of_range if the indices do not fit the index type I.
+         *
+         * \param rows number of rows.
+         * \param cols number of columns.
+         */
+        DynamicSparseMatrix(size_t rows, size_t cols) : _rows(rows), _cols(cols)
+        {
+            if (!sparsematrix_detail::index_fits<I>(rows) || !sparsematrix_detail::index_fits<I>(cols))
+            {
+                throw std::out_of_range("dimensions exceed index type");
+            }
+        }
+
+        //! Copy-constructor
+        /*!
+         * Create a copy of an existing instance.
+         *
+         * \param other object to be copied.
+         */
+        DynamicSparseMatrix(const DynamicSparseMatrix& other) = default;
+
+        //! Move-constructor.
+        DynamicSparseMatrix(DynamicSparseMatrix&& other) = default;
+
+        //! Copy-assignment.
+        DynamicSparseMatrix& operator=(const DynamicSparseMatrix& other) = default;
+
+        //! Move-assignment.
+        DynamicSparseMatrix& operator=(DynamicSparseMatrix&& other) = default;
+
+        //! Construction via initializer list.
+        /*!
+         * Create an instance of the given size by providing a (key, value)-list for the cells to be populated. The key
+         * is a pair (i,j) corresponding to the row and column indices into the matrix.
+         * Throws std::out_of_range if any key exceeds the matrix dimensions.
+         *
+         * \param rows number of rows.
+         * \param cols number of columns.
+         * \param m initializer list of (key, value) pairs.
+         */
+        DynamicSparseMatrix(size_t rows, size_t cols,
+                            std::initializer_list<std::pair<const std::pair<size_t, size_t>, T>> m)
+            : DynamicSparseMatrix(rows, cols)
+        {
+            for (const auto& elem : m)
+            {
+                size_t i, j;
+                std::tie(i, j) = elem.first;
+                if (i >= _rows || j >= _cols)
+                {
+                    throw std::out_of_range("index out of bounds");
+                }
+                _values.emplace(key(i, j), elem.second);
+            }
+        }
+
+        //! Conversion from a matrix with fixed dimensions.
+        /*!
+         * Create an instance with the same size and allocated elements as a SparseMatrix.
+         *
+         * \param other matrix to be converted.
+         */
+        template <size_t M, size_t N, typename Alloc>
+        explicit DynamicSparseMatrix(const SparseMatrix<M, N, T, I, Alloc>& other) : _rows(M), _cols(N)
+        {
+            for (auto elem = other.cbegin(); elem != other.cend(); ++elem)
+            {
+                _values.emplace_hint(_values.end(), *elem);
+            }
+        }
+
+        //! Conversion to a matrix with fixed dimensions.
+        /*!
+         * Create a SparseMatrix with the same allocated elements.
+         * Throws std::out_of_range if the size of this matrix is not M x N.
+         *
+         * \return the matrix with fixed dimensions.
+         */
+        template <size_t M, size_t N>
+        SparseMatrix<M, N, T, I> to_fixed() const
+        {
+            if (_rows != M || _cols != N)
+            {
+                throw std::out_of_range("dimension mismatch");
+            }
+
+            SparseMatrix<M, N, T, I> lhs;
+            for (auto elem = _values.cbegin(); elem != _values.cend(); ++elem)
+            {
+                lhs._values.emplace_hint(lhs._values.end(), *elem);
+            }
+            return lhs;
+        }
+
+        //! Number of rows.
+        size_t rows() const
+        {
+            return _rows;
+        }
+
+        //! Number of columns.
+        size_t cols() const
+        {
+            return _cols;
+        }
+
+        //! Access an element at index (i,j).
+        /*!
+         * Access an individual element at row i and column j. If the element was empty before, it is created. Use
+         * peek() to avoid this.
+         * Throws std::out_of_range if either i or j exceeds the respective matrix dimension.
+         *
+         * \sa peek()
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return a reference to the element at (i,j).
+         */
+        T& operator()(size_t i, size_t j)
+        {
+            if (i >= _rows || j >= _cols)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            // Keys are inserted if non-existing.
+            return _values[key(i, j)];
+        }
+
+        //! Size of the matrix.
+        /*!
+         * Gives the size of the matrix as the number of elements, i.e. rows x columns.
+         *
+         * \sa allocated()
+         *
+         * \return the matrix size.
+         */
+        size_t size() const
+        {
+            return _rows * _cols;
+        }
+
+        //! Number of allocated elements.
+        /*!
+         * Get the number of allocated elements. This takes constant time.
+         *
+         * \sa size()
+         *
+         * \return the number of allocated elements.
+         */
+        size_t allocated() const
+        {
+            return _values.size();
+        }
+
+        //! Memory footprint.
+        /*!
+         * Get the memory used by the matrix: the size of this object plus the heap memory of the allocated elements,
+         * which are stored in separate map nodes. The overhead of the memory allocator is not included.
+         *
+         * \sa allocated()
+         *
+         * \return the memory footprint in bytes.
+         */
+        size_t memory_bytes() const
+        {
+            return sizeof(*this) + sparsematrix_detail::map_memory_bytes(_values);
+        }
+
+        //! Peek if an element is allocated.
+        /*!
+         * Check if the element has an allocated space in the internal storage.
+         * Throws std::out_of_range if either i or j exceeds the respective matrix dimension.
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return Boolean value indicating if the element is allocated.
+         */
+        bool peek(size_t i, size_t j) const
+        {
+            if (i >= _rows || j >= _cols)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            return _values.find(key(i, j)) != _values.end();
+        }
+
+        //! Constant iterator to the beginning of the internal map storage.
+        const typename std::map<std::pair<I, I>, T>::const_iterator cbegin() const
+        {
+            return _values.cbegin();
+        }
+
+        //! Constant iterator to the end of the internal map storage.
+        const typename std::map<std::pair<I, I>, T>::const_iterator cend() const
+        {
+            return _values.cend();
+        }
+
+        //! Check for equality.
+        /*!
+         * Check for equality by comparing the dimensions and the internal map storage. As for SparseMatrix, this is a
+         * strict comparison that also considers sparseness.
+         *
+         * \param rhs right-hand side of the equality test.
+         * \return Boolean value indicating equality.
+         */
+        bool operator==(const DynamicSparseMatrix& rhs) const
+        {
+            return _rows == rhs._rows && _cols == rhs._cols && _values == rhs._values;
+        }
+
+        //! Check for inequality.
+        /*!
+         * Check for inequality by comparing the dimensions and the internal map storage.
+         *
+         * \param rhs right-hand side of the inequality test.
+         * \return Boolean value indicating inequality.
+         */
+        bool operator!=(const DynamicSparseMatrix& rhs) const
+        {
+            return !(*this == rhs);
+        }
+
+        //! Addition.
+        /*!
+         * Implements A += B, with A and B of same size (checked at runtime). Both are merged in a single pass in
+         * row-major order.
+         * Throws std::out_of_range if the sizes differ.
+         *
+         * \param rhs Matrix to add.
+         * \return A += B.
+         */
+        DynamicSparseMatrix& operator+=(const DynamicSparseMatrix& rhs)
+        {
+            check_same_size(rhs);
+            typedef sparsematrix_detail::MapCursor<std::map<std::pair<I, I>, T>> Cursor;
+            sparsematrix_detail::map_merge(_values, Cursor(rhs._values), std::plus<T>());
+            return *this;
+        }
+
+        //! Addition.
+        /*!
+         * Implements A + B, with A and B of same size (checked at runtime).
+         * Throws std::out_of_range if the sizes differ.
+         *
+         * \param op1 First operand.
+         * \param op2 Second operand.
+         * \return A + B.
+         */
+        friend DynamicSparseMatrix operator+(const DynamicSparseMatrix& op1, const DynamicSparseMatrix& op2)
+        {
+            DynamicSparseMatrix lhs(op1);
+            lhs += op2;
+            return lhs;
+        }
+
+        //! Unitary plus.
+        /*!
+         * Returns the same matrix unaltered.
+         *
+         * \param rhs Any matrix A.
+         * \return A.
+         */
+        friend const DynamicSparseMatrix& operator+(const DynamicSparseMatrix& rhs)
+        {
+            return rhs;
+        }
+
+        //! Subtraction.
+        /*!
+         * Implements A -= B, with A and B of same size (checked at runtime). Both are merged in a single pass in
+         * row-major order.
+         * Throws std::out_of_range if the sizes differ.
+         *
+         * \param rhs Matrix to subtract.
+         * \return A -= B.
+         */
+        DynamicSparseMatrix& operator-=(const DynamicSparseMatrix& rhs)
+        {
+            check_same_size(rhs);
+            typedef sparsematrix_detail::MapCursor<std::map<std::pair<I, I>, T>> Cursor;
+            sparsematrix_detail::map_merge(_values, Cursor(rhs._values), std::minus<T>());
+            return *this;
+        }
+
+        //! Subtraction.
+        /*!
+         * Implements A - B, with A and B of same size (checked at runtime).
+         * Throws std::out_of_range if the sizes differ.
+         *
+         * \param op1 First operand.
+         * \param op2 Second operand.
+         * \return A - B.
+         */
+        friend DynamicSparseMatrix operator-(const DynamicSparseMatrix& op1, const DynamicSparseMatrix& op2)
+        {
+            DynamicSparseMatrix lhs(op1);
+            lhs -= op2;
+            return lhs;
+        }
+
+        //! Unitary minus.
+        /*!
+         * Returns a copy of the input matrix with every element negated.
+         *
+         * \param rhs Any matrix A.
+         * \return -A.
+         */
+        friend DynamicSparseMatrix operator-(const DynamicSparseMatrix& rhs)
+        {
+            DynamicSparseMatrix lhs = rhs;
+            for (auto elem = lhs._values.begin(); elem != lhs._values.end(); ++elem)
+            {
+                elem->second *= -1;
+            }
+            return lhs;
+        }
+
+        //! Scaling.
+        /*!
+         * Returns a copy of the input matrix with every element scaled.
+         *
+         * \param s Scaling factor.
+         * \param op2 Any matrix A.
+         * \return s x A.
+         */
+        friend DynamicSparseMatrix operator*(const T s, const DynamicSparseMatrix& op2)
+        {
+            DynamicSparseMatrix lhs = op2;
+            for (auto elem = lhs._values.begin(); elem != lhs._values.end(); ++elem)
+            {
+                elem->second *= s;
+            }
+            return lhs;
+        }
+
+        //! Scaling.
+        /*!
+         * Returns a copy of the input matrix with every element scaled.
+         *
+         * \param op1 Any matrix A.
+         * \param s Scaling factor.
+         * \return A x s.
+         */
+        friend DynamicSparseMatrix operator*(const DynamicSparseMatrix& op1, const T s)
+        {
+            return s * op1;
+        }
+
+        //! Multiplication
+        /*!
+         * Multiplies two matrices of compatible size (checked at runtime), row by row.
+         * Throws std::out_of_range if the number of columns of A differs from the number of rows of B.
+         *
+         * \sa sparsematrix_detail::map_multiply()
+         *
+         * \param op1 First operand.
+         * \param op2 Second operand.
+         * \return A x B.
+         */
+        friend DynamicSparseMatrix operator*(const DynamicSparseMatrix& op1, const DynamicSparseMatrix& op2)
+        {
+            if (op1._cols != op2._rows)
+            {
+                throw std::out_of_range("dimension mismatch");
+            }
+
+            DynamicSparseMatrix lhs(op1._rows, op2._cols);
+            if (op1.allocated() == 0 || op2.allocated() == 0)
+            {
+                return lhs;
+            }
+
+            sparsematrix_detail::map_multiply(op1._values, op2._values, op2._cols, lhs._values);
+            return lhs;
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y for a dense vector x with one element per column and a dense vector y
+         * with one element per row. If beta is zero, y is not read, so it does not need to be initialized. No memory
+         * is allocated.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(const T alpha, const T* x, const T beta, T* y) const
+        {
+            sparsematrix_detail::map_spmv(_values, _rows, alpha, x, beta, y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x for a dense vector x with one element per column and a dense vector y with one element
+         * per row.
+         *
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(const T* x, T* y) const
+        {
+            multiply(T(1), x, T(0), y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y. The vectors are not resized.
+         * Throws std::out_of_range if x does not have one element per column or y does not have one element per row.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(const T alpha, const std::vector<T>& x, const T beta, std::vector<T>& y) const
+        {
+            if (x.size() != _cols || y.size() != _rows)
+            {
+                throw std::out_of_range("vector size mismatch");
+            }
+
+            multiply(alpha, x.data(), beta, y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x. The vectors are not resized.
+         * Throws std::out_of_range if x does not have one element per column or y does not have one element per row.
+         *
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(const std::vector<T>& x, std::vector<T>& y) const
+        {
+            multiply(T(1), x, T(0), y);
+        }
+
+        //! Transpose.
+        /*!
+         * Returns a copy of the matrix with rows and columns swapped.
+         *
+         * \return A^T.
+         */
+        DynamicSparseMatrix transpose() const
+        {
+            DynamicSparseMatrix lhs(_cols, _rows);
+            for (auto elem = _values.cbegin(); elem != _values.cend(); ++elem)
+            {
+                lhs._values.emplace(std::make_pair(elem->first.second, elem->first.first), elem->second);
+            }
+
+            return lhs;
+        }
+
+};
+
+#endif  // DYNAMICSPARSEMATRIX_H
@@ -0,0 +1,1102 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#ifndef MATRIXMARKET_H
+#define MATRIXMARKET_H
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "csrmatrix.h"
+#include "dynamicsparsematrix.h"
+#include "sparsematrix.h"
+#include "sparsematrixbuilder.h"
+
+
+//! Type of the values in a Matrix Market file.
+enum class MatrixMarketField
+{
+    //! Floating point values.
+    Real,
+
+    //! Integer values.
+    Integer,
+
+    //! No values; every listed element is one.
+    Pattern
+};
+
+
+//! Symmetry of a matrix in a Matrix Market file.
+enum class MatrixMarketSymmetry
+{
+    //! All elements are listed.
+    General,
+
+    //! Only elements on and below the diagonal are listed; element (i,j) is also element (j,i).
+    Symmetric
+};
+
+
+//! Algorithms shared by the matrix classes.
+namespace sparsematrix_detail
+{
+
+//! Size of the buffers for reading and writing Matrix Market files.
+static const size_t matrix_market_buffer_size = 1 << 20;
+
+//! Largest number of elements for which memory is reserved before they are read; beyond it, containers grow as the
+//! elements are read, so that the count in the header of a corrupt file cannot exhaust memory.
+static const size_t matrix_market_reserve_limit = 1 << 24;
+
+//! Buffered reader of the lines of a file
+/*!
+ * The file is read in large blocks with std::fread. Lines are returned in place in the buffer, terminated by a NUL
+ * character instead of the line break, so that they can be parsed without copying. The buffer grows if a line does not
+ * fit.
+ */
+class LineReader
+{
+    private:
+        //! The file.
+        std::FILE* _file;
+
+        //! Buffer; one byte more than the data, for the NUL character after an unterminated last line.
+        std::vector<char> _buffer;
+
+        //! Start of the data in the buffer that has not been returned yet.
+        size_t _begin;
+
+        //! End of the data in the buffer.
+        size_t _end;
+
+        //! Set when the end of the file has been reached.
+        bool _eof;
+
+        //! Number of the last returned line, starting at one.
+        size_t _line;
+
+    public:
+        //! Constructor; opens the file.
+        /*!
+         * Throws std::runtime_error if the file cannot be opened.
+         *
+         * \param filename name of the file.
+         */
+        explicit LineReader(const std::string& filename)
+            : _file(std::fopen(filename.c_str(), "rb")), _buffer(matrix_market_buffer_size + 1), _begin(0), _end(0),
+              _eof(false), _line(0)
+        {
+            if (_file == nullptr)
+            {
+                throw std::runtime_error("cannot open " + filename);
+            }
+        }
+
+        //! Readers cannot be copied.
+        LineReader(const LineReader&) = delete;
+
+        //! Readers cannot be copied.
+        LineReader& operator=(const LineReader&) = delete;
+
+        //! Destructor; closes the file.
+        ~LineReader()
+        {
+            std::fclose(_file);
+        }
+
+        //! Read the next line.
+        /*!
+         * The line is valid until the next call. Line breaks (LF or CRLF) are not included.
+         *
+         * \return the line as a NUL-terminated string, or nullptr at the end of the file.
+         */
+        char* next()
+        {
+            for (;;)
+            {
+                char* first = _buffer.data() + _begin;
+                char* last = static_cast<char*>(std::memchr(first, '\n', _end - _begin));
+                if (last != nullptr)
+                {
+                    _begin = last - _buffer.data() + 1;
+                }
+                else if (_eof)
+                {
+                    // The last line may not end with a line break; the buffer has room for the NUL character.
+                    if (_begin == _end)
+                    {
+                        return nullptr;
+                    }
+                    last = _buffer.data() + _end;
+                    _begin = _end;
+                }
+                else
+                {
+                    // Move the incomplete line to the front and fill the rest of the buffer; grow it if the line fills
+                    // the whole buffer.
+                    std::memmove(_buffer.data(), first, _end - _begin);
+                    _end -= _begin;
+                    _begin = 0;
+                    if (_end + 1 == _buffer.size())
+                    {
+                        _buffer.resize(2 * _buffer.size() - 1);
+                    }
+                    const size_t count = std::fread(_buffer.data() + _end, 1, _buffer.size() - 1 - _end, _file);
+                    if (count == 0)
+                    {
+                        if (std::ferror(_file))
+                        {
+                            throw std::runtime_error("read error");
+                        }
+                        _eof = true;
+                    }
+                    _end += count;
+                    continue;
+                }
+
+                if (last > first && last[-1] == '\r')
+                {
+                    --last;
+                }
+                *last = '\0';
+                ++_line;
+                return first;
+            }
+        }
+
+        //! Number of the last returned line, starting at one.
+        size_t line() const
+        {
+            return _line;
+        }
+};
+
+//! Buffered writer of a file
+/*!
+ * Text is collected in a large buffer that is written with std::fwrite when it is full.
+ */
+class BufferedWriter
+{
+    private:
+        //! The file.
+        std::FILE* _file;
+
+        //! Buffer.
+        std::vector<char> _buffer;
+
+        //! End of the data in the buffer.
+        size_t _end;
+
+        //! Write the buffer to the file.
+        void flush()
+        {
+            if (_end > 0 && std::fwrite(_buffer.data(), 1, _end, _file) != _end)
+            {
+                throw std::runtime_error("write error");
+            }
+            _end = 0;
+        }
+
+    public:
+        //! Constructor; creates the file.
+        /*!
+         * Throws std::runtime_error if the file cannot be created.
+         *
+         * \param filename name of the file.
+         */
+        explicit BufferedWriter(const std::string& filename)
+            : _file(std::fopen(filename.c_str(), "wb")), _buffer(matrix_market_buffer_size), _end(0)
+        {
+            if (_file == nullptr)
+            {
+                throw std::runtime_error("cannot create " + filename);
+            }
+        }
+
+        //! Writers cannot be copied.
+        BufferedWriter(const BufferedWriter&) = delete;
+
+        //! Writers cannot be copied.
+        BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+        //! Destructor; closes the file if close() was not called, ignoring errors.
+        ~BufferedWriter()
+        {
+            if (_file != nullptr)
+            {
+                std::fclose(_file);
+            }
+        }
+
+        //! Write text.
+        /*!
+         * \param text the text.
+         * \param length number of characters.
+         */
+        void write(const char* text, size_t length)
+        {
+            if (_end + length > _buffer.size())
+            {
+                flush();
+                if (length > _buffer.size())
+                {
+                    _buffer.resize(length);
+                }
+            }
+            std::memcpy(_buffer.data() + _end, text, length);
+            _end += length;
+        }
+
+        //! Write a non-negative integer.
+        /*!
+         * \param value the integer.
+         */
+        void write(unsigned long long value)
+        {
+            char digits[20];
+            char* first = digits + sizeof(digits);
+            do
+            {
+                *--first = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while (value != 0);
+            write(first, digits + sizeof(digits) - first);
+        }
+
+        //! Write a character.
+        /*!
+         * \param c the character.
+         */
+        void write(char c)
+        {
+            write(&c, 1);
+        }
+
+        //! Write a value.
+        /*!
+         * Integers are written exactly. Floating point values are written with as many digits as needed to read back
+         * the same value.
+         *
+         * \param value the value.
+         */
+        template <typename T>
+        void write_value(const T& value)
+        {
+            if (std::is_integral<T>::value && std::is_signed<T>::value)
+            {
+                const long long v = static_cast<long long>(value);
+                if (v < 0)
+                {
+                    write('-');
+                    write(0ULL - static_cast<unsigned long long>(v));
+                }
+                else
+                {
+                    write(static_cast<unsigned long long>(v));
+                }
+            }
+            else if (std::is_integral<T>::value)
+            {
+                write(static_cast<unsigned long long>(value));
+            }
+            else
+            {
+                // Widening to long double is exact, so float and double are printed as they would be on their own.
+                char text[48];
+                const int length = std::snprintf(text, sizeof(text), "%.*Lg", std::numeric_limits<T>::max_digits10,
+                                                 static_cast<long double>(value));
+                write(text, length);
+            }
+        }
+
+        //! Write the rest of the buffer and close the file.
+        /*!
+         * Throws std::runtime_error if writing fails.
+         */
+        void close()
+        {
+            flush();
+            std::FILE* file = _file;
+            _file = nullptr;
+            if (std::fclose(file) != 0)
+            {
+                throw std::runtime_error("write error");
+            }
+        }
+};
+
+#if defined(__i386__) || defined(__x86_64__)
+//! Long double is the x87 extended type, of which the first eight bytes hold the 64-bit mantissa.
+static const bool x87_long_double = std::numeric_limits<long double>::digits == 64;
+#else
+//! Long double is the x87 extended type, of which the first eight bytes hold the 64-bit mantissa.
+static const bool x87_long_double = false;
+#endif
+
+//! Skip spaces and tabs.
+inline const char* skip_blanks(const char* p)
+{
+    while (*p == ' ' || *p == '\t')
+    {
+        ++p;
+    }
+    return p;
+}
+
+//! Check if a token ends at a position, i.e. if it is followed by a blank or the end of the line.
+inline bool token_end(const char* p)
+{
+    return *p == ' ' || *p == '\t' || *p == '\0';
+}
+
+//! Parse a non-negative integer.
+/*!
+ * \param p position in a NUL-terminated string; moved past the integer.
+ * \param value output: the integer.
+ * \return false if there is no valid integer at the position, or if it does not fit.
+ */
+inline bool parse_unsigned(const char*& p, unsigned long long& value)
+{
+    const char* s = skip_blanks(p);
+    if (*s < '0' || *s > '9')
+    {
+        return false;
+    }
+
+    value = 0;
+    for (; *s >= '0' && *s <= '9'; ++s)
+    {
+        const unsigned digit = *s - '0';
+        if (value > (std::numeric_limits<unsigned long long>::max() - digit) / 10)
+        {
+            return false;
+        }
+        value = 10 * value + digit;
+    }
+    p = s;
+    return token_end(s);
+}
+
+//! Parse an integer with an optional sign.
+/*!
+ * \param p position in a NUL-terminated string; moved past the integer.
+ * \param value output: the integer.
+ * \return false if there is no valid integer at the position, or if it does not fit.
+ */
+inline bool parse_integer(const char*& p, long long& value)
+{
+    const char* s = skip_blanks(p);
+    const bool negative = *s == '-';
+    if (*s == '-' || *s == '+')
+    {
+        ++s;
+    }
+
+    unsigned long long magnitude;
+    if (*s < '0' || *s > '9' || !parse_unsigned(s, magnitude) ||
+        magnitude > static_cast<unsigned long long>(std::numeric_limits<long long>::max()) + (negative ? 1 : 0))
+    {
+        return false;
+    }
+    value = negative ? static_cast<long long>(0ULL - magnitude) : static_cast<long long>(magnitude);
+    p = s;
+    return true;
+}
+
+//! Parse a floating point number.
+/*!
+ * Numbers whose significant digits fit the 53-bit mantissa of a double and with a decimal exponent of at most 22 are
+ * converted with a single exact multiplication or division (Clinger's fast path), which is correctly rounded. Numbers
+ * with up to 19 significant digits, like the 17 digits needed to write a double exactly, are converted the same way
+ * in long double if that is the x87 type with a 64-bit mantissa: the digits and the power of ten are exact, so the
+ * result has a single rounding error, and rounding it to double gives the correctly rounded result unless it is
+ * halfway between two doubles. All other numbers, including infinity and NaN, and the rare halfway cases are converted
+ * with std::strtod.
+ *
+ * \param p position in a NUL-terminated string; moved past the number.
+ * \param value output: the number.
+ * \return false if there is no valid number at the position.
+ */
+inline bool parse_real(const char*& p, double& value)
+{
+    static const double powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    static const long double long_powers[] = {1e0L,  1e1L,  1e2L,  1e3L,  1e4L,  1e5L,  1e6L,  1e7L,  1e8L,  1e9L,
+                                              1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L,
+                                              1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L};
+
+    const char* start = skip_blanks(p);
+    const char* s = start;
+    const bool negative = *s == '-';
+    if (*s == '-' || *s == '+')
+    {
+        ++s;
+    }
+
+    // Significant digits, without leading zeros, and the power of ten by which they are scaled.
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any_digits = false;
+    for (; *s >= '0' && *s <= '9'; ++s)
+    {
+        any_digits = true;
+        if (digits < 19)
+        {
+            mantissa = 10 * mantissa + (*s - '0');
+            digits += mantissa != 0;
+        }
+        else
+        {
+            ++digits;
+            ++exponent;
+        }
+    }
+    if (*s == '.')
+    {
+        for (++s; *s >= '0' && *s <= '9'; ++s)
+        {
+            any_digits = true;
+            if (digits < 19)
+            {
+                mantissa = 10 * mantissa + (*s - '0');
+                digits += mantissa != 0;
+                --exponent;
+            }
+            else
+            {
+                ++digits;
+            }
+        }
+    }
+    if (any_digits && (*s == 'e' || *s == 'E'))
+    {
+        ++s;
+        const bool negative_exponent = *s == '-';
+        if (*s == '-' || *s == '+')
+        {
+            ++s;
+        }
+        if (*s < '0' || *s > '9')
+        {
+            return false;
+        }
+        int e = 0;
+        for (; *s >= '0' && *s <= '9'; ++s)
+        {
+            e = std::min(10 * e + (*s - '0'), 100000);
+        }
+        exponent += negative_exponent ? -e : e;
+    }
+
+    if (any_digits && token_end(s) && digits <= 19)
+    {
+        if (mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+        {
+            const double m = static_cast<double>(mantissa);
+            value = exponent < 0 ? m / powers[-exponent] : m * powers[exponent];
+            value = negative ? -value : value;
+            p = s;
+            return true;
+        }
+
+        if (x87_long_double && mantissa != 0 && exponent >= -27 && exponent <= 27)
+        {
+            const long double m = static_cast<long double>(mantissa);
+            const long double r = exponent < 0 ? m / long_powers[-exponent] : m * long_powers[exponent];
+
+            // The 11 bits below the mantissa of a double; 0x400 is halfway, and its neighbours may be rounded from it.
+            uint64_t bits;
+            std::memcpy(&bits, &r, sizeof(bits));
+            const uint64_t rest = bits & 0x7ff;
+            if (rest < 0x3ff || rest > 0x401)
+            {
+                value = static_cast<double>(r);
+                value = negative ? -value : value;
+                p = s;
+                return true;
+            }
+        }
+    }
+
+    char* end;
+    value = std::strtod(start, &end);
+    if (end == start || !token_end(end))
+    {
+        return false;
+    }
+    p = end;
+    return true;
+}
+
+//! Default type of the values in a Matrix Market file: integer for integer types and real otherwise.
+template <typename T>
+MatrixMarketField matrix_market_field()
+{
+    return std::is_integral<T>::value ? MatrixMarketField::Integer : MatrixMarketField::Real;
+}
+
+//! Write the header of a Matrix Market file.
+/*!
+ * \param writer the file.
+ * \param rows number of rows.
+ * \param cols number of columns.
+ * \param entries number of elements that follow.
+ * \param symmetry symmetry of the matrix.
+ * \param field type of the values.
+ */
+inline void write_matrix_market_header(BufferedWriter& writer, size_t rows, size_t cols, size_t entries,
+                                       MatrixMarketSymmetry symmetry, MatrixMarketField field)
+{
+    static const char banner[] = "%%MatrixMarket matrix coordinate ";
+    writer.write(banner, sizeof(banner) - 1);
+    const char* name = field == MatrixMarketField::Real ? "real" : field == MatrixMarketField::Integer ? "integer"
+                                                                                                       : "pattern";
+    writer.write(name, std::strlen(name));
+    writer.write(' ');
+    name = symmetry == MatrixMarketSymmetry::Symmetric ? "symmetric" : "general";
+    writer.write(name, std::strlen(name));
+    writer.write('\n');
+    writer.write(static_cast<unsigned long long>(rows));
+    writer.write(' ');
+    writer.write(static_cast<unsigned long long>(cols));
+    writer.write(' ');
+    writer.write(static_cast<unsigned long long>(entries));
+    writer.write('\n');
+}
+
+//! Write an element to a Matrix Market file.
+/*!
+ * \param writer the file.
+ * \param i row index (zero-based).
+ * \param j column index (zero-based).
+ * \param value value of the element.
+ * \param field type of the values; for pattern files, only the indices are written.
+ */
+template <typename T>
+void write_matrix_market_element(BufferedWriter& writer, size_t i, size_t j, const T& value, MatrixMarketField field)
+{
+    writer.write(static_cast<unsigned long long>(i + 1));
+    writer.write(' ');
+    writer.write(static_cast<unsigned long long>(j + 1));
+    if (field != MatrixMarketField::Pattern)
+    {
+        writer.write(' ');
+        writer.write_value(value);
+    }
+    writer.write('\n');
+}
+
+//! Check that a matrix can be written with the given symmetry and type of values.
+/*!
+ * Throws std::out_of_range if a symmetric matrix is not square, and std::runtime_error if integer values are requested
+ * for a floating point type.
+ *
+ * \param rows number of rows.
+ * \param cols number of columns.
+ * \param symmetry symmetry of the matrix.
+ * \param field type of the values.
+ */
+template <typename T>
+void check_matrix_market_format(size_t rows, size_t cols, MatrixMarketSymmetry symmetry, MatrixMarketField field)
+{
+    if (symmetry == MatrixMarketSymmetry::Symmetric && rows != cols)
+    {
+        throw std::out_of_range("dimension mismatch");
+    }
+    if (field == MatrixMarketField::Integer && !std::is_integral<T>::value)
+    {
+        throw std::runtime_error("integer field requires an integer value type");
+    }
+}
+
+//! Write a matrix with map storage (SparseMatrix or DynamicSparseMatrix) in Matrix Market format.
+/*!
+ * \param filename name of the file.
+ * \param rows number of rows.
+ * \param cols number of columns.
+ * \param matrix the matrix.
+ * \param symmetry symmetry of the matrix; for symmetric matrices, only the elements on and below the diagonal are
+ * written.
+ * \param field type of the values.
+ */
+template <typename T, typename Matrix>
+void write_matrix_market_map(const std::string& filename, size_t rows, size_t cols, const Matrix& matrix,
+                             MatrixMarketSymmetry symmetry, MatrixMarketField field)
+{
+    check_matrix_market_format<T>(rows, cols, symmetry, field);
+    const bool lower = symmetry == MatrixMarketSymmetry::Symmetric;
+
+    size_t entries = matrix.allocated();
+    if (lower)
+    {
+        entries = 0;
+        for (auto elem = matrix.cbegin(); elem != matrix.cend(); ++elem)
+        {
+            entries += elem->first.second <= elem->first.first;
+        }
+    }
+
+    BufferedWriter writer(filename);
+    write_matrix_market_header(writer, rows, cols, entries, symmetry, field);
+    for (auto elem = matrix.cbegin(); elem != matrix.cend(); ++elem)
+    {
+        if (!lower || elem->first.second <= elem->first.first)
+        {
+            write_matrix_market_element(writer, elem->first.first, elem->first.second, elem->second, field);
+        }
+    }
+    writer.close();
+}
+
+}  // namespace sparsematrix_detail
+
+
+//! Reader of sparse matrices in Matrix Market format
+/*!
+ * Reads matrices in the coordinate format of Matrix Market (.mtx) files, with real, integer or pattern values and
+ * general or symmetric storage. The header is read on construction, so that the size of the matrix is known before
+ * the elements are read. The elements are then read once, into a SparseMatrixBuilder (for matrices with fixed
+ * dimensions) or a DynamicSparseMatrix. Elements of a symmetric matrix are mirrored, and elements that are listed more
+ * than once are summed.
+ *
+ * The file is read in large blocks and numbers are parsed directly from the buffer, without streams, so that reading
+ * a large file is limited by the speed of the disk rather than by parsing.
+ *
+ * Errors in the file throw std::runtime_error, with the number of the offending line. Indices that exceed the size in
+ * the header throw std::out_of_range.
+ *
+ * Example:
+ * \code
+ * MatrixMarketReader reader("matrix.mtx");
+ * SparseMatrixBuilder<100, 100, double> builder;
+ * reader.read(builder);
+ * CsrMatrix<100, 100, double> c = builder.build_csr();
+ * \endcode
+ */
+class MatrixMarketReader
+{
+    private:
+        //! The file.
+        sparsematrix_detail::LineReader _input;
+
+        //! Type of the values.
+        MatrixMarketField _field;
+
+        //! Symmetry of the matrix.
+        MatrixMarketSymmetry _symmetry;
+
+        //! Number of rows.
+        size_t _rows;
+
+        //! Number of columns.
+        size_t _cols;
+
+        //! Number of elements listed in the file.
+        size_t _entries;
+
+        //! Set once the elements have been read.
+        bool _done;
+
+        //! Throw an error for the current line.
+        [[noreturn]] void error(const char* message) const
+        {
+            throw std::runtime_error("line " + std::to_string(_input.line()) + ": " + message);
+        }
+
+        //! Read the next line that is not a comment or empty; throws at the end of the file.
+        const char* next_line()
+        {
+            for (;;)
+            {
+                const char* line = _input.next();
+                if (line == nullptr)
+                {
+                    throw std::runtime_error("unexpected end of file");
+                }
+                line = sparsematrix_detail::skip_blanks(line);
+                if (*line != '%' && *line != '\0')
+                {
+                    return line;
+                }
+            }
+        }
+
+        //! Read the elements.
+        /*!
+         * \param add callable that is called with (i, j, value) for every element, with zero-based indices; elements
+         * of symmetric matrices are passed twice if they are not on the diagonal.
+         */
+        template <typename T, typename Add>
+        void read_entries(const Add& add)
+        {
+            if (_done)
+            {
+                throw std::runtime_error("elements have already been read");
+            }
+            _done = true;
+
+            for (size_t n = 0; n < _entries; ++n)
+            {
+                const char* p = next_line();
+                unsigned long long i;
+                unsigned long long j;
+                if (!sparsematrix_detail::parse_unsigned(p, i) || !sparsematrix_detail::parse_unsigned(p, j))
+                {
+                    error("invalid index");
+                }
+                if (i == 0 || j == 0 || i > _rows || j > _cols)
+                {
+                    throw std::out_of_range("index out of bounds");
+                }
+
+                T value(1);
+                if (_field == MatrixMarketField::Real)
+                {
+                    double v;
+                    if (!sparsematrix_detail::parse_real(p, v))
+                    {
+                        error("invalid value");
+                    }
+                    value = static_cast<T>(v);
+                }
+                else if (_field == MatrixMarketField::Integer)
+                {
+                    long long v;
+                    if (!sparsematrix_detail::parse_integer(p, v))
+                    {
+                        error("invalid value");
+                    }
+                    value = static_cast<T>(v);
+                }
+                if (*sparsematrix_detail::skip_blanks(p) != '\0')
+                {
+                    error("unexpected text after element");
+                }
+
+                add(i - 1, j - 1, value);
+                if (_symmetry == MatrixMarketSymmetry::Symmetric && i != j)
+                {
+                    add(j - 1, i - 1, value);
+                }
+            }
+        }
+
+    public:
+        //! Constructor; opens the file and reads the header.
+        /*!
+         * Throws std::runtime_error if the file cannot be opened, or if the header is invalid or describes a format
+         * that is not supported (array storage, complex values, skew-symmetric or Hermitian matrices). The header is
+         * also invalid if it lists more elements than the matrix can hold.
+         *
+         * \param filename name of the file.
+         */
+        explicit MatrixMarketReader(const std::string& filename) : _input(filename), _done(false)
+        {
+            const char* line = _input.next();
+            if (line == nullptr)
+            {
+                throw std::runtime_error("unexpected end of file");
+            }
+
+            // Banner: %%MatrixMarket matrix coordinate <field> <symmetry>, case insensitive.
+            std::vector<std::string> words;
+            for (const char* p = line; *p != '\0';)
+            {
+                p = sparsematrix_detail::skip_blanks(p);
+                std::string word;
+                for (; !sparsematrix_detail::token_end(p); ++p)
+                {
+                    word += static_cast<char>(std::tolower(static_cast<unsigned char>(*p)));
+                }
+                if (!word.empty())
+                {
+                    words.push_back(word);
+                }
+            }
+            if (words.size() != 5 || words[0] != "%%matrixmarket" || words[1] != "matrix")
+            {
+                error("invalid header");
+            }
+            if (words[2] != "coordinate")
+            {
+                error("unsupported format; only coordinate format is supported");
+            }
+
+            if (words[3] == "real" || words[3] == "double")
+            {
+                _field = MatrixMarketField::Real;
+            }
+            else if (words[3] == "integer")
+            {
+                _field = MatrixMarketField::Integer;
+            }
+            else if (words[3] == "pattern")
+            {
+                _field = MatrixMarketField::Pattern;
+            }
+            else
+            {
+                error("unsupported field; only real, integer and pattern are supported");
+            }
+
+            if (words[4] == "general")
+            {
+                _symmetry = MatrixMarketSymmetry::General;
+            }
+            else if (words[4] == "symmetric")
+            {
+                _symmetry = MatrixMarketSymmetry::Symmetric;
+            }
+            else
+            {
+                error("unsupported symmetry; only general and symmetric are supported");
+            }
+
+            // Size line: <rows> <columns> <entries>, after any comments.
+            const char* p = next_line();
+            unsigned long long rows;
+            unsigned long long cols;
+            unsigned long long entries;
+            if (!sparsematrix_detail::parse_unsigned(p, rows) || !sparsematrix_detail::parse_unsigned(p, cols) ||
+                !sparsematrix_detail::parse_unsigned(p, entries) || *sparsematrix_detail::skip_blanks(p) != '\0')
+            {
+                error("invalid size");
+            }
+            if (_symmetry == MatrixMarketSymmetry::Symmetric && rows != cols)
+            {
+                error("symmetric matrix is not square");
+            }
+
+            // A file lists every element at most once, so there are at most rows * cols elements, or rows * (rows + 1)
+            // / 2 for a symmetric matrix; the products saturate instead of overflowing.
+            const unsigned long long max = std::numeric_limits<unsigned long long>::max();
+            unsigned long long limit;
+            if (_symmetry == MatrixMarketSymmetry::Symmetric)
+            {
+                const unsigned long long a = rows % 2 == 0 ? rows / 2 : rows;
+                const unsigned long long b = rows % 2 == 0 ? rows + 1 : rows / 2 + 1;
+                limit = a > max / b ? max : a * b;
+            }
+            else
+            {
+                limit = cols != 0 && rows > max / cols ? max : rows * cols;
+            }
+            if (entries > limit || entries > std::numeric_limits<size_t>::max())
+            {
+                error("invalid size");
+            }
+            _rows = rows;
+            _cols = cols;
+            _entries = entries;
+        }
+
+        //! Number of rows.
+        size_t rows() const
+        {
+            return _rows;
+        }
+
+        //! Number of columns.
+        size_t cols() const
+        {
+            return _cols;
+        }
+
+        //! Number of elements listed in the file; for symmetric matrices, this excludes the mirrored elements.
+        size_t entries() const
+        {
+            return _entries;
+        }
+
+        //! Type of the values.
+        MatrixMarketField field() const
+        {
+            return _field;
+        }
+
+        //! Symmetry of the matrix.
+        MatrixMarketSymmetry symmetry() const
+        {
+            return _symmetry;
+        }
+
+        //! Read the elements into a builder.
+        /*!
+         * The elements are added to the builder, which can then assemble them in any storage format. Throws
+         * std::out_of_range if the size of the matrix in the file is not M x N.
+         *
+         * \param builder builder for the matrix.
+         */
+        template <size_t M, size_t N, typename T, typename I>
+        void read(SparseMatrixBuilder<M, N, T, I>& builder)
+        {
+            if (_rows != M || _cols != N)
+            {
+                throw std::out_of_range("dimension mismatch");
+            }
+
+            const size_t reserve = std::min(_entries, sparsematrix_detail::matrix_market_reserve_limit);
+            builder.reserve(builder.size() + (_symmetry == MatrixMarketSymmetry::Symmetric ? 2 : 1) * reserve);
+            read_entries<T>([&builder](size_t i, size_t j, const T& value) { builder.add(i, j, value); });
+        }
+
+        //! Read the elements into a matrix with runtime dimensions.
+        /*!
+         * The matrix is replaced by a matrix of the size in the file. The elements are sorted before they are
+         * inserted, so that no tree searches are needed. Throws std::out_of_range if the size exceeds the index type.
+         *
+         * \param matrix output: the matrix.
+         */
+        template <typename T, typename I>
+        void read(DynamicSparseMatrix<T, I>& matrix)
+        {
+            DynamicSparseMatrix<T, I> lhs(_rows, _cols);
+
+            std::vector<std::pair<std::pair<I, I>, T>> elements;
+            const size_t reserve = std::min(_entries, sparsematrix_detail::matrix_market_reserve_limit);
+            elements.reserve((_symmetry == MatrixMarketSymmetry::Symmetric ? 2 : 1) * reserve);
+            read_entries<T>([&elements](size_t i, size_t j, const T& value)
+            {
+                elements.emplace_back(DynamicSparseMatrix<T, I>::key(i, j), value);
+            });
+
+            // Keep elements with the same index in file order, so that their sum does not depend on the sort.
+            std::stable_sort(elements.begin(), elements.end(),
+                             [](const std::pair<std::pair<I, I>, T>& a, const std::pair<std::pair<I, I>, T>& b)
+                             {
+                                 return a.first < b.first;
+                             });
+            for (const auto& elem : elements)
+            {
+                if (!lhs._values.empty() && std::prev(lhs._values.end())->first == elem.first)
+                {
+                    std::prev(lhs._values.end())->second += elem.second;
+                }
+                else
+                {
+                    lhs._values.emplace_hint(lhs._values.end(), elem.first, elem.second);
+                }
+            }
+
+            matrix = std::move(lhs);
+        }
+};
+
+
+//! Write a matrix in Matrix Market format.
+/*!
+ * The matrix is written in coordinate format, in row-major order. By default, all allocated elements are written with
+ * general symmetry, with integer values if T is an integer type and real values otherwise.
+ *
+ * A symmetric matrix can be written with symmetric symmetry instead, in which case only the elements on and below the
+ * diagonal are written, as the format requires; the elements above the diagonal are assumed to mirror them and are not
+ * checked. With the pattern field, only the indices of the elements are written.
+ *
+ * Throws std::out_of_range if a symmetric matrix is not square, and std::runtime_error if integer values are requested
+ * for a floating point type or if the file cannot be written.
+ *
+ * \param filename name of the file.
+ * \param matrix the matrix.
+ * \param symmetry symmetry of the matrix in the file.
+ * \param field type of the values in the file.
+ */
+template <size_t M, size_t N, typename T, typename I, typename Alloc>
+void write_matrix_market(const std::string& filename, const SparseMatrix<M, N, T, I, Alloc>& matrix,
+                         MatrixMarketSymmetry symmetry = MatrixMarketSymmetry::General,
+                         MatrixMarketField field = sparsematrix_detail::matrix_market_field<T>())
+{
+    sparsematrix_detail::write_matrix_market_map<T>(filename, M, N, matrix, symmetry, field);
+}
+
+//! Write a matrix in compressed row storage in Matrix Market format.
+/*!
+ * Like write_matrix_market() for SparseMatrix.
+ *
+ * \param filename name of the file.
+ * \param matrix the matrix.
+ * \param symmetry symmetry of the matrix in the file.
+ * \param field type of the values in the file.
+ */
+template <size_t M, size_t N, typename T, typename I>
+void write_matrix_market(const std::string& filename, const CsrMatrix<M, N, T, I>& matrix,
+                         MatrixMarketSymmetry symmetry = MatrixMarketSymmetry::General,
+                         MatrixMarketField field = sparsematrix_detail::matrix_market_field<T>())
+{
+    sparsematrix_detail::check_matrix_market_format<T>(M, N, symmetry, field);
+    const bool lower = symmetry == MatrixMarketSymmetry::Symmetric;
+
+    const std::vector<size_t>& row_ptr = matrix.row_ptr();
+    const std::vector<I>& col_idx = matrix.col_idx();
+    const std::vector<T>& values = matrix.values();
+
+    size_t entries = matrix.allocated();
+    if (lower)
+    {
+        // Columns are sorted within a row, so the elements on and below the diagonal come first.
+        entries = 0;
+        for (size_t i = 0; i < M; ++i)
+        {
+            entries += std::upper_bound(col_idx.begin() + row_ptr[i], col_idx.begin() + row_ptr[i + 1], i) -
+                       (col_idx.begin() + row_ptr[i]);
+        }
+    }
+
+    sparsematrix_detail::BufferedWriter writer(filename);
+    sparsematrix_detail::write_matrix_market_header(writer, M, N, entries, symmetry, field);
+    for (size_t i = 0; i < M; ++i)
+    {
+        for (size_t n = row_ptr[i]; n < row_ptr[i + 1] && (!lower || col_idx[n] <= i); ++n)
+        {
+            sparsematrix_detail::write_matrix_market_element(writer, i, col_idx[n], values[n], field);
+        }
+    }
+    writer.close();
+}
+
+//! Write a matrix with runtime dimensions in Matrix Market format.
+/*!
+ * Like write_matrix_market() for SparseMatrix.
+ *
+ * \param filename name of the file.
+ * \param matrix the matrix.
+ * \param symmetry symmetry of the matrix in the file.
+ * \param field type of the values in the file.
+ */
+template <typename T, typename I>
+void write_matrix_market(const std::string& filename, const DynamicSparseMatrix<T, I>& matrix,
+                         MatrixMarketSymmetry symmetry = MatrixMarketSymmetry::General,
+                         MatrixMarketField field = sparsematrix_detail::matrix_market_field<T>())
+{
+    sparsematrix_detail::write_matrix_market_map<T>(filename, matrix.rows(), matrix.cols(), matrix, symmetry, field);
+}
+
+#endif  // MATRIXMARKET_H
@@ -0,0 +1,310 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#ifndef POOLALLOCATOR_H
+#define POOLALLOCATOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+
+//! Algorithms shared by the matrix classes.
+namespace sparsematrix_detail
+{
+
+//! Memory pool for blocks of a single size.
+/*!
+ * Blocks are carved from slabs, which start small and double in size up to a maximum, so that small matrices stay
+ * small and large matrices need few system allocations. Freed blocks are kept on a free list for reuse. Slabs are only
+ * returned to the system when the pool is destroyed, all at once.
+ *
+ * The block size is set by the first allocation; objects of other sizes are not taken from the pool. The pool is not
+ * thread-safe.
+ */
+class NodePool
+{
+    private:
+        //! Size of the first slab in bytes.
+        static const size_t first_slab_size = 4096;
+
+        //! Maximum size of a slab in bytes.
+        static const size_t max_slab_size = 1 << 20;
+
+        //! Size of a block in bytes; zero until the first allocation.
+        size_t _block_size;
+
+        //! Size of the next slab in bytes.
+        size_t _slab_size;
+
+        //! Allocated slabs.
+        std::vector<void*> _slabs;
+
+        //! Next free position in the current slab.
+        char* _next;
+
+        //! End of the current slab.
+        char* _end;
+
+        //! Head of the list of freed blocks; every freed block stores a pointer to the next one.
+        void* _free;
+
+        //! Total size of the slabs in bytes.
+        size_t _capacity;
+
+        //! Size of the blocks for objects of the given size and alignment; zero if they are over-aligned.
+        static size_t block_size(size_t size, size_t alignment)
+        {
+            // Slabs are only aligned for fundamental types.
+            if (alignment > alignof(std::max_align_t))
+            {
+                return 0;
+            }
+
+            // Blocks are at least large enough to hold a free-list pointer, and keep every block aligned.
+            const size_t align = std::max(alignment, alignof(void*));
+            return (std::max(size, sizeof(void*)) + align - 1) / align * align;
+        }
+
+    public:
+        //! Constructor; no memory is allocated until the first block is requested.
+        NodePool() : _block_size(0), _slab_size(first_slab_size), _next(nullptr), _end(nullptr), _free(nullptr),
+            _capacity(0)
+        {
+        }
+
+        //! Pools cannot be copied.
+        NodePool(const NodePool&) = delete;
+
+        //! Pools cannot be copied.
+        NodePool& operator=(const NodePool&) = delete;
+
+        //! Destructor; releases all slabs.
+        ~NodePool()
+        {
+            for (void* slab : _slabs)
+            {
+                ::operator delete(slab);
+            }
+        }
+
+        //! Check if blocks of the given size and alignment are taken from this pool.
+        /*!
+         * This does not change the pool: before the first allocation, no objects are taken from it. Objects that are
+         * over-aligned are never taken from the pool.
+         *
+         * \param size size of the object in bytes.
+         * \param alignment alignment of the object in bytes.
+         * \return true if the object is allocated from the pool.
+         */
+        bool accepts(size_t size, size_t alignment) const
+        {
+            return _block_size != 0 && block_size(size, alignment) == _block_size;
+        }
+
+        //! Allocate a block.
+        /*!
+         * Takes a freed block if there is one, or the next block of the current slab. A new slab is allocated when
+         * the current one is full. The first allocation sets the block size of the pool.
+         *
+         * \param size size of the object in bytes.
+         * \param alignment alignment of the object in bytes.
+         * \return pointer to the block, or nullptr if the object is not taken from the pool.
+         */
+        void* allocate(size_t size, size_t alignment)
+        {
+            if (_block_size == 0)
+            {
+                _block_size = block_size(size, alignment);
+            }
+            if (!accepts(size, alignment))
+            {
+                return nullptr;
+            }
+
+            if (_free != nullptr)
+            {
+                void* block = _free;
+                _free = *static_cast<void**>(block);
+                return block;
+            }
+
+            if (_next == nullptr || static_cast<size_t>(_end - _next) < _block_size)
+            {
+                const size_t slab_size = std::max(_slab_size, _block_size);
+                _slabs.reserve(_slabs.size() + 1);
+                _next = static_cast<char*>(::operator new(slab_size));
+                _end = _next + slab_size;
+                _slabs.push_back(_next);
+                _capacity += slab_size;
+                _slab_size = std::min(2 * _slab_size, static_cast<size_t>(max_slab_size));
+            }
+
+            void* block = _next;
+            _next += _block_size;
+            return block;
+        }
+
+        //! Return a block to the pool.
+        /*!
+         * \param block pointer to a block that was allocated from this pool.
+         */
+        void deallocate(void* block)
+        {
+            *static_cast<void**>(block) = _free;
+            _free = block;
+        }
+
+        //! Total size of the slabs in bytes.
+        size_t capacity() const
+        {
+            return _capacity;
+        }
+};
+
+}  // namespace sparsematrix_detail
+
+
+//! Allocator that takes single objects from a pool
+/*!
+ * This allocator is meant for node-based containers like the std::map in SparseMatrix, which allocate every element
+ * separately. Single objects are taken from a NodePool, which carves them from large slabs instead of calling the
+ * system allocator for each of them. Freeing an object only puts it on a free list; the slabs are released all at once
+ * when the last copy of the allocator is destroyed. This makes both building and destroying large matrices faster, at
+ * the cost of not returning memory to the system while the matrix exists.
+ *
+ * Copies and rebound copies of an allocator share the pool. A copy of a container gets a new pool, and moving or
+ * swapping containers moves the pool along with the elements. Arrays of objects are allocated with operator new.
+ *
+ * The allocator is not thread-safe: like the matrix itself, a matrix that uses it must not be modified by multiple
+ * threads at the same time.
+ *
+ * Example:
+ * \code
+ * SparseMatrix<1000, 1000, double, size_t, PoolAllocator<double>> m;
+ * \endcode
+ */
+template <typename T>
+class PoolAllocator
+{
+    private:
+        //! The pool; shared by all copies.
+        std::shared_ptr<sparsematrix_detail::NodePool> _pool;
+
+        //! Rebound copies share the pool.
+        template <typename> friend class PoolAllocator;
+
+    public:
+        //! Type of the allocated objects.
+        typedef T value_type;
+
+        //! Containers that are moved take the pool along.
+        typedef std::true_type propagate_on_container_move_assignment;
+
+        //! Containers that are swapped swap their pools.
+        typedef std::true_type propagate_on_container_swap;
+
+        //! Constructor; creates a new pool.
+        PoolAllocator() : _pool(std::make_shared<sparsematrix_detail::NodePool>())
+        {
+        }
+
+        //! Copy-constructor; the copy shares the pool.
+        /*!
+         * There is no move-constructor, so that an allocator that is moved from keeps the pool and stays usable.
+         */
+        PoolAllocator(const PoolAllocator& other) noexcept : _pool(other._pool)
+        {
+        }
+
+        //! Assignment; shares the pool of the other allocator.
+        PoolAllocator& operator=(const PoolAllocator& other) = default;
+
+        //! Conversion from an allocator for another type; shares the pool.
+        template <typename U>
+        PoolAllocator(const PoolAllocator<U>& other) noexcept : _pool(other._pool)
+        {
+        }
+
+        //! Allocator for a copy of a container: a new pool.
+        PoolAllocator select_on_container_copy_construction() const
+        {
+            return PoolAllocator();
+        }
+
+        //! Allocate memory for n objects.
+        /*!
+         * \param n number of objects.
+         * \return pointer to uninitialized memory.
+         */
+        T* allocate(size_t n)
+        {
+            if (n == 1)
+            {
+                void* block = _pool->allocate(sizeof(T), alignof(T));
+                if (block != nullptr)
+                {
+                    return static_cast<T*>(block);
+                }
+            }
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+
+        //! Free memory for n objects.
+        /*!
+         * \param ptr pointer returned by allocate().
+         * \param n number of objects, as passed to allocate().
+         */
+        void deallocate(T* ptr, size_t n)
+        {
+            if (n == 1 && _pool->accepts(sizeof(T), alignof(T)))
+            {
+                _pool->deallocate(ptr);
+            }
+            else
+            {
+                ::operator delete(ptr);
+            }
+        }
+
+        //! Total size of the slabs of the pool in bytes.
+        size_t capacity() const
+        {
+            return _pool->capacity();
+        }
+
+        //! Check if memory from one allocator can be freed by the other, i.e. if they share the pool.
+        template <typename U>
+        bool operator==(const PoolAllocator<U>& other) const
+        {
+            return _pool == other._pool;
+        }
+
+        //! Check if memory from one allocator cannot be freed by the other.
+        template <typename U>
+        bool operator!=(const PoolAllocator<U>& other) const
+        {
+            return !(*this == other);
+        }
+};
+
+#endif  // POOLALLOCATOR_H
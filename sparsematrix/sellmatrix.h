@@ -0,0 +1,696 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#ifndef SELLMATRIX_H
+#define SELLMATRIX_H
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "csrkernels.h"
+#include "csrmatrix.h"
+#include "simdkernels.h"
+#include "sparsematrix.h"
+#include "threadpool.h"
+
+
+//! Algorithms shared by the matrix classes.
+namespace sparsematrix_detail
+{
+
+//! Sparse matrix-vector product in SELL-C-sigma format without explicit vectorization.
+/*!
+ * Computes y = alpha * A * x + beta * y for the chunks [first, last) of a matrix A in SELL-C-sigma format. Chunk c
+ * holds the C rows in slots [c * C, (c + 1) * C) and occupies positions [chunk_ptr[c], chunk_ptr[c + 1]) of col_idx
+ * and values, in column-major order: element k of the row in slot c * C + r is at chunk_ptr[c] + k * C + r. Padding
+ * elements have value zero. If beta is zero, y is not read, so it does not need to be initialized.
+ *
+ * \param first first chunk to compute.
+ * \param last one past the last chunk to compute.
+ * \param rows number of rows of A.
+ * \param chunk_ptr chunk pointers of A.
+ * \param perm original row of every slot.
+ * \param col_idx column indices of A.
+ * \param values values of A.
+ * \param alpha scaling factor for A * x.
+ * \param x input vector (N elements).
+ * \param beta scaling factor for y.
+ * \param y output vector (M elements).
+ */
+template <size_t C, typename T, typename I>
+void sell_spmv_scalar(size_t first, size_t last, size_t rows, const size_t* chunk_ptr, const I* perm,
+                      const I* col_idx, const T* values, const T alpha, const T* x, const T beta, T* y)
+{
+    T sums[C];
+    for (size_t chunk = first; chunk < last; ++chunk)
+    {
+        std::fill(sums, sums + C, T(0));
+        for (size_t n = chunk_ptr[chunk]; n < chunk_ptr[chunk + 1]; n += C)
+        {
+            for (size_t lane = 0; lane < C; ++lane)
+            {
+                sums[lane] += values[n + lane] * x[col_idx[n + lane]];
+            }
+        }
+        sell_store(chunk * C, std::min(C, rows - chunk * C), perm, sums, alpha, beta, y);
+    }
+}
+
+//! Sparse matrix-vector product in SELL-C-sigma format with a given instruction set.
+/*!
+ * Like sell_spmv(), with the kernel for the given instruction set, which must be supported by the processor (see
+ * simd_level()). Types without a vectorized kernel, and chunks smaller than a vector, use the scalar kernel.
+ */
+template <size_t C, typename T, typename I>
+void sell_spmv_level(SimdLevel level, size_t first, size_t last, size_t rows, const size_t* chunk_ptr, const I* perm,
+                     const I* col_idx, const T* values, const T alpha, const T* x, const T beta, T* y,
+                     std::false_type)
+{
+    (void)level;
+    sell_spmv_scalar<C>(first, last, rows, chunk_ptr, perm, col_idx, values, alpha, x, beta, y);
+}
+
+//! Sparse matrix-vector product in SELL-C-sigma format with a given instruction set, for types with vectorized kernels.
+template <size_t C, typename T, typename I>
+void sell_spmv_level(SimdLevel level, size_t first, size_t last, size_t rows, const size_t* chunk_ptr, const I* perm,
+                     const I* col_idx, const T* values, const T alpha, const T* x, const T beta, T* y,
+                     std::true_type)
+{
+#ifdef SPARSEMATRIX_X86_SIMD
+    // AVX-512 is only used if its vectors fill a chunk; processors with AVX-512 also support AVX2.
+    if (level == SimdLevel::Avx512 && C % Avx512Lanes<T, sizeof(I)>::width == 0)
+    {
+        sell_spmv_avx512<C>(first, last, rows, chunk_ptr, perm, col_idx, values, alpha, x, beta, y);
+        return;
+    }
+    if (level != SimdLevel::Scalar && C >= Avx2Lanes<T, sizeof(I)>::width)
+    {
+        sell_spmv_avx2<C>(first, last, rows, chunk_ptr, perm, col_idx, values, alpha, x, beta, y);
+        return;
+    }
+#endif
+    (void)level;
+    sell_spmv_scalar<C>(first, last, rows, chunk_ptr, perm, col_idx, values, alpha, x, beta, y);
+}
+
+//! Sparse matrix-vector product in SELL-C-sigma format with a given instruction set.
+template <size_t C, typename T, typename I>
+void sell_spmv_level(SimdLevel level, size_t first, size_t last, size_t rows, const size_t* chunk_ptr, const I* perm,
+                     const I* col_idx, const T* values, const T alpha, const T* x, const T beta, T* y)
+{
+    sell_spmv_level<C>(level, first, last, rows, chunk_ptr, perm, col_idx, values, alpha, x, beta, y,
+                       simd_spmv_supported<T, I>());
+}
+
+//! Sparse matrix-vector product in SELL-C-sigma format.
+/*!
+ * Computes y = alpha * A * x + beta * y for the chunks [first, last) of a matrix A in SELL-C-sigma format (see
+ * sell_spmv_scalar()). For float and double values with 32-bit or 64-bit indices, the rows of a chunk are processed
+ * side by side in the lanes of the vector registers of the processor (see simd_level()).
+ */
+template <size_t C, typename T, typename I>
+void sell_spmv(size_t first, size_t last, size_t rows, const size_t* chunk_ptr, const I* perm, const I* col_idx,
+               const T* values, const T alpha, const T* x, const T beta, T* y)
+{
+    sell_spmv_level<C>(simd_level(), first, last, rows, chunk_ptr, perm, col_idx, values, alpha, x, beta, y);
+}
+
+}  // namespace sparsematrix_detail
+
+
+//! Representation of a sparse matrix with M rows and N columns, of type T, in SELL-C-sigma format
+/*!
+ * This class represents a sparse matrix in sliced ELLPACK format with chunks of C rows and sorting windows of sigma
+ * rows (SELL-C-sigma). Within every window, rows are sorted by decreasing number of allocated elements; consecutive
+ * groups of C sorted rows form a chunk. All rows of a chunk are padded to the length of the longest row and stored
+ * interleaved, so that the k-th elements of the C rows are contiguous. A matrix-vector product then processes the rows
+ * of a chunk in the lanes of the vector registers, with full vector loads of values and column indices, which is
+ * faster than CSR for matrices with many short rows. Sorting keeps the rows of a chunk of similar length, which limits
+ * the padding; see padding_overhead().
+ *
+ * The format is read-only, like CsrMatrix. Build a SparseMatrix or CsrMatrix and convert it instead. C should be a
+ * multiple of the vector width of the processor: 4 (AVX2) or 8 (AVX-512) for double, twice that for float.
+ */
+template <size_t M, size_t N, typename T, typename I = size_t, size_t C = 8>
+class SellMatrix
+{
+    static_assert(std::is_integral<I>::value && std::is_unsigned<I>::value, "index type must be unsigned integer");
+    static_assert(sparsematrix_detail::index_fits<I>(M) && sparsematrix_detail::index_fits<I>(N),
+                  "matrix dimensions exceed index type");
+    static_assert(C > 0, "chunk size must be positive");
+
+    private:
+        //! Number of chunks.
+        static constexpr size_t chunks = (M + C - 1) / C;
+
+        //! Sorting window, a multiple of C.
+        size_t _sigma;
+
+        //! Chunk pointers; chunk c occupies positions [_chunk_ptr[c], _chunk_ptr[c + 1]) of _col_idx and _values.
+        std::vector<size_t> _chunk_ptr;
+
+        //! Original row of every slot.
+        std::vector<I> _perm;
+
+        //! Slot of every original row.
+        std::vector<I> _slot;
+
+        //! Number of allocated elements of every original row; a full row has N elements, which may not fit in I.
+        std::vector<size_t> _row_len;
+
+        //! Column indices of the stored values, sorted within every row; padding repeats the last column of the row.
+        std::vector<I> _col_idx;
+
+        //! Stored values, interleaved per chunk; padding is zero.
+        std::vector<T> _values;
+
+        //! Number of allocated elements, excluding padding.
+        size_t _allocated;
+
+        //! Position of element k of a row in slot s.
+        size_t position(size_t s, size_t k) const
+        {
+            return _chunk_ptr[s / C] + k * C + s % C;
+        }
+
+        //! Find a column in row i.
+        /*!
+         * Binary search over the elements of row i, which are C positions apart.
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return the position of the element, or the size of the storage if it is not allocated.
+         */
+        size_t find(size_t i, size_t j) const
+        {
+            const size_t s = _slot[i];
+            size_t lo = 0;
+            size_t hi = _row_len[i];
+            while (lo < hi)
+            {
+                const size_t mid = lo + (hi - lo) / 2;
+                if (_col_idx[position(s, mid)] < j)
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            if (lo < _row_len[i] && _col_idx[position(s, lo)] == j)
+            {
+                return position(s, lo);
+            }
+            return _values.size();
+        }
+
+    public:
+        //! Default sorting window.
+        static constexpr size_t default_sigma = 256;
+
+        //! Default constructor.
+        SellMatrix() : _sigma(C), _chunk_ptr(chunks + 1, 0), _perm(M), _slot(M), _row_len(M, 0), _allocated(0)
+        {
+            std::iota(_perm.begin(), _perm.end(), I(0));
+            std::iota(_slot.begin(), _slot.end(), I(0));
+        }
+
+        //! Conversion from compressed row storage.
+        /*!
+         * Create an instance from a CsrMatrix. Rows are sorted by decreasing length within windows of sigma rows; the
+         * order of rows of equal length is kept. Sigma is rounded up to a multiple of C; a window of a single chunk
+         * keeps the original row order, a window of M rows sorts all rows.
+         *
+         * \param other matrix to be converted.
+         * \param sigma sorting window.
+         */
+        explicit SellMatrix(const CsrMatrix<M, N, T, I>& other, size_t sigma = default_sigma)
+            : _sigma(std::max<size_t>(1, (sigma + C - 1) / C) * C), _chunk_ptr(chunks + 1, 0), _perm(M), _slot(M),
+              _row_len(M), _allocated(other.allocated())
+        {
+            const std::vector<size_t>& row_ptr = other.row_ptr();
+            for (size_t i = 0; i < M; ++i)
+            {
+                _row_len[i] = row_ptr[i + 1] - row_ptr[i];
+            }
+
+            // Sort the rows within every window by decreasing length. Sorting within a single chunk does not change
+            // the padding, so the original order is kept then.
+            std::iota(_perm.begin(), _perm.end(), I(0));
+            for (size_t first = 0; _sigma > C && first < M; first += _sigma)
+            {
+                std::stable_sort(_perm.begin() + first, _perm.begin() + std::min(first + _sigma, M),
+                                 [this](I a, I b) { return _row_len[a] > _row_len[b]; });
+            }
+            for (size_t s = 0; s < M; ++s)
+            {
+                _slot[_perm[s]] = static_cast<I>(s);
+            }
+
+            // The width of a chunk is the length of its longest row.
+            for (size_t c = 0; c < chunks; ++c)
+            {
+                size_t width = 0;
+                for (size_t s = c * C; s < std::min(c * C + C, M); ++s)
+                {
+                    width = std::max(width, _row_len[_perm[s]]);
+                }
+                _chunk_ptr[c + 1] = _chunk_ptr[c] + C * width;
+            }
+
+            // Interleave the rows; padding repeats the last column of the row, so it reads an element of x that is
+            // already in cache.
+            _col_idx.assign(_chunk_ptr[chunks], I(0));
+            _values.assign(_chunk_ptr[chunks], T(0));
+            for (size_t s = 0; s < M; ++s)
+            {
+                const size_t i = _perm[s];
+                const size_t width = (_chunk_ptr[s / C + 1] - _chunk_ptr[s / C]) / C;
+                for (size_t k = 0; k < _row_len[i]; ++k)
+                {
+                    _col_idx[position(s, k)] = other.col_idx()[row_ptr[i] + k];
+                    _values[position(s, k)] = other.values()[row_ptr[i] + k];
+                }
+                for (size_t k = _row_len[i]; k > 0 && k < width; ++k)
+                {
+                    _col_idx[position(s, k)] = other.col_idx()[row_ptr[i + 1] - 1];
+                }
+            }
+        }
+
+        //! Conversion from map storage.
+        /*!
+         * Create an instance from a SparseMatrix, via compressed row storage.
+         *
+         * \param other matrix to be converted.
+         * \param sigma sorting window.
+         */
+        template <typename Alloc>
+        explicit SellMatrix(const SparseMatrix<M, N, T, I, Alloc>& other, size_t sigma = default_sigma)
+            : SellMatrix(CsrMatrix<M, N, T, I>(other), sigma)
+        {
+        }
+
+        //! Conversion to compressed row storage.
+        /*!
+         * Create a CsrMatrix with the same allocated elements, in the original row order. Padding is dropped.
+         *
+         * \return the matrix in compressed row storage.
+         */
+        CsrMatrix<M, N, T, I> to_csr() const
+        {
+            std::vector<size_t> row_ptr(M + 1, 0);
+            std::vector<I> col_idx;
+            std::vector<T> values;
+            col_idx.reserve(_allocated);
+            values.reserve(_allocated);
+            for (size_t i = 0; i < M; ++i)
+            {
+                for (size_t k = 0; k < _row_len[i]; ++k)
+                {
+                    col_idx.push_back(_col_idx[position(_slot[i], k)]);
+                    values.push_back(_values[position(_slot[i], k)]);
+                }
+                row_ptr[i + 1] = col_idx.size();
+            }
+
+            return CsrMatrix<M, N, T, I>(std::move(row_ptr), std::move(col_idx), std::move(values));
+        }
+
+        //! Conversion to map storage.
+        /*!
+         * Create a SparseMatrix with the same allocated elements.
+         *
+         * \return the matrix in map storage.
+         */
+        SparseMatrix<M, N, T, I> to_sparse() const
+        {
+            return to_csr().to_sparse();
+        }
+
+        //! Read an element at index (i,j).
+        /*!
+         * Read an individual element at row i and column j. The storage is read-only, so a copy of the value is
+         * returned; elements that are not allocated read as zero.
+         * Throws std::out_of_range if either i or j exceeds the respective matrix dimension.
+         *
+         * \sa peek()
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return the value of the element at (i,j).
+         */
+        T operator()(size_t i, size_t j) const
+        {
+            if (i >= M || j >= N)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            const size_t pos = find(i, j);
+            return pos == _values.size() ? T(0) : _values[pos];
+        }
+
+        //! Size of the matrix.
+        /*!
+         * Gives the size of the matrix as the number of elements. By definition, this is equal to M x N.
+         *
+         * \sa allocated()
+         *
+         * \return the matrix size.
+         */
+        size_t size() const
+        {
+            return M * N;
+        }
+
+        //! Number of allocated elements.
+        /*!
+         * Get the number of allocated elements, excluding padding. This takes constant time.
+         *
+         * \sa stored()
+         *
+         * \return the number of allocated elements.
+         */
+        size_t allocated() const
+        {
+            return _allocated;
+        }
+
+        //! Number of stored elements.
+        /*!
+         * Get the number of stored elements, including padding.
+         *
+         * \sa allocated()
+         *
+         * \return the number of stored elements.
+         */
+        size_t stored() const
+        {
+            return _values.size();
+        }
+
+        //! Relative padding.
+        /*!
+         * Get the number of padding elements relative to the number of allocated elements. Every padding element costs
+         * the same as an allocated element in a matrix-vector product, so this is the extra work compared to CSR.
+         * A larger sigma or a smaller C reduce the padding.
+         *
+         * \return (stored() - allocated()) / allocated(), or zero for an empty matrix.
+         */
+        double padding_overhead() const
+        {
+            if (_allocated == 0)
+            {
+                return 0.0;
+            }
+            return static_cast<double>(stored() - _allocated) / static_cast<double>(_allocated);
+        }
+
+        //! Sorting window, rounded up to a multiple of C.
+        size_t sigma() const
+        {
+            return _sigma;
+        }
+
+        //! Memory footprint.
+        /*!
+         * Get the memory used by the matrix: the size of this object plus the capacity of the storage arrays, including
+         * padding. The overhead of the memory allocator is not included.
+         *
+         * \sa stored()
+         *
+         * \return the memory footprint in bytes.
+         */
+        size_t memory_bytes() const
+        {
+            return sizeof(*this) + sparsematrix_detail::vector_memory_bytes(_chunk_ptr) +
+                   sparsematrix_detail::vector_memory_bytes(_perm) + sparsematrix_detail::vector_memory_bytes(_slot) +
+                   sparsematrix_detail::vector_memory_bytes(_row_len) +
+                   sparsematrix_detail::vector_memory_bytes(_col_idx) +
+                   sparsematrix_detail::vector_memory_bytes(_values);
+        }
+
+        //! Peek if an element is allocated.
+        /*!
+         * Check if the element is stored. This is a binary search within row i; padding is not allocated.
+         * Throws std::out_of_range if either i or j exceeds the respective matrix dimension.
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return Boolean value indicating if the element is allocated.
+         */
+        bool peek(size_t i, size_t j) const
+        {
+            if (i >= M || j >= N)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            return find(i, j) != _values.size();
+        }
+
+        //! Chunk pointers (one more than the number of chunks); chunk c occupies [chunk_ptr()[c], chunk_ptr()[c + 1]).
+        const std::vector<size_t>& chunk_ptr() const
+        {
+            return _chunk_ptr;
+        }
+
+        //! Original row of every slot.
+        const std::vector<I>& perm() const
+        {
+            return _perm;
+        }
+
+        //! Column indices of the stored elements, interleaved per chunk.
+        const std::vector<I>& col_idx() const
+        {
+            return _col_idx;
+        }
+
+        //! Values of the stored elements, interleaved per chunk.
+        const std::vector<T>& values() const
+        {
+            return _values;
+        }
+
+        //! Check for equality.
+        /*!
+         * Check for equality by comparing the internal storage. This is a strict comparison that also considers
+         * sparseness and the sorting window.
+         *
+         * \param rhs right-hand side of the equality test.
+         * \return Boolean value indicating equality.
+         */
+        bool operator==(const SellMatrix& rhs) const
+        {
+            return _perm == rhs._perm && _chunk_ptr == rhs._chunk_ptr && _col_idx == rhs._col_idx &&
+                   _values == rhs._values && _row_len == rhs._row_len;
+        }
+
+        //! Check for inequality.
+        /*!
+         * Check for inequality by comparing the internal storage.
+         *
+         * \param rhs right-hand side of the inequality test.
+         * \return Boolean value indicating inequality.
+         */
+        bool operator!=(const SellMatrix& rhs) const
+        {
+            return !(*this == rhs);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y for a dense vector x of N elements and a dense vector y of M elements.
+         * The rows of a chunk are computed side by side in the lanes of the vector registers (see simd_level()); every
+         * row is summed in the order of its elements.
+         * If beta is zero, y is not read, so it does not need to be initialized. No memory is allocated.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector (N elements).
+         * \param beta scaling factor for y.
+         * \param y output vector (M elements).
+         */
+        void multiply(const T alpha, const T* x, const T beta, T* y) const
+        {
+            sparsematrix_detail::sell_spmv<C>(0, chunks, M, _chunk_ptr.data(), _perm.data(), _col_idx.data(),
+                                              _values.data(), alpha, x, beta, y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x for a dense vector x of N elements and a dense vector y of M elements.
+         *
+         * \param x input vector (N elements).
+         * \param y output vector (M elements).
+         */
+        void multiply(const T* x, T* y) const
+        {
+            multiply(T(1), x, T(0), y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y, with sizes of x and y checked at compile time.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(const T alpha, const std::array<T, N>& x, const T beta, std::array<T, M>& y) const
+        {
+            multiply(alpha, x.data(), beta, y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x, with sizes of x and y checked at compile time.
+         *
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(const std::array<T, N>& x, std::array<T, M>& y) const
+        {
+            multiply(T(1), x.data(), T(0), y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(const T alpha, const std::vector<T>& x, const T beta, std::vector<T>& y) const
+        {
+            if (x.size() != N || y.size() != M)
+            {
+                throw std::out_of_range("vector size mismatch");
+            }
+
+            multiply(alpha, x.data(), beta, y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(const std::vector<T>& x, std::vector<T>& y) const
+        {
+            multiply(T(1), x, T(0), y);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y like multiply(alpha, x, beta, y), using the threads of a pool. The
+         * chunks are split into one part per thread, with roughly equal numbers of stored elements. Every chunk writes
+         * its own rows of y, so no memory is allocated.
+         *
+         * \param pool threads to use.
+         * \param alpha scaling factor for A * x.
+         * \param x input vector (N elements).
+         * \param beta scaling factor for y.
+         * \param y output vector (M elements).
+         */
+        void multiply(ThreadPool& pool, const T alpha, const T* x, const T beta, T* y) const
+        {
+            const size_t* chunk_ptr = _chunk_ptr.data();
+            const I* perm = _perm.data();
+            const I* col_idx = _col_idx.data();
+            const T* values = _values.data();
+            const size_t parts = pool.size();
+            pool.run(parts, [=](size_t part)
+            {
+                const size_t first = sparsematrix_detail::csr_partition(chunk_ptr, chunks, part, parts);
+                const size_t last = sparsematrix_detail::csr_partition(chunk_ptr, chunks, part + 1, parts);
+                sparsematrix_detail::sell_spmv<C>(first, last, M, chunk_ptr, perm, col_idx, values, alpha, x, beta, y);
+            });
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = A * x like multiply(x, y), using the threads of a pool.
+         *
+         * \param pool threads to use.
+         * \param x input vector (N elements).
+         * \param y output vector (M elements).
+         */
+        void multiply(ThreadPool& pool, const T* x, T* y) const
+        {
+            multiply(pool, T(1), x, T(0), y);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y, using the threads of a pool. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param pool threads to use.
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(ThreadPool& pool, const T alpha, const std::vector<T>& x, const T beta,
+                      std::vector<T>& y) const
+        {
+            if (x.size() != N || y.size() != M)
+            {
+                throw std::out_of_range("vector size mismatch");
+            }
+
+            multiply(pool, alpha, x.data(), beta, y.data());
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = A * x, using the threads of a pool. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param pool threads to use.
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(ThreadPool& pool, const std::vector<T>& x, std::vector<T>& y) const
+        {
+            multiply(pool, T(1), x, T(0), y);
+        }
+};
+
+template <size_t M, size_t N, typename T, typename I, size_t C>
+constexpr size_t SellMatrix<M, N, T, I, C>::chunks;
+
+template <size_t M, size_t N, typename T, typename I, size_t C>
+constexpr size_t SellMatrix<M, N, T, I, C>::default_sigma;
+
+#endif  // SELLMATRIX_H
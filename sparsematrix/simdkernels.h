@@ -0,0 +1,577 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Vectorized kernels are compiled for x86 with GCC or Clang, which can compile individual functions for instruction
+// sets that are not enabled for the whole program. Define SPARSEMATRIX_NO_SIMD to use the portable kernels only.
+#if !defined(SPARSEMATRIX_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define SPARSEMATRIX_X86_SIMD
+#include <immintrin.h>
+#define SPARSEMATRIX_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define SPARSEMATRIX_TARGET_AVX512 __attribute__((target("avx512f,avx512vl,avx2,fma")))
+#endif
+
+
+//! Instruction sets for vectorized kernels.
+enum class SimdLevel
+{
+    //! Portable kernels without explicit vectorization.
+    Scalar,
+
+    //! AVX2 with FMA (256-bit vectors).
+    Avx2,
+
+    //! AVX-512 F and VL (512-bit vectors).
+    Avx512
+};
+
+
+//! Best instruction set of this processor.
+/*!
+ * The processor is queried once, on the first call. Kernels that have a vectorized version use the instruction set
+ * returned here; on other platforms, or if SPARSEMATRIX_NO_SIMD is defined, this is always SimdLevel::Scalar.
+ *
+ * \return the instruction set.
+ */
+inline SimdLevel simd_level()
+{
+#ifdef SPARSEMATRIX_X86_SIMD
+    static const SimdLevel level = []()
+    {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl"))
+        {
+            return SimdLevel::Avx512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        {
+            return SimdLevel::Avx2;
+        }
+        return SimdLevel::Scalar;
+    }();
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+
+//! Algorithms shared by the matrix classes.
+namespace sparsematrix_detail
+{
+
+//! Vectorized kernels exist for float and double values with 32-bit or 64-bit indices.
+template <typename T, typename I>
+struct simd_spmv_supported
+    : std::integral_constant<bool, (std::is_same<T, float>::value || std::is_same<T, double>::value) &&
+                                   (sizeof(I) == 4 || sizeof(I) == 8)>
+{
+};
+
+//! Write the row sums of a chunk in SELL-C-sigma format.
+/*!
+ * Computes y(perm[slot]) = alpha * sum + beta * y(perm[slot]) for the given number of rows of a chunk, starting at a
+ * given slot. If beta is zero, y is not read.
+ *
+ * \param slot first slot of the chunk.
+ * \param count number of rows in the chunk; the last chunk can hold fewer than C rows.
+ * \param perm original row of every slot.
+ * \param sums row sums of the chunk.
+ * \param alpha scaling factor for A * x.
+ * \param beta scaling factor for y.
+ * \param y output vector.
+ */
+template <typename T, typename I>
+inline void sell_store(size_t slot, size_t count, const I* perm, const T* sums, const T alpha, const T beta, T* y)
+{
+    for (size_t lane = 0; lane < count; ++lane)
+    {
+        T& out = y[perm[slot + lane]];
+        out = (beta == T(0)) ? alpha * sums[lane] : alpha * sums[lane] + beta * out;
+    }
+}
+
+#ifdef SPARSEMATRIX_X86_SIMD
+
+//! Operations on the lanes of a vector register, per instruction set, value type and index size
+/*!
+ * Every specialization provides the number of lanes, a store of the lanes to memory, a fused multiply-add of a full
+ * vector of values with the gathered elements of x and the same for the first count < width lanes only (masked).
+ * Column indices are unsigned, but gather instructions take signed indices: 32-bit indices are zero-extended to 64
+ * bits, or, for floats, offset by 2^31 together with the base address.
+ */
+template <typename T, size_t IndexBytes>
+struct Avx2Lanes;
+
+//! Sum of the lanes of a 256-bit vector of doubles.
+SPARSEMATRIX_TARGET_AVX2 inline double avx2_sum(__m256d acc)
+{
+    __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+//! Sum of the lanes of a 256-bit vector of floats.
+SPARSEMATRIX_TARGET_AVX2 inline float avx2_sum(__m256 acc)
+{
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    return _mm_cvtss_f32(_mm_add_ss(sum, _mm_movehdup_ps(sum)));
+}
+
+//! Mask of the first count of eight 32-bit lanes.
+SPARSEMATRIX_TARGET_AVX2 inline __m256i avx2_mask32(size_t count)
+{
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(count)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+//! Mask of the first count of four 64-bit lanes.
+SPARSEMATRIX_TARGET_AVX2 inline __m256i avx2_mask64(size_t count)
+{
+    return _mm256_cmpgt_epi64(_mm256_set1_epi64x(static_cast<long long>(count)), _mm256_setr_epi64x(0, 1, 2, 3));
+}
+
+//! Base address for gathering floats with 32-bit indices that are offset by -2^31.
+inline const float* offset_base(const float* x)
+{
+    return reinterpret_cast<const float*>(reinterpret_cast<uintptr_t>(x) + (uintptr_t(1) << 31) * sizeof(float));
+}
+
+template <>
+struct Avx2Lanes<double, 8>
+{
+    typedef __m256d Vec;
+    static const size_t width = 4;
+
+    SPARSEMATRIX_TARGET_AVX2 static void store(double* out, Vec acc)
+    {
+        _mm256_storeu_pd(out, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX2 static Vec fma(const double* values, const void* idx, const double* x, Vec acc)
+    {
+        const __m256i j = _mm256_loadu_si256(static_cast<const __m256i*>(idx));
+        return _mm256_fmadd_pd(_mm256_loadu_pd(values), _mm256_i64gather_pd(x, j, 8), acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX2 static Vec fma(const double* values, const void* idx, const double* x, Vec acc,
+                                            size_t count)
+    {
+        const __m256i mask = avx2_mask64(count);
+        const __m256i j = _mm256_maskload_epi64(static_cast<const long long*>(idx), mask);
+        const __m256d xv = _mm256_mask_i64gather_pd(_mm256_setzero_pd(), x, j, _mm256_castsi256_pd(mask), 8);
+        return _mm256_fmadd_pd(_mm256_maskload_pd(values, mask), xv, acc);
+    }
+};
+
+template <>
+struct Avx2Lanes<double, 4>
+{
+    typedef __m256d Vec;
+    static const size_t width = 4;
+
+    SPARSEMATRIX_TARGET_AVX2 static void store(double* out, Vec acc)
+    {
+        _mm256_storeu_pd(out, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX2 static Vec fma(const double* values, const void* idx, const double* x, Vec acc)
+    {
+        const __m256i j = _mm256_cvtepu32_epi64(_mm_loadu_si128(static_cast<const __m128i*>(idx)));
+        return _mm256_fmadd_pd(_mm256_loadu_pd(values), _mm256_i64gather_pd(x, j, 8), acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX2 static Vec fma(const double* values, const void* idx, const double* x, Vec acc,
+                                            size_t count)
+    {
+        const __m256i mask = avx2_mask64(count);
+        const __m128i mask32 = _mm_cmpgt_epi32(_mm_set1_epi32(static_cast<int>(count)), _mm_setr_epi32(0, 1, 2, 3));
+        const __m256i j = _mm256_cvtepu32_epi64(_mm_maskload_epi32(static_cast<const int*>(idx), mask32));
+        const __m256d xv = _mm256_mask_i64gather_pd(_mm256_setzero_pd(), x, j, _mm256_castsi256_pd(mask), 8);
+        return _mm256_fmadd_pd(_mm256_maskload_pd(values, mask), xv, acc);
+    }
+};
+
+template <>
+struct Avx2Lanes<float, 4>
+{
+    typedef __m256 Vec;
+    static const size_t width = 8;
+
+    SPARSEMATRIX_TARGET_AVX2 static void store(float* out, Vec acc)
+    {
+        _mm256_storeu_ps(out, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX2 static Vec fma(const float* values, const void* idx, const float* x, Vec acc)
+    {
+        const __m256i j = _mm256_xor_si256(_mm256_loadu_si256(static_cast<const __m256i*>(idx)),
+                                           _mm256_set1_epi32(INT32_MIN));
+        return _mm256_fmadd_ps(_mm256_loadu_ps(values), _mm256_i32gather_ps(offset_base(x), j, 4), acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX2 static Vec fma(const float* values, const void* idx, const float* x, Vec acc,
+                                            size_t count)
+    {
+        const __m256i mask = avx2_mask32(count);
+        const __m256i j = _mm256_xor_si256(_mm256_maskload_epi32(static_cast<const int*>(idx), mask),
+                                           _mm256_set1_epi32(INT32_MIN));
+        const __m256 xv = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), offset_base(x), j, _mm256_castsi256_ps(mask),
+                                                   4);
+        return _mm256_fmadd_ps(_mm256_maskload_ps(values, mask), xv, acc);
+    }
+};
+
+template <>
+struct Avx2Lanes<float, 8>
+{
+    typedef __m256 Vec;
+    static const size_t width = 8;
+
+    SPARSEMATRIX_TARGET_AVX2 static void store(float* out, Vec acc)
+    {
+        _mm256_storeu_ps(out, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX2 static Vec fma(const float* values, const void* idx, const float* x, Vec acc)
+    {
+        const __m256i* j = static_cast<const __m256i*>(idx);
+        const __m128 lo = _mm256_i64gather_ps(x, _mm256_loadu_si256(j), 4);
+        const __m128 hi = _mm256_i64gather_ps(x, _mm256_loadu_si256(j + 1), 4);
+        return _mm256_fmadd_ps(_mm256_loadu_ps(values), _mm256_set_m128(hi, lo), acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX2 static Vec fma(const float* values, const void* idx, const float* x, Vec acc,
+                                            size_t count)
+    {
+        const __m256i mask = avx2_mask32(count);
+        const __m128i mask_lo = _mm256_castsi256_si128(mask);
+        const __m128i mask_hi = _mm256_extracti128_si256(mask, 1);
+        const long long* j = static_cast<const long long*>(idx);
+        const __m256i j_lo = _mm256_maskload_epi64(j, _mm256_cvtepi32_epi64(mask_lo));
+        const __m256i j_hi = _mm256_maskload_epi64(j + 4, _mm256_cvtepi32_epi64(mask_hi));
+        const __m128 lo = _mm256_mask_i64gather_ps(_mm_setzero_ps(), x, j_lo, _mm_castsi128_ps(mask_lo), 4);
+        const __m128 hi = _mm256_mask_i64gather_ps(_mm_setzero_ps(), x, j_hi, _mm_castsi128_ps(mask_hi), 4);
+        return _mm256_fmadd_ps(_mm256_maskload_ps(values, mask), _mm256_set_m128(hi, lo), acc);
+    }
+};
+
+//! Sum of the lanes of a 512-bit vector of doubles.
+/*!
+ * The AVX-512 intrinsics in this file use the masked forms with an explicit zero source. The unmasked forms, and with
+ * GCC also the casts to the lower half of a vector, pass an undefined vector to the builtins, which GCC reports as
+ * possibly uninitialized in every file that includes this one.
+ */
+SPARSEMATRIX_TARGET_AVX512 inline double avx512_sum(__m512d acc)
+{
+    return avx2_sum(_mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xF, acc, 0),
+                                  _mm512_maskz_extractf64x4_pd(0xF, acc, 1)));
+}
+
+//! Sum of the lanes of a 512-bit vector of floats.
+SPARSEMATRIX_TARGET_AVX512 inline float avx512_sum(__m512 acc)
+{
+    const __m512d halves = _mm512_castps_pd(acc);
+    return avx2_sum(_mm256_add_ps(_mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, halves, 0)),
+                                  _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, halves, 1))));
+}
+
+//! Operations on the lanes of an AVX-512 vector register; see Avx2Lanes. These also provide the sum of the lanes.
+template <typename T, size_t IndexBytes>
+struct Avx512Lanes;
+
+template <>
+struct Avx512Lanes<double, 8>
+{
+    typedef __m512d Vec;
+    static const size_t width = 8;
+
+    SPARSEMATRIX_TARGET_AVX512 static void store(double* out, Vec acc)
+    {
+        _mm512_storeu_pd(out, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX512 static Vec fma(const double* values, const void* idx, const double* x, Vec acc)
+    {
+        const __m512i j = _mm512_loadu_si512(idx);
+        const __m512d xv = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), 0xFF, j, x, 8);
+        return _mm512_fmadd_pd(_mm512_loadu_pd(values), xv, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX512 static Vec fma(const double* values, const void* idx, const double* x, Vec acc,
+                                              size_t count)
+    {
+        const __mmask8 mask = static_cast<__mmask8>((1u << count) - 1);
+        const __m512i j = _mm512_maskz_loadu_epi64(mask, idx);
+        const __m512d xv = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), mask, j, x, 8);
+        return _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, values), xv, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX512 static double sum(Vec acc)
+    {
+        return avx512_sum(acc);
+    }
+};
+
+template <>
+struct Avx512Lanes<double, 4>
+{
+    typedef __m512d Vec;
+    static const size_t width = 8;
+
+    SPARSEMATRIX_TARGET_AVX512 static void store(double* out, Vec acc)
+    {
+        _mm512_storeu_pd(out, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX512 static Vec fma(const double* values, const void* idx, const double* x, Vec acc)
+    {
+        const __m512i j = _mm512_maskz_cvtepu32_epi64(0xFF, _mm256_loadu_si256(static_cast<const __m256i*>(idx)));
+        const __m512d xv = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), 0xFF, j, x, 8);
+        return _mm512_fmadd_pd(_mm512_loadu_pd(values), xv, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX512 static Vec fma(const double* values, const void* idx, const double* x, Vec acc,
+                                              size_t count)
+    {
+        const __mmask8 mask = static_cast<__mmask8>((1u << count) - 1);
+        const __m512i j = _mm512_maskz_cvtepu32_epi64(mask, _mm256_maskz_loadu_epi32(mask, idx));
+        const __m512d xv = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), mask, j, x, 8);
+        return _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, values), xv, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX512 static double sum(Vec acc)
+    {
+        return avx512_sum(acc);
+    }
+};
+
+template <>
+struct Avx512Lanes<float, 4>
+{
+    typedef __m512 Vec;
+    static const size_t width = 16;
+
+    SPARSEMATRIX_TARGET_AVX512 static void store(float* out, Vec acc)
+    {
+        _mm512_storeu_ps(out, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX512 static Vec fma(const float* values, const void* idx, const float* x, Vec acc)
+    {
+        const __m512i j = _mm512_xor_si512(_mm512_loadu_si512(idx), _mm512_set1_epi32(INT32_MIN));
+        const __m512 xv = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, j, offset_base(x), 4);
+        return _mm512_fmadd_ps(_mm512_loadu_ps(values), xv, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX512 static Vec fma(const float* values, const void* idx, const float* x, Vec acc,
+                                              size_t count)
+    {
+        const __mmask16 mask = static_cast<__mmask16>((1u << count) - 1);
+        const __m512i j = _mm512_xor_si512(_mm512_maskz_loadu_epi32(mask, idx), _mm512_set1_epi32(INT32_MIN));
+        const __m512 xv = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, j, offset_base(x), 4);
+        return _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, values), xv, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX512 static float sum(Vec acc)
+    {
+        return avx512_sum(acc);
+    }
+};
+
+template <>
+struct Avx512Lanes<float, 8>
+{
+    typedef __m256 Vec;
+    static const size_t width = 8;
+
+    SPARSEMATRIX_TARGET_AVX512 static void store(float* out, Vec acc)
+    {
+        _mm256_storeu_ps(out, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX512 static Vec fma(const float* values, const void* idx, const float* x, Vec acc)
+    {
+        const __m512i j = _mm512_loadu_si512(idx);
+        const __m256 xv = _mm512_mask_i64gather_ps(_mm256_setzero_ps(), 0xFF, j, x, 4);
+        return _mm256_fmadd_ps(_mm256_loadu_ps(values), xv, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX512 static Vec fma(const float* values, const void* idx, const float* x, Vec acc,
+                                              size_t count)
+    {
+        const __mmask8 mask = static_cast<__mmask8>((1u << count) - 1);
+        const __m512i j = _mm512_maskz_loadu_epi64(mask, idx);
+        const __m256 xv = _mm512_mask_i64gather_ps(_mm256_setzero_ps(), mask, j, x, 4);
+        return _mm256_fmadd_ps(_mm256_maskz_loadu_ps(mask, values), xv, acc);
+    }
+
+    SPARSEMATRIX_TARGET_AVX512 static float sum(Vec acc)
+    {
+        return avx2_sum(acc);
+    }
+};
+
+//! Sparse matrix-vector product with AVX2.
+/*!
+ * Like csr_spmv(). Every row is processed in vectors of Avx2Lanes::width allocated elements: the elements of x are
+ * gathered by column index and accumulated with fused multiply-adds. The last, partial vector of a row is masked, so
+ * nothing is read beyond the row.
+ */
+template <typename T, typename I>
+SPARSEMATRIX_TARGET_AVX2 void csr_spmv_avx2(size_t first, size_t last, const size_t* row_ptr, const I* col_idx,
+                                            const T* values, const T alpha, const T* x, const T beta, T* y)
+{
+    typedef Avx2Lanes<T, sizeof(I)> Lanes;
+    for (size_t i = first; i < last; ++i)
+    {
+        typename Lanes::Vec acc = typename Lanes::Vec();
+        size_t n = row_ptr[i];
+        const size_t end = row_ptr[i + 1];
+        for (; n + Lanes::width <= end; n += Lanes::width)
+        {
+            acc = Lanes::fma(values + n, col_idx + n, x, acc);
+        }
+        if (n < end)
+        {
+            acc = Lanes::fma(values + n, col_idx + n, x, acc, end - n);
+        }
+
+        const T sum = avx2_sum(acc);
+        y[i] = (beta == T(0)) ? alpha * sum : alpha * sum + beta * y[i];
+    }
+}
+
+//! Sparse matrix-vector product with AVX-512.
+/*!
+ * Like csr_spmv_avx2(), with vectors of Avx512Lanes::width elements and mask registers for the partial vectors.
+ */
+template <typename T, typename I>
+SPARSEMATRIX_TARGET_AVX512 void csr_spmv_avx512(size_t first, size_t last, const size_t* row_ptr, const I* col_idx,
+                                                const T* values, const T alpha, const T* x, const T beta, T* y)
+{
+    typedef Avx512Lanes<T, sizeof(I)> Lanes;
+    for (size_t i = first; i < last; ++i)
+    {
+        typename Lanes::Vec acc = typename Lanes::Vec();
+        size_t n = row_ptr[i];
+        const size_t end = row_ptr[i + 1];
+        for (; n + Lanes::width <= end; n += Lanes::width)
+        {
+            acc = Lanes::fma(values + n, col_idx + n, x, acc);
+        }
+        if (n < end)
+        {
+            acc = Lanes::fma(values + n, col_idx + n, x, acc, end - n);
+        }
+
+        const T sum = Lanes::sum(acc);
+        y[i] = (beta == T(0)) ? alpha * sum : alpha * sum + beta * y[i];
+    }
+}
+
+//! Sparse matrix-vector product in SELL-C-sigma format with AVX2.
+/*!
+ * Like sell_spmv(). The C rows of a chunk are processed in vectors of Avx2Lanes::width rows: for every position in the
+ * rows, the values and column indices of the rows are contiguous, so they are loaded as full vectors and the elements
+ * of x are gathered. If the chunk size is not a multiple of the vector width, the remaining rows are processed without
+ * vectors.
+ */
+template <size_t C, typename T, typename I>
+SPARSEMATRIX_TARGET_AVX2 void sell_spmv_avx2(size_t first, size_t last, size_t rows, const size_t* chunk_ptr,
+                                             const I* perm, const I* col_idx, const T* values, const T alpha,
+                                             const T* x, const T beta, T* y)
+{
+    typedef Avx2Lanes<T, sizeof(I)> Lanes;
+
+    T sums[C];
+    for (size_t chunk = first; chunk < last; ++chunk)
+    {
+        const size_t end = chunk_ptr[chunk + 1];
+        size_t lane = 0;
+        for (; lane + Lanes::width <= C; lane += Lanes::width)
+        {
+            typename Lanes::Vec acc = typename Lanes::Vec();
+            for (size_t n = chunk_ptr[chunk] + lane; n < end; n += C)
+            {
+                acc = Lanes::fma(values + n, col_idx + n, x, acc);
+            }
+            Lanes::store(sums + lane, acc);
+        }
+        for (; lane < C; ++lane)
+        {
+            sums[lane] = 0;
+            for (size_t n = chunk_ptr[chunk] + lane; n < end; n += C)
+            {
+                sums[lane] += values[n] * x[col_idx[n]];
+            }
+        }
+        sell_store(chunk * C, std::min(C, rows - chunk * C), perm, sums, alpha, beta, y);
+    }
+}
+
+//! Sparse matrix-vector product in SELL-C-sigma format with AVX-512.
+/*!
+ * Like sell_spmv_avx2(), with vectors of Avx512Lanes::width rows.
+ */
+template <size_t C, typename T, typename I>
+SPARSEMATRIX_TARGET_AVX512 void sell_spmv_avx512(size_t first, size_t last, size_t rows, const size_t* chunk_ptr,
+                                                 const I* perm, const I* col_idx, const T* values, const T alpha,
+                                                 const T* x, const T beta, T* y)
+{
+    typedef Avx512Lanes<T, sizeof(I)> Lanes;
+
+    T sums[C];
+    for (size_t chunk = first; chunk < last; ++chunk)
+    {
+        const size_t end = chunk_ptr[chunk + 1];
+        size_t lane = 0;
+        for (; lane + Lanes::width <= C; lane += Lanes::width)
+        {
+            typename Lanes::Vec acc = typename Lanes::Vec();
+            for (size_t n = chunk_ptr[chunk] + lane; n < end; n += C)
+            {
+                acc = Lanes::fma(values + n, col_idx + n, x, acc);
+            }
+            Lanes::store(sums + lane, acc);
+        }
+        for (; lane < C; ++lane)
+        {
+            sums[lane] = 0;
+            for (size_t n = chunk_ptr[chunk] + lane; n < end; n += C)
+            {
+                sums[lane] += values[n] * x[col_idx[n]];
+            }
+        }
+        sell_store(chunk * C, std::min(C, rows - chunk * C), perm, sums, alpha, beta, y);
+    }
+}
+
+#endif  // SPARSEMATRIX_X86_SIMD
+
+}  // namespace sparsematrix_detail
+
+#endif  // SIMDKERNELS_H
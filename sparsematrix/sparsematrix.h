@@ -16,12 +16,653 @@ OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
 */
 
 
+#ifndef SPARSEMATRIX_H
+#define SPARSEMATRIX_H
+
 #include <algorithm>
+#include <array>
+#include <functional>
 #include <initializer_list>
+#include <limits>
 #include <stdexcept>
 #include <map>
+#include <memory>
 #include <tuple>
+#include <type_traits>
 #include <utility>
+#include <vector>
+
+
+template <size_t M, size_t N, typename T, typename I, typename Alloc>
+class SparseMatrix;
+
+template <size_t M, size_t N, typename T, typename I>
+class CsrMatrix;
+
+template <typename T, typename I>
+class DynamicSparseMatrix;
+
+template <size_t M, size_t N, typename T, typename I>
+class SparseMatrixBuilder;
+
+
+//! Algorithms shared by the matrix classes.
+namespace sparsematrix_detail
+{
+
+//! Check if all indices of a dimension fit in an index type.
+/*!
+ * \param n dimension (number of rows or columns).
+ * \return true if the indices 0 ... n-1 can be represented by I.
+ */
+template <typename I>
+constexpr bool index_fits(size_t n)
+{
+    return n == 0 || n - 1 <= static_cast<size_t>(std::numeric_limits<I>::max());
+}
+
+//! Layout of a node of a std::map; a red-black tree node holds three links, a colour and the element.
+template <typename Value>
+struct map_node
+{
+    void* parent;
+    void* left;
+    void* right;
+    int color;
+    Value value;
+};
+
+//! Check if an allocator reports the memory it holds with a capacity() member, like PoolAllocator.
+template <typename Alloc>
+struct has_capacity
+{
+    template <typename A>
+    static auto test(int) -> decltype(static_cast<size_t>(std::declval<const A&>().capacity()), std::true_type());
+
+    template <typename>
+    static std::false_type test(...);
+
+    static const bool value = decltype(test<Alloc>(0))::value;
+};
+
+//! Heap memory used by a map whose allocator does not report its capacity.
+/*!
+ * Every element of a std::map is allocated as a separate tree node, so the heap memory is the number of elements
+ * times the size of a node.
+ */
+template <typename Map>
+size_t map_memory_bytes(const Map& values, std::false_type)
+{
+    return values.size() * sizeof(map_node<typename Map::value_type>);
+}
+
+//! Heap memory used by a map whose allocator reports its capacity: everything the allocator holds, including freed
+//! nodes and the unused part of its slabs.
+template <typename Map>
+size_t map_memory_bytes(const Map& values, std::true_type)
+{
+    return values.get_allocator().capacity();
+}
+
+//! Heap memory used by a map.
+/*!
+ * If the allocator has a capacity() member, like PoolAllocator, the memory is its capacity; otherwise it is the
+ * number of elements times the size of a tree node. The overhead of the system allocator is not included.
+ *
+ * \param values the map.
+ * \return the estimated number of bytes allocated by the map.
+ */
+template <typename Map>
+size_t map_memory_bytes(const Map& values)
+{
+    return map_memory_bytes(values, std::integral_constant<bool, has_capacity<typename Map::allocator_type>::value>());
+}
+
+//! Heap memory used by a vector.
+/*!
+ * \param values the vector.
+ * \return the number of bytes allocated by the vector, which is determined by its capacity.
+ */
+template <typename Vector>
+size_t vector_memory_bytes(const Vector& values)
+{
+    return values.capacity() * sizeof(typename Vector::value_type);
+}
+
+//! Multiplication of matrices in map storage.
+/*!
+ * Computes C = A x B row by row (Gustavson's algorithm), for matrices stored in maps with (i,j) keys in row-major
+ * order. Row r of C is the sum of the rows k of B, each weighted by element A(r,k). Only allocated elements of A and
+ * the matching rows of B are visited, so the cost scales with the number of actual multiplications instead of the
+ * matrix dimensions. Only non-zero elements are stored in C.
+ *
+ * \param lhs storage of A.
+ * \param rhs storage of B.
+ * \param columns number of columns of B.
+ * \param result storage of C; must be empty.
+ */
+template <typename MapA, typename MapB, typename MapC>
+void map_multiply(const MapA& lhs, const MapB& rhs, size_t columns, MapC& result)
+{
+    typedef typename MapB::key_type KeyB;
+    typedef typename MapC::key_type KeyC;
+    typedef typename MapC::mapped_type T;
+    typedef typename KeyB::second_type IndexB;
+
+    // Dense accumulator for a single row of the result, plus the list of columns that were touched.
+    std::vector<T> accumulator(columns, T(0));
+    std::vector<bool> touched(columns, false);
+    std::vector<size_t> touched_columns;
+
+    auto elem = lhs.cbegin();
+    while (elem != lhs.cend())
+    {
+        const size_t r = elem->first.first;
+
+        // For C = A * B, row C(r,:) = sum_k A(r,k) * B(k,:).
+        for (; elem != lhs.cend() && elem->first.first == r; ++elem)
+        {
+            const size_t k = elem->first.second;
+            // The end of row k is searched with the largest column index, since k + 1 may not fit the index type.
+            const auto row_end = rhs.upper_bound(KeyB(k, std::numeric_limits<IndexB>::max()));
+            for (auto other = rhs.lower_bound(KeyB(k, 0)); other != row_end; ++other)
+            {
+                const size_t c = other->first.second;
+                if (!touched[c])
+                {
+                    touched[c] = true;
+                    touched_columns.push_back(c);
+                }
+                accumulator[c] += elem->second * other->second;
+            }
+        }
+
+        // Store the row in column order, which is also the order of the map.
+        std::sort(touched_columns.begin(), touched_columns.end());
+        for (const size_t c : touched_columns)
+        {
+            // Add the element only if it is non-zero.
+            if (accumulator[c] != 0)
+            {
+                result.emplace_hint(result.end(), KeyC(r, c), accumulator[c]);
+            }
+            accumulator[c] = 0;
+            touched[c] = false;
+        }
+        touched_columns.clear();
+    }
+}
+
+//! In-place element-wise combination of matrices in map storage.
+/*!
+ * Computes A = op(A, B) for a matrix A stored in a map with (i,j) keys in row-major order and the elements of B given
+ * by a cursor in the same order. Both are walked side by side, like in a merge: elements of B that are not allocated
+ * in A are inserted with op(0, b) at the current position, which takes amortized constant time. If the next element
+ * of B is far ahead, the position is found with a tree search instead, so that adding a few elements to a large
+ * matrix does not visit all of its elements. The allocated elements of the result are the union of those of A and B.
+ *
+ * B may refer to A itself: every element of B is read before A is updated at the same index.
+ *
+ * \param values storage of A.
+ * \param elem cursor over the elements of B.
+ * \param op binary operation to apply.
+ */
+template <typename Map, typename Cursor, typename Op>
+void map_merge(Map& values, Cursor elem, Op op)
+{
+    typedef typename Map::mapped_type T;
+
+    // Number of elements that are skipped one by one before falling back to a tree search.
+    const size_t max_steps = 8;
+
+    auto pos = values.begin();
+    for (; elem.valid(); elem.next())
+    {
+        size_t steps = 0;
+        while (pos != values.end() && pos->first < elem.key())
+        {
+            if (++steps > max_steps)
+            {
+                pos = values.lower_bound(elem.key());
+                break;
+            }
+            ++pos;
+        }
+
+        if (pos != values.end() && !(elem.key() < pos->first))
+        {
+            pos->second = op(pos->second, elem.value());
+        }
+        else
+        {
+            // The hint is the element after the new one, so pos stays valid for the next element of B.
+            values.emplace_hint(pos, elem.key(), op(T(0), elem.value()));
+        }
+    }
+}
+
+//! Matrix-vector product for a matrix in map storage.
+/*!
+ * Computes y = alpha * A * x + beta * y for a matrix A stored in a map with (i,j) keys in row-major order. The
+ * allocated elements are visited once, in order. If beta is zero, y is not read.
+ *
+ * \param values storage of A.
+ * \param rows number of rows of A.
+ * \param alpha scaling factor for A * x.
+ * \param x input vector.
+ * \param beta scaling factor for y.
+ * \param y output vector.
+ */
+template <typename Map, typename T>
+void map_spmv(const Map& values, size_t rows, const T alpha, const T* x, const T beta, T* y)
+{
+    auto elem = values.cbegin();
+    for (size_t i = 0; i < rows; ++i)
+    {
+        // Allocated elements are visited in row-major order, so row i is a contiguous range in the map.
+        T sum = 0;
+        for (; elem != values.cend() && elem->first.first == i; ++elem)
+        {
+            sum += elem->second * x[elem->first.second];
+        }
+        y[i] = (beta == T(0)) ? alpha * sum : alpha * sum + beta * y[i];
+    }
+}
+
+//! Type that is not used for template argument deduction.
+template <typename T>
+struct nondeduced
+{
+    typedef T type;
+};
+
+//! Cursor over the allocated elements of a map, in row-major order.
+/*!
+ * A cursor visits the allocated elements of a (possibly unevaluated) matrix in row-major order. It is valid as long
+ * as there are elements left; key() and value() give the current element and next() moves to the next one.
+ */
+template <typename Map>
+class MapCursor
+{
+    private:
+        //! Current position.
+        typename Map::const_iterator _pos;
+
+        //! End of the map.
+        typename Map::const_iterator _end;
+
+    public:
+        //! Create a cursor at the first element of a map.
+        explicit MapCursor(const Map& values) : _pos(values.cbegin()), _end(values.cend())
+        {
+        }
+
+        //! Check if the cursor points to an element.
+        bool valid() const
+        {
+            return _pos != _end;
+        }
+
+        //! Index (i,j) of the current element.
+        const typename Map::key_type& key() const
+        {
+            return _pos->first;
+        }
+
+        //! Value of the current element.
+        typename Map::mapped_type value() const
+        {
+            return _pos->second;
+        }
+
+        //! Move to the next element.
+        void next()
+        {
+            ++_pos;
+        }
+};
+
+//! Base class of matrix expressions.
+/*!
+ * Sums, differences and scalings of matrices are not computed right away: the operators return an expression that
+ * refers to its operands. When the expression is assigned to a SparseMatrix, all operations are evaluated in a single
+ * merge pass over the allocated elements of all operands, without temporary matrices. Every expression of type E
+ * provides a cursor() over the allocated elements of its result, which are the union of those of its operands.
+ *
+ * Expressions refer to the matrices they were built from and should not outlive them. Assign them to a matrix or use
+ * eval() instead of storing them.
+ */
+template <size_t M, size_t N, typename T, typename I, typename E>
+class MatrixExpression
+{
+    public:
+        //! The expression as its actual type.
+        const E& derived() const
+        {
+            return static_cast<const E&>(*this);
+        }
+
+        //! Evaluate the expression.
+        /*!
+         * \return the result of the expression.
+         */
+        SparseMatrix<M, N, T, I, std::allocator<T>> eval() const
+        {
+            return SparseMatrix<M, N, T, I, std::allocator<T>>(derived());
+        }
+};
+
+//! Storage of an operand in an expression: expressions are stored by value, matrices by reference.
+template <typename E>
+struct expression_operand
+{
+    typedef E type;
+};
+
+//! Storage of an operand in an expression: expressions are stored by value, matrices by reference.
+template <size_t M, size_t N, typename T, typename I, typename Alloc>
+struct expression_operand<SparseMatrix<M, N, T, I, Alloc>>
+{
+    typedef const SparseMatrix<M, N, T, I, Alloc>& type;
+};
+
+//! Scaled matrix expression, s x A.
+template <size_t M, size_t N, typename T, typename I, typename E>
+class ScaledExpression : public MatrixExpression<M, N, T, I, ScaledExpression<M, N, T, I, E>>
+{
+    private:
+        //! Operand A.
+        typename expression_operand<E>::type _operand;
+
+        //! Scaling factor s.
+        T _scale;
+
+    public:
+        //! Cursor over the allocated elements of s x A; these are the allocated elements of A.
+        class Cursor
+        {
+            private:
+                //! Cursor over A.
+                typename E::cursor_type _operand;
+
+                //! Scaling factor s.
+                T _scale;
+
+            public:
+                //! Create a cursor at the first element.
+                Cursor(const typename E::cursor_type& operand, const T scale) : _operand(operand), _scale(scale)
+                {
+                }
+
+                //! Check if the cursor points to an element.
+                bool valid() const
+                {
+                    return _operand.valid();
+                }
+
+                //! Index (i,j) of the current element.
+                const std::pair<I, I>& key() const
+                {
+                    return _operand.key();
+                }
+
+                //! Value of the current element.
+                T value() const
+                {
+                    return _operand.value() * _scale;
+                }
+
+                //! Move to the next element.
+                void next()
+                {
+                    _operand.next();
+                }
+        };
+
+        //! Cursor type.
+        typedef Cursor cursor_type;
+
+        //! Create the expression s x A.
+        ScaledExpression(const E& operand, const T scale) : _operand(operand), _scale(scale)
+        {
+        }
+
+        //! Cursor over the allocated elements of the result.
+        cursor_type cursor() const
+        {
+            return cursor_type(_operand.cursor(), _scale);
+        }
+};
+
+//! Element-wise matrix expression, op(A, B), for addition and subtraction.
+template <size_t M, size_t N, typename T, typename I, typename A, typename B, typename Op>
+class BinaryExpression : public MatrixExpression<M, N, T, I, BinaryExpression<M, N, T, I, A, B, Op>>
+{
+    private:
+        //! Operand A.
+        typename expression_operand<A>::type _op1;
+
+        //! Operand B.
+        typename expression_operand<B>::type _op2;
+
+    public:
+        //! Cursor over the allocated elements of op(A, B); these are the union of the allocated elements of A and B.
+        class Cursor
+        {
+            private:
+                //! Operands that have an element at the current index.
+                enum class Source
+                {
+                    First,
+                    Second,
+                    Both
+                };
+
+                //! Cursor over A.
+                typename A::cursor_type _op1;
+
+                //! Cursor over B.
+                typename B::cursor_type _op2;
+
+                //! Operands that have an element at the current index.
+                Source _source;
+
+                //! Find the operands with the element that comes first in row-major order.
+                void merge()
+                {
+                    if (!_op2.valid() || (_op1.valid() && _op1.key() < _op2.key()))
+                    {
+                        _source = Source::First;
+                    }
+                    else if (!_op1.valid() || _op2.key() < _op1.key())
+                    {
+                        _source = Source::Second;
+                    }
+                    else
+                    {
+                        _source = Source::Both;
+                    }
+                }
+
+            public:
+                //! Create a cursor at the first element.
+                Cursor(const typename A::cursor_type& op1, const typename B::cursor_type& op2) : _op1(op1), _op2(op2)
+                {
+                    merge();
+                }
+
+                //! Check if the cursor points to an element.
+                bool valid() const
+                {
+                    return _op1.valid() || _op2.valid();
+                }
+
+                //! Index (i,j) of the current element.
+                const std::pair<I, I>& key() const
+                {
+                    return _source == Source::Second ? _op2.key() : _op1.key();
+                }
+
+                //! Value of the current element; elements that are allocated in one operand only are combined with 0.
+                T value() const
+                {
+                    if (_source == Source::First)
+                    {
+                        return _op1.value();
+                    }
+                    else if (_source == Source::Second)
+                    {
+                        return Op()(T(0), _op2.value());
+                    }
+                    return Op()(_op1.value(), _op2.value());
+                }
+
+                //! Move to the next element.
+                void next()
+                {
+                    if (_source != Source::Second)
+                    {
+                        _op1.next();
+                    }
+                    if (_source != Source::First)
+                    {
+                        _op2.next();
+                    }
+                    merge();
+                }
+        };
+
+        //! Cursor type.
+        typedef Cursor cursor_type;
+
+        //! Create the expression op(A, B).
+        BinaryExpression(const A& op1, const B& op2) : _op1(op1), _op2(op2)
+        {
+        }
+
+        //! Cursor over the allocated elements of the result.
+        cursor_type cursor() const
+        {
+            return cursor_type(_op1.cursor(), _op2.cursor());
+        }
+};
+
+//! Evaluate an expression; a matrix is passed on without copying.
+template <size_t M, size_t N, typename T, typename I, typename Alloc>
+const SparseMatrix<M, N, T, I, Alloc>& evaluate(const SparseMatrix<M, N, T, I, Alloc>& matrix)
+{
+    return matrix;
+}
+
+//! Evaluate an expression; a matrix is passed on without copying.
+template <size_t M, size_t N, typename T, typename I, typename E>
+SparseMatrix<M, N, T, I, std::allocator<T>> evaluate(const MatrixExpression<M, N, T, I, E>& expression)
+{
+    return expression.eval();
+}
+
+//! Addition.
+/*!
+ * Implements A + B, with A and B of same size and type (checked at compile time). The allocated elements of the
+ * result are the union of those of A and B.
+ *
+ * \param op1 First operand.
+ * \param op2 Second operand.
+ * \return expression for A + B.
+ */
+template <size_t M, size_t N, typename T, typename I, typename A, typename B>
+BinaryExpression<M, N, T, I, A, B, std::plus<T>> operator+(const MatrixExpression<M, N, T, I, A>& op1,
+                                                           const MatrixExpression<M, N, T, I, B>& op2)
+{
+    return BinaryExpression<M, N, T, I, A, B, std::plus<T>>(op1.derived(), op2.derived());
+}
+
+//! Subtraction.
+/*!
+ * Implements A - B, with A and B of same size and type (checked at compile time). The allocated elements of the
+ * result are the union of those of A and B.
+ *
+ * \param op1 First operand.
+ * \param op2 Second operand.
+ * \return expression for A - B.
+ */
+template <size_t M, size_t N, typename T, typename I, typename A, typename B>
+BinaryExpression<M, N, T, I, A, B, std::minus<T>> operator-(const MatrixExpression<M, N, T, I, A>& op1,
+                                                            const MatrixExpression<M, N, T, I, B>& op2)
+{
+    return BinaryExpression<M, N, T, I, A, B, std::minus<T>>(op1.derived(), op2.derived());
+}
+
+//! Unitary minus.
+/*!
+ * \param rhs Any matrix A.
+ * \return expression for -A.
+ */
+template <size_t M, size_t N, typename T, typename I, typename E>
+ScaledExpression<M, N, T, I, E> operator-(const MatrixExpression<M, N, T, I, E>& rhs)
+{
+    return ScaledExpression<M, N, T, I, E>(rhs.derived(), T(-1));
+}
+
+//! Scaling.
+/*!
+ * \param s Scaling factor.
+ * \param op2 Any matrix A.
+ * \return expression for s x A.
+ */
+template <size_t M, size_t N, typename T, typename I, typename E>
+ScaledExpression<M, N, T, I, E> operator*(const typename nondeduced<T>::type s,
+                                          const MatrixExpression<M, N, T, I, E>& op2)
+{
+    return ScaledExpression<M, N, T, I, E>(op2.derived(), s);
+}
+
+//! Scaling.
+/*!
+ * \param op1 Any matrix A.
+ * \param s Scaling factor.
+ * \return expression for A x s.
+ */
+template <size_t M, size_t N, typename T, typename I, typename E>
+ScaledExpression<M, N, T, I, E> operator*(const MatrixExpression<M, N, T, I, E>& op1,
+                                          const typename nondeduced<T>::type s)
+{
+    return ScaledExpression<M, N, T, I, E>(op1.derived(), s);
+}
+
+//! Multiplication of expressions.
+/*!
+ * Matrix multiplication is not fused with other operations: the operands are evaluated first, unless they are
+ * matrices already.
+ *
+ * \param op1 First operand.
+ * \param op2 Second operand.
+ * \return A x B.
+ */
+template <size_t M, size_t N, size_t P, typename T, typename I, typename A, typename B>
+SparseMatrix<M, P, T, I, std::allocator<T>> operator*(const MatrixExpression<M, N, T, I, A>& op1,
+                                                      const MatrixExpression<N, P, T, I, B>& op2)
+{
+    return evaluate(op1.derived()) * evaluate(op2.derived());
+}
+
+//! Multiplication of an expression and a matrix.
+/*!
+ * Same as the multiplication of two expressions. This overload is an exact match for a matrix as second operand,
+ * so it is preferred over the multiplication of two matrices with an implicit evaluation of the first operand.
+ *
+ * \param op1 First operand.
+ * \param op2 Second operand.
+ * \return A x B.
+ */
+template <size_t M, size_t N, size_t P, typename T, typename I, typename A, typename Alloc>
+SparseMatrix<M, P, T, I, std::allocator<T>> operator*(const MatrixExpression<M, N, T, I, A>& op1,
+                                                      const SparseMatrix<N, P, T, I, Alloc>& op2)
+{
+    return evaluate(op1.derived()) * op2;
+}
+
+}  // namespace sparsematrix_detail
 
 
 //! Representation of a sparse matrix with M rows and N columns, of type T
@@ -29,13 +670,80 @@ OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
  * This class represents a sparse matrix, i.e. a matrix with mostly empty (zero-valued) cells. Internally it uses a map
  * (std::map) to store non-zero values. The matrix is stored in row-major order. Indices (i,j) are used as keys for the
  * map.
+ *
+ * The indices are stored as type I, which must be an unsigned integer type that can hold M - 1 and N - 1 (checked at
+ * compile time). A smaller index type reduces the memory used per element, e.g. uint32_t for matrices with up to 2^32
+ * rows and columns. The interface always uses size_t for indices.
+ *
+ * Addition, subtraction and scaling return expressions that are evaluated when they are assigned to a matrix, so that
+ * a chain like a x A + B - c x C is computed in a single pass without temporary matrices.
+ *
+ * The map nodes are allocated with an allocator of type Alloc, which is rebound to the node type. Use PoolAllocator
+ * (poolallocator.h) to take the nodes from large slabs that are released at once when the matrix is destroyed.
+ *
+ * \sa sparsematrix_detail::MatrixExpression
  */
-template <size_t M, size_t N, typename T>
-class SparseMatrix
+template <size_t M, size_t N, typename T, typename I = size_t, typename Alloc = std::allocator<T>>
+class SparseMatrix : public sparsematrix_detail::MatrixExpression<M, N, T, I, SparseMatrix<M, N, T, I, Alloc>>
 {
+    static_assert(std::is_integral<I>::value && std::is_unsigned<I>::value, "index type must be unsigned integer");
+    static_assert(sparsematrix_detail::index_fits<I>(M) && sparsematrix_detail::index_fits<I>(N),
+                  "matrix dimensions exceed index type");
+
     private:
+        //! Allocator for the elements of the internal storage map.
+        typedef typename std::allocator_traits<Alloc>::template rebind_alloc<std::pair<const std::pair<I, I>, T>>
+            StorageAllocator;
+
+        //! Type of the internal storage map.
+        typedef std::map<std::pair<I, I>, T, std::less<std::pair<I, I>>, StorageAllocator> Storage;
+
         //! Internal storage map; keys are pairs (i,j), which are sorted first by i and then by j (row-major order).
-        std::map<std::pair<size_t, size_t>, T> _values;
+        Storage _values;
+
+        //! All matrix sizes have access to each others internal storage (needed for multiplication).
+        template <size_t, size_t, typename, typename, typename> friend class SparseMatrix;
+
+        //! Compressed storage is converted back to map storage without per-element lookups.
+        template <size_t, size_t, typename, typename> friend class CsrMatrix;
+
+        //! Matrices with runtime dimensions are converted to fixed dimensions without per-element lookups.
+        template <typename, typename> friend class DynamicSparseMatrix;
+
+        //! Batches of elements are inserted in row-major order without per-element lookups.
+        template <size_t, size_t, typename, typename> friend class SparseMatrixBuilder;
+
+        //! Storage key of the element at index (i,j); the indices must be in bounds.
+        static std::pair<I, I> key(size_t i, size_t j)
+        {
+            return std::pair<I, I>(static_cast<I>(i), static_cast<I>(j));
+        }
+
+        //! Scale all allocated elements in place.
+        void scale(const T s)
+        {
+            for (auto elem = _values.begin(); elem != _values.end(); ++elem)
+            {
+                elem->second *= s;
+            }
+        }
+
+        //! Multiplication.
+        /*!
+         * Multiplies this matrix with another matrix of compatible size, row by row.
+         *
+         * \sa sparsematrix_detail::map_multiply()
+         *
+         * \param rhs Right-hand side operand.
+         * \return this x rhs.
+         */
+        template <size_t P, typename OtherAlloc>
+        SparseMatrix<M, P, T, I, Alloc> multiply_rows(const SparseMatrix<N, P, T, I, OtherAlloc>& rhs) const
+        {
+            SparseMatrix<M, P, T, I, Alloc> lhs;
+            sparsematrix_detail::map_multiply(_values, rhs._values, P, lhs._values);
+            return lhs;
+        }
 
     public:
         //! Default constructor.
@@ -49,6 +757,47 @@ class SparseMatrix
          */
         SparseMatrix(const SparseMatrix& other) = default;
 
+        //! Move-constructor.
+        SparseMatrix(SparseMatrix&& other) = default;
+
+        //! Copy-assignment.
+        SparseMatrix& operator=(const SparseMatrix& other) = default;
+
+        //! Move-assignment.
+        SparseMatrix& operator=(SparseMatrix&& other) = default;
+
+        //! Evaluation of an expression.
+        /*!
+         * Create an instance from the result of an expression of matrices with the same size and type. The elements
+         * are computed in row-major order and appended to the map storage in a single pass.
+         *
+         * \param expression expression to evaluate.
+         */
+        template <typename E>
+        SparseMatrix(const sparsematrix_detail::MatrixExpression<M, N, T, I, E>& expression)
+        {
+            for (auto elem = expression.derived().cursor(); elem.valid(); elem.next())
+            {
+                _values.emplace_hint(_values.end(), elem.key(), elem.value());
+            }
+        }
+
+        //! Assignment of an expression.
+        /*!
+         * Evaluates an expression and replaces the contents of this matrix with the result. The expression may refer
+         * to this matrix itself.
+         *
+         * \param expression expression to evaluate.
+         * \return this matrix.
+         */
+        template <typename E>
+        SparseMatrix& operator=(const sparsematrix_detail::MatrixExpression<M, N, T, I, E>& expression)
+        {
+            SparseMatrix lhs(expression);
+            _values.swap(lhs._values);
+            return *this;
+        }
+
         //! Construction via initializer list.
         /*!
          * Create an instance by providing a (key, value)-list for the cells to be populated. The key is a pair (i,j)
@@ -56,7 +805,7 @@ class SparseMatrix
          *
          * \param m initializer list of (key, value) pairs.
          */
-        SparseMatrix(std::initializer_list<std::pair<const std::pair<size_t, size_t>, T>> m) : _values{m}
+        SparseMatrix(std::initializer_list<std::pair<const std::pair<size_t, size_t>, T>> m)
         {
             for (const auto& elem : m)
             {
@@ -66,6 +815,7 @@ class SparseMatrix
                 {
                     throw std::out_of_range("index out of bounds");
                 }
+                _values.emplace(key(i, j), elem.second);
             }
         }
 
@@ -91,7 +841,7 @@ class SparseMatrix
             }
 
             // Keys are inserted if non-existing.
-            return _values[{i, j}];
+            return _values[key(i, j)];
         }
 
         //! Size of the matrix.
@@ -113,15 +863,43 @@ class SparseMatrix
         /*!
          * Get the number of allocated elements. This is typically equal to the number of non-zero elements, unless one
          * or more elements have been accessed before. The number of allocated elements R always satisfies
-         * 0 <= R <= M x N.
+         * 0 <= R <= M x N. This takes constant time.
          *
-         * \sa size()
+         * \sa size(), memory_bytes()
          *
          * \return the number of allocated elements.
          */
         size_t allocated() const
         {
-            return std::distance(_values.cbegin(), _values.cend());
+            return _values.size();
+        }
+
+        //! Memory footprint.
+        /*!
+         * Get the memory used by the matrix: the size of this object plus the heap memory of the allocated elements,
+         * which are stored in separate map nodes. The overhead of the system allocator is not included. This takes
+         * constant time.
+         *
+         * With an allocator that reports its capacity, like PoolAllocator, the heap memory is the capacity of the
+         * allocator instead: its slabs, including freed nodes and space that has not been used yet. A pool that is
+         * shared with other containers is counted in full.
+         *
+         * \sa allocated()
+         *
+         * \return the memory footprint in bytes.
+         */
+        size_t memory_bytes() const
+        {
+            return sizeof(*this) + sparsematrix_detail::map_memory_bytes(_values);
+        }
+
+        //! Allocator of the map nodes.
+        /*!
+         * \return a copy of the allocator, rebound to the element type.
+         */
+        Alloc get_allocator() const
+        {
+            return Alloc(_values.get_allocator());
         }
 
         //! Peek if an element is allocated.
@@ -142,7 +920,7 @@ class SparseMatrix
             }
 
             bool has_value = false;
-            if (_values.find({i, j}) == _values.end())
+            if (_values.find(key(i, j)) == _values.end())
             {
                 has_value = false;
             }
@@ -154,29 +932,41 @@ class SparseMatrix
         }
 
         //! Constant iterator to the beginning of the internal map storage.
-        const typename std::map<std::pair<size_t, size_t>, T>::const_iterator cbegin() const
+        const typename Storage::const_iterator cbegin() const
         {
             return _values.cbegin();
         }
 
         //! Constant iterator to the end of the internal map storage.
-        const typename std::map<std::pair<size_t, size_t>, T>::const_iterator cend() const
+        const typename Storage::const_iterator cend() const
         {
             return _values.cend();
         }
 
+        //! Cursor type for use in expressions.
+        typedef sparsematrix_detail::MapCursor<Storage> cursor_type;
+
+        //! Cursor over the allocated elements, for use in expressions.
+        cursor_type cursor() const
+        {
+            return cursor_type(_values);
+        }
+
         //! Check for equality.
         /*!
          * Check for equality by comparing the internal map storage. Note that this is a strict comparison that also
          * implicitly considers sparseness. For example, if two 2x2 matrices A and B are created without any data (empty
          * matrix), but one assigns B(0,1) = 0, then A != B, because B will have one element assigned.
          *
-         * \param rhs right-hand side of the equality test.
+         * Expressions are evaluated before they are compared.
+         *
+         * \param op1 left-hand side of the equality test.
+         * \param op2 right-hand side of the equality test.
          * \return Boolean value indicating equality.
          */
-        bool operator==(const SparseMatrix& rhs) const
+        friend bool operator==(const SparseMatrix& op1, const SparseMatrix& op2)
         {
-            return _values == rhs._values;
+            return op1._values == op2._values;
         }
 
         //! Check for inequality.
@@ -185,45 +975,80 @@ class SparseMatrix
          * implicitly considers sparseness. For example, if two 2x2 matrices A and B are created without any data (empty
          * matrix), but one assigns B(0,1) = 0, then A != B, because B will have one element assigned.
          *
-         * \param rhs right-hand side of the inequality test.
+         * Expressions are evaluated before they are compared.
+         *
+         * \param op1 left-hand side of the inequality test.
+         * \param op2 right-hand side of the inequality test.
          * \return Boolean value indicating inequality.
          */
-        bool operator!=(const SparseMatrix& rhs) const
+        friend bool operator!=(const SparseMatrix& op1, const SparseMatrix& op2)
         {
-            return !(_values == rhs._values);
+            return !(op1._values == op2._values);
         }
 
         //! Addition.
         /*!
-         * Implements A += B, with A and B of same size and type (checked at compile time).
+         * Implements A += B, with A and B of same size and type (checked at compile time). B can be a matrix or an
+         * expression; an expression is evaluated element by element while it is added. Both are merged in a single
+         * pass in row-major order.
+         *
+         * \sa sparsematrix_detail::map_merge()
          *
          * \param rhs Matrix to add.
          * \return A += B.
          */
-        SparseMatrix& operator+=(const SparseMatrix& rhs)
+        template <typename E>
+        SparseMatrix& operator+=(const sparsematrix_detail::MatrixExpression<M, N, T, I, E>& rhs)
         {
-            for (auto elem = rhs.cbegin(); elem != rhs.cend(); ++elem)
-            {
-                size_t i, j;
-                std::tie(i, j) = elem->first;
-                this->operator()(i, j) += elem->second;
-            }
+            sparsematrix_detail::map_merge(_values, rhs.derived().cursor(), std::plus<T>());
             return *this;
         }
 
         //! Addition.
         /*!
-         * Implements A + B, with A and B of same size and type (checked at compile time).
+         * Implements A + B for a temporary A, which is reused for the result: only elements that are allocated in B
+         * but not in A are allocated.
          *
-         * \param op1 First operand.
+         * \param op1 First operand (temporary).
          * \param op2 Second operand.
          * \return A + B.
          */
-        friend SparseMatrix operator+(SparseMatrix& op1, const SparseMatrix& op2)
+        template <typename E>
+        friend SparseMatrix operator+(SparseMatrix&& op1,
+                                      const sparsematrix_detail::MatrixExpression<M, N, T, I, E>& op2)
         {
-            SparseMatrix lhs(op1);
-            lhs += op2;
-            return lhs;
+            op1 += op2;
+            return std::move(op1);
+        }
+
+        //! Addition.
+        /*!
+         * Implements A + B for a temporary B, which is reused for the result.
+         *
+         * \param op1 First operand.
+         * \param op2 Second operand (temporary).
+         * \return A + B.
+         */
+        template <typename E>
+        friend SparseMatrix operator+(const sparsematrix_detail::MatrixExpression<M, N, T, I, E>& op1,
+                                      SparseMatrix&& op2)
+        {
+            op2 += op1;
+            return std::move(op2);
+        }
+
+        //! Addition.
+        /*!
+         * Implements A + B for temporaries A and B; A is reused for the result.
+         *
+         * \param op1 First operand (temporary).
+         * \param op2 Second operand (temporary).
+         * \return A + B.
+         */
+        friend SparseMatrix operator+(SparseMatrix&& op1, SparseMatrix&& op2)
+        {
+            op1 += op2;
+            return std::move(op1);
         }
 
         //! Unitary plus.
@@ -240,120 +1065,219 @@ class SparseMatrix
 
         //! Subtraction.
         /*!
-         * Implements A -= B, with A and B of same size and type (checked at compile time).
+         * Implements A -= B, with A and B of same size and type (checked at compile time). B can be a matrix or an
+         * expression; an expression is evaluated element by element while it is subtracted. Both are merged in a
+         * single pass in row-major order.
+         *
+         * \sa sparsematrix_detail::map_merge()
          *
          * \param rhs Matrix to subtract.
          * \return A -= B.
          */
-        SparseMatrix& operator-=(const SparseMatrix& rhs)
+        template <typename E>
+        SparseMatrix& operator-=(const sparsematrix_detail::MatrixExpression<M, N, T, I, E>& rhs)
         {
-            return *this += (-rhs);
+            sparsematrix_detail::map_merge(_values, rhs.derived().cursor(), std::minus<T>());
+            return *this;
         }
 
         //! Subtraction.
         /*!
-         * Implements A - B, with A and B of same size and type (checked at compile time).
+         * Implements A - B for a temporary A, which is reused for the result: only elements that are allocated in B
+         * but not in A are allocated.
          *
-         * \param op1 First operand.
+         * \param op1 First operand (temporary).
          * \param op2 Second operand.
          * \return A - B.
          */
-        friend SparseMatrix operator-(SparseMatrix op1, const SparseMatrix& op2)
+        template <typename E>
+        friend SparseMatrix operator-(SparseMatrix&& op1,
+                                      const sparsematrix_detail::MatrixExpression<M, N, T, I, E>& op2)
         {
-            SparseMatrix lhs(op1);
-            lhs -= op2;
-            return lhs;
+            op1 -= op2;
+            return std::move(op1);
+        }
+
+        //! Subtraction.
+        /*!
+         * Implements A - B for a temporary B, which is reused for the result: B is negated in place and A is added.
+         *
+         * \param op1 First operand.
+         * \param op2 Second operand (temporary).
+         * \return A - B.
+         */
+        template <typename E>
+        friend SparseMatrix operator-(const sparsematrix_detail::MatrixExpression<M, N, T, I, E>& op1,
+                                      SparseMatrix&& op2)
+        {
+            op2.scale(T(-1));
+            op2 += op1;
+            return std::move(op2);
+        }
+
+        //! Subtraction.
+        /*!
+         * Implements A - B for temporaries A and B; A is reused for the result.
+         *
+         * \param op1 First operand (temporary).
+         * \param op2 Second operand (temporary).
+         * \return A - B.
+         */
+        friend SparseMatrix operator-(SparseMatrix&& op1, SparseMatrix&& op2)
+        {
+            op1 -= op2;
+            return std::move(op1);
         }
 
         //! Unitary minus.
         /*!
-         * Returns a copy of the input matrix with every element negated.
+         * Negates a temporary matrix in place.
          *
-         * \param rhs Any matrix A.
+         * \param rhs Any matrix A (temporary).
          * \return -A.
          */
-        friend SparseMatrix operator-(const SparseMatrix& rhs)
+        friend SparseMatrix operator-(SparseMatrix&& rhs)
         {
-            SparseMatrix lhs = rhs;
-            for (auto elem = lhs._values.begin(); elem != lhs._values.end(); ++elem)
-            {
-                elem->second *= -1;
-            }
-            return lhs;
+            rhs.scale(T(-1));
+            return std::move(rhs);
         }
 
         //! Scaling.
         /*!
-         * Returns a copy of the input matrix with every element scaled.
+         * Scales a temporary matrix in place.
          *
          * \param s Scaling factor.
-         * \param op2 Any matrix A.
+         * \param op2 Any matrix A (temporary).
          * \return s x A.
          */
-        friend SparseMatrix operator*(const T s, const SparseMatrix& op2)
+        friend SparseMatrix operator*(const T s, SparseMatrix&& op2)
         {
-            SparseMatrix lhs = op2;
-            for (auto elem = lhs._values.begin(); elem != lhs._values.end(); ++elem)
-            {
-                elem->second *= s;
-            }
-            return lhs;
+            op2.scale(s);
+            return std::move(op2);
         }
 
         //! Scaling.
         /*!
-         * Returns a copy of the input matrix with every element scaled.
+         * Scales a temporary matrix in place.
          *
-         * \param op1 Any matrix A.
+         * \param op1 Any matrix A (temporary).
          * \param s Scaling factor.
          * \return A x s.
          */
-        friend SparseMatrix operator*(const SparseMatrix& op1, const T s)
+        friend SparseMatrix operator*(SparseMatrix&& op1, const T s)
         {
-            return s * op1;
+            op1.scale(s);
+            return std::move(op1);
         }
 
         //! Multiplication
         /*!
-         * Multiplies two matrices of compatible size (checked at compile time.)
+         * Multiplies two matrices of compatible size (checked at compile time.) The result uses the allocator type of
+         * the first operand.
          *
          * \param op1 First operand.
          * \param op2 Second operand.
          * \return A x B.
          */
-        template <size_t P>
-        friend SparseMatrix<M, P, T> operator*(const SparseMatrix<M, N, T>& op1, const SparseMatrix<N, P, T>& op2)
+        template <size_t P, typename OtherAlloc>
+        friend SparseMatrix<M, P, T, I, Alloc> operator*(const SparseMatrix& op1,
+                                                         const SparseMatrix<N, P, T, I, OtherAlloc>& op2)
         {
-            SparseMatrix<M, P, T> lhs;
+            SparseMatrix<M, P, T, I, Alloc> lhs;
 
             if (op1.allocated() == 0 || op2.allocated() == 0)
             {
                 return lhs;
             }
 
-            for (size_t r = 0; r < M; ++r)
-            {
-                for (size_t c = 0; c < P; ++c)
-                {
-                    // For C = A * B, element C(x,y) = sum_i A(x,i) * B(i, y).
-                    T v = 0;
-                    for (size_t i = 0; i < N; ++i)
-                    {
-                        if (op1.peek(r, i) && op2.peek(i, c))
-                        {
-                            v += const_cast<SparseMatrix<M, N, T>&>(op1)(r, i) * const_cast<SparseMatrix<N, P, T>&>(op2)(i, c);
-                        }
-                    }
+            return op1.multiply_rows(op2);
+        }
 
-                    // Add the element only if it is non-zero.
-                    if (v != 0)
-                    {
-                        lhs(r, c) = v;
-                    }
-                }
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y for a dense vector x of N elements and a dense vector y of M elements.
+         * The allocated elements are visited once, in order.
+         * If beta is zero, y is not read, so it does not need to be initialized. No memory is allocated.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector (N elements).
+         * \param beta scaling factor for y.
+         * \param y output vector (M elements).
+         */
+        void multiply(const T alpha, const T* x, const T beta, T* y) const
+        {
+            sparsematrix_detail::map_spmv(_values, M, alpha, x, beta, y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x for a dense vector x of N elements and a dense vector y of M elements.
+         *
+         * \param x input vector (N elements).
+         * \param y output vector (M elements).
+         */
+        void multiply(const T* x, T* y) const
+        {
+            multiply(T(1), x, T(0), y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y, with sizes of x and y checked at compile time.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(const T alpha, const std::array<T, N>& x, const T beta, std::array<T, M>& y) const
+        {
+            multiply(alpha, x.data(), beta, y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x, with sizes of x and y checked at compile time.
+         *
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(const std::array<T, N>& x, std::array<T, M>& y) const
+        {
+            multiply(T(1), x.data(), T(0), y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(const T alpha, const std::vector<T>& x, const T beta, std::vector<T>& y) const
+        {
+            if (x.size() != N || y.size() != M)
+            {
+                throw std::out_of_range("vector size mismatch");
             }
 
-            return lhs;
+            multiply(alpha, x.data(), beta, y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x. The vectors are not resized.
+         * Throws std::out_of_range if x does not have N elements or y does not have M elements.
+         *
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(const std::vector<T>& x, std::vector<T>& y) const
+        {
+            multiply(T(1), x, T(0), y);
         }
 
         //! Transpose.
@@ -362,9 +1286,9 @@ class SparseMatrix
          *
          * \return A^T.
          */
-        SparseMatrix<N, M, T> transpose()
+        SparseMatrix<N, M, T, I, Alloc> transpose()
         {
-            SparseMatrix<N, M, T> lhs;
+            SparseMatrix<N, M, T, I, Alloc> lhs;
             for (auto elem = _values.cbegin(); elem != _values.cend(); ++elem)
             {
                 lhs(elem->first.second, elem->first.first) = elem->second;
@@ -374,3 +1298,5 @@ class SparseMatrix
         }
 
 };
+
+#endif  // SPARSEMATRIX_H
@@ -0,0 +1,472 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#ifndef SPARSEMATRIXBUILDER_H
+#define SPARSEMATRIXBUILDER_H
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "csrmatrix.h"
+#include "sparsematrix.h"
+#include "threadpool.h"
+
+
+//! Combination of elements that are added more than once at the same index.
+enum class Duplicates
+{
+    //! Store the sum of the values.
+    Sum,
+
+    //! Store the value that was added last.
+    Last,
+
+    //! Store the largest value.
+    Max
+};
+
+
+//! Builder for sparse matrices with M rows and N columns, of type T, from batches of (row, column, value) triplets
+/*!
+ * Inserting elements into a SparseMatrix one by one costs a tree search per element. This class collects triplets in
+ * any order instead, and assembles them all at once: the triplets are distributed over the rows with a counting sort,
+ * every row is sorted by column and duplicates are combined as chosen. The result is written directly into the
+ * storage of a SparseMatrix (in row-major order, so without tree searches) or of a CsrMatrix.
+ *
+ * Large batches can be assembled on the threads of a ThreadPool: the rows are split into one range per thread and
+ * every thread assembles its own rows, with the same result as a single thread.
+ *
+ * Indices are checked when a triplet is added. The builder is not changed by building, so the same triplets can be
+ * assembled more than once.
+ *
+ * Example:
+ * \code
+ * SparseMatrixBuilder<3, 5, double> builder;
+ * builder.add(2, 4, 1.0);
+ * builder.add(0, 1, 2.0);
+ * builder.add(2, 4, 3.0);
+ * SparseMatrix<3, 5, double> s = builder.build();  // s(2, 4) == 4
+ * \endcode
+ */
+template <size_t M, size_t N, typename T, typename I = size_t>
+class SparseMatrixBuilder
+{
+    static_assert(std::is_integral<I>::value && std::is_unsigned<I>::value, "index type must be unsigned integer");
+    static_assert(sparsematrix_detail::index_fits<I>(M) && sparsematrix_detail::index_fits<I>(N),
+                  "matrix dimensions exceed index type");
+
+    private:
+        //! Element at index (row, column).
+        struct Triplet
+        {
+            I row;
+            I column;
+            T value;
+        };
+
+        //! Collected triplets, in the order in which they were added.
+        std::vector<Triplet> _triplets;
+
+        //! Assemble triplets of a range of rows in compressed row storage.
+        /*!
+         * The triplets are distributed over the rows with a counting sort, which keeps triplets with the same index in
+         * the order in which they are given. Every row is then sorted by column (rows that are already sorted are left
+         * as they are) and runs of equal columns are combined.
+         *
+         * \param first first triplet.
+         * \param last end of the triplets; all of them must be in rows [row_begin, row_begin + rows).
+         * \param row_begin first row.
+         * \param rows number of rows.
+         * \param duplicates combination of duplicate elements.
+         * \param row_ptr output: row pointers of the rows, relative to the first one (rows + 1 entries).
+         * \param col_idx output: column indices, sorted within every row.
+         * \param values output: values.
+         */
+        static void assemble(const Triplet* first, const Triplet* last, size_t row_begin, size_t rows,
+                             Duplicates duplicates, std::vector<size_t>& row_ptr, std::vector<I>& col_idx,
+                             std::vector<T>& values)
+        {
+            row_ptr.assign(rows + 1, 0);
+            for (const Triplet* t = first; t != last; ++t)
+            {
+                ++row_ptr[t->row - row_begin + 1];
+            }
+            for (size_t i = 0; i < rows; ++i)
+            {
+                row_ptr[i + 1] += row_ptr[i];
+            }
+
+            std::vector<std::pair<I, T>> entries(last - first);
+            {
+                std::vector<size_t> next(row_ptr.cbegin(), row_ptr.cend() - 1);
+                for (const Triplet* t = first; t != last; ++t)
+                {
+                    entries[next[t->row - row_begin]++] = std::pair<I, T>(t->column, t->value);
+                }
+            }
+
+            const auto by_column = [](const std::pair<I, T>& a, const std::pair<I, T>& b)
+            {
+                return a.first < b.first;
+            };
+
+            col_idx.clear();
+            values.clear();
+            col_idx.reserve(entries.size());
+            values.reserve(entries.size());
+            for (size_t i = 0; i < rows; ++i)
+            {
+                const auto row_first = entries.begin() + row_ptr[i];
+                const auto row_last = entries.begin() + row_ptr[i + 1];
+                if (!std::is_sorted(row_first, row_last, by_column))
+                {
+                    // Only the order of duplicates matters for Last, so the cheaper unstable sort does for the others.
+                    if (duplicates == Duplicates::Last)
+                    {
+                        std::stable_sort(row_first, row_last, by_column);
+                    }
+                    else
+                    {
+                        std::sort(row_first, row_last, by_column);
+                    }
+                }
+
+                // Compact the row in place; the start of row i is no longer needed once it has been read.
+                row_ptr[i] = col_idx.size();
+                for (auto entry = row_first; entry != row_last;)
+                {
+                    const I column = entry->first;
+                    T value = entry->second;
+                    for (++entry; entry != row_last && entry->first == column; ++entry)
+                    {
+                        switch (duplicates)
+                        {
+                            case Duplicates::Sum:
+                                value += entry->second;
+                                break;
+                            case Duplicates::Last:
+                                value = entry->second;
+                                break;
+                            case Duplicates::Max:
+                                value = std::max(value, entry->second);
+                                break;
+                        }
+                    }
+                    col_idx.push_back(column);
+                    values.push_back(value);
+                }
+            }
+            row_ptr[rows] = col_idx.size();
+        }
+
+        //! Assemble all triplets in compressed row storage.
+        /*!
+         * \param duplicates combination of duplicate elements.
+         * \param row_ptr output: row pointers.
+         * \param col_idx output: column indices, sorted within every row.
+         * \param values output: values.
+         */
+        void assemble(Duplicates duplicates, std::vector<size_t>& row_ptr, std::vector<I>& col_idx,
+                      std::vector<T>& values) const
+        {
+            assemble(_triplets.data(), _triplets.data() + _triplets.size(), 0, M, duplicates, row_ptr, col_idx,
+                     values);
+        }
+
+        //! Assemble all triplets in compressed row storage, using the threads of a pool.
+        /*!
+         * The rows are split into one range per thread, with roughly equal numbers of triplets, and every thread
+         * assembles its own range:
+         *
+         *  1. every thread counts the triplets of one chunk of the input per block of rows; the blocks are then
+         *     assigned to row ranges so that the ranges are balanced;
+         *  2. every thread copies the triplets of its chunk to the parts of the row ranges, at offsets that follow from
+         *     the counts, so that no locks are needed and triplets keep their order;
+         *  3. every thread assembles one row range like the serial assembly;
+         *  4. every thread copies its row range to its place in the result.
+         *
+         * The result is identical to that of the serial assembly.
+         *
+         * \param pool threads to use.
+         * \param duplicates combination of duplicate elements.
+         * \param row_ptr output: row pointers.
+         * \param col_idx output: column indices, sorted within every row.
+         * \param values output: values.
+         */
+        void assemble(ThreadPool& pool, Duplicates duplicates, std::vector<size_t>& row_ptr, std::vector<I>& col_idx,
+                      std::vector<T>& values) const
+        {
+            const size_t parts = pool.size();
+            const size_t n = _triplets.size();
+            if (parts == 1 || M < parts)
+            {
+                assemble(duplicates, row_ptr, col_idx, values);
+                return;
+            }
+
+            // Rows are counted in blocks, which are fine enough to balance the row ranges.
+            const size_t blocks = std::min(M, 64 * parts);
+            const auto block_of = [blocks](size_t i) { return i * blocks / M; };
+            const Triplet* triplets = _triplets.data();
+            const auto chunk_begin = [n, parts](size_t chunk) { return n * chunk / parts; };
+
+            // 1. Count the triplets per chunk and block, and split the blocks into row ranges.
+            std::vector<size_t> block_counts(parts * blocks, 0);
+            pool.run(parts, [&](size_t chunk)
+            {
+                size_t* counts = block_counts.data() + chunk * blocks;
+                for (size_t k = chunk_begin(chunk); k < chunk_begin(chunk + 1); ++k)
+                {
+                    ++counts[block_of(triplets[k].row)];
+                }
+            });
+
+            std::vector<size_t> part_of_block(blocks);
+            std::vector<size_t> row_begin(parts + 1, M);
+            row_begin[0] = 0;
+            {
+                size_t part = 0;
+                size_t count = 0;
+                for (size_t b = 0; b < blocks; ++b)
+                {
+                    // Start the next range once this one holds its share of the triplets.
+                    while (part + 1 < parts && count >= n * (part + 1) / parts)
+                    {
+                        ++part;
+                        row_begin[part] = (b * M + blocks - 1) / blocks;
+                    }
+                    part_of_block[b] = part;
+                    for (size_t chunk = 0; chunk < parts; ++chunk)
+                    {
+                        count += block_counts[chunk * blocks + b];
+                    }
+                }
+            }
+
+            // 2. Copy the triplets to their row ranges. Chunk c writes its triplets of range p after those of the
+            // chunks before it, so that triplets keep the order in which they were added.
+            std::vector<size_t> offsets(parts * parts, 0);
+            for (size_t chunk = 0; chunk < parts; ++chunk)
+            {
+                for (size_t b = 0; b < blocks; ++b)
+                {
+                    offsets[chunk * parts + part_of_block[b]] += block_counts[chunk * blocks + b];
+                }
+            }
+            std::vector<size_t> part_begin(parts + 1);
+            {
+                size_t offset = 0;
+                for (size_t part = 0; part < parts; ++part)
+                {
+                    part_begin[part] = offset;
+                    for (size_t chunk = 0; chunk < parts; ++chunk)
+                    {
+                        const size_t count = offsets[chunk * parts + part];
+                        offsets[chunk * parts + part] = offset;
+                        offset += count;
+                    }
+                }
+                part_begin[parts] = offset;
+            }
+
+            std::unique_ptr<Triplet[]> partitioned(new Triplet[n]);
+            pool.run(parts, [&](size_t chunk)
+            {
+                size_t* next = offsets.data() + chunk * parts;
+                for (size_t k = chunk_begin(chunk); k < chunk_begin(chunk + 1); ++k)
+                {
+                    partitioned[next[part_of_block[block_of(triplets[k].row)]]++] = triplets[k];
+                }
+            });
+
+            // 3. Assemble every row range.
+            std::vector<std::vector<size_t>> part_row_ptr(parts);
+            std::vector<std::vector<I>> part_col_idx(parts);
+            std::vector<std::vector<T>> part_values(parts);
+            pool.run(parts, [&](size_t part)
+            {
+                assemble(partitioned.get() + part_begin[part], partitioned.get() + part_begin[part + 1],
+                         row_begin[part], row_begin[part + 1] - row_begin[part], duplicates, part_row_ptr[part],
+                         part_col_idx[part], part_values[part]);
+            });
+            partitioned.reset();
+
+            // 4. Concatenate the row ranges.
+            std::vector<size_t> value_begin(parts + 1, 0);
+            for (size_t part = 0; part < parts; ++part)
+            {
+                value_begin[part + 1] = value_begin[part] + part_col_idx[part].size();
+            }
+            row_ptr.resize(M + 1);
+            col_idx.resize(value_begin[parts]);
+            values.resize(value_begin[parts]);
+            pool.run(parts, [&](size_t part)
+            {
+                for (size_t i = row_begin[part]; i < row_begin[part + 1]; ++i)
+                {
+                    row_ptr[i] = value_begin[part] + part_row_ptr[part][i - row_begin[part]];
+                }
+                std::copy(part_col_idx[part].cbegin(), part_col_idx[part].cend(), col_idx.begin() + value_begin[part]);
+                std::copy(part_values[part].cbegin(), part_values[part].cend(), values.begin() + value_begin[part]);
+            });
+            row_ptr[M] = value_begin[parts];
+        }
+
+        //! Insert elements in compressed row storage into a map.
+        /*!
+         * The elements are inserted in row-major order, which is the order of the map, so without tree searches.
+         *
+         * \param row_ptr row pointers.
+         * \param col_idx column indices, sorted within every row.
+         * \param values values.
+         * \return the matrix in map storage.
+         */
+        template <typename Alloc>
+        static SparseMatrix<M, N, T, I, Alloc> to_map(const std::vector<size_t>& row_ptr, const std::vector<I>& col_idx,
+                                                      const std::vector<T>& values)
+        {
+            SparseMatrix<M, N, T, I, Alloc> lhs;
+            for (size_t i = 0; i < M; ++i)
+            {
+                for (size_t n = row_ptr[i]; n < row_ptr[i + 1]; ++n)
+                {
+                    lhs._values.emplace_hint(lhs._values.end(), lhs.key(i, col_idx[n]), values[n]);
+                }
+            }
+
+            return lhs;
+        }
+
+    public:
+        //! Reserve memory for a number of triplets.
+        /*!
+         * \param n expected number of triplets.
+         */
+        void reserve(size_t n)
+        {
+            _triplets.reserve(n);
+        }
+
+        //! Add an element.
+        /*!
+         * The element may be added in any order, and more than once. Throws std::out_of_range if the index exceeds the
+         * matrix dimensions.
+         *
+         * \param i row index.
+         * \param j column index.
+         * \param value value of the element.
+         */
+        void add(size_t i, size_t j, const T& value)
+        {
+            if (i >= M || j >= N)
+            {
+                throw std::out_of_range("index out of bounds");
+            }
+
+            Triplet t;
+            t.row = static_cast<I>(i);
+            t.column = static_cast<I>(j);
+            t.value = value;
+            _triplets.push_back(t);
+        }
+
+        //! Number of added triplets, including duplicates.
+        size_t size() const
+        {
+            return _triplets.size();
+        }
+
+        //! Remove all triplets.
+        void clear()
+        {
+            _triplets.clear();
+        }
+
+        //! Assemble the triplets in map storage.
+        /*!
+         * Every index that was added is allocated in the result, also if its value is zero.
+         *
+         * \param duplicates combination of elements that were added more than once.
+         * \return the matrix.
+         */
+        template <typename Alloc = std::allocator<T>>
+        SparseMatrix<M, N, T, I, Alloc> build(Duplicates duplicates = Duplicates::Sum) const
+        {
+            std::vector<size_t> row_ptr;
+            std::vector<I> col_idx;
+            std::vector<T> values;
+            assemble(duplicates, row_ptr, col_idx, values);
+            return to_map<Alloc>(row_ptr, col_idx, values);
+        }
+
+        //! Assemble the triplets in map storage, using the threads of a pool.
+        /*!
+         * The triplets are sorted and combined in parallel, as for build_csr(ThreadPool&, Duplicates). Inserting the
+         * elements into the map takes a single thread.
+         *
+         * \param pool threads to use.
+         * \param duplicates combination of elements that were added more than once.
+         * \return the matrix.
+         */
+        template <typename Alloc = std::allocator<T>>
+        SparseMatrix<M, N, T, I, Alloc> build(ThreadPool& pool, Duplicates duplicates = Duplicates::Sum) const
+        {
+            std::vector<size_t> row_ptr;
+            std::vector<I> col_idx;
+            std::vector<T> values;
+            assemble(pool, duplicates, row_ptr, col_idx, values);
+            return to_map<Alloc>(row_ptr, col_idx, values);
+        }
+
+        //! Assemble the triplets in compressed row storage.
+        /*!
+         * Every index that was added is allocated in the result, also if its value is zero.
+         *
+         * \param duplicates combination of elements that were added more than once.
+         * \return the matrix.
+         */
+        CsrMatrix<M, N, T, I> build_csr(Duplicates duplicates = Duplicates::Sum) const
+        {
+            CsrMatrix<M, N, T, I> lhs;
+            assemble(duplicates, lhs._row_ptr, lhs._col_idx, lhs._values);
+            return lhs;
+        }
+
+        //! Assemble the triplets in compressed row storage, using the threads of a pool.
+        /*!
+         * The rows are split into one range per thread with roughly equal numbers of triplets. Every thread sorts and
+         * combines the triplets of its own rows, and copies them to their place in the result; no locks are taken.
+         * The result is identical to that of build_csr(Duplicates).
+         *
+         * \param pool threads to use.
+         * \param duplicates combination of elements that were added more than once.
+         * \return the matrix.
+         */
+        CsrMatrix<M, N, T, I> build_csr(ThreadPool& pool, Duplicates duplicates = Duplicates::Sum) const
+        {
+            CsrMatrix<M, N, T, I> lhs;
+            assemble(pool, duplicates, lhs._row_ptr, lhs._col_idx, lhs._values);
+            return lhs;
+        }
+};
+
+#endif  // SPARSEMATRIXBUILDER_H
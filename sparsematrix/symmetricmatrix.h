@@ -0,0 +1,640 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#ifndef SYMMETRICMATRIX_H
+#define SYMMETRICMATRIX_H
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "csrmatrix.h"
+#include "sparsematrix.h"
+#include "threadpool.h"
+
+
+//! Algorithms shared by the matrix classes.
+namespace sparsematrix_detail
+{
+
+//! Sparse matrix-vector product for a symmetric matrix of which the upper triangle is stored in CSR format.
+/*!
+ * Adds alpha * A(i,:) * x to y(i) for the rows i in [first, last) of the upper triangle U of a symmetric matrix
+ * A = U + U^T - diag(U), and alpha * U(i,j) * x(i) to y(j) for the elements above the diagonal in those rows. Every
+ * stored element is read once and applied twice. The column indices of a row are sorted, so a diagonal element can
+ * only be the first element of its row and the inner loop has no branch.
+ *
+ * The rows that are updated through U^T are all rows from first on, so y points to the element for row first and has
+ * rows - first elements.
+ *
+ * \param first first row to compute.
+ * \param last one past the last row to compute.
+ * \param row_ptr row pointers of U.
+ * \param col_idx column indices of U.
+ * \param values values of U.
+ * \param alpha scaling factor for A * x.
+ * \param x input vector.
+ * \param y output vector, starting at row first.
+ */
+template <typename T, typename I>
+void sym_spmv(size_t first, size_t last, const size_t* row_ptr, const I* col_idx, const T* values, const T alpha,
+              const T* x, T* y)
+{
+    for (size_t i = first; i < last; ++i)
+    {
+        size_t n = row_ptr[i];
+        const size_t end = row_ptr[i + 1];
+        const T xi = alpha * x[i];
+        T sum = T(0);
+        if (n < end && col_idx[n] == i)
+        {
+            sum = values[n] * x[i];
+            ++n;
+        }
+        for (; n < end; ++n)
+        {
+            const size_t j = col_idx[n];
+            sum += values[n] * x[j];
+            y[j - first] += values[n] * xi;
+        }
+        y[i - first] += alpha * sum;
+    }
+}
+
+}  // namespace sparsematrix_detail
+
+
+//! Representation of a symmetric sparse matrix with N rows and N columns, of type T
+/*!
+ * This class represents a symmetric sparse matrix by its upper triangle (the elements (i,j) with i <= j) in Compressed
+ * Sparse Row format. Reading an element below the diagonal reads its mirror image above it, so the class behaves as
+ * the full matrix while storing about half the elements. A matrix-vector product reads every stored element once and
+ * applies it to both its own row and, mirrored, to the row of its column, which halves the memory traffic compared to
+ * a CsrMatrix with both triangles.
+ *
+ * Like CsrMatrix, the storage is read-only: build a SparseMatrix or CsrMatrix and convert it. Only the upper triangle
+ * of the source is read, so the elements below the diagonal do not need to be stored there either.
+ */
+template <size_t N, typename T, typename I = size_t>
+class SymmetricMatrix
+{
+    static_assert(std::is_integral<I>::value && std::is_unsigned<I>::value, "index type must be unsigned integer");
+    static_assert(sparsematrix_detail::index_fits<I>(N), "matrix dimensions exceed index type");
+
+    private:
+        //! Upper triangle of the matrix, including the diagonal.
+        CsrMatrix<N, N, T, I> _upper;
+
+    public:
+        //! Default constructor.
+        SymmetricMatrix() = default;
+
+        //! Conversion from compressed row storage.
+        /*!
+         * Create an instance from the upper triangle of a CsrMatrix. Elements below the diagonal are ignored, so
+         * the result only equals other if other is symmetric.
+         *
+         * \param other matrix to be converted.
+         */
+        explicit SymmetricMatrix(const CsrMatrix<N, N, T, I>& other)
+        {
+            const std::vector<size_t>& row_ptr = other.row_ptr();
+            const std::vector<I>& col_idx = other.col_idx();
+            std::vector<size_t> upper_row_ptr(N + 1, 0);
+            std::vector<I> upper_col_idx;
+            std::vector<T> upper_values;
+            for (size_t i = 0; i < N; ++i)
+            {
+                // Columns are sorted, so the upper triangle is the tail of the row.
+                const auto row_begin = col_idx.cbegin() + row_ptr[i];
+                const auto row_end = col_idx.cbegin() + row_ptr[i + 1];
+                const auto pos = std::lower_bound(row_begin, row_end, i);
+                upper_col_idx.insert(upper_col_idx.end(), pos, row_end);
+                upper_values.insert(upper_values.end(), other.values().cbegin() + (pos - col_idx.cbegin()),
+                                    other.values().cbegin() + row_ptr[i + 1]);
+                upper_row_ptr[i + 1] = upper_col_idx.size();
+            }
+            _upper = CsrMatrix<N, N, T, I>(std::move(upper_row_ptr), std::move(upper_col_idx), std::move(upper_values));
+        }
+
+        //! Conversion from map storage.
+        /*!
+         * Create an instance from the upper triangle of a SparseMatrix. Elements below the diagonal are ignored.
+         *
+         * \param other matrix to be converted.
+         */
+        template <typename Alloc>
+        explicit SymmetricMatrix(const SparseMatrix<N, N, T, I, Alloc>& other)
+        {
+            std::vector<size_t> upper_row_ptr(N + 1, 0);
+            std::vector<I> upper_col_idx;
+            std::vector<T> upper_values;
+            for (auto elem = other.cbegin(); elem != other.cend(); ++elem)
+            {
+                const size_t i = elem->first.first;
+                const size_t j = elem->first.second;
+                if (i <= j)
+                {
+                    // The map is visited in row-major order, so rows are filled in order.
+                    upper_col_idx.push_back(static_cast<I>(j));
+                    upper_values.push_back(elem->second);
+                    ++upper_row_ptr[i + 1];
+                }
+            }
+            for (size_t i = 0; i < N; ++i)
+            {
+                upper_row_ptr[i + 1] += upper_row_ptr[i];
+            }
+            _upper = CsrMatrix<N, N, T, I>(std::move(upper_row_ptr), std::move(upper_col_idx), std::move(upper_values));
+        }
+
+        //! Conversion to compressed row storage.
+        /*!
+         * Create a CsrMatrix with both triangles of the matrix. The upper triangle is merged with its transpose row by
+         * row: the mirrored elements of row i come from the rows above it and precede the stored elements of row i.
+         *
+         * \return the full matrix in CSR format.
+         */
+        CsrMatrix<N, N, T, I> to_csr() const
+        {
+            const std::vector<size_t>& row_ptr = _upper.row_ptr();
+            const std::vector<I>& col_idx = _upper.col_idx();
+            const std::vector<T>& values = _upper.values();
+
+            // Count the elements in every row of the full matrix and turn the counts into offsets.
+            std::vector<size_t> full_row_ptr(N + 1, 0);
+            for (size_t i = 0; i < N; ++i)
+            {
+                for (size_t n = row_ptr[i]; n < row_ptr[i + 1]; ++n)
+                {
+                    ++full_row_ptr[i + 1];
+                    if (col_idx[n] != i)
+                    {
+                        ++full_row_ptr[col_idx[n] + 1];
+                    }
+                }
+            }
+            for (size_t i = 0; i < N; ++i)
+            {
+                full_row_ptr[i + 1] += full_row_ptr[i];
+            }
+
+            // Rows are visited in order, so the mirrored elements of every row are placed in column order, and all of
+            // them are placed before row i itself is copied behind them.
+            std::vector<I> full_col_idx(full_row_ptr[N]);
+            std::vector<T> full_values(full_row_ptr[N]);
+            std::vector<size_t> next(full_row_ptr.cbegin(), full_row_ptr.cend() - 1);
+            for (size_t i = 0; i < N; ++i)
+            {
+                for (size_t n = row_ptr[i]; n < row_ptr[i + 1]; ++n)
+                {
+                    const size_t pos = next[i]++;
+                    full_col_idx[pos] = col_idx[n];
+                    full_values[pos] = values[n];
+                    if (col_idx[n] != i)
+                    {
+                        const size_t mirror = next[col_idx[n]]++;
+                        full_col_idx[mirror] = static_cast<I>(i);
+                        full_values[mirror] = values[n];
+                    }
+                }
+            }
+
+            return CsrMatrix<N, N, T, I>(std::move(full_row_ptr), std::move(full_col_idx), std::move(full_values));
+        }
+
+        //! Conversion to map storage.
+        /*!
+         * Create a SparseMatrix with both triangles of the matrix.
+         *
+         * \return the full matrix in map storage.
+         */
+        SparseMatrix<N, N, T, I> to_sparse() const
+        {
+            return to_csr().to_sparse();
+        }
+
+        //! Upper triangle.
+        /*!
+         * The stored part of the matrix: the elements on and above the diagonal, in CSR format.
+         *
+         * \return the upper triangle.
+         */
+        const CsrMatrix<N, N, T, I>& upper() const
+        {
+            return _upper;
+        }
+
+        //! Read an element at index (i,j).
+        /*!
+         * Read an individual element at row i and column j. Elements below the diagonal are read from their mirror
+         * image (j,i). The storage is read-only, so a copy of the value is returned.
+         * Throws std::out_of_range if either i or j exceeds the matrix dimension.
+         *
+         * \sa peek()
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return the value of the element at (i,j).
+         */
+        T operator()(size_t i, size_t j) const
+        {
+            return i <= j ? _upper(i, j) : _upper(j, i);
+        }
+
+        //! Size of the matrix.
+        /*!
+         * Gives the size of the matrix as the number of elements. By definition, this is equal to N x N.
+         *
+         * \sa allocated()
+         *
+         * \return the matrix size.
+         */
+        size_t size() const
+        {
+            return N * N;
+        }
+
+        //! Number of allocated elements.
+        /*!
+         * Get the number of stored elements: the allocated elements on and above the diagonal. An element below the
+         * diagonal is not counted, even though peek() reports it through its mirror image.
+         *
+         * \sa size()
+         *
+         * \return the number of allocated elements.
+         */
+        size_t allocated() const
+        {
+            return _upper.allocated();
+        }
+
+        //! Memory footprint.
+        /*!
+         * Get the memory used by the matrix: the size of this object plus the capacity of the storage arrays of the
+         * upper triangle. The overhead of the memory allocator is not included.
+         *
+         * \sa allocated()
+         *
+         * \return the memory footprint in bytes.
+         */
+        size_t memory_bytes() const
+        {
+            return sizeof(*this) - sizeof(_upper) + _upper.memory_bytes();
+        }
+
+        //! Peek if an element is allocated.
+        /*!
+         * Check if the element, or its mirror image for an element below the diagonal, is allocated.
+         * Throws std::out_of_range if either i or j exceeds the matrix dimension.
+         *
+         * \param i row index.
+         * \param j column index.
+         * \return Boolean value indicating if the element is allocated.
+         */
+        bool peek(size_t i, size_t j) const
+        {
+            return i <= j ? _upper.peek(i, j) : _upper.peek(j, i);
+        }
+
+        //! Check for equality.
+        /*!
+         * Check for equality by comparing the internal storage. This is a strict comparison that also considers
+         * allocated elements with a value of zero.
+         *
+         * \param rhs right-hand side of the equality test.
+         * \return Boolean value indicating equality.
+         */
+        bool operator==(const SymmetricMatrix& rhs) const
+        {
+            return _upper == rhs._upper;
+        }
+
+        //! Check for inequality.
+        /*!
+         * Check for inequality by comparing the internal storage.
+         *
+         * \param rhs right-hand side of the inequality test.
+         * \return Boolean value indicating inequality.
+         */
+        bool operator!=(const SymmetricMatrix& rhs) const
+        {
+            return !(*this == rhs);
+        }
+
+        //! Addition.
+        /*!
+         * Implements A += B. The sum of two symmetric matrices is symmetric, so only the upper triangles are added.
+         *
+         * \param rhs Matrix to add.
+         * \return A += B.
+         */
+        SymmetricMatrix& operator+=(const SymmetricMatrix& rhs)
+        {
+            _upper += rhs._upper;
+            return *this;
+        }
+
+        //! Addition.
+        /*!
+         * Implements A + B, with A and B of same size and type (checked at compile time).
+         *
+         * \param op1 First operand.
+         * \param op2 Second operand.
+         * \return A + B.
+         */
+        friend SymmetricMatrix operator+(const SymmetricMatrix& op1, const SymmetricMatrix& op2)
+        {
+            SymmetricMatrix lhs = op1;
+            lhs += op2;
+            return lhs;
+        }
+
+        //! Unitary plus.
+        /*!
+         * Returns the same matrix unaltered.
+         *
+         * \param rhs Any matrix A.
+         * \return A.
+         */
+        friend const SymmetricMatrix& operator+(const SymmetricMatrix& rhs)
+        {
+            return rhs;
+        }
+
+        //! Subtraction.
+        /*!
+         * Implements A -= B. Only the upper triangles are subtracted.
+         *
+         * \param rhs Matrix to subtract.
+         * \return A -= B.
+         */
+        SymmetricMatrix& operator-=(const SymmetricMatrix& rhs)
+        {
+            _upper -= rhs._upper;
+            return *this;
+        }
+
+        //! Subtraction.
+        /*!
+         * Implements A - B, with A and B of same size and type (checked at compile time).
+         *
+         * \param op1 First operand.
+         * \param op2 Second operand.
+         * \return A - B.
+         */
+        friend SymmetricMatrix operator-(const SymmetricMatrix& op1, const SymmetricMatrix& op2)
+        {
+            SymmetricMatrix lhs = op1;
+            lhs -= op2;
+            return lhs;
+        }
+
+        //! Unitary minus.
+        /*!
+         * Returns a copy of the input matrix with every element negated.
+         *
+         * \param rhs Any matrix A.
+         * \return -A.
+         */
+        friend SymmetricMatrix operator-(const SymmetricMatrix& rhs)
+        {
+            SymmetricMatrix lhs;
+            lhs._upper = -rhs._upper;
+            return lhs;
+        }
+
+        //! Scaling.
+        /*!
+         * Returns a copy of the input matrix with every element scaled.
+         *
+         * \param s Scaling factor.
+         * \param op2 Any matrix A.
+         * \return s x A.
+         */
+        friend SymmetricMatrix operator*(const T s, const SymmetricMatrix& op2)
+        {
+            SymmetricMatrix lhs;
+            lhs._upper = s * op2._upper;
+            return lhs;
+        }
+
+        //! Scaling.
+        /*!
+         * Returns a copy of the input matrix with every element scaled.
+         *
+         * \param op1 Any matrix A.
+         * \param s Scaling factor.
+         * \return A x s.
+         */
+        friend SymmetricMatrix operator*(const SymmetricMatrix& op1, const T s)
+        {
+            return s * op1;
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y for dense vectors x and y of N elements. y is scaled by beta first,
+         * after which every stored element is applied to both its row and its mirrored row in a single pass.
+         * If beta is zero, y is not read, so it does not need to be initialized. x and y must not overlap. No memory
+         * is allocated.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector (N elements).
+         * \param beta scaling factor for y.
+         * \param y output vector (N elements).
+         */
+        void multiply(const T alpha, const T* x, const T beta, T* y) const
+        {
+            if (beta == T(0))
+            {
+                std::fill(y, y + N, T(0));
+            }
+            else if (beta != T(1))
+            {
+                std::transform(y, y + N, y, [beta](const T v) { return beta * v; });
+            }
+            sparsematrix_detail::sym_spmv(0, N, _upper.row_ptr().data(), _upper.col_idx().data(),
+                                          _upper.values().data(), alpha, x, y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x for dense vectors x and y of N elements.
+         *
+         * \param x input vector (N elements).
+         * \param y output vector (N elements).
+         */
+        void multiply(const T* x, T* y) const
+        {
+            multiply(T(1), x, T(0), y);
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y, with sizes of x and y checked at compile time.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(const T alpha, const std::array<T, N>& x, const T beta, std::array<T, N>& y) const
+        {
+            multiply(alpha, x.data(), beta, y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x, with sizes of x and y checked at compile time.
+         *
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(const std::array<T, N>& x, std::array<T, N>& y) const
+        {
+            multiply(T(1), x.data(), T(0), y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y. The vectors are not resized.
+         * Throws std::out_of_range if x or y does not have N elements.
+         *
+         * \param alpha scaling factor for A * x.
+         * \param x input vector.
+         * \param beta scaling factor for y.
+         * \param y output vector.
+         */
+        void multiply(const T alpha, const std::vector<T>& x, const T beta, std::vector<T>& y) const
+        {
+            if (x.size() != N || y.size() != N)
+            {
+                throw std::out_of_range("vector size mismatch");
+            }
+
+            multiply(alpha, x.data(), beta, y.data());
+        }
+
+        //! Matrix-vector product.
+        /*!
+         * Computes y = A * x. The vectors are not resized.
+         * Throws std::out_of_range if x or y does not have N elements.
+         *
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(const std::vector<T>& x, std::vector<T>& y) const
+        {
+            multiply(T(1), x, T(0), y);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = alpha * A * x + beta * y like multiply(alpha, x, beta, y), using the threads of a pool. The rows
+         * are split into one part per thread, with roughly equal numbers of stored elements. The mirrored elements of
+         * a part update rows of later parts, so every part accumulates into a buffer for its own first row up to the
+         * last row, and the buffers are summed into y afterwards. The buffers take at most N elements per thread and
+         * are allocated for every call.
+         *
+         * \param pool threads to use.
+         * \param alpha scaling factor for A * x.
+         * \param x input vector (N elements).
+         * \param beta scaling factor for y.
+         * \param y output vector (N elements).
+         */
+        void multiply(ThreadPool& pool, const T alpha, const T* x, const T beta, T* y) const
+        {
+            const size_t parts = pool.size();
+            const size_t* row_ptr = _upper.row_ptr().data();
+            const I* col_idx = _upper.col_idx().data();
+            const T* values = _upper.values().data();
+
+            // Part p covers rows [first[p], first[p + 1]) and its buffer holds rows [first[p], N).
+            std::vector<size_t> first(parts + 1);
+            std::vector<size_t> offset(parts + 1, 0);
+            for (size_t part = 0; part <= parts; ++part)
+            {
+                first[part] = sparsematrix_detail::csr_partition(row_ptr, N, part, parts);
+            }
+            for (size_t part = 0; part < parts; ++part)
+            {
+                offset[part + 1] = offset[part] + N - first[part];
+            }
+            std::vector<T> buffers(offset[parts]);
+
+            const size_t* f = first.data();
+            const size_t* o = offset.data();
+            T* b = buffers.data();
+            pool.run(parts, [=](size_t part)
+            {
+                sparsematrix_detail::sym_spmv(f[part], f[part + 1], row_ptr, col_idx, values, T(1), x, b + o[part]);
+            });
+
+            // Sum the buffers that cover every row, with the rows split the same way.
+            pool.run(parts, [=](size_t part)
+            {
+                for (size_t i = f[part]; i < f[part + 1]; ++i)
+                {
+                    T sum = T(0);
+                    for (size_t p = 0; p <= part; ++p)
+                    {
+                        sum += b[o[p] + i - f[p]];
+                    }
+                    y[i] = (beta == T(0)) ? alpha * sum : alpha * sum + beta * y[i];
+                }
+            });
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = A * x like multiply(x, y), using the threads of a pool.
+         *
+         * \param pool threads to use.
+         * \param x input vector (N elements).
+         * \param y output vector (N elements).
+         */
+        void multiply(ThreadPool& pool, const T* x, T* y) const
+        {
+            multiply(pool, T(1), x, T(0), y);
+        }
+
+        //! Parallel matrix-vector product.
+        /*!
+         * Computes y = A * x, using the threads of a pool. The vectors are not resized.
+         * Throws std::out_of_range if x or y does not have N elements.
+         *
+         * \param pool threads to use.
+         * \param x input vector.
+         * \param y output vector.
+         */
+        void multiply(ThreadPool& pool, const std::vector<T>& x, std::vector<T>& y) const
+        {
+            if (x.size() != N || y.size() != N)
+            {
+                throw std::out_of_range("vector size mismatch");
+            }
+
+            multiply(pool, T(1), x.data(), T(0), y.data());
+        }
+};
+
+#endif  // SYMMETRICMATRIX_H
@@ -0,0 +1,223 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+//! A fixed set of worker threads that execute batches of tasks
+/*!
+ * This class keeps a number of threads alive, so that they can be reused for many parallel operations without the
+ * cost of starting threads every time. Work is submitted as a batch of tasks numbered 0, 1, ..., n - 1 with run(),
+ * which blocks until all tasks have completed. The calling thread participates in the work, so a pool of size P uses
+ * P - 1 worker threads. Submitting work does not allocate memory.
+ */
+class ThreadPool
+{
+    private:
+        //! Worker threads.
+        std::vector<std::thread> _workers;
+
+        //! Protects the batch state below.
+        std::mutex _mutex;
+
+        //! Signals the workers that a new batch is available (or that the pool stops).
+        std::condition_variable _start;
+
+        //! Signals the calling thread that all workers finished the batch.
+        std::condition_variable _done;
+
+        //! Serializes calls to run().
+        std::mutex _run_mutex;
+
+        //! Type-erased task of the current batch.
+        void (*_invoke)(const void*, size_t) = nullptr;
+
+        //! Callable object of the current batch.
+        const void* _task = nullptr;
+
+        //! Number of tasks in the current batch.
+        size_t _tasks = 0;
+
+        //! Next task to be picked up.
+        std::atomic<size_t> _next;
+
+        //! Number of workers that have not yet finished the current batch.
+        size_t _active = 0;
+
+        //! Batch counter, used by the workers to detect a new batch.
+        size_t _generation = 0;
+
+        //! Set when the pool is destroyed.
+        bool _stop = false;
+
+        //! First exception thrown by a task of the current batch.
+        std::exception_ptr _error;
+
+        //! Calls a callable object of type Task with a task number.
+        template <typename Task>
+        static void invoke(const void* task, size_t n)
+        {
+            (*static_cast<const Task*>(task))(n);
+        }
+
+        //! Pick up and execute tasks of the current batch until there are none left.
+        void work()
+        {
+            for (size_t n = _next++; n < _tasks; n = _next++)
+            {
+                try
+                {
+                    _invoke(_task, n);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    if (!_error)
+                    {
+                        _error = std::current_exception();
+                    }
+                }
+            }
+        }
+
+        //! Main loop of a worker thread.
+        void worker()
+        {
+            size_t seen = 0;
+            for (;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _start.wait(lock, [this, seen]() { return _stop || _generation != seen; });
+                    if (_stop)
+                    {
+                        return;
+                    }
+                    seen = _generation;
+                }
+
+                work();
+
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (--_active == 0)
+                {
+                    _done.notify_one();
+                }
+            }
+        }
+
+    public:
+        //! Constructor.
+        /*!
+         * Create a pool that executes tasks on the given number of threads, including the thread calling run().
+         *
+         * \param threads number of threads; defaults to the number of hardware threads.
+         */
+        explicit ThreadPool(size_t threads = std::thread::hardware_concurrency()) : _next(0)
+        {
+            for (size_t n = 1; n < threads; ++n)
+            {
+                _workers.emplace_back(&ThreadPool::worker, this);
+            }
+        }
+
+        //! The pool cannot be copied.
+        ThreadPool(const ThreadPool& other) = delete;
+
+        //! The pool cannot be copied.
+        ThreadPool& operator=(const ThreadPool& other) = delete;
+
+        //! Destructor; stops and joins all worker threads.
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _start.notify_all();
+            for (auto& thread : _workers)
+            {
+                thread.join();
+            }
+        }
+
+        //! Number of threads, including the thread calling run().
+        size_t size() const
+        {
+            return _workers.size() + 1;
+        }
+
+        //! Execute a batch of tasks.
+        /*!
+         * Calls task(n) for n = 0, 1, ..., tasks - 1, distributed over the threads of the pool, and returns when all
+         * calls have completed. Tasks are picked up in order, but may run concurrently and complete in any order.
+         * If a task throws, the remaining tasks are still executed and the first exception is rethrown afterwards.
+         *
+         * \param tasks number of tasks.
+         * \param task callable object that takes the task number.
+         */
+        template <typename Task>
+        void run(size_t tasks, const Task& task)
+        {
+            if (tasks == 0)
+            {
+                return;
+            }
+
+            std::lock_guard<std::mutex> serial(_run_mutex);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _invoke = &ThreadPool::invoke<Task>;
+                _task = &task;
+                _tasks = tasks;
+                _next = 0;
+                _active = _workers.size();
+                _error = nullptr;
+                ++_generation;
+            }
+            _start.notify_all();
+
+            work();
+
+            std::exception_ptr error;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _done.wait(lock, [this]() { return _active == 0; });
+                error = _error;
+                _error = nullptr;
+            }
+
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+};
+
+#endif  // THREADPOOL_H
@@ -0,0 +1,432 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#ifndef TRIANGULARSOLVE_H
+#define TRIANGULARSOLVE_H
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "csrmatrix.h"
+#include "threadpool.h"
+
+
+//! Triangle of a square matrix that is used by a triangular solve.
+enum class Triangle
+{
+    //! Elements on and below the diagonal (forward substitution).
+    Lower,
+
+    //! Elements on and above the diagonal (backward substitution).
+    Upper
+};
+
+
+//! Algorithms shared by the matrix classes.
+namespace sparsematrix_detail
+{
+
+//! Smallest number of rows per thread for which a level of a schedule is solved in parallel.
+static const size_t trisolve_min_rows = 256;
+
+//! Solve a single row of a triangular system.
+/*!
+ * Computes x(i) = (b(i) - sum of A(i,j) * x(j)) / A(i,i) over the elements A(i,j) of the triangle that are not on the
+ * diagonal. The columns of a row are sorted, so these are the elements before the diagonal element for a lower
+ * triangle and the elements after it for an upper triangle.
+ *
+ * \param i row to solve.
+ * \param row_ptr row pointers of A.
+ * \param diag position of the diagonal element of every row in col_idx and values.
+ * \param col_idx column indices of A.
+ * \param values values of A.
+ * \param triangle triangle of A to use.
+ * \param b right-hand side.
+ * \param x solution; the elements that row i depends on must have been solved.
+ */
+template <typename T, typename I>
+inline void trisolve_row(size_t i, const size_t* row_ptr, const size_t* diag, const I* col_idx, const T* values,
+                         Triangle triangle, const T* b, T* x)
+{
+    const size_t first = triangle == Triangle::Lower ? row_ptr[i] : diag[i] + 1;
+    const size_t last = triangle == Triangle::Lower ? diag[i] : row_ptr[i + 1];
+    T sum = b[i];
+    for (size_t n = first; n < last; ++n)
+    {
+        sum -= values[n] * x[col_idx[n]];
+    }
+    x[i] = sum / values[diag[i]];
+}
+
+}  // namespace sparsematrix_detail
+
+
+//! Level schedule of a sparse triangular system with N rows
+/*!
+ * A triangular solve has to compute the rows in order, as every row depends on the solution of the rows it has
+ * elements in. This class analyses these dependencies once for a sparsity pattern, so that many solves can reuse the
+ * result, also when the values of the matrix change but the pattern does not.
+ *
+ * The rows are grouped into levels. A row is in level 0 if it depends on no other row, and otherwise in the level after
+ * the highest level of the rows it depends on. The rows of a level only depend on rows of earlier levels, so they can
+ * be solved in any order and in parallel. The number of rows per level is the parallelism of the system: a diagonal
+ * matrix is a single level, a bidiagonal matrix has N levels of one row.
+ *
+ * The schedule also holds the position of every diagonal element, so solves do not need to search for it.
+ */
+template <size_t N>
+class LevelSchedule
+{
+    private:
+        //! Triangle of the matrix the schedule was made for.
+        Triangle _triangle;
+
+        //! Number of allocated elements of the matrix the schedule was made for.
+        size_t _allocated;
+
+        //! Position of the diagonal element of every row.
+        std::vector<size_t> _diag;
+
+        //! Level pointers; level l holds the rows _rows[_level_ptr[l]] to _rows[_level_ptr[l + 1] - 1].
+        std::vector<size_t> _level_ptr;
+
+        //! Rows ordered by level, and by row index within every level.
+        std::vector<size_t> _rows;
+
+    public:
+        //! Analyse a triangular matrix.
+        /*!
+         * Create the schedule for the given triangle of a square matrix in CSR format. Elements of the other triangle
+         * are ignored, so the same matrix can be analysed for both triangles. This takes time proportional to the
+         * number of allocated elements.
+         * Throws std::runtime_error if a row has no allocated diagonal element.
+         *
+         * \param a matrix to analyse.
+         * \param triangle triangle of a to use.
+         */
+        template <typename T, typename I>
+        LevelSchedule(const CsrMatrix<N, N, T, I>& a, Triangle triangle) :
+            _triangle(triangle), _allocated(a.allocated()), _diag(N), _rows(N)
+        {
+            const std::vector<size_t>& row_ptr = a.row_ptr();
+            const std::vector<I>& col_idx = a.col_idx();
+
+            for (size_t i = 0; i < N; ++i)
+            {
+                const auto row_begin = col_idx.cbegin() + row_ptr[i];
+                const auto row_end = col_idx.cbegin() + row_ptr[i + 1];
+                const auto pos = std::lower_bound(row_begin, row_end, i);
+                if (pos == row_end || *pos != i)
+                {
+                    throw std::runtime_error("missing diagonal element");
+                }
+                _diag[i] = pos - col_idx.cbegin();
+            }
+
+            // Rows are visited in the order of the substitution, so the levels of their dependencies are known.
+            std::vector<size_t> level(N);
+            size_t levels = 0;
+            for (size_t k = 0; k < N; ++k)
+            {
+                const size_t i = triangle == Triangle::Lower ? k : N - 1 - k;
+                const size_t first = triangle == Triangle::Lower ? row_ptr[i] : _diag[i] + 1;
+                const size_t last = triangle == Triangle::Lower ? _diag[i] : row_ptr[i + 1];
+                size_t l = 0;
+                for (size_t n = first; n < last; ++n)
+                {
+                    l = std::max(l, level[col_idx[n]] + 1);
+                }
+                level[i] = l;
+                levels = std::max(levels, l + 1);
+            }
+
+            // Counting sort of the rows by level.
+            _level_ptr.assign(levels + 1, 0);
+            for (size_t i = 0; i < N; ++i)
+            {
+                ++_level_ptr[level[i] + 1];
+            }
+            for (size_t l = 0; l < levels; ++l)
+            {
+                _level_ptr[l + 1] += _level_ptr[l];
+            }
+            std::vector<size_t> next(_level_ptr.cbegin(), _level_ptr.cend() - 1);
+            for (size_t i = 0; i < N; ++i)
+            {
+                _rows[next[level[i]]++] = i;
+            }
+        }
+
+        //! Triangle of the matrix the schedule was made for.
+        Triangle triangle() const
+        {
+            return _triangle;
+        }
+
+        //! Number of allocated elements of the matrix the schedule was made for.
+        size_t allocated() const
+        {
+            return _allocated;
+        }
+
+        //! Number of levels.
+        size_t levels() const
+        {
+            return _level_ptr.size() - 1;
+        }
+
+        //! Level pointers; level l holds the rows rows()[level_ptr()[l]] to rows()[level_ptr()[l + 1] - 1].
+        const std::vector<size_t>& level_ptr() const
+        {
+            return _level_ptr;
+        }
+
+        //! Rows ordered by level, and by row index within every level.
+        const std::vector<size_t>& rows() const
+        {
+            return _rows;
+        }
+
+        //! Position of the diagonal element of every row in the column indices and values of the matrix.
+        const std::vector<size_t>& diag() const
+        {
+            return _diag;
+        }
+
+        //! Average number of rows per level, which bounds the speedup of a parallel solve.
+        double parallelism() const
+        {
+            return levels() == 0 ? 0.0 : static_cast<double>(N) / levels();
+        }
+};
+
+
+//! Triangular solve.
+/*!
+ * Solves A * x = b for x, where A is the given triangle of a square matrix in CSR format, by forward (lower triangle)
+ * or backward (upper triangle) substitution. Elements of the other triangle are ignored. b and x may be the same
+ * vector, to solve in place. A zero on the diagonal gives infinite or undefined results.
+ * Throws std::runtime_error if a row has no allocated diagonal element.
+ *
+ * \param a matrix A.
+ * \param triangle triangle of A to use.
+ * \param b right-hand side (N elements).
+ * \param x solution (N elements).
+ */
+template <size_t N, typename T, typename I>
+void triangular_solve(const CsrMatrix<N, N, T, I>& a, Triangle triangle, const T* b, T* x)
+{
+    const size_t* row_ptr = a.row_ptr().data();
+    const I* col_idx = a.col_idx().data();
+    const T* values = a.values().data();
+
+    for (size_t k = 0; k < N; ++k)
+    {
+        const size_t i = triangle == Triangle::Lower ? k : N - 1 - k;
+
+        // Columns are sorted, so the triangle is walked from the outer end of the row up to the diagonal element;
+        // first and last delimit the elements that are not visited.
+        size_t first = row_ptr[i];
+        size_t last = row_ptr[i + 1];
+        T sum = b[i];
+        if (triangle == Triangle::Lower)
+        {
+            for (; first < last && col_idx[first] < i; ++first)
+            {
+                sum -= values[first] * x[col_idx[first]];
+            }
+        }
+        else
+        {
+            for (; last > first && col_idx[last - 1] > i; --last)
+            {
+                sum -= values[last - 1] * x[col_idx[last - 1]];
+            }
+        }
+
+        const size_t n = triangle == Triangle::Lower ? first : last - 1;
+        if (first == last || col_idx[n] != i)
+        {
+            throw std::runtime_error("missing diagonal element");
+        }
+        x[i] = sum / values[n];
+    }
+}
+
+//! Triangular solve.
+/*!
+ * Solves A * x = b for x like triangular_solve(a, triangle, b, x). The vectors are not resized.
+ * Throws std::out_of_range if b or x does not have N elements, and std::runtime_error if a row has no allocated
+ * diagonal element.
+ *
+ * \param a matrix A.
+ * \param triangle triangle of A to use.
+ * \param b right-hand side.
+ * \param x solution.
+ */
+template <size_t N, typename T, typename I>
+void triangular_solve(const CsrMatrix<N, N, T, I>& a, Triangle triangle, const std::vector<T>& b, std::vector<T>& x)
+{
+    if (b.size() != N || x.size() != N)
+    {
+        throw std::out_of_range("vector size mismatch");
+    }
+
+    triangular_solve(a, triangle, b.data(), x.data());
+}
+
+//! Triangular solve with a level schedule.
+/*!
+ * Solves A * x = b for x like triangular_solve(a, triangle, b, x), for the triangle and sparsity pattern of a schedule.
+ * The rows are solved in order, using the diagonal positions of the schedule.
+ * Throws std::out_of_range if the number of allocated elements of A differs from that of the analysed matrix. Other
+ * changes to the sparsity pattern are not detected.
+ *
+ * \param a matrix A.
+ * \param schedule schedule made for the sparsity pattern of A.
+ * \param b right-hand side (N elements).
+ * \param x solution (N elements).
+ */
+template <size_t N, typename T, typename I>
+void triangular_solve(const CsrMatrix<N, N, T, I>& a, const LevelSchedule<N>& schedule, const T* b, T* x)
+{
+    if (a.allocated() != schedule.allocated())
+    {
+        throw std::out_of_range("sparsity pattern mismatch");
+    }
+
+    const size_t* row_ptr = a.row_ptr().data();
+    const size_t* diag = schedule.diag().data();
+    const I* col_idx = a.col_idx().data();
+    const T* values = a.values().data();
+    const Triangle triangle = schedule.triangle();
+    for (size_t k = 0; k < N; ++k)
+    {
+        const size_t i = triangle == Triangle::Lower ? k : N - 1 - k;
+        sparsematrix_detail::trisolve_row(i, row_ptr, diag, col_idx, values, triangle, b, x);
+    }
+}
+
+//! Parallel triangular solve.
+/*!
+ * Solves A * x = b for x like triangular_solve(a, schedule, b, x), using the threads of a pool. The levels of the
+ * schedule are solved one after the other; the rows of a level are split into equal parts, one per thread. Levels
+ * with fewer than sparsematrix_detail::trisolve_min_rows rows per thread use fewer threads, down to solving the level
+ * on the calling thread, as waiting for the threads would take longer than the rows. No memory is allocated.
+ * Throws std::out_of_range if the number of allocated elements of A differs from that of the analysed matrix.
+ *
+ * \param pool threads to use.
+ * \param a matrix A.
+ * \param schedule schedule made for the sparsity pattern of A.
+ * \param b right-hand side (N elements).
+ * \param x solution (N elements).
+ */
+template <size_t N, typename T, typename I>
+void triangular_solve(ThreadPool& pool, const CsrMatrix<N, N, T, I>& a, const LevelSchedule<N>& schedule, const T* b,
+                      T* x)
+{
+    if (pool.size() == 1)
+    {
+        // Rows in their natural order access the matrix and the vectors with better locality than levels.
+        triangular_solve(a, schedule, b, x);
+        return;
+    }
+    if (a.allocated() != schedule.allocated())
+    {
+        throw std::out_of_range("sparsity pattern mismatch");
+    }
+
+    const size_t* row_ptr = a.row_ptr().data();
+    const size_t* diag = schedule.diag().data();
+    const I* col_idx = a.col_idx().data();
+    const T* values = a.values().data();
+    const Triangle triangle = schedule.triangle();
+    const std::vector<size_t>& level_ptr = schedule.level_ptr();
+    for (size_t l = 0; l < schedule.levels(); ++l)
+    {
+        const size_t* rows = schedule.rows().data() + level_ptr[l];
+        const size_t count = level_ptr[l + 1] - level_ptr[l];
+        const size_t parts = std::min(pool.size(), count / sparsematrix_detail::trisolve_min_rows);
+        if (parts <= 1)
+        {
+            for (size_t k = 0; k < count; ++k)
+            {
+                sparsematrix_detail::trisolve_row(rows[k], row_ptr, diag, col_idx, values, triangle, b, x);
+            }
+            continue;
+        }
+
+        pool.run(parts, [=](size_t part)
+        {
+            for (size_t k = count * part / parts; k < count * (part + 1) / parts; ++k)
+            {
+                sparsematrix_detail::trisolve_row(rows[k], row_ptr, diag, col_idx, values, triangle, b, x);
+            }
+        });
+    }
+}
+
+//! Triangular solve with a level schedule.
+/*!
+ * Solves A * x = b for x like triangular_solve(a, schedule, b, x). The vectors are not resized.
+ * Throws std::out_of_range if b or x does not have N elements, or if the number of allocated elements of A differs
+ * from that of the analysed matrix.
+ *
+ * \param a matrix A.
+ * \param schedule schedule made for the sparsity pattern of A.
+ * \param b right-hand side.
+ * \param x solution.
+ */
+template <size_t N, typename T, typename I>
+void triangular_solve(const CsrMatrix<N, N, T, I>& a, const LevelSchedule<N>& schedule, const std::vector<T>& b,
+                      std::vector<T>& x)
+{
+    if (b.size() != N || x.size() != N)
+    {
+        throw std::out_of_range("vector size mismatch");
+    }
+
+    triangular_solve(a, schedule, b.data(), x.data());
+}
+
+//! Parallel triangular solve.
+/*!
+ * Solves A * x = b for x like triangular_solve(pool, a, schedule, b, x). The vectors are not resized.
+ * Throws std::out_of_range if b or x does not have N elements, or if the number of allocated elements of A differs
+ * from that of the analysed matrix.
+ *
+ * \param pool threads to use.
+ * \param a matrix A.
+ * \param schedule schedule made for the sparsity pattern of A.
+ * \param b right-hand side.
+ * \param x solution.
+ */
+template <size_t N, typename T, typename I>
+void triangular_solve(ThreadPool& pool, const CsrMatrix<N, N, T, I>& a, const LevelSchedule<N>& schedule,
+                      const std::vector<T>& b, std::vector<T>& x)
+{
+    if (b.size() != N || x.size() != N)
+    {
+        throw std::out_of_range("vector size mismatch");
+    }
+
+    triangular_solve(pool, a, schedule, b.data(), x.data());
+}
+
+#endif  // TRIANGULARSOLVE_H
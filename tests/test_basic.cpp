@@ -91,6 +91,70 @@ TEST_CASE_TEMPLATE("allocation only when accessed", T, int, float, double)
     CHECK(m.peek(1, 2) == true);
 }
 
+TEST_CASE_TEMPLATE("memory footprint", T, int, float, double)
+{
+    SparseMatrix<2, 3, T> m;
+    CHECK(m.memory_bytes() == sizeof(m));
+
+    m(0, 0) = 1;
+    const size_t one = m.memory_bytes();
+    CHECK(one > sizeof(m) + sizeof(std::pair<size_t, size_t>) + sizeof(T));
+
+    m(1, 2) = 2;
+    CHECK(m.memory_bytes() - one == one - sizeof(m));
+}
+
+TEST_CASE_TEMPLATE("in-place addition and subtraction", T, int, float, double)
+{
+    // Interleaved elements, with long runs of elements of a that are not in b and the other way around.
+    SparseMatrix<20, 20, T> a;
+    SparseMatrix<20, 20, T> b;
+    T dense_a[20][20] = {};
+    T dense_b[20][20] = {};
+    for (size_t i = 0; i < 20; ++i)
+    {
+        for (size_t j = 0; j < 20; ++j)
+        {
+            if ((i * 7 + j) % 3 == 0 || i < 5)
+            {
+                a(i, j) = dense_a[i][j] = static_cast<T>(i + j);
+            }
+            if ((i * 3 + j) % 5 == 0 || i > 15)
+            {
+                b(i, j) = dense_b[i][j] = static_cast<T>(i * 2 + 1);
+            }
+        }
+    }
+
+    SparseMatrix<20, 20, T> sum(a);
+    sum += b;
+    SparseMatrix<20, 20, T> difference(a);
+    difference -= b;
+    for (size_t i = 0; i < 20; ++i)
+    {
+        for (size_t j = 0; j < 20; ++j)
+        {
+            CHECK(sum.peek(i, j) == (a.peek(i, j) || b.peek(i, j)));
+            CHECK(difference.peek(i, j) == (a.peek(i, j) || b.peek(i, j)));
+            if (sum.peek(i, j))
+            {
+                CHECK(sum(i, j) == dense_a[i][j] + dense_b[i][j]);
+                CHECK(difference(i, j) == dense_a[i][j] - dense_b[i][j]);
+            }
+        }
+    }
+
+    SparseMatrix<20, 20, T> twice(a);
+    twice += twice;
+    CHECK(twice == 2 * a);
+    twice -= twice;
+    CHECK(twice == 0 * a);
+
+    SparseMatrix<20, 20, T> aliased(a);
+    aliased += aliased + b;
+    CHECK(aliased == 2 * a + b);
+}
+
 TEST_CASE_TEMPLATE("arithmetic operators", T, int, float, double)
 {
     SparseMatrix<2, 2, T> s {
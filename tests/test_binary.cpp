@@ -0,0 +1,240 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "binarymatrix.h"
+#include "csrmatrix.h"
+#include "sparsematrix.h"
+#include "threadpool.h"
+
+
+//! Name of the file used by the tests.
+static const char* filename = "test_binary.bin";
+
+//! Read the test file.
+static std::string read_file()
+{
+    std::ifstream file(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+//! Write text to the test file.
+static void write_file(const std::string& text)
+{
+    std::ofstream file(filename, std::ios::binary);
+    file << text;
+}
+
+
+TEST_CASE_TEMPLATE("binary round trip", T, int, float, double)
+{
+    const SparseMatrix<3, 4, T> s = {
+        { {0, 1}, 1 },
+        { {0, 3}, 2 },
+        { {2, 0}, 3 },
+        { {2, 2}, 4 },
+    };
+    const CsrMatrix<3, 4, T> c(s);
+
+    SUBCASE("from compressed storage")
+    {
+        write_binary(filename, c);
+    }
+
+    SUBCASE("from map storage")
+    {
+        write_binary(filename, s);
+    }
+
+    MappedCsrMatrix<T> m(filename);
+    CHECK(m.rows() == 3);
+    CHECK(m.cols() == 4);
+    CHECK(m.size() == 12);
+    CHECK(m.allocated() == 4);
+    CHECK(m.mapped_bytes() == read_file().size());
+    CHECK(m.memory_bytes() == sizeof(m) + m.mapped_bytes());
+    m.validate();
+    CHECK(std::vector<size_t>(m.row_ptr(), m.row_ptr() + 4) == c.row_ptr());
+    CHECK(std::vector<size_t>(m.col_idx(), m.col_idx() + 4) == c.col_idx());
+    CHECK(std::vector<T>(m.values(), m.values() + 4) == c.values());
+
+    // Arrays are aligned to cache lines within the page-aligned mapping.
+    CHECK(reinterpret_cast<uintptr_t>(m.row_ptr()) % 64 == 0);
+    CHECK(reinterpret_cast<uintptr_t>(m.col_idx()) % 64 == 0);
+    CHECK(reinterpret_cast<uintptr_t>(m.values()) % 64 == 0);
+
+    CHECK(m.peek(0, 1) == true);
+    CHECK(m.peek(1, 1) == false);
+    CHECK(m(0, 3) == 2);
+    CHECK(m(1, 1) == 0);
+    CHECK(m(2, 2) == 4);
+    REQUIRE_THROWS_AS( m(3, 0), const std::out_of_range& );
+    REQUIRE_THROWS_AS( m.peek(0, 4), const std::out_of_range& );
+
+    CHECK(m.template to_csr<3, 4>() == c);
+    REQUIRE_THROWS_AS( (m.template to_csr<4, 3>()), const std::out_of_range& );
+
+    std::vector<T> x = {1, 2, 3, 4};
+    std::vector<T> y(3, 1);
+    std::vector<T> z(3, 1);
+    m.multiply(2, x, 1, y);
+    c.multiply(2, x, 1, z);
+    CHECK(y == z);
+    REQUIRE_THROWS_AS( m.multiply(x, x), const std::out_of_range& );
+
+    std::vector<T> b(8, 1);
+    std::vector<T> out(6);
+    std::vector<T> expected(6);
+    m.multiply(2, 1, b.data(), 2, 0, out.data(), 2);
+    c.multiply(2, b, expected);
+    CHECK(out == expected);
+
+    std::remove(filename);
+}
+
+TEST_CASE("binary parallel product")
+{
+    SparseMatrix<200, 150, double> s;
+    for (size_t i = 0; i < 200; ++i)
+    {
+        for (size_t j = (i * 7) % 13; j < 150; j += 1 + i % 11)
+        {
+            s(i, j) = static_cast<double>(i + 2 * j + 1);
+        }
+    }
+    const CsrMatrix<200, 150, double> c(s);
+    write_binary(filename, c);
+    const MappedCsrMatrix<double> m(filename);
+
+    std::vector<double> x(150);
+    for (size_t j = 0; j < 150; ++j)
+    {
+        x[j] = static_cast<double>(j % 5 + 1);
+    }
+    std::vector<double> expected(200);
+    c.multiply(x, expected);
+
+    for (const Partitioning partitioning : {Partitioning::Rows, Partitioning::MergePath})
+    {
+        ThreadPool pool(3);
+        std::vector<double> y(200);
+        m.multiply(pool, x, y, partitioning);
+        CHECK(y == expected);
+    }
+
+    std::remove(filename);
+}
+
+TEST_CASE("binary index type and empty matrix")
+{
+    const SparseMatrix<300, 65536, float, uint16_t> s = {
+        { {0, 0}, 1.0f },
+        { {299, 65535}, 2.0f },
+    };
+    write_binary(filename, s);
+    {
+        MappedCsrMatrix<float, uint16_t> m(filename);
+        CHECK(m(299, 65535) == 2.0f);
+        CHECK(m.template to_csr<300, 65536>() == CsrMatrix<300, 65536, float, uint16_t>(s));
+    }
+
+    // The index type and value type must match the file.
+    REQUIRE_THROWS_AS( (MappedCsrMatrix<float, size_t>(filename)), const std::runtime_error& );
+    REQUIRE_THROWS_AS( (MappedCsrMatrix<double, uint16_t>(filename)), const std::runtime_error& );
+    REQUIRE_THROWS_AS( (MappedCsrMatrix<int32_t, uint16_t>(filename)), const std::runtime_error& );
+
+    write_binary(filename, CsrMatrix<5, 5, double>());
+    MappedCsrMatrix<double> e(filename);
+    CHECK(e.rows() == 5);
+    CHECK(e.allocated() == 0);
+    CHECK(e(4, 4) == 0.0);
+
+    // Moving transfers the mapping.
+    MappedCsrMatrix<double> f(std::move(e));
+    CHECK(f.rows() == 5);
+    CHECK(e.rows() == 0);
+    CHECK(e.allocated() == 0);
+
+    std::remove(filename);
+}
+
+TEST_CASE("binary errors")
+{
+    REQUIRE_THROWS_AS( MappedCsrMatrix<double>("does_not_exist.bin"), const std::runtime_error& );
+
+    write_file("");
+    REQUIRE_THROWS_AS( (MappedCsrMatrix<double>(filename)), const std::runtime_error& );
+
+    write_file(std::string(256, 'x'));
+    REQUIRE_THROWS_AS( (MappedCsrMatrix<double>(filename)), const std::runtime_error& );
+
+    const SparseMatrix<3, 4, double> s = {
+        { {0, 1}, 1 },
+        { {2, 2}, 4 },
+    };
+    write_binary(filename, s);
+    const std::string data = read_file();
+
+    // Truncated values.
+    write_file(data.substr(0, data.size() - 1));
+    REQUIRE_THROWS_AS( (MappedCsrMatrix<double>(filename)), const std::runtime_error& );
+
+    // Unknown version.
+    std::string changed = data;
+    changed[8] = 2;
+    write_file(changed);
+    REQUIRE_THROWS_AS( (MappedCsrMatrix<double>(filename)), const std::runtime_error& );
+
+    // Number of elements does not match the row pointers.
+    changed = data;
+    changed[sizeof(sparsematrix_detail::BinaryHeader) - 4 * 8] = 1;
+    write_file(changed);
+    REQUIRE_THROWS_AS( (MappedCsrMatrix<double>(filename)), const std::runtime_error& );
+
+    // Decreasing row pointers and column indices out of range are only found by validate().
+    const sparsematrix_detail::BinaryHeader header = sparsematrix_detail::binary_header<double, size_t>(3, 4, 2);
+    changed = data;
+    changed[header.row_ptr_offset + 1 * sizeof(size_t)] = 2;
+    write_file(changed);
+    MappedCsrMatrix<double> decreasing(filename);
+    REQUIRE_THROWS_AS( decreasing.validate(), const std::runtime_error& );
+
+    changed = data;
+    changed[header.col_idx_offset + 1 * sizeof(size_t)] = 4;
+    write_file(changed);
+    MappedCsrMatrix<double> out_of_range(filename);
+    REQUIRE_THROWS_AS( out_of_range.validate(), const std::runtime_error& );
+
+    changed = data;
+    changed[header.col_idx_offset] = 3;
+    write_file(changed);
+    REQUIRE_NOTHROW( MappedCsrMatrix<double>(filename).validate() );
+
+    std::remove(filename);
+}
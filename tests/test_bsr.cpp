@@ -0,0 +1,225 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <vector>
+
+#include "bsrmatrix.h"
+#include "csrmatrix.h"
+#include "sparsematrix.h"
+#include "threadpool.h"
+
+
+//! Test matrix made of dense 3 x 3 blocks, like a finite element matrix with three degrees of freedom per node.
+template <size_t M, typename T>
+static SparseMatrix<M, M, T> block_matrix()
+{
+    SparseMatrix<M, M, T> s;
+    for (size_t node = 0; node < M / 3; ++node)
+    {
+        for (const size_t neighbour : {node, (node + 1) % (M / 3), (node * 5 + 2) % (M / 3)})
+        {
+            for (size_t i = 0; i < 3; ++i)
+            {
+                for (size_t j = 0; j < 3; ++j)
+                {
+                    s(node * 3 + i, neighbour * 3 + j) = static_cast<T>((node + i + 2 * j) % 7 + 1);
+                }
+            }
+        }
+    }
+    return s;
+}
+
+
+TEST_CASE("block storage conversion")
+{
+    const SparseMatrix<4, 6, double> s = {
+        { {0, 0}, 1 },
+        { {1, 1}, 2 },
+        { {0, 5}, 3 },
+        { {3, 2}, 4 },
+        { {2, 3}, 5 },
+    };
+    const CsrMatrix<4, 6, double> c(s);
+    const BsrMatrix<4, 6, 2, double> m(s);
+
+    CHECK(m.row_ptr() == std::vector<size_t>({0, 2, 3}));
+    CHECK(m.col_idx() == std::vector<size_t>({0, 2, 1}));
+    CHECK(m.values() == std::vector<double>({1, 0, 0, 2, 0, 3, 0, 0, 0, 5, 4, 0}));
+    CHECK(m.blocks() == 3);
+    CHECK(m.size() == 24);
+    CHECK(m.allocated() == 12);
+    CHECK(m.fill_ratio() == doctest::Approx(12.0 / 5.0));
+    CHECK(m.memory_bytes() > m.allocated() * sizeof(double));
+    CHECK(m == BsrMatrix<4, 6, 2, double>(c));
+    CHECK(m != BsrMatrix<4, 6, 2, double>());
+
+    CHECK(m(0, 0) == 1);
+    CHECK(m(0, 1) == 0);
+    CHECK(m(0, 5) == 3);
+    CHECK(m(3, 2) == 4);
+    CHECK(m(3, 0) == 0);
+    CHECK(m.peek(1, 0) == true);
+    CHECK(m.peek(1, 5) == true);
+    CHECK(m.peek(0, 2) == false);
+    CHECK(m.peek(3, 0) == false);
+    REQUIRE_THROWS_AS( m(4, 0), const std::out_of_range& );
+    REQUIRE_THROWS_AS( m.peek(0, 6), const std::out_of_range& );
+
+    // The fill is dropped when converting back.
+    CHECK(m.to_csr() == c);
+    CHECK(m.to_sparse() == s);
+
+    const BsrMatrix<4, 6, 2, double> e;
+    CHECK(e.blocks() == 0);
+    CHECK(e.fill_ratio() == 1.0);
+    CHECK(e(3, 5) == 0);
+    CHECK(e.to_csr() == CsrMatrix<4, 6, double>());
+}
+
+TEST_CASE_TEMPLATE("block storage product", T, int, float, double)
+{
+    const auto s = block_matrix<60, T>();
+    const CsrMatrix<60, 60, T> c(s);
+
+    std::vector<T> x(60);
+    for (size_t j = 0; j < 60; ++j)
+    {
+        x[j] = static_cast<T>(j % 5 + 1);
+    }
+    std::vector<T> expected(60, 1);
+    c.multiply(2, x, 3, expected);
+
+    std::vector<T> y(60, 1);
+    const BsrMatrix<60, 60, 3, T> m3(s);
+    CHECK(m3.fill_ratio() == 1.0);
+    m3.multiply(2, x, 3, y);
+    CHECK(y == expected);
+
+    // Other block sizes give the same product, with fill.
+    y.assign(60, 1);
+    const BsrMatrix<60, 60, 4, T> m4(c);
+    CHECK(m4.fill_ratio() > 1.0);
+    m4.multiply(2, x, 3, y);
+    CHECK(y == expected);
+
+    y.assign(60, 1);
+    const BsrMatrix<60, 60, 1, T> m1(m3.to_csr());
+    m1.multiply(2, x, 3, y);
+    CHECK(y == expected);
+
+    std::array<T, 60> xa;
+    std::array<T, 60> ya;
+    std::copy(x.begin(), x.end(), xa.begin());
+    m3.multiply(xa, ya);
+    c.multiply(x, expected);
+    CHECK(std::vector<T>(ya.begin(), ya.end()) == expected);
+
+    ThreadPool pool(3);
+    y.assign(60, 0);
+    m3.multiply(pool, x, y);
+    CHECK(y == expected);
+
+    std::vector<T> z(59);
+    REQUIRE_THROWS_AS( m3.multiply(x, z), const std::out_of_range& );
+}
+
+TEST_CASE("block storage product with dense matrices")
+{
+    const auto s = block_matrix<48, double>();
+    const CsrMatrix<48, 48, double> c(s);
+    const BsrMatrix<48, 48, 3, double> m(c);
+    ThreadPool pool(2);
+
+    for (const size_t k : {1, 16, 37})
+    {
+        std::vector<double> b(48 * k);
+        for (size_t n = 0; n < b.size(); ++n)
+        {
+            b[n] = static_cast<double>(n % 11);
+        }
+
+        std::vector<double> expected(48 * k);
+        std::vector<double> out(48 * k);
+        c.multiply(k, b, expected);
+        m.multiply(k, b, out);
+        CHECK(out == expected);
+
+        c.multiply(k, b, expected, DenseLayout::ColumnMajor);
+        m.multiply(k, b, out, DenseLayout::ColumnMajor);
+        CHECK(out == expected);
+
+        // Padded leading dimensions, with beta.
+        std::vector<double> padded(50 * k, 1.0);
+        std::vector<double> padded_expected(50 * k, 1.0);
+        c.multiply(k, 2.0, b.data(), 48, 3.0, padded_expected.data(), 50, DenseLayout::ColumnMajor);
+        m.multiply(pool, k, 2.0, b.data(), 48, 3.0, padded.data(), 50, DenseLayout::ColumnMajor);
+        CHECK(padded == padded_expected);
+
+        m.multiply(pool, k, 1.0, b.data(), k, 0.0, out.data(), k);
+        c.multiply(k, b, expected);
+        CHECK(out == expected);
+
+        REQUIRE_THROWS_AS( m.multiply(k, 1.0, b.data(), 47, 0.0, out.data(), 48, DenseLayout::ColumnMajor),
+                           const std::out_of_range& );
+        REQUIRE_THROWS_AS( m.multiply(k + 1, b, out), const std::out_of_range& );
+    }
+}
+
+TEST_CASE("block size recommendation")
+{
+    const auto s = block_matrix<60, double>();
+
+    const std::vector<BlockFill> fill = block_fill(s);
+    REQUIRE(fill.size() == 6);  // 8 does not divide 60
+    CHECK(fill[0].block_size == 1);
+    CHECK(fill[0].blocks == s.allocated());
+    CHECK(fill[0].fill_ratio == 1.0);
+    CHECK(fill[2].block_size == 3);
+    CHECK(fill[2].blocks * 9 == s.allocated());
+    CHECK(fill[2].fill_ratio == 1.0);
+    CHECK(fill[2].storage_bytes < fill[0].storage_bytes);
+    CHECK(fill[3].block_size == 4);
+    CHECK(fill[3].fill_ratio > 1.0);
+    CHECK(fill[3].blocks == BsrMatrix<60, 60, 4, double>(s).blocks());
+    CHECK(recommend_block_size(s) == 3);
+
+    // Without a matching candidate, the one with the least storage wins.
+    const std::vector<BlockFill> other = block_fill(CsrMatrix<60, 60, double>(s), {1, 2, 4});
+    const auto best = std::min_element(other.cbegin(), other.cend(), [](const BlockFill& a, const BlockFill& b)
+    {
+        return a.storage_bytes < b.storage_bytes;
+    });
+    CHECK(recommend_block_size(s, {1, 2, 4}) == best->block_size);
+
+    // A diagonal matrix has no blocks.
+    SparseMatrix<60, 60, double> d;
+    for (size_t i = 0; i < 60; ++i)
+    {
+        d(i, i) = 1.0;
+    }
+    CHECK(recommend_block_size(d) == 1);
+    CHECK(recommend_block_size(d, {7}) == 1);
+    CHECK(block_fill(d, {7}).empty());
+}
@@ -0,0 +1,168 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <random>
+#include <stdexcept>
+
+#include "csrmatrix.h"
+#include "poolallocator.h"
+#include "sparsematrix.h"
+#include "sparsematrixbuilder.h"
+#include "threadpool.h"
+
+
+TEST_CASE_TEMPLATE("builder", T, int, float, double)
+{
+    SparseMatrixBuilder<3, 4, T> builder;
+    builder.reserve(7);
+    builder.add(2, 3, 1);
+    builder.add(0, 2, 2);
+    builder.add(2, 0, 3);
+    builder.add(0, 2, 5);
+    builder.add(1, 1, 0);
+    builder.add(2, 3, 4);
+    builder.add(0, 0, 6);
+    CHECK(builder.size() == 7);
+
+    SUBCASE("duplicates are summed")
+    {
+        SparseMatrix<3, 4, T> expected = {
+            { {0, 0}, 6 },
+            { {0, 2}, 7 },
+            { {1, 1}, 0 },
+            { {2, 0}, 3 },
+            { {2, 3}, 5 },
+        };
+        CHECK(builder.build() == expected);
+        CHECK(builder.build_csr() == CsrMatrix<3, 4, T>(expected));
+    }
+
+    SUBCASE("last duplicate is kept")
+    {
+        SparseMatrix<3, 4, T> s = builder.build(Duplicates::Last);
+        CHECK(s.allocated() == 5);
+        CHECK(s(0, 2) == 5);
+        CHECK(s(2, 3) == 4);
+        CHECK(CsrMatrix<3, 4, T>(s) == builder.build_csr(Duplicates::Last));
+    }
+
+    SUBCASE("largest duplicate is kept")
+    {
+        builder.add(0, 2, -9);
+        SparseMatrix<3, 4, T> s = builder.build(Duplicates::Max);
+        CHECK(s(0, 2) == 5);
+        CHECK(s(2, 3) == 4);
+        CHECK(s(2, 0) == 3);
+    }
+
+    SUBCASE("order of addition within a row")
+    {
+        // Many duplicates in reverse column order, so that the row is not sorted.
+        SparseMatrixBuilder<1, 50, T> row;
+        for (size_t n = 0; n < 200; ++n)
+        {
+            row.add(0, 49 - n % 50, static_cast<T>(n));
+        }
+        SparseMatrix<1, 50, T> s = row.build(Duplicates::Last);
+        CHECK(s.allocated() == 50);
+        CHECK(s(0, 49) == 150);
+        CHECK(s(0, 0) == 199);
+
+        SparseMatrix<1, 50, T> t = row.build();
+        CHECK(t(0, 49) == 0 + 50 + 100 + 150);
+    }
+
+    SUBCASE("bounds are checked")
+    {
+        CHECK_THROWS_AS(builder.add(3, 0, 1), std::out_of_range);
+        CHECK_THROWS_AS(builder.add(0, 4, 1), std::out_of_range);
+        CHECK(builder.size() == 7);
+    }
+
+    SUBCASE("empty builder and clear")
+    {
+        SparseMatrixBuilder<3, 4, T> empty;
+        CHECK(empty.build().allocated() == 0);
+        CHECK(empty.build_csr() == CsrMatrix<3, 4, T>());
+
+        builder.clear();
+        CHECK(builder.size() == 0);
+        CHECK(builder.build() == SparseMatrix<3, 4, T>());
+    }
+
+    SUBCASE("index type and allocator")
+    {
+        SparseMatrixBuilder<3, 4, T, uint8_t> small;
+        small.add(1, 3, 2);
+        small.add(1, 3, 2);
+        SparseMatrix<3, 4, T, uint8_t, PoolAllocator<T>> s = small.template build<PoolAllocator<T>>();
+        CHECK(s.allocated() == 1);
+        CHECK(s(1, 3) == 4);
+        CHECK(small.build_csr()(1, 3) == 4);
+    }
+}
+
+TEST_CASE_TEMPLATE("parallel builder", T, int, float, double)
+{
+    // Random triplets with many duplicates, and a row that holds a large share of them.
+    SparseMatrixBuilder<300, 200, T> builder;
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<size_t> row(0, 299);
+    std::uniform_int_distribution<size_t> column(0, 199);
+    std::uniform_int_distribution<int> value(-50, 50);
+    for (size_t n = 0; n < 20000; ++n)
+    {
+        builder.add(n % 4 == 0 ? 150 : row(generator), column(generator), static_cast<T>(value(generator)));
+    }
+
+    for (size_t threads = 1; threads <= 5; ++threads)
+    {
+        ThreadPool pool(threads);
+        CHECK(builder.build_csr(pool) == builder.build_csr());
+        CHECK(builder.build_csr(pool, Duplicates::Last) == builder.build_csr(Duplicates::Last));
+        CHECK(builder.build_csr(pool, Duplicates::Max) == builder.build_csr(Duplicates::Max));
+        CHECK(builder.build(pool) == builder.build());
+    }
+
+    SUBCASE("few triplets")
+    {
+        ThreadPool pool(4);
+        SparseMatrixBuilder<300, 200, T> small;
+        CHECK(small.build_csr(pool) == CsrMatrix<300, 200, T>());
+
+        small.add(299, 0, 1);
+        small.add(0, 199, 2);
+        small.add(299, 0, 3);
+        CsrMatrix<300, 200, T> c = small.build_csr(pool, Duplicates::Last);
+        CHECK(c.allocated() == 2);
+        CHECK(c(299, 0) == 3);
+        CHECK(c(0, 199) == 2);
+    }
+
+    SUBCASE("fewer rows than threads")
+    {
+        ThreadPool pool(4);
+        SparseMatrixBuilder<2, 3, T> small;
+        small.add(1, 2, 1);
+        small.add(1, 2, 1);
+        CHECK(small.build_csr(pool)(1, 2) == 2);
+    }
+}
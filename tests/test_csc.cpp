@@ -0,0 +1,116 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include "cscmatrix.h"
+
+
+TEST_CASE_TEMPLATE("csc conversion", T, int, float, double)
+{
+    SparseMatrix<3, 4, T> s = {
+        { {0, 1}, 1 },
+        { {0, 3}, 2 },
+        { {2, 0}, 3 },
+        { {2, 1}, 4 },
+    };
+
+    SUBCASE("from map storage")
+    {
+        CscMatrix<3, 4, T> c(s);
+
+        CHECK(c.size() == 12);
+        CHECK(c.allocated() == 4);
+        CHECK(c.col_ptr() == std::vector<size_t>({0, 1, 3, 3, 4}));
+        CHECK(c.row_idx() == std::vector<size_t>({2, 0, 2, 0}));
+        CHECK(c.values() == std::vector<T>({3, 1, 4, 2}));
+
+        CHECK(c.peek(2, 1) == true);
+        CHECK(c.peek(1, 1) == false);
+        CHECK(c(0, 3) == 2);
+        CHECK(c(1, 2) == 0);
+
+        CHECK(c.to_sparse() == s);
+
+        REQUIRE_THROWS_AS( c(3, 0), const std::out_of_range& );
+        REQUIRE_THROWS_AS( c.peek(0, 4), const std::out_of_range& );
+    }
+
+    SUBCASE("from and to compressed row storage")
+    {
+        CsrMatrix<3, 4, T> r(s);
+        CscMatrix<3, 4, T> c(r);
+
+        CHECK(c == CscMatrix<3, 4, T>(s));
+        CHECK(c.to_csr() == r);
+    }
+
+    SUBCASE("reinterpret as transpose")
+    {
+        CsrMatrix<3, 4, T> r(s);
+        const T* data = r.values().data();
+
+        CscMatrix<4, 3, T> c = CscMatrix<4, 3, T>::from_transposed(std::move(r));
+        CHECK(c.values().data() == data);
+        CHECK(c.to_sparse() == s.transpose());
+        CHECK(r.allocated() == 0);
+        CHECK(r.row_ptr().size() == 4);
+
+        CsrMatrix<3, 4, T> back = c.release_transposed();
+        CHECK(back.values().data() == data);
+        CHECK(back.to_sparse() == s);
+        CHECK(c.allocated() == 0);
+        CHECK(c.col_ptr().size() == 4);
+    }
+
+    SUBCASE("transpose")
+    {
+        CscMatrix<3, 4, T> c(s);
+        CHECK(c.transpose().to_sparse() == s.transpose());
+        CHECK(c.transpose().transpose() == c);
+    }
+}
+
+TEST_CASE_TEMPLATE("csc column operations", T, int, float, double)
+{
+    SparseMatrix<3, 2, T> s = {
+        { {0, 0}, 1 },
+        { {1, 1}, 2 },
+        { {2, 1}, 3 },
+    };
+
+    CscMatrix<3, 2, T> c(s);
+
+    SUBCASE("column extraction")
+    {
+        SparseMatrix<3, 1, T> v = { { {1, 0}, 2 }, { {2, 0}, 3 } };
+        CHECK(c.column(1) == v);
+        REQUIRE_THROWS_AS( c.column(2), const std::out_of_range& );
+    }
+
+    SUBCASE("column scaling")
+    {
+        c.scale_column(1, 2);
+        CHECK(c(0, 0) == 1);
+        CHECK(c(1, 1) == 4);
+        CHECK(c(2, 1) == 6);
+        REQUIRE_THROWS_AS( c.scale_column(2, 2), const std::out_of_range& );
+    }
+}
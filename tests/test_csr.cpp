@@ -0,0 +1,141 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include "csrmatrix.h"
+
+
+TEST_CASE_TEMPLATE("csr conversion", T, int, float, double)
+{
+    SparseMatrix<3, 4, T> s = {
+        { {0, 1}, 1 },
+        { {0, 3}, 2 },
+        { {2, 0}, 3 },
+        { {2, 2}, 4 },
+    };
+
+    CsrMatrix<3, 4, T> c(s);
+
+    CHECK(c.size() == 12);
+    CHECK(c.allocated() == 4);
+    CHECK(c.row_ptr() == std::vector<size_t>({0, 2, 2, 4}));
+    CHECK(c.col_idx() == std::vector<size_t>({1, 3, 0, 2}));
+    CHECK(c.values() == std::vector<T>({1, 2, 3, 4}));
+    CHECK(c.memory_bytes() == sizeof(c) + 4 * sizeof(size_t) + 4 * (sizeof(size_t) + sizeof(T)));
+
+    CHECK(c.peek(0, 1) == true);
+    CHECK(c.peek(1, 1) == false);
+    CHECK(c(0, 3) == 2);
+    CHECK(c(1, 1) == 0);
+    CHECK(c(2, 2) == 4);
+
+    CHECK(c.to_sparse() == s);
+    CHECK(CsrMatrix<3, 4, T>() == CsrMatrix<3, 4, T>(SparseMatrix<3, 4, T>()));
+
+    REQUIRE_THROWS_AS( c(3, 0), const std::out_of_range& );
+    REQUIRE_THROWS_AS( c.peek(0, 4), const std::out_of_range& );
+    REQUIRE_THROWS_AS( (CsrMatrix<2, 3, T>({ { {3, 4}, 1 } })), const std::out_of_range& );
+}
+
+TEST_CASE_TEMPLATE("csr construction from arrays", T, int, float, double)
+{
+    typedef CsrMatrix<3, 4, T> Matrix;
+
+    Matrix c({0, 2, 2, 4}, {1, 3, 0, 2}, {1, 2, 3, 4});
+    CHECK(c.allocated() == 4);
+    CHECK(c(0, 3) == 2);
+    CHECK(c(2, 0) == 3);
+    CHECK(c == Matrix({ { {0, 1}, 1 }, { {0, 3}, 2 }, { {2, 0}, 3 }, { {2, 2}, 4 } }));
+    CHECK(Matrix({0, 0, 0, 0}, {}, {}) == Matrix());
+
+    // Wrong lengths, row pointers that do not start at zero or decrease, and unsorted or out of bounds columns.
+    REQUIRE_THROWS_AS( Matrix({0, 2, 4}, {1, 3, 0, 2}, {1, 2, 3, 4}), const std::out_of_range& );
+    REQUIRE_THROWS_AS( Matrix({0, 2, 2, 4}, {1, 3, 0, 2}, {1, 2, 3}), const std::out_of_range& );
+    REQUIRE_THROWS_AS( Matrix({1, 2, 2, 4}, {1, 3, 0, 2}, {1, 2, 3, 4}), const std::out_of_range& );
+    REQUIRE_THROWS_AS( Matrix({0, 3, 2, 4}, {1, 3, 0, 2}, {1, 2, 3, 4}), const std::out_of_range& );
+    REQUIRE_THROWS_AS( Matrix({0, 2, 2, 4}, {3, 1, 0, 2}, {1, 2, 3, 4}), const std::out_of_range& );
+    REQUIRE_THROWS_AS( Matrix({0, 2, 2, 4}, {1, 1, 0, 2}, {1, 2, 3, 4}), const std::out_of_range& );
+    REQUIRE_THROWS_AS( Matrix({0, 2, 2, 4}, {1, 4, 0, 2}, {1, 2, 3, 4}), const std::out_of_range& );
+}
+
+TEST_CASE_TEMPLATE("csr arithmetic operators", T, int, float, double)
+{
+    SparseMatrix<2, 3, T> s {
+        { {0, 0}, 1 },
+        { {0, 2}, 2 },
+        { {1, 1}, 3 },
+    };
+
+    SparseMatrix<2, 3, T> t {
+        { {0, 1}, 5 },
+        { {0, 2}, 6 },
+        { {1, 1}, 7 },
+    };
+
+    CsrMatrix<2, 3, T> cs(s);
+    CsrMatrix<2, 3, T> ct(t);
+
+    SUBCASE("unitary plus")
+    {
+        CHECK(+cs == cs);
+    }
+
+    SUBCASE("unitary minus")
+    {
+        CHECK((-cs).to_sparse() == -s);
+    }
+
+    SUBCASE("addition")
+    {
+        CHECK((cs + ct).to_sparse() == s + t);
+
+        CsrMatrix<2, 3, T> u = cs;
+        u += ct;
+        CHECK(u == cs + ct);
+    }
+
+    SUBCASE("subtraction")
+    {
+        CHECK((cs - ct).to_sparse() == s - t);
+
+        CsrMatrix<2, 3, T> u = cs;
+        u -= ct;
+        CHECK(u == cs - ct);
+    }
+
+    SUBCASE("scaling")
+    {
+        CHECK((T(3) * cs).to_sparse() == T(3) * s);
+        CHECK(cs * T(3) == T(3) * cs);
+    }
+
+    SUBCASE("multiplication")
+    {
+        CHECK((cs * ct.transpose()).to_sparse() == s * t.transpose());
+        CHECK((cs.transpose() * ct).to_sparse() == s.transpose() * t);
+    }
+
+    SUBCASE("transpose")
+    {
+        CHECK(cs.transpose().to_sparse() == s.transpose());
+        CHECK(cs.transpose().transpose() == cs);
+    }
+}
@@ -0,0 +1,203 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "csrmatrix.h"
+#include "diamatrix.h"
+#include "sparsematrix.h"
+#include "threadpool.h"
+
+
+//! Stencil matrix with diagonals at the given offsets, truncated at the borders of the matrix.
+template <size_t M, size_t N, typename T>
+static SparseMatrix<M, N, T> stencil_matrix(const std::vector<std::ptrdiff_t>& offsets)
+{
+    SparseMatrix<M, N, T> s;
+    for (size_t i = 0; i < M; ++i)
+    {
+        for (const std::ptrdiff_t offset : offsets)
+        {
+            const std::ptrdiff_t j = static_cast<std::ptrdiff_t>(i) + offset;
+            if (j >= 0 && j < static_cast<std::ptrdiff_t>(N))
+            {
+                s(i, static_cast<size_t>(j)) = static_cast<T>((i + 3 * static_cast<size_t>(j)) % 7 + 1);
+            }
+        }
+    }
+    return s;
+}
+
+
+TEST_CASE("diagonal storage conversion")
+{
+    const SparseMatrix<3, 4, double> s = {
+        { {0, 0}, 1 },
+        { {1, 1}, 2 },
+        { {0, 3}, 3 },
+        { {2, 1}, 4 },
+        { {2, 3}, 5 },
+    };
+    const CsrMatrix<3, 4, double> c(s);
+    const DiaMatrix<3, 4, double> m(s);
+
+    CHECK(m.offsets() == std::vector<std::ptrdiff_t>({-1, 0, 1, 3}));
+    CHECK(m.values() == std::vector<double>({0, 0, 4, 1, 2, 0, 0, 0, 5, 3, 0, 0}));
+    CHECK(m.diagonals() == 4);
+    CHECK(m.size() == 12);
+    CHECK(m.allocated() == 2 + 3 + 3 + 1);
+    CHECK(m.memory_bytes() > m.values().size() * sizeof(double));
+    CHECK(m == DiaMatrix<3, 4, double>(c));
+    CHECK(m != DiaMatrix<3, 4, double>());
+
+    CHECK(m(0, 0) == 1);
+    CHECK(m(0, 3) == 3);
+    CHECK(m(2, 1) == 4);
+    CHECK(m(1, 2) == 0);
+    CHECK(m(2, 0) == 0);
+    CHECK(m.peek(1, 2) == true);
+    CHECK(m.peek(2, 0) == false);
+    CHECK(m.peek(0, 2) == false);
+    REQUIRE_THROWS_AS( m(3, 0), const std::out_of_range& );
+    REQUIRE_THROWS_AS( m.peek(0, 4), const std::out_of_range& );
+
+    // Zeros on stored diagonals are dropped when converting back.
+    CHECK(m.to_csr() == c);
+    CHECK(m.to_sparse() == s);
+
+    const DiaMatrix<3, 4, double> e;
+    CHECK(e.diagonals() == 0);
+    CHECK(e.allocated() == 0);
+    CHECK(e(2, 3) == 0);
+    CHECK(e.to_csr() == CsrMatrix<3, 4, double>());
+}
+
+TEST_CASE_TEMPLATE("diagonal storage product", T, int, float, double)
+{
+    // Tall and wide matrices, with diagonals on both sides and more rows than a tile.
+    const auto s = stencil_matrix<2500, 2000, T>({-1500, -40, -1, 0, 1, 40, 1999});
+    const CsrMatrix<2500, 2000, T> c(s);
+    const DiaMatrix<2500, 2000, T> m(s);
+    CHECK(m.diagonals() == 7);
+
+    std::vector<T> x(2000);
+    for (size_t j = 0; j < 2000; ++j)
+    {
+        x[j] = static_cast<T>(j % 5 + 1);
+    }
+    std::vector<T> expected(2500, 1);
+    std::vector<T> y(2500, 1);
+    c.multiply(2, x, 3, expected);
+    m.multiply(2, x, 3, y);
+    CHECK(y == expected);
+
+    c.multiply(x, expected);
+    m.multiply(x, y);
+    CHECK(y == expected);
+
+    ThreadPool pool(3);
+    std::vector<T> z(2500);
+    m.multiply(pool, x, z);
+    CHECK(z == expected);
+
+    const auto w = stencil_matrix<2000, 2500, T>({-1999, -1, 0, 1, 2400});
+    const DiaMatrix<2000, 2500, T> mw(w);
+    std::vector<T> xw(2500, 2);
+    std::vector<T> yw(2000);
+    std::vector<T> ew(2000);
+    CsrMatrix<2000, 2500, T>(w).multiply(xw, ew);
+    mw.multiply(xw, yw);
+    CHECK(yw == ew);
+
+    REQUIRE_THROWS_AS( m.multiply(y, x), const std::out_of_range& );
+    REQUIRE_THROWS_AS( m.multiply(pool, x, x), const std::out_of_range& );
+}
+
+//! Check that two matrices have the same elements, regardless of their storage.
+template <typename A, typename B>
+static bool same_elements(const A& a, const B& b, size_t rows, size_t cols)
+{
+    for (size_t i = 0; i < rows; ++i)
+    {
+        for (size_t j = 0; j < cols; ++j)
+        {
+            if (a(i, j) != b(i, j))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+TEST_CASE("diagonal storage arithmetic")
+{
+    const auto s1 = stencil_matrix<20, 20, int>({-1, 0, 1});
+    const auto s2 = stencil_matrix<20, 20, int>({0, 2, -19});
+    const DiaMatrix<20, 20, int> a(s1);
+    const DiaMatrix<20, 20, int> b(s2);
+
+    // Results have the union of the diagonals of the operands, including diagonals that become zero.
+    CHECK((a + b).offsets() == std::vector<std::ptrdiff_t>({-19, -1, 0, 1, 2}));
+    CHECK(same_elements(a + b, CsrMatrix<20, 20, int>(SparseMatrix<20, 20, int>(s1 + s2)), 20, 20));
+    CHECK(same_elements(a - b, CsrMatrix<20, 20, int>(SparseMatrix<20, 20, int>(s1 - s2)), 20, 20));
+    CHECK((a - a).diagonals() == 3);
+    CHECK((a - a).to_csr() == CsrMatrix<20, 20, int>());
+
+    DiaMatrix<20, 20, int> d = a;
+    d += a;
+    CHECK(d == 2 * a);
+    d -= b;
+    CHECK(same_elements(d, CsrMatrix<20, 20, int>(SparseMatrix<20, 20, int>(2 * s1 - s2)), 20, 20));
+    d += b;
+    CHECK(same_elements(d, a * 2, 20, 20));
+
+    CHECK(same_elements(-a, CsrMatrix<20, 20, int>(SparseMatrix<20, 20, int>(-s1)), 20, 20));
+    CHECK(+a == a);
+    CHECK((3 * a)(4, 5) == 3 * a(4, 5));
+
+    std::array<int, 20> x;
+    std::array<int, 20> y;
+    std::array<int, 20> z;
+    x.fill(1);
+    (a + b).multiply(x, y);
+    CsrMatrix<20, 20, int>(SparseMatrix<20, 20, int>(s1 + s2)).multiply(x, z);
+    CHECK(y == z);
+}
+
+TEST_CASE("diagonal storage index type")
+{
+    const auto s = stencil_matrix<300, 300, float>({-2, 0, 5});
+    SparseMatrix<300, 300, float, uint16_t> t;
+    for (auto elem = s.cbegin(); elem != s.cend(); ++elem)
+    {
+        t(elem->first.first, elem->first.second) = elem->second;
+    }
+
+    const DiaMatrix<300, 300, float, uint16_t> m(t);
+    CHECK(m.diagonals() == 3);
+    CHECK(m.to_sparse() == t);
+}
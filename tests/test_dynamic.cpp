@@ -0,0 +1,185 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include "dynamicsparsematrix.h"
+
+
+TEST_CASE_TEMPLATE("create a dynamic matrix", T, int, float, double)
+{
+    DynamicSparseMatrix<T> m(2, 3, {
+        { {0, 0}, 1 },
+        { {0, 2}, 3 },
+        { {1, 1}, 5 },
+    });
+
+    CHECK(m.rows() == 2);
+    CHECK(m.cols() == 3);
+    CHECK(m.size() == 6);
+    CHECK(m.allocated() == 3);
+    CHECK(m.peek(0, 1) == false);
+    CHECK(m(0, 2) == 3);
+    CHECK(m(1, 1) == 5);
+
+    m(1, 2) = 6;
+    CHECK(m.allocated() == 4);
+    CHECK(m.peek(1, 2) == true);
+
+    DynamicSparseMatrix<T> empty;
+    CHECK(empty.rows() == 0);
+    CHECK(empty.size() == 0);
+    CHECK(empty.memory_bytes() == sizeof(empty));
+    CHECK(m.memory_bytes() > sizeof(m) + 4 * (sizeof(std::pair<size_t, size_t>) + sizeof(T)));
+}
+
+TEST_CASE_TEMPLATE("dynamic matrix conversion", T, int, float, double)
+{
+    SparseMatrix<2, 3, T> s = {
+        { {0, 1}, 2 },
+        { {1, 2}, 3 },
+    };
+
+    DynamicSparseMatrix<T> d(s);
+    CHECK(d.rows() == 2);
+    CHECK(d.cols() == 3);
+    CHECK(d(0, 1) == 2);
+    CHECK(d(1, 2) == 3);
+
+    SparseMatrix<2, 3, T> t = d.template to_fixed<2, 3>();
+    CHECK(t == s);
+
+    REQUIRE_THROWS_AS( (d.template to_fixed<3, 2>()), const std::out_of_range& );
+}
+
+TEST_CASE_TEMPLATE("dynamic matrix arithmetic operators", T, int, float, double)
+{
+    SparseMatrix<2, 2, T> s {
+        { {0, 0}, 1 },
+        { {0, 1}, 2 },
+        { {1, 1}, 4 },
+    };
+
+    SparseMatrix<2, 2, T> t {
+        { {0, 0}, 5 },
+        { {1, 0}, 7 },
+        { {1, 1}, 8 },
+    };
+
+    DynamicSparseMatrix<T> ds(s);
+    DynamicSparseMatrix<T> dt(t);
+
+    SUBCASE("equality")
+    {
+        CHECK(ds == DynamicSparseMatrix<T>(s));
+        CHECK(ds != dt);
+        CHECK(DynamicSparseMatrix<T>(2, 3) != DynamicSparseMatrix<T>(3, 2));
+    }
+
+    SUBCASE("unitary operators")
+    {
+        CHECK(+ds == ds);
+        CHECK((-ds).template to_fixed<2, 2>() == -s);
+    }
+
+    SUBCASE("addition and subtraction")
+    {
+        CHECK((ds + dt).template to_fixed<2, 2>() == s + t);
+        CHECK((ds - dt).template to_fixed<2, 2>() == s - t);
+
+        DynamicSparseMatrix<T> u = ds;
+        u += dt;
+        u -= dt;
+        CHECK(u.template to_fixed<2, 2>() == s + t - t);
+    }
+
+    SUBCASE("scaling")
+    {
+        CHECK((T(3) * ds).template to_fixed<2, 2>() == T(3) * s);
+        CHECK(ds * T(3) == T(3) * ds);
+    }
+
+    SUBCASE("multiplication")
+    {
+        CHECK((ds * dt).template to_fixed<2, 2>() == s * t);
+
+        SparseMatrix<2, 3, T> u = {
+            { {0, 0}, 1 },
+            { {0, 2}, 3 },
+            { {1, 1}, 5 },
+        };
+        DynamicSparseMatrix<T> du(u);
+        CHECK((ds * du).template to_fixed<2, 3>() == s * u);
+        CHECK((du.transpose() * ds).template to_fixed<3, 2>() == u.transpose() * s);
+    }
+
+    SUBCASE("transpose")
+    {
+        SparseMatrix<2, 3, T> u = {
+            { {0, 0}, 1 },
+            { {0, 2}, 3 },
+            { {1, 1}, 5 },
+        };
+        CHECK(DynamicSparseMatrix<T>(u).transpose() == DynamicSparseMatrix<T>(u.transpose()));
+    }
+
+    SUBCASE("matrix-vector product")
+    {
+        std::vector<T> x = {1, 2};
+        std::vector<T> y(2);
+        std::vector<T> z(2);
+        ds.multiply(x, y);
+        s.multiply(x, z);
+        CHECK(y == z);
+
+        ds.multiply(2, x, 1, y);
+        CHECK(y == std::vector<T>({15, 24}));
+    }
+}
+
+TEST_CASE_TEMPLATE("dynamic matrix dimension checks", T, int, float, double)
+{
+    DynamicSparseMatrix<T> s(2, 3);
+    DynamicSparseMatrix<T> t(3, 2);
+
+    SUBCASE("out of bounds")
+    {
+        REQUIRE_THROWS_AS( (DynamicSparseMatrix<T>(2, 3, { { {3, 4}, 1 } })), const std::out_of_range& );
+        REQUIRE_THROWS_AS( s(2, 0) = 6, const std::out_of_range& );
+        REQUIRE_THROWS_AS( s.peek(0, 3), const std::out_of_range& );
+    }
+
+    SUBCASE("dimension mismatch")
+    {
+        REQUIRE_THROWS_AS( s + t, const std::out_of_range& );
+        REQUIRE_THROWS_AS( s - t, const std::out_of_range& );
+        REQUIRE_THROWS_AS( s += t, const std::out_of_range& );
+        REQUIRE_THROWS_AS( s -= t, const std::out_of_range& );
+        REQUIRE_THROWS_AS( s * s, const std::out_of_range& );
+        CHECK_NOTHROW( s * t );
+    }
+
+    SUBCASE("vector size mismatch")
+    {
+        std::vector<T> x(2);
+        std::vector<T> y(2);
+        REQUIRE_THROWS_AS( s.multiply(x, y), const std::out_of_range& );
+    }
+}
@@ -0,0 +1,113 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include "sparsematrix.h"
+
+
+TEST_CASE_TEMPLATE("chained expressions", T, int, float, double)
+{
+    SparseMatrix<2, 3, T> a = {
+        { {0, 0}, 1 },
+        { {0, 2}, 2 },
+        { {1, 1}, 3 },
+    };
+    SparseMatrix<2, 3, T> b = {
+        { {0, 0}, 4 },
+        { {1, 0}, 5 },
+    };
+    SparseMatrix<2, 3, T> c = {
+        { {0, 2}, 1 },
+        { {1, 1}, 1 },
+        { {1, 2}, 6 },
+    };
+
+    SUBCASE("single pass matches separate operations")
+    {
+        SparseMatrix<2, 3, T> d = 2 * a + b - c * 3;
+
+        SparseMatrix<2, 3, T> expected = {
+            { {0, 0}, 6 },
+            { {0, 2}, 1 },
+            { {1, 0}, 5 },
+            { {1, 1}, 3 },
+            { {1, 2}, -18 },
+        };
+        CHECK(d == expected);
+
+        SparseMatrix<2, 3, T> step = 2 * a;
+        step += b;
+        step -= 3 * c;
+        CHECK(d == step);
+    }
+
+    SUBCASE("allocated elements are the union of the operands")
+    {
+        SparseMatrix<2, 3, T> d = a - a + b;
+        CHECK(d.allocated() == 4);
+        CHECK(d.peek(0, 2) == true);
+        CHECK(d(0, 2) == 0);
+        CHECK(d(1, 0) == 5);
+    }
+
+    SUBCASE("negation and scaling")
+    {
+        SparseMatrix<2, 3, T> d = -a;
+        CHECK(d(0, 2) == -2);
+        CHECK(d.allocated() == 3);
+        CHECK(-(-a) == a);
+        CHECK((a * 2) * 3 == 6 * a);
+        CHECK(-b + a == a - b);
+    }
+
+    SUBCASE("assignment to an operand")
+    {
+        a = a + b;
+        CHECK(a(0, 0) == 5);
+        CHECK(a(1, 0) == 5);
+        CHECK(a.allocated() == 4);
+
+        b = c - 2 * b;
+        CHECK(b(0, 0) == -8);
+        CHECK(b(1, 2) == 6);
+        CHECK(b.allocated() == 5);
+    }
+
+    SUBCASE("evaluation")
+    {
+        CHECK((a + b).eval() == a + b);
+        CHECK((a + b).eval().allocated() == 4);
+        CHECK((a + b) != (a - b));
+    }
+
+    SUBCASE("products of expressions")
+    {
+        SparseMatrix<3, 2, T> e = {
+            { {0, 1}, 1 },
+            { {2, 0}, 2 },
+        };
+
+        SparseMatrix<2, 3, T> sum = a + b;
+        SparseMatrix<3, 2, T> scaled = 2 * e;
+        CHECK((a + b) * (2 * e) == sum * scaled);
+        CHECK((a + b) * e == sum * e);
+        CHECK(a * (e + e) == a * scaled);
+    }
+}
@@ -0,0 +1,172 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "cscmatrix.h"
+#include "csrmatrix.h"
+#include "dynamicsparsematrix.h"
+#include "sellmatrix.h"
+#include "sparsematrix.h"
+
+
+TEST_CASE_TEMPLATE("matrix with a small index type", T, int, float, double)
+{
+    SparseMatrix<60000, 60000, T, uint16_t> m = {
+        { {0, 0}, 1 },
+        { {0, 59999}, 2 },
+        { {59999, 0}, 3 },
+    };
+    m(59999, 59999) = 4;
+
+    CHECK(m.size() == 3600000000u);
+    CHECK(m.allocated() == 4);
+    CHECK(m.peek(59999, 59999) == true);
+    CHECK(m.peek(1, 1) == false);
+    CHECK(m(0, 59999) == 2);
+    CHECK(m.cbegin()->first.first == 0);
+    CHECK(sizeof(m.cbegin()->first) == 2 * sizeof(uint16_t));
+
+    SparseMatrix<60000, 60000, T> wide;
+    for (auto elem = m.cbegin(); elem != m.cend(); ++elem)
+    {
+        wide(elem->first.first, elem->first.second) = elem->second;
+    }
+    CHECK(m.memory_bytes() < wide.memory_bytes());
+    CHECK_THROWS_AS(m(60000, 0), std::out_of_range);
+
+    SparseMatrix<60000, 60000, T, uint16_t> t = m.transpose();
+    CHECK(t(59999, 0) == 2);
+    CHECK(t(0, 59999) == 3);
+}
+
+TEST_CASE_TEMPLATE("multiplication with indices at the limit of the index type", T, int, float, double)
+{
+    // The last row of b has index 65535, the largest value of the index type.
+    SparseMatrix<2, 65536, T, uint16_t> a = {
+        { {0, 65534}, 2 },
+        { {0, 65535}, 3 },
+        { {1, 65535}, 4 },
+    };
+    SparseMatrix<65536, 2, T, uint16_t> b = {
+        { {0, 0}, 7 },
+        { {65534, 1}, 5 },
+        { {65535, 0}, 6 },
+    };
+
+    SparseMatrix<2, 2, T, uint16_t> expected = {
+        { {0, 0}, 18 },
+        { {0, 1}, 10 },
+        { {1, 0}, 24 },
+    };
+    CHECK(a * b == expected);
+
+    CsrMatrix<2, 65536, T, uint16_t> ca(a);
+    CsrMatrix<65536, 2, T, uint16_t> cb(b);
+    CHECK((ca * cb).to_sparse() == expected);
+}
+
+TEST_CASE_TEMPLATE("compressed storage with a small index type", T, int, float, double)
+{
+    SparseMatrix<3, 4, T, uint8_t> s = {
+        { {0, 1}, 1 },
+        { {0, 3}, 2 },
+        { {1, 0}, 3 },
+        { {2, 2}, 4 },
+        { {2, 3}, 5 },
+    };
+
+    CsrMatrix<3, 4, T, uint8_t> c(s);
+    CHECK((std::is_same<typename std::decay<decltype(c.col_idx())>::type, std::vector<uint8_t>>::value));
+    CHECK(c.col_idx() == std::vector<uint8_t>({1, 3, 0, 2, 3}));
+    CHECK(c.to_sparse() == s);
+    CHECK(c.transpose().to_sparse() == s.transpose());
+
+    CscMatrix<3, 4, T, uint8_t> d(s);
+    CHECK((std::is_same<typename std::decay<decltype(d.row_idx())>::type, std::vector<uint8_t>>::value));
+    CHECK(d.row_idx() == std::vector<uint8_t>({1, 0, 2, 0, 2}));
+    CHECK(d.to_csr() == c);
+    CHECK(d.to_sparse() == s);
+    CHECK(d.column(3)(2, 0) == 5);
+
+    // The result does not depend on the index type.
+    CsrMatrix<3, 4, T> wide = {
+        { {0, 1}, 1 },
+        { {0, 3}, 2 },
+        { {1, 0}, 3 },
+        { {2, 2}, 4 },
+        { {2, 3}, 5 },
+    };
+    const std::vector<T> x = {1, 2, 3, 4};
+    std::vector<T> y(3);
+    std::vector<T> y_wide(3);
+    c.multiply(x, y);
+    wide.multiply(x, y_wide);
+    CHECK(y == y_wide);
+    CHECK(y == std::vector<T>({10, 3, 32}));
+}
+
+TEST_CASE_TEMPLATE("dynamic matrix with a small index type", T, int, float, double)
+{
+    DynamicSparseMatrix<T, uint8_t> m(256, 256, {
+        { {0, 255}, 1 },
+        { {255, 0}, 2 },
+    });
+    CHECK(m(255, 0) == 2);
+    CHECK(m.transpose()(0, 255) == 2);
+
+    SparseMatrix<256, 256, T, uint8_t> s = m.template to_fixed<256, 256>();
+    CHECK(s(0, 255) == 1);
+    CHECK(DynamicSparseMatrix<T, uint8_t>(s) == m);
+
+    CHECK_THROWS_AS((DynamicSparseMatrix<T, uint8_t>(257, 1)), std::out_of_range);
+    CHECK_THROWS_AS((DynamicSparseMatrix<T, uint8_t>(1, 257)), std::out_of_range);
+}
+
+TEST_CASE_TEMPLATE("sliced storage with a full row at the limit of the index type", T, int, float, double)
+{
+    // A full row has 256 elements, one more than the largest value of the index type.
+    SparseMatrix<2, 256, T, uint8_t> s;
+    for (size_t j = 0; j < 256; ++j)
+    {
+        s(0, j) = 1;
+    }
+    s(1, 255) = 2;
+
+    const CsrMatrix<2, 256, T, uint8_t> c(s);
+    for (const size_t sigma : {size_t(1), size_t(256)})
+    {
+        const SellMatrix<2, 256, T, uint8_t, 2> m(c, sigma);
+        CHECK(m.allocated() == 257);
+        CHECK(m.stored() == 512);
+        CHECK(m(0, 5) == 1);
+        CHECK(m(0, 255) == 1);
+        CHECK(m(1, 255) == 2);
+        CHECK(m.to_csr() == c);
+
+        const std::vector<T> x(256, 1);
+        std::vector<T> y(2);
+        m.multiply(x, y);
+        CHECK(y == std::vector<T>({256, 2}));
+    }
+}
@@ -0,0 +1,405 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "csrmatrix.h"
+#include "dynamicsparsematrix.h"
+#include "matrixmarket.h"
+#include "sparsematrix.h"
+#include "sparsematrixbuilder.h"
+
+
+//! Name of the file used by the tests.
+static const char* filename = "test_matrix_market.mtx";
+
+//! Write text to the test file.
+static void write_file(const std::string& text)
+{
+    std::ofstream file(filename, std::ios::binary);
+    file << text;
+}
+
+
+TEST_CASE("number parsing")
+{
+    const char* p;
+    unsigned long long u;
+    long long n;
+    double x;
+
+    p = " 42 7";
+    CHECK(sparsematrix_detail::parse_unsigned(p, u) == true);
+    CHECK(u == 42);
+    CHECK(sparsematrix_detail::parse_unsigned(p, u) == true);
+    CHECK(u == 7);
+    CHECK(sparsematrix_detail::parse_unsigned(p, u) == false);
+
+    p = "18446744073709551616";
+    CHECK(sparsematrix_detail::parse_unsigned(p, u) == false);
+    p = "12x";
+    CHECK(sparsematrix_detail::parse_unsigned(p, u) == false);
+
+    p = "-9223372036854775808";
+    CHECK(sparsematrix_detail::parse_integer(p, n) == true);
+    CHECK(n == -9223372036854775807LL - 1);
+    p = "+5";
+    CHECK(sparsematrix_detail::parse_integer(p, n) == true);
+    CHECK(n == 5);
+    p = "- 5";
+    CHECK(sparsematrix_detail::parse_integer(p, n) == false);
+
+    p = "\t-.5e1 ";
+    CHECK(sparsematrix_detail::parse_real(p, x) == true);
+    CHECK(x == -5.0);
+    p = "inf";
+    CHECK(sparsematrix_detail::parse_real(p, x) == true);
+    CHECK(x == std::numeric_limits<double>::infinity());
+    p = "1.5.";
+    CHECK(sparsematrix_detail::parse_real(p, x) == false);
+    p = "e5";
+    CHECK(sparsematrix_detail::parse_real(p, x) == false);
+    p = "1e";
+    CHECK(sparsematrix_detail::parse_real(p, x) == false);
+
+    // Both the fast path and the fallback give the correctly rounded result.
+    std::mt19937_64 generator(1);
+    std::uniform_real_distribution<double> mantissa(-10.0, 10.0);
+    std::uniform_int_distribution<int> exponent(-40, 40);
+    const char* formats[] = {"%.17g", "%.6g", "%.3e", "%.25f", "%.0f"};
+    for (size_t k = 0; k < 10000; ++k)
+    {
+        char text[128];
+        std::snprintf(text, sizeof(text), formats[k % 5], mantissa(generator) * std::pow(10.0, exponent(generator)));
+        p = text;
+        REQUIRE(sparsematrix_detail::parse_real(p, x) == true);
+        CHECK(x == std::strtod(text, nullptr));
+    }
+}
+
+TEST_CASE_TEMPLATE("reading", T, int, float, double)
+{
+    SUBCASE("general real, with comments")
+    {
+        write_file("%%MatrixMarket matrix coordinate real general\n"
+                   "% a comment\n"
+                   "%\n"
+                   "\n"
+                   "3 4 5\n"
+                   "1 1 1.5e1\n"
+                   "3 4 -2\n"
+                   "  2 2\t7.0  \n"
+                   "1 1 3\n"
+                   "1 3 0\n");
+        MatrixMarketReader reader(filename);
+        CHECK(reader.rows() == 3);
+        CHECK(reader.cols() == 4);
+        CHECK(reader.entries() == 5);
+        CHECK(reader.field() == MatrixMarketField::Real);
+        CHECK(reader.symmetry() == MatrixMarketSymmetry::General);
+
+        SparseMatrixBuilder<3, 4, T> builder;
+        reader.read(builder);
+        CHECK(builder.size() == 5);
+
+        SparseMatrix<3, 4, T> expected = {
+            { {0, 0}, 18 },
+            { {0, 2}, 0 },
+            { {1, 1}, 7 },
+            { {2, 3}, -2 },
+        };
+        CHECK(builder.build() == expected);
+        CHECK_THROWS_AS(reader.read(builder), std::runtime_error);
+    }
+
+    SUBCASE("symmetric integer, with CRLF line breaks")
+    {
+        write_file("%%MatrixMarket Matrix Coordinate Integer Symmetric\r\n"
+                   "3 3 3\r\n"
+                   "1 1 2\r\n"
+                   "3 1 -4\r\n"
+                   "3 2 5");
+        MatrixMarketReader reader(filename);
+        CHECK(reader.field() == MatrixMarketField::Integer);
+        CHECK(reader.symmetry() == MatrixMarketSymmetry::Symmetric);
+
+        DynamicSparseMatrix<T> d;
+        reader.read(d);
+        CHECK(d.rows() == 3);
+        CHECK(d.cols() == 3);
+        CHECK(d.allocated() == 5);
+        CHECK(d(0, 0) == 2);
+        CHECK(d(2, 0) == -4);
+        CHECK(d(0, 2) == -4);
+        CHECK(d(1, 2) == 5);
+        CHECK(d(2, 1) == 5);
+    }
+
+    SUBCASE("pattern, with duplicates")
+    {
+        write_file("%%MatrixMarket matrix coordinate pattern general\n"
+                   "2 3 3\n"
+                   "2 3\n"
+                   "1 1\n"
+                   "2 3\n");
+        MatrixMarketReader reader(filename);
+        CHECK(reader.field() == MatrixMarketField::Pattern);
+
+        DynamicSparseMatrix<T> d;
+        reader.read(d);
+        CHECK(d.allocated() == 2);
+        CHECK(d(0, 0) == 1);
+        CHECK(d(1, 2) == 2);
+    }
+
+    SUBCASE("long lines")
+    {
+        write_file("%%MatrixMarket matrix coordinate real general\n%" + std::string(3 << 20, 'x') + "\n1 1 1\n1 1 4\n");
+        MatrixMarketReader reader(filename);
+        SparseMatrixBuilder<1, 1, T> builder;
+        reader.read(builder);
+        CHECK(builder.build()(0, 0) == 4);
+    }
+
+    SUBCASE("errors")
+    {
+        CHECK_THROWS_AS(MatrixMarketReader("no_such_file.mtx"), std::runtime_error);
+
+        write_file("");
+        CHECK_THROWS_AS(MatrixMarketReader reader(filename), std::runtime_error);
+        write_file("%%MatrixMarket matrix array real general\n2 2\n");
+        CHECK_THROWS_AS(MatrixMarketReader reader(filename), std::runtime_error);
+        write_file("%%MatrixMarket matrix coordinate complex general\n2 2 0\n");
+        CHECK_THROWS_AS(MatrixMarketReader reader(filename), std::runtime_error);
+        write_file("%%MatrixMarket matrix coordinate real skew-symmetric\n2 2 0\n");
+        CHECK_THROWS_AS(MatrixMarketReader reader(filename), std::runtime_error);
+        write_file("%%MatrixMarket matrix coordinate real symmetric\n2 3 0\n");
+        CHECK_THROWS_AS(MatrixMarketReader reader(filename), std::runtime_error);
+        write_file("%%MatrixMarket matrix coordinate real general\n2 x 0\n");
+        CHECK_THROWS_AS(MatrixMarketReader reader(filename), std::runtime_error);
+        write_file("%%MatrixMarket matrix coordinate real general\n2 2 99999999999999\n");
+        CHECK_THROWS_AS(MatrixMarketReader reader(filename), std::runtime_error);
+        write_file("%%MatrixMarket matrix coordinate real general\n2 2 5\n");
+        CHECK_THROWS_AS(MatrixMarketReader reader(filename), std::runtime_error);
+        write_file("%%MatrixMarket matrix coordinate real symmetric\n3 3 7\n");
+        CHECK_THROWS_AS(MatrixMarketReader reader(filename), std::runtime_error);
+        write_file("%%MatrixMarket matrix coordinate real symmetric\n3 3 6\n");
+        CHECK(MatrixMarketReader(filename).entries() == 6);
+        write_file("%%MatrixMarket matrix coordinate real general\n2 3 6\n");
+        CHECK(MatrixMarketReader(filename).entries() == 6);
+
+        SparseMatrixBuilder<2, 2, T> builder;
+
+        write_file("%%MatrixMarket matrix coordinate real general\n3 2 0\n");
+        MatrixMarketReader wrong_size(filename);
+        CHECK_THROWS_AS(wrong_size.read(builder), std::out_of_range);
+
+        write_file("%%MatrixMarket matrix coordinate real general\n2 2 1\n3 1 1\n");
+        MatrixMarketReader out_of_bounds(filename);
+        CHECK_THROWS_AS(out_of_bounds.read(builder), std::out_of_range);
+
+        write_file("%%MatrixMarket matrix coordinate real general\n2 2 1\n0 1 1\n");
+        MatrixMarketReader zero_index(filename);
+        CHECK_THROWS_AS(zero_index.read(builder), std::out_of_range);
+
+        write_file("%%MatrixMarket matrix coordinate real general\n2 2 2\n1 1 1\n");
+        MatrixMarketReader truncated(filename);
+        CHECK_THROWS_AS(truncated.read(builder), std::runtime_error);
+
+        // A count that passes the header check but is far larger than the file reserves only a bounded amount of
+        // memory, and fails at the end of the file.
+        write_file("%%MatrixMarket matrix coordinate real general\n100000000 100000000 1000000000000\n1 1 1\n");
+        MatrixMarketReader huge_count(filename);
+        DynamicSparseMatrix<T> d;
+        CHECK_THROWS_AS(huge_count.read(d), std::runtime_error);
+
+        write_file("%%MatrixMarket matrix coordinate integer general\n2 2 1\n1 1 1.5\n");
+        MatrixMarketReader not_integer(filename);
+        CHECK_THROWS_AS(not_integer.read(builder), std::runtime_error);
+
+        write_file("%%MatrixMarket matrix coordinate real general\n2 2 1\n1 1 1 1\n");
+        MatrixMarketReader extra_text(filename);
+        CHECK_THROWS_AS(extra_text.read(builder), std::runtime_error);
+    }
+
+    std::remove(filename);
+}
+
+TEST_CASE_TEMPLATE("writing", T, int, float, double)
+{
+    SparseMatrix<3, 4, T> s = {
+        { {0, 0}, 1 },
+        { {0, 3}, -2 },
+        { {1, 2}, 0 },
+        { {2, 1}, 3 },
+    };
+    s(2, 2) = static_cast<T>(1) / 3;
+
+    SUBCASE("map storage")
+    {
+        write_matrix_market(filename, s);
+        MatrixMarketReader reader(filename);
+        CHECK(reader.field() == (std::is_integral<T>::value ? MatrixMarketField::Integer : MatrixMarketField::Real));
+        CHECK(reader.entries() == 5);
+
+        SparseMatrixBuilder<3, 4, T> builder;
+        reader.read(builder);
+        CHECK(builder.build() == s);
+    }
+
+    SUBCASE("compressed storage")
+    {
+        write_matrix_market(filename, CsrMatrix<3, 4, T>(s));
+        SparseMatrixBuilder<3, 4, T> builder;
+        MatrixMarketReader(filename).read(builder);
+        CHECK(builder.build_csr() == CsrMatrix<3, 4, T>(s));
+    }
+
+    SUBCASE("runtime dimensions")
+    {
+        DynamicSparseMatrix<T> d(s);
+        write_matrix_market(filename, d);
+        DynamicSparseMatrix<T> e;
+        MatrixMarketReader(filename).read(e);
+        CHECK(e == d);
+    }
+
+    SUBCASE("pattern")
+    {
+        write_matrix_market(filename, s, MatrixMarketSymmetry::General, MatrixMarketField::Pattern);
+        MatrixMarketReader reader(filename);
+        CHECK(reader.field() == MatrixMarketField::Pattern);
+        CHECK(reader.symmetry() == MatrixMarketSymmetry::General);
+        CHECK(reader.entries() == 5);
+
+        DynamicSparseMatrix<T> e;
+        reader.read(e);
+        CHECK(e.allocated() == 5);
+        for (auto elem = s.cbegin(); elem != s.cend(); ++elem)
+        {
+            CHECK(e(elem->first.first, elem->first.second) == 1);
+        }
+    }
+
+    SUBCASE("symmetric")
+    {
+        SparseMatrix<3, 3, T> a = {
+            { {0, 0}, 4 },
+            { {0, 2}, -1 },
+            { {1, 1}, 5 },
+            { {1, 2}, 2 },
+            { {2, 0}, -1 },
+            { {2, 1}, 2 },
+        };
+
+        write_matrix_market(filename, a, MatrixMarketSymmetry::Symmetric);
+        MatrixMarketReader reader(filename);
+        CHECK(reader.symmetry() == MatrixMarketSymmetry::Symmetric);
+        CHECK(reader.entries() == 4);
+        SparseMatrixBuilder<3, 3, T> builder;
+        reader.read(builder);
+        CHECK(builder.build() == a);
+
+        write_matrix_market(filename, CsrMatrix<3, 3, T>(a), MatrixMarketSymmetry::Symmetric);
+        MatrixMarketReader csr_reader(filename);
+        CHECK(csr_reader.entries() == 4);
+        SparseMatrixBuilder<3, 3, T> csr_builder;
+        csr_reader.read(csr_builder);
+        CHECK(csr_builder.build_csr() == CsrMatrix<3, 3, T>(a));
+
+        write_matrix_market(filename, DynamicSparseMatrix<T>(a), MatrixMarketSymmetry::Symmetric,
+                            MatrixMarketField::Pattern);
+        MatrixMarketReader pattern_reader(filename);
+        CHECK(pattern_reader.field() == MatrixMarketField::Pattern);
+        CHECK(pattern_reader.entries() == 4);
+        DynamicSparseMatrix<T> e;
+        pattern_reader.read(e);
+        CHECK(e.allocated() == 6);
+        CHECK(e(2, 0) == 1);
+        CHECK(e(0, 2) == 1);
+    }
+
+    SUBCASE("errors")
+    {
+        CHECK_THROWS_AS(write_matrix_market(filename, s, MatrixMarketSymmetry::Symmetric), std::out_of_range);
+        CHECK_THROWS_AS(write_matrix_market(filename, CsrMatrix<3, 4, T>(s), MatrixMarketSymmetry::Symmetric),
+                        std::out_of_range);
+        if (!std::is_integral<T>::value)
+        {
+            CHECK_THROWS_AS(write_matrix_market(filename, s, MatrixMarketSymmetry::General, MatrixMarketField::Integer),
+                            std::runtime_error);
+        }
+    }
+
+    SUBCASE("empty matrix")
+    {
+        write_matrix_market(filename, SparseMatrix<3, 4, T>());
+        DynamicSparseMatrix<T> e;
+        MatrixMarketReader(filename).read(e);
+        CHECK(e == DynamicSparseMatrix<T>(3, 4));
+    }
+
+    std::remove(filename);
+}
+
+TEST_CASE("writing wide values")
+{
+    SUBCASE("unsigned integers")
+    {
+        SparseMatrix<1, 2, unsigned long long> u;
+        u(0, 0) = std::numeric_limits<unsigned long long>::max();
+        u(0, 1) = 1ULL << 63;
+        write_matrix_market(filename, u);
+
+        std::ifstream file(filename);
+        std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        CHECK(text.find("1 1 18446744073709551615\n") != std::string::npos);
+        CHECK(text.find("1 2 9223372036854775808\n") != std::string::npos);
+    }
+
+    SUBCASE("long double")
+    {
+        SparseMatrix<1, 1, long double> l;
+        l(0, 0) = 1.0L / 3;
+        write_matrix_market(filename, l);
+
+        std::ifstream file(filename);
+        std::string line;
+        std::string last;
+        while (std::getline(file, line))
+        {
+            last = line;
+        }
+        CHECK(last.compare(0, 4, "1 1 ") == 0);
+        CHECK(std::strtold(last.c_str() + 4, nullptr) == l(0, 0));
+    }
+
+    std::remove(filename);
+}
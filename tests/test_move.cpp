@@ -0,0 +1,147 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#include "sparsematrix.h"
+
+
+//! Number of allocations with the global operator new.
+static size_t allocations = 0;
+
+// GCC sees that the replaced operator delete frees memory from the replaced operator new and warns about the mismatch;
+// the pair uses malloc and free consistently.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+#pragma GCC diagnostic pop
+
+
+TEST_CASE_TEMPLATE("move construction and assignment", T, int, float, double)
+{
+    SparseMatrix<3, 3, T> a = {
+        { {0, 0}, 1 },
+        { {1, 2}, 2 },
+        { {2, 1}, 3 },
+    };
+    const SparseMatrix<3, 3, T> copy(a);
+
+    const size_t before = allocations;
+    SparseMatrix<3, 3, T> b(std::move(a));
+    SparseMatrix<3, 3, T> c;
+    c = std::move(b);
+    const size_t count = allocations - before;
+
+    CHECK(count == 0);
+    CHECK(c == copy);
+}
+
+TEST_CASE_TEMPLATE("operators reuse temporaries", T, int, float, double)
+{
+    const SparseMatrix<3, 3, T> a = {
+        { {0, 0}, 1 },
+        { {0, 2}, 2 },
+        { {1, 1}, 3 },
+        { {2, 0}, 4 },
+        { {2, 2}, 5 },
+    };
+    const SparseMatrix<3, 3, T> b = {
+        { {0, 2}, 1 },
+        { {2, 0}, 2 },
+    };
+    const SparseMatrix<3, 3, T> c = {
+        { {1, 1}, 1 },
+    };
+
+    SUBCASE("negation of a product")
+    {
+        size_t before = allocations;
+        SparseMatrix<3, 3, T> product = a * b;
+        const size_t product_count = allocations - before;
+
+        before = allocations;
+        SparseMatrix<3, 3, T> negated = -(a * b);
+        const size_t negated_count = allocations - before;
+
+        CHECK(negated_count == product_count);
+        CHECK(negated == -product);
+    }
+
+    SUBCASE("chain on a temporary")
+    {
+        SparseMatrix<3, 3, T> expected = 2 * (a - b) + c;
+        SparseMatrix<3, 3, T> d(a);
+
+        const size_t before = allocations;
+        SparseMatrix<3, 3, T> e = 2 * (std::move(d) - b) + c;
+        e = -std::move(e) * 3;
+        e = b + std::move(e);
+        e = c - std::move(e);
+        const size_t count = allocations - before;
+
+        CHECK(count == 0);
+        CHECK(e == c - (b - 3 * expected));
+    }
+
+    SUBCASE("new elements are allocated")
+    {
+        SparseMatrix<3, 3, T> d(b);
+
+        const size_t before = allocations;
+        SparseMatrix<3, 3, T> e = std::move(d) + c;
+        const size_t count = allocations - before;
+
+        CHECK(count == 1);
+        CHECK(e == b + c);
+        CHECK(e.allocated() == 3);
+    }
+
+    SUBCASE("two temporaries")
+    {
+        SparseMatrix<3, 3, T> d(a);
+        SparseMatrix<3, 3, T> e(b);
+
+        const size_t before = allocations;
+        SparseMatrix<3, 3, T> f = std::move(d) - std::move(e);
+        const size_t count = allocations - before;
+
+        CHECK(count == 0);
+        CHECK(f == a - b);
+    }
+}
@@ -276,3 +276,46 @@ TEST_CASE_TEMPLATE("multiplication 2d edge cases", T, int, float, double)
         CHECK(u(1, 0) == 0);
     }
 }
+
+
+TEST_CASE_TEMPLATE("multiplication 2d larger sparse matrices", T, int, float, double)
+{
+    // Pseudo-random sparse matrices, compared against a dense reference product.
+    SparseMatrix<20, 30, T> s;
+    SparseMatrix<30, 10, T> t;
+    for (size_t n = 0; n < 60; ++n)
+    {
+        s((n * 7) % 20, (n * 13) % 30) = static_cast<T>(n % 5 + 1);
+        t((n * 11) % 30, (n * 3) % 10) = static_cast<T>(n % 3 + 1);
+    }
+
+    SparseMatrix<20, 10, T> u = s * t;
+
+    size_t nonzero = 0;
+    for (size_t r = 0; r < 20; ++r)
+    {
+        for (size_t c = 0; c < 10; ++c)
+        {
+            T v = 0;
+            for (size_t i = 0; i < 30; ++i)
+            {
+                if (s.peek(r, i) && t.peek(i, c))
+                {
+                    v += s(r, i) * t(i, c);
+                }
+            }
+
+            if (v != 0)
+            {
+                ++nonzero;
+                CHECK(u.peek(r, c));
+                CHECK(u(r, c) == v);
+            }
+            else
+            {
+                CHECK_FALSE(u.peek(r, c));
+            }
+        }
+    }
+    CHECK(u.allocated() == nonzero);
+}
@@ -0,0 +1,256 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "csrmatrix.h"
+#include "threadpool.h"
+
+
+TEST_CASE("thread pool")
+{
+    SUBCASE("all tasks are executed once")
+    {
+        for (size_t threads = 1; threads <= 4; ++threads)
+        {
+            ThreadPool pool(threads);
+            CHECK(pool.size() == threads);
+
+            std::vector<std::atomic<int>> counts(100);
+            for (auto& count : counts)
+            {
+                count = 0;
+            }
+
+            for (int batch = 0; batch < 10; ++batch)
+            {
+                pool.run(counts.size(), [&counts](size_t n) { ++counts[n]; });
+            }
+
+            for (auto& count : counts)
+            {
+                CHECK(count == 10);
+            }
+        }
+    }
+
+    SUBCASE("exceptions are rethrown")
+    {
+        for (size_t threads = 1; threads <= 4; ++threads)
+        {
+            ThreadPool pool(threads);
+
+            std::atomic<int> executed(0);
+            auto task = [&executed](size_t n)
+            {
+                ++executed;
+                if (n == 3)
+                {
+                    throw std::runtime_error("task failed");
+                }
+            };
+            REQUIRE_THROWS_AS( pool.run(8, task), const std::runtime_error& );
+            CHECK(executed == 8);
+
+            // The pool is still usable afterwards.
+            pool.run(8, [&executed](size_t) { ++executed; });
+            CHECK(executed == 16);
+        }
+    }
+}
+
+TEST_CASE("row partitioning")
+{
+    // Row 2 holds most of the elements.
+    const std::vector<size_t> row_ptr = {0, 1, 2, 12, 13, 14, 16};
+
+    CHECK(sparsematrix_detail::csr_partition(row_ptr.data(), 6, 0, 4) == 0);
+    CHECK(sparsematrix_detail::csr_partition(row_ptr.data(), 6, 4, 4) == 6);
+
+    size_t previous = 0;
+    for (size_t part = 0; part <= 4; ++part)
+    {
+        const size_t first = sparsematrix_detail::csr_partition(row_ptr.data(), 6, part, 4);
+        CHECK(first >= previous);
+        previous = first;
+    }
+
+    // Empty matrix: everything ends up in the last part.
+    const std::vector<size_t> empty(4, 0);
+    CHECK(sparsematrix_detail::csr_partition(empty.data(), 3, 1, 2) == 0);
+    CHECK(sparsematrix_detail::csr_partition(empty.data(), 3, 2, 2) == 3);
+}
+
+TEST_CASE_TEMPLATE("parallel matrix-vector product", T, int, float, double)
+{
+    // A matrix with one dense row and otherwise short rows.
+    SparseMatrix<50, 40, T> s;
+    for (size_t j = 0; j < 40; ++j)
+    {
+        s(7, j) = static_cast<T>(j % 4 + 1);
+    }
+    for (size_t i = 0; i < 50; i += 3)
+    {
+        s(i, (i * 7) % 40) = static_cast<T>(i % 5 + 1);
+    }
+    CsrMatrix<50, 40, T> c(s);
+
+    std::vector<T> x(40);
+    for (size_t j = 0; j < 40; ++j)
+    {
+        x[j] = static_cast<T>(j % 3);
+    }
+
+    std::vector<T> expected(50);
+    c.multiply(x, expected);
+
+    for (size_t threads = 1; threads <= 5; ++threads)
+    {
+        ThreadPool pool(threads);
+
+        std::vector<T> y(50, 1);
+        c.multiply(pool, x, y);
+        CHECK(y == expected);
+
+        std::vector<T> z(50, 1);
+        c.multiply(pool, 2, x, 1, z);
+        for (size_t i = 0; i < 50; ++i)
+        {
+            CHECK(z[i] == 2 * expected[i] + 1);
+        }
+
+        std::array<T, 40> xa;
+        std::array<T, 50> ya;
+        std::copy(x.cbegin(), x.cend(), xa.begin());
+        c.multiply(pool, xa, ya);
+        CHECK(std::equal(ya.cbegin(), ya.cend(), expected.cbegin()));
+
+        std::vector<T> wrong(49);
+        REQUIRE_THROWS_AS( c.multiply(pool, x, wrong), const std::out_of_range& );
+    }
+}
+
+TEST_CASE_TEMPLATE("parallel sparse-dense matrix product", T, int, float, double)
+{
+    SparseMatrix<50, 40, T> s;
+    for (size_t j = 0; j < 40; ++j)
+    {
+        s(7, j) = static_cast<T>(j % 4 + 1);
+    }
+    for (size_t i = 0; i < 50; i += 3)
+    {
+        s(i, (i * 7) % 40) = static_cast<T>(i % 5 + 1);
+    }
+    CsrMatrix<50, 40, T> c(s);
+
+    const size_t k = 20;
+    std::vector<T> b(40 * k);
+    for (size_t n = 0; n < b.size(); ++n)
+    {
+        b[n] = static_cast<T>(n % 7);
+    }
+
+    std::vector<T> expected(50 * k);
+    c.multiply(k, b, expected);
+
+    for (size_t threads = 1; threads <= 5; ++threads)
+    {
+        ThreadPool pool(threads);
+
+        std::vector<T> out(50 * k, 1);
+        c.multiply(pool, k, b, out);
+        CHECK(out == expected);
+
+        std::vector<T> out_col(50 * k, 1);
+        c.multiply(pool, k, b, out_col, DenseLayout::ColumnMajor);
+        std::vector<T> expected_col(50 * k);
+        c.multiply(k, b, expected_col, DenseLayout::ColumnMajor);
+        CHECK(out_col == expected_col);
+
+        std::vector<T> wrong(49 * k);
+        REQUIRE_THROWS_AS( c.multiply(pool, k, b, wrong), const std::out_of_range& );
+    }
+}
+
+TEST_CASE("merge path search")
+{
+    // Rows of length 1, 0, 3; the merge path has 3 + 4 = 7 steps.
+    const std::vector<size_t> row_ptr = {0, 1, 1, 4};
+    const size_t rows[] = {0, 0, 1, 2, 2, 2, 2, 3};
+    const size_t elements[] = {0, 1, 1, 1, 2, 3, 4, 4};
+
+    for (size_t diagonal = 0; diagonal <= 7; ++diagonal)
+    {
+        size_t row, element;
+        sparsematrix_detail::merge_path_search(row_ptr.data(), 3, diagonal, row, element);
+        CHECK(row == rows[diagonal]);
+        CHECK(element == elements[diagonal]);
+    }
+}
+
+TEST_CASE_TEMPLATE("merge path matrix-vector product", T, int, float, double)
+{
+    // A matrix where one row holds most elements, plus empty rows.
+    SparseMatrix<30, 60, T> s;
+    for (size_t j = 0; j < 60; ++j)
+    {
+        s(11, j) = static_cast<T>(j % 4 + 1);
+    }
+    for (size_t i = 0; i < 30; i += 4)
+    {
+        s(i, (i * 7) % 60) = static_cast<T>(i % 5 + 1);
+        s(i, (i * 11 + 3) % 60) = static_cast<T>(i % 3 + 1);
+    }
+    CsrMatrix<30, 60, T> c(s);
+
+    std::vector<T> x(60);
+    for (size_t j = 0; j < 60; ++j)
+    {
+        x[j] = static_cast<T>(j % 3);
+    }
+
+    std::vector<T> expected(30);
+    c.multiply(x, expected);
+
+    for (size_t threads = 1; threads <= 9; ++threads)
+    {
+        ThreadPool pool(threads);
+
+        std::vector<T> y(30, 1);
+        c.multiply(pool, x, y, Partitioning::MergePath);
+        CHECK(y == expected);
+
+        std::vector<T> z(30, 1);
+        c.multiply(pool, 2, x, 3, z, Partitioning::MergePath);
+        for (size_t i = 0; i < 30; ++i)
+        {
+            CHECK(z[i] == 2 * expected[i] + 3);
+        }
+
+        CsrMatrix<30, 60, T> empty;
+        std::vector<T> w(30, 1);
+        empty.multiply(pool, x, w, Partitioning::MergePath);
+        CHECK(w == std::vector<T>(30, 0));
+    }
+}
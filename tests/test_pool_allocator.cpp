@@ -0,0 +1,168 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <cstddef>
+#include <utility>
+
+#include "csrmatrix.h"
+#include "dynamicsparsematrix.h"
+#include "poolallocator.h"
+#include "sparsematrix.h"
+
+
+TEST_CASE("node pool")
+{
+    sparsematrix_detail::NodePool pool;
+    CHECK(pool.capacity() == 0);
+
+    // Nothing is taken from the pool before the first allocation, which sets the block size.
+    CHECK(pool.accepts(40, 8) == false);
+    CHECK(pool.allocate(40, 2 * alignof(std::max_align_t)) == nullptr);
+    CHECK(pool.accepts(40, 8) == false);
+    char* a = static_cast<char*>(pool.allocate(40, 8));
+    CHECK(a != nullptr);
+    CHECK(pool.accepts(40, 8) == true);
+    CHECK(pool.accepts(36, 4) == true);
+    CHECK(pool.accepts(48, 8) == false);
+    CHECK(pool.accepts(2, 1) == false);
+    CHECK(pool.accepts(40, 2 * alignof(std::max_align_t)) == false);
+    CHECK(pool.allocate(48, 8) == nullptr);
+
+    // Blocks are carved from the same slab, and freed blocks are reused first.
+    char* b = static_cast<char*>(pool.allocate(40, 8));
+    CHECK(b == a + 40);
+    CHECK(pool.capacity() == 4096);
+
+    pool.deallocate(a);
+    CHECK(pool.allocate(40, 8) == a);
+    CHECK(pool.allocate(40, 8) == b + 40);
+
+    // Once the first slab is full, a larger one is allocated.
+    for (size_t n = 3; n < 4096 / 40 + 1; ++n)
+    {
+        pool.allocate(40, 8);
+    }
+    CHECK(pool.capacity() == 4096 + 8192);
+}
+
+TEST_CASE_TEMPLATE("pool allocator", T, int, float, double)
+{
+    typedef SparseMatrix<2, 3, T, size_t, PoolAllocator<T>> Matrix;
+
+    Matrix s = {
+        { {0, 0}, 1 },
+        { {0, 2}, 2 },
+        { {1, 1}, 3 },
+    };
+    SparseMatrix<2, 3, T> t = {
+        { {0, 0}, 4 },
+        { {1, 2}, 5 },
+    };
+
+    SUBCASE("elements are taken from the pool")
+    {
+        CHECK(s.allocated() == 3);
+        CHECK(s.get_allocator().capacity() == 4096);
+        CHECK(s(1, 1) == 3);
+
+        Matrix u;
+        CHECK(u.get_allocator().capacity() == 0);
+        u(1, 2) = 7;
+        CHECK(u.get_allocator().capacity() == 4096);
+        CHECK(u.get_allocator() != s.get_allocator());
+    }
+
+    SUBCASE("memory footprint includes the whole pool")
+    {
+        CHECK(s.memory_bytes() == sizeof(Matrix) + 4096);
+        CHECK(Matrix().memory_bytes() == sizeof(Matrix));
+        CHECK(t.memory_bytes() > sizeof(t));
+        CHECK(t.memory_bytes() < sizeof(t) + 4096);
+    }
+
+    SUBCASE("copies get their own pool")
+    {
+        Matrix u(s);
+        CHECK(u == s);
+        CHECK(u.get_allocator() != s.get_allocator());
+
+        u(0, 1) = 8;
+        CHECK(s.allocated() == 3);
+        CHECK(u.allocated() == 4);
+
+        u = s;
+        CHECK(u == s);
+    }
+
+    SUBCASE("moves take the pool along")
+    {
+        PoolAllocator<T> pool = s.get_allocator();
+        Matrix u(std::move(s));
+        CHECK(u.get_allocator() == pool);
+        CHECK(u.allocated() == 3);
+
+        Matrix v;
+        v = std::move(u);
+        CHECK(v.get_allocator() == pool);
+        CHECK(v(0, 2) == 2);
+    }
+
+    SUBCASE("operations")
+    {
+        Matrix u = 2 * s + t - s;
+        SparseMatrix<2, 3, T> expected = {
+            { {0, 0}, 5 },
+            { {0, 2}, 2 },
+            { {1, 1}, 3 },
+            { {1, 2}, 5 },
+        };
+        CHECK(u == expected);
+
+        u -= t;
+        u += s;
+        CHECK(u(0, 0) == 2);
+        CHECK(u(1, 2) == 0);
+
+        SparseMatrix<3, 2, T, size_t, PoolAllocator<T>> v = s.transpose();
+        CHECK(v(2, 0) == 2);
+
+        SparseMatrix<2, 2, T, size_t, PoolAllocator<T>> w = s * v;
+        CHECK(w(0, 0) == 5);
+        CHECK(w(1, 1) == 9);
+        CHECK(w.allocated() == 2);
+
+        SparseMatrix<2, 2, T> x = t * v;
+        CHECK(x(0, 0) == 4);
+        CHECK(x(1, 0) == 10);
+        CHECK(x.allocated() == 2);
+    }
+
+    SUBCASE("conversions")
+    {
+        CsrMatrix<2, 3, T> c(s);
+        CHECK(c.allocated() == 3);
+        CHECK(c(0, 2) == 2);
+
+        DynamicSparseMatrix<T> d(s);
+        CHECK(d.allocated() == 3);
+        CHECK(d(1, 1) == 3);
+    }
+}
@@ -0,0 +1,210 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "csrmatrix.h"
+#include "sellmatrix.h"
+#include "sparsematrix.h"
+#include "threadpool.h"
+
+
+//! Test matrix with rows of very different lengths, including empty rows.
+template <size_t M, size_t N, typename T, typename I>
+static SparseMatrix<M, N, T, I> uneven_matrix()
+{
+    SparseMatrix<M, N, T, I> s;
+    for (size_t i = 0; i < M; ++i)
+    {
+        const size_t length = (i * 7) % 23 == 0 ? 0 : (i * 13) % 17 + (i % 31 == 0 ? 40 : 0);
+        for (size_t n = 0; n < length; ++n)
+        {
+            s(i, (i * 3 + n * 5) % N) = static_cast<T>((i + n) % 9 + 1);
+        }
+    }
+    return s;
+}
+
+
+TEST_CASE("sliced storage conversion")
+{
+    const SparseMatrix<5, 4, double> s = {
+        { {0, 1}, 1 },
+        { {0, 3}, 2 },
+        { {2, 0}, 3 },
+        { {3, 0}, 4 },
+        { {3, 2}, 5 },
+        { {3, 3}, 6 },
+        { {4, 2}, 7 },
+    };
+    const CsrMatrix<5, 4, double> c(s);
+
+    SUBCASE("rows in original order")
+    {
+        const SellMatrix<5, 4, double, size_t, 2> m(s, 1);
+        CHECK(m.sigma() == 2);
+        CHECK(m.perm() == std::vector<size_t>({0, 1, 2, 3, 4}));
+        CHECK(m.chunk_ptr() == std::vector<size_t>({0, 4, 10, 12}));
+        CHECK(m.col_idx() == std::vector<size_t>({1, 0, 3, 0, 0, 0, 0, 2, 0, 3, 2, 0}));
+        CHECK(m.values() == std::vector<double>({1, 0, 2, 0, 3, 4, 0, 5, 0, 6, 7, 0}));
+        CHECK(m.stored() == 12);
+        CHECK(m.padding_overhead() == doctest::Approx(5.0 / 7.0));
+        CHECK(m.to_csr() == c);
+    }
+
+    SUBCASE("rows sorted by length")
+    {
+        const SellMatrix<5, 4, double, size_t, 2> m(c, 4);
+        CHECK(m.sigma() == 4);
+        CHECK(m.perm() == std::vector<size_t>({3, 0, 2, 1, 4}));
+        CHECK(m.chunk_ptr() == std::vector<size_t>({0, 6, 8, 10}));
+        CHECK(m.stored() == 10);
+        CHECK(m.padding_overhead() == doctest::Approx(3.0 / 7.0));
+        CHECK(m.to_csr() == c);
+        CHECK(m.to_sparse() == s);
+    }
+
+    const SellMatrix<5, 4, double, size_t, 2> m(s);
+    CHECK(m.size() == 20);
+    CHECK(m.allocated() == 7);
+    CHECK(m.memory_bytes() > m.stored() * sizeof(double));
+    CHECK(m(0, 3) == 2);
+    CHECK(m(1, 1) == 0);
+    CHECK(m(3, 2) == 5);
+    CHECK(m(4, 2) == 7);
+    CHECK(m(4, 3) == 0);
+    CHECK(m.peek(3, 0) == true);
+    CHECK(m.peek(2, 3) == false);
+    CHECK(m.peek(1, 0) == false);
+    REQUIRE_THROWS_AS( m(5, 0), const std::out_of_range& );
+    REQUIRE_THROWS_AS( m.peek(0, 4), const std::out_of_range& );
+
+    CHECK(m == SellMatrix<5, 4, double, size_t, 2>(c));
+    CHECK(m != SellMatrix<5, 4, double, size_t, 2>(c, 2));
+
+    const SellMatrix<5, 4, double> e;
+    CHECK(e.allocated() == 0);
+    CHECK(e.stored() == 0);
+    CHECK(e.padding_overhead() == 0.0);
+    CHECK(e(4, 3) == 0);
+    CHECK(e.to_csr() == CsrMatrix<5, 4, double>());
+}
+
+TEST_CASE_TEMPLATE("sliced storage product", T, int, float, double)
+{
+    const auto s = uneven_matrix<203, 150, T, size_t>();
+    const CsrMatrix<203, 150, T> c(s);
+
+    std::vector<T> x(150);
+    for (size_t j = 0; j < 150; ++j)
+    {
+        x[j] = static_cast<T>(j % 5 + 1);
+    }
+    std::vector<T> expected(203, 1);
+    c.multiply(2, x, 3, expected);
+
+    for (const size_t sigma : {size_t(1), size_t(32), size_t(203)})
+    {
+        std::vector<T> y(203, 1);
+        const SellMatrix<203, 150, T, size_t, 4> m4(s, sigma);
+        m4.multiply(2, x, 3, y);
+        CHECK(y == expected);
+
+        y.assign(203, 1);
+        const SellMatrix<203, 150, T, size_t, 8> m8(c, sigma);
+        m8.multiply(2, x, 3, y);
+        CHECK(y == expected);
+        CHECK(m8.to_csr() == c);
+
+        y.assign(203, 1);
+        const SellMatrix<203, 150, T, size_t, 16> m16(c, sigma);
+        m16.multiply(2, x, 3, y);
+        CHECK(y == expected);
+
+        // A chunk size that is not a multiple of the vector width.
+        y.assign(203, 1);
+        const SellMatrix<203, 150, T, size_t, 6> m6(c, sigma);
+        m6.multiply(2, x, 3, y);
+        CHECK(y == expected);
+    }
+
+    // Sorting reduces the padding.
+    CHECK(SellMatrix<203, 150, T>(c, 203).stored() < SellMatrix<203, 150, T>(c, 1).stored());
+
+    std::vector<T> y(203);
+    const SellMatrix<203, 150, T> m(c);
+    c.multiply(x, expected);
+    m.multiply(x, y);
+    CHECK(y == expected);
+
+    ThreadPool pool(3);
+    std::vector<T> z(203);
+    m.multiply(pool, x, z);
+    CHECK(z == expected);
+
+    REQUIRE_THROWS_AS( m.multiply(y, y), const std::out_of_range& );
+    REQUIRE_THROWS_AS( m.multiply(pool, x, x), const std::out_of_range& );
+}
+
+TEST_CASE("sliced storage instruction sets")
+{
+    const auto s = uneven_matrix<101, 80, float, uint32_t>();
+    const CsrMatrix<101, 80, float, uint32_t> c(s);
+    const SellMatrix<101, 80, float, uint32_t, 16> m(c, 64);
+
+    std::vector<float> x(80);
+    for (size_t j = 0; j < 80; ++j)
+    {
+        x[j] = static_cast<float>(j % 7);
+    }
+    std::vector<float> expected(101, 1);
+    c.multiply(-1, x, 2, expected);
+
+    std::vector<SimdLevel> levels = {SimdLevel::Scalar};
+    if (simd_level() != SimdLevel::Scalar)
+    {
+        levels.push_back(SimdLevel::Avx2);
+    }
+    if (simd_level() == SimdLevel::Avx512)
+    {
+        levels.push_back(SimdLevel::Avx512);
+    }
+
+    for (const SimdLevel level : levels)
+    {
+        std::vector<float> y(101, 1);
+        sparsematrix_detail::sell_spmv_level<16>(level, 0, m.chunk_ptr().size() - 1, 101, m.chunk_ptr().data(),
+                                                 m.perm().data(), m.col_idx().data(), m.values().data(), -1.0f,
+                                                 x.data(), 2.0f, y.data());
+        CHECK(y == expected);
+    }
+
+    std::array<float, 80> xa;
+    std::array<float, 101> ya;
+    std::copy(x.begin(), x.end(), xa.begin());
+    m.multiply(xa, ya);
+    c.multiply(x, expected);
+    CHECK(std::vector<float>(ya.begin(), ya.end()) == expected);
+}
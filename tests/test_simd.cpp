@@ -0,0 +1,164 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "csrkernels.h"
+#include "csrmatrix.h"
+
+
+//! Instruction sets supported by this processor, including the scalar kernels.
+static std::vector<SimdLevel> supported_levels()
+{
+    std::vector<SimdLevel> levels = {SimdLevel::Scalar};
+    if (simd_level() != SimdLevel::Scalar)
+    {
+        levels.push_back(SimdLevel::Avx2);
+    }
+    if (simd_level() == SimdLevel::Avx512)
+    {
+        levels.push_back(SimdLevel::Avx512);
+    }
+    return levels;
+}
+
+
+TEST_CASE_TEMPLATE_DEFINE("vectorized matrix-vector product", T, simd_spmv)
+{
+    typedef typename T::first_type V;
+    typedef typename T::second_type I;
+
+    // Rows of every length from 0 to 40, to cover full vectors and all partial vectors.
+    const size_t rows = 41;
+    const size_t cols = 50;
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<size_t> column(0, cols - 1);
+    std::uniform_real_distribution<V> value(-1, 1);
+
+    std::vector<size_t> row_ptr = {0};
+    std::vector<I> col_idx;
+    std::vector<V> values;
+    for (size_t i = 0; i < rows; ++i)
+    {
+        for (size_t n = 0; n < i; ++n)
+        {
+            col_idx.push_back(static_cast<I>(column(generator)));
+            values.push_back(value(generator));
+        }
+        row_ptr.push_back(col_idx.size());
+    }
+
+    std::vector<V> x(cols);
+    for (auto& v : x)
+    {
+        v = value(generator);
+    }
+
+    std::vector<V> expected(rows, 1);
+    sparsematrix_detail::csr_spmv_scalar(0, rows, row_ptr.data(), col_idx.data(), values.data(), V(2), x.data(), V(3),
+                                         expected.data());
+
+    for (const SimdLevel level : supported_levels())
+    {
+        std::vector<V> y(rows, 1);
+        sparsematrix_detail::csr_spmv_level(level, 0, rows, row_ptr.data(), col_idx.data(), values.data(), V(2),
+                                            x.data(), V(3), y.data());
+        for (size_t i = 0; i < rows; ++i)
+        {
+            CHECK(y[i] == doctest::Approx(expected[i]).epsilon(1e-5));
+        }
+
+        // With beta zero, y is not read.
+        std::vector<V> z(rows, NAN);
+        sparsematrix_detail::csr_spmv_level(level, 0, rows, row_ptr.data(), col_idx.data(), values.data(), V(1),
+                                            x.data(), V(0), z.data());
+        for (size_t i = 0; i < rows; ++i)
+        {
+            CHECK(2 * z[i] + 3 == doctest::Approx(expected[i]).epsilon(1e-5));
+        }
+    }
+}
+
+TEST_CASE_TEMPLATE_INVOKE(simd_spmv, std::pair<float, uint32_t>, std::pair<float, size_t>, std::pair<double, uint32_t>,
+                          std::pair<double, size_t>, std::pair<double, uint16_t>);
+
+TEST_CASE("vectorized product with large column indices")
+{
+    // Gather instructions take signed 32-bit indices, so indices of 2^31 and more need care. Rather than allocating a
+    // vector of 2^31 elements, x points 2^31 elements before a small array and only large indices are used.
+    const uint32_t offset = uint32_t(1) << 31;
+    std::vector<float> storage(40);
+    for (size_t n = 0; n < storage.size(); ++n)
+    {
+        storage[n] = static_cast<float>(n);
+    }
+    const float* x = reinterpret_cast<const float*>(reinterpret_cast<uintptr_t>(storage.data()) -
+                                                    uintptr_t(offset) * sizeof(float));
+
+    // One row with 19 elements: two full AVX2 vectors and a partial one, or one full AVX-512 vector and a partial one.
+    std::vector<uint32_t> col_idx;
+    std::vector<float> values;
+    float expected = 0;
+    for (uint32_t n = 0; n < 19; ++n)
+    {
+        col_idx.push_back(offset + 2 * n);
+        values.push_back(1);
+        expected += static_cast<float>(2 * n);
+    }
+    const std::vector<size_t> row_ptr = {0, col_idx.size()};
+
+    for (const SimdLevel level : supported_levels())
+    {
+        float y = 0;
+        sparsematrix_detail::csr_spmv_level(level, 0, 1, row_ptr.data(), col_idx.data(), values.data(), 1.0f, x, 0.0f,
+                                            &y);
+        CHECK(y == expected);
+    }
+}
+
+TEST_CASE_TEMPLATE("matrix classes use the vectorized kernels", T, float, double)
+{
+    SparseMatrix<20, 30, T, uint32_t> s;
+    for (size_t i = 0; i < 20; ++i)
+    {
+        for (size_t j = i % 3; j < 30; j += 1 + i % 4)
+        {
+            s(i, j) = static_cast<T>(i + j + 1);
+        }
+    }
+    CsrMatrix<20, 30, T, uint32_t> c(s);
+
+    std::vector<T> x(30);
+    for (size_t j = 0; j < 30; ++j)
+    {
+        x[j] = static_cast<T>(j % 7);
+    }
+
+    // Integer values are summed exactly in any order.
+    std::vector<T> expected(20);
+    std::vector<T> y(20);
+    s.multiply(x, expected);
+    c.multiply(x, y);
+    CHECK(y == expected);
+}
@@ -0,0 +1,196 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include "csrmatrix.h"
+
+
+TEST_CASE_TEMPLATE("matrix-vector product", T, int, float, double)
+{
+    SparseMatrix<3, 4, T> s = {
+        { {0, 0}, 1 },
+        { {0, 3}, 2 },
+        { {2, 1}, 3 },
+        { {2, 2}, 4 },
+    };
+    CsrMatrix<3, 4, T> c(s);
+
+    SUBCASE("raw pointers")
+    {
+        const T x[4] = {1, 2, 3, 4};
+        T y[3] = {-1, -1, -1};
+
+        s.multiply(x, y);
+        CHECK(y[0] == 9);
+        CHECK(y[1] == 0);
+        CHECK(y[2] == 18);
+
+        T z[3] = {-1, -1, -1};
+        c.multiply(x, z);
+        CHECK(z[0] == 9);
+        CHECK(z[1] == 0);
+        CHECK(z[2] == 18);
+    }
+
+    SUBCASE("scaled and accumulated")
+    {
+        const std::array<T, 4> x = {{1, 2, 3, 4}};
+        std::array<T, 3> y = {{1, 2, 3}};
+        std::array<T, 3> z = y;
+
+        s.multiply(2, x, 3, y);
+        CHECK(y == std::array<T, 3>({{21, 6, 45}}));
+
+        c.multiply(2, x, 3, z);
+        CHECK(z == y);
+    }
+
+    SUBCASE("standard vectors")
+    {
+        const std::vector<T> x = {1, 2, 3, 4};
+        std::vector<T> y(3);
+        std::vector<T> z(3);
+
+        s.multiply(x, y);
+        CHECK(y == std::vector<T>({9, 0, 18}));
+
+        c.multiply(x, z);
+        CHECK(z == y);
+
+        c.multiply(1, x, 1, z);
+        CHECK(z == std::vector<T>({18, 0, 36}));
+    }
+
+    SUBCASE("same as multiplication with column vector")
+    {
+        SparseMatrix<4, 1, T> v = {
+            { {0, 0}, 1 },
+            { {1, 0}, 2 },
+            { {2, 0}, 3 },
+            { {3, 0}, 4 },
+        };
+        SparseMatrix<3, 1, T> u = s * v;
+
+        std::array<T, 4> x = {{1, 2, 3, 4}};
+        std::array<T, 3> y;
+        c.multiply(x, y);
+        for (size_t i = 0; i < 3; ++i)
+        {
+            CHECK(y[i] == u(i, 0));
+        }
+    }
+
+    SUBCASE("vector size mismatch")
+    {
+        std::vector<T> x(3);
+        std::vector<T> y(3);
+        REQUIRE_THROWS_AS( s.multiply(x, y), const std::out_of_range& );
+        REQUIRE_THROWS_AS( c.multiply(x, y), const std::out_of_range& );
+
+        x.resize(4);
+        y.resize(4);
+        REQUIRE_THROWS_AS( s.multiply(x, y), const std::out_of_range& );
+        REQUIRE_THROWS_AS( c.multiply(x, y), const std::out_of_range& );
+    }
+}
+
+TEST_CASE_TEMPLATE("sparse-dense matrix product", T, int, float, double)
+{
+    SparseMatrix<3, 4, T> s = {
+        { {0, 0}, 1 },
+        { {0, 3}, 2 },
+        { {2, 1}, 3 },
+        { {2, 2}, 4 },
+    };
+    CsrMatrix<3, 4, T> c(s);
+
+    // Column counts below, at and above the block size of the kernel.
+    for (const size_t k : {1, 16, 37})
+    {
+        // Column j of B is x_j(r) = r + j, so column j of C is A * x_j.
+        std::vector<T> b_row(4 * k);
+        std::vector<T> b_col(4 * k);
+        for (size_t r = 0; r < 4; ++r)
+        {
+            for (size_t j = 0; j < k; ++j)
+            {
+                b_row[r * k + j] = static_cast<T>(r + j);
+                b_col[r + j * 4] = static_cast<T>(r + j);
+            }
+        }
+
+        std::vector<T> expected(3 * k);
+        for (size_t j = 0; j < k; ++j)
+        {
+            const std::vector<T> x = {T(j), T(j + 1), T(j + 2), T(j + 3)};
+            std::vector<T> y(3);
+            c.multiply(x, y);
+            for (size_t i = 0; i < 3; ++i)
+            {
+                expected[i * k + j] = y[i];
+            }
+        }
+
+        SUBCASE("row-major")
+        {
+            std::vector<T> out(3 * k, -1);
+            c.multiply(k, b_row, out);
+            CHECK(out == expected);
+
+            c.multiply(k, 2, b_row, 1, out);
+            for (size_t n = 0; n < 3 * k; ++n)
+            {
+                CHECK(out[n] == 3 * expected[n]);
+            }
+        }
+
+        SUBCASE("column-major with padding")
+        {
+            // Leading dimensions larger than the number of rows.
+            std::vector<T> b(6 * k, 99);
+            std::vector<T> out(5 * k, -1);
+            for (size_t j = 0; j < k; ++j)
+            {
+                std::copy(b_col.cbegin() + j * 4, b_col.cbegin() + (j + 1) * 4, b.begin() + j * 6);
+            }
+            c.multiply(k, 1, b.data(), 6, 0, out.data(), 5, DenseLayout::ColumnMajor);
+            for (size_t i = 0; i < 3; ++i)
+            {
+                for (size_t j = 0; j < k; ++j)
+                {
+                    CHECK(out[i + j * 5] == expected[i * k + j]);
+                }
+            }
+            CHECK(out[3] == -1);
+            CHECK(out[4] == -1);
+        }
+    }
+
+    SUBCASE("size mismatch")
+    {
+        std::vector<T> b(4 * 2);
+        std::vector<T> out(3 * 2);
+        REQUIRE_THROWS_AS( c.multiply(3, b, out), const std::out_of_range& );
+        REQUIRE_THROWS_AS( c.multiply(2, 1, b.data(), 1, 0, out.data(), 2), const std::out_of_range& );
+        REQUIRE_THROWS_AS( c.multiply(2, 1, b.data(), 4, 0, out.data(), 2, DenseLayout::ColumnMajor),
+                           const std::out_of_range& );
+    }
+}
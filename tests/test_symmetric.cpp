@@ -0,0 +1,211 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "csrmatrix.h"
+#include "sparsematrix.h"
+#include "symmetricmatrix.h"
+#include "threadpool.h"
+
+
+//! Symmetric test matrix with a full diagonal, some empty rows and a dense last row and column.
+template <size_t N, typename T, typename I>
+static SparseMatrix<N, N, T, I> symmetric_matrix()
+{
+    SparseMatrix<N, N, T, I> s;
+    for (size_t i = 0; i < N; ++i)
+    {
+        if (i % 11 != 5)
+        {
+            s(i, i) = static_cast<T>(i % 4 + 2);
+        }
+        for (const size_t j : {(i * 7 + 3) % N, (i * 13 + 1) % N, N - 1})
+        {
+            if (i % 11 != 5 && j % 11 != 5 && i != j)
+            {
+                s(i, j) = static_cast<T>((i + j) % 5 + 1);
+                s(j, i) = static_cast<T>((i + j) % 5 + 1);
+            }
+        }
+    }
+    return s;
+}
+
+
+TEST_CASE("symmetric storage conversion")
+{
+    const SparseMatrix<4, 4, double> s = {
+        { {0, 0}, 1 },
+        { {0, 2}, 2 },
+        { {2, 0}, 2 },
+        { {1, 3}, 3 },
+        { {3, 1}, 3 },
+        { {2, 2}, 4 },
+        { {2, 3}, 5 },
+        { {3, 2}, 5 },
+    };
+    const CsrMatrix<4, 4, double> c(s);
+    const SymmetricMatrix<4, double> m(s);
+
+    CHECK(m.upper().row_ptr() == std::vector<size_t>({0, 2, 3, 5, 5}));
+    CHECK(m.upper().col_idx() == std::vector<size_t>({0, 2, 3, 2, 3}));
+    CHECK(m.upper().values() == std::vector<double>({1, 2, 3, 4, 5}));
+    CHECK(m.size() == 16);
+    CHECK(m.allocated() == 5);
+    CHECK(m.memory_bytes() > m.allocated() * sizeof(double));
+    CHECK(m == SymmetricMatrix<4, double>(c));
+    CHECK(m != SymmetricMatrix<4, double>());
+
+    CHECK(m(0, 2) == 2);
+    CHECK(m(2, 0) == 2);
+    CHECK(m(3, 1) == 3);
+    CHECK(m(3, 2) == 5);
+    CHECK(m(3, 3) == 0);
+    CHECK(m(1, 0) == 0);
+    CHECK(m.peek(3, 1) == true);
+    CHECK(m.peek(1, 3) == true);
+    CHECK(m.peek(1, 1) == false);
+    REQUIRE_THROWS_AS( m(4, 0), const std::out_of_range& );
+    REQUIRE_THROWS_AS( m(0, 4), const std::out_of_range& );
+    REQUIRE_THROWS_AS( m.peek(4, 4), const std::out_of_range& );
+
+    CHECK(m.to_csr() == c);
+    CHECK(m.to_sparse() == s);
+
+    // Only the upper triangle is read.
+    const SparseMatrix<4, 4, double> u = {
+        { {0, 0}, 1 },
+        { {0, 2}, 2 },
+        { {1, 3}, 3 },
+        { {2, 2}, 4 },
+        { {2, 3}, 5 },
+        { {3, 0}, 9 },
+    };
+    CHECK(SymmetricMatrix<4, double>(u) == m);
+    CHECK(SymmetricMatrix<4, double>(CsrMatrix<4, 4, double>(u)) == m);
+
+    const SymmetricMatrix<4, double> e;
+    CHECK(e.allocated() == 0);
+    CHECK(e(3, 0) == 0);
+    CHECK(e.to_csr() == CsrMatrix<4, 4, double>());
+}
+
+TEST_CASE_TEMPLATE("symmetric storage product", T, int, float, double)
+{
+    const auto s = symmetric_matrix<301, T, size_t>();
+    const CsrMatrix<301, 301, T> c(s);
+    const SymmetricMatrix<301, T> m(c);
+    CHECK(m.to_csr() == c);
+    CHECK(2 * m.allocated() > c.allocated());
+    CHECK(2 * m.allocated() < c.allocated() + 301);
+    CHECK(m.memory_bytes() < c.memory_bytes());
+
+    std::vector<T> x(301);
+    for (size_t j = 0; j < 301; ++j)
+    {
+        x[j] = static_cast<T>(j % 5 + 1);
+    }
+    std::vector<T> expected(301, 1);
+    std::vector<T> y(301, 1);
+    c.multiply(2, x, 3, expected);
+    m.multiply(2, x, 3, y);
+    CHECK(y == expected);
+
+    y.assign(301, 1);
+    expected.assign(301, 1);
+    c.multiply(2, x, 1, expected);
+    m.multiply(2, x, 1, y);
+    CHECK(y == expected);
+
+    c.multiply(x, expected);
+    m.multiply(x, y);
+    CHECK(y == expected);
+
+    std::array<T, 301> xa;
+    std::array<T, 301> ya;
+    std::copy(x.begin(), x.end(), xa.begin());
+    m.multiply(xa, ya);
+    CHECK(std::vector<T>(ya.begin(), ya.end()) == expected);
+
+    for (const size_t threads : {1, 3, 4})
+    {
+        ThreadPool pool(threads);
+        std::vector<T> z(301);
+        m.multiply(pool, x, z);
+        CHECK(z == expected);
+
+        std::vector<T> expected_beta(301, 2);
+        z.assign(301, 2);
+        c.multiply(-1, x, 2, expected_beta);
+        m.multiply(pool, -1, x.data(), 2, z.data());
+        CHECK(z == expected_beta);
+    }
+
+    ThreadPool pool(2);
+    std::vector<T> short_y(300);
+    REQUIRE_THROWS_AS( m.multiply(x, short_y), const std::out_of_range& );
+    REQUIRE_THROWS_AS( m.multiply(pool, x, short_y), const std::out_of_range& );
+}
+
+TEST_CASE("symmetric storage arithmetic")
+{
+    const auto s = symmetric_matrix<50, int, size_t>();
+    const SymmetricMatrix<50, int> a(s);
+    SparseMatrix<50, 50, int> d;
+    for (size_t i = 0; i < 50; ++i)
+    {
+        d(i, i) = 1;
+        d(i, 49 - i) = 2;
+    }
+    const SymmetricMatrix<50, int> b(d);
+
+    CHECK((a + b).to_csr() == CsrMatrix<50, 50, int>(a.to_csr() + b.to_csr()));
+    CHECK((a - b).to_csr() == CsrMatrix<50, 50, int>(a.to_csr() - b.to_csr()));
+    CHECK((-a).to_csr() == -a.to_csr());
+    CHECK((3 * a).to_csr() == 3 * a.to_csr());
+    CHECK(a * 3 == 3 * a);
+    CHECK(+a == a);
+
+    SymmetricMatrix<50, int> e = a;
+    e += b;
+    CHECK(e == a + b);
+    e -= b;
+    CHECK(e(10, 2) == a(10, 2));
+}
+
+TEST_CASE("symmetric storage index type")
+{
+    const auto s = symmetric_matrix<300, float, uint16_t>();
+    const SymmetricMatrix<300, float, uint16_t> m(s);
+    CHECK(m.to_sparse() == s);
+
+    std::vector<float> x(300, 1.0f);
+    std::vector<float> y(300);
+    std::vector<float> expected(300);
+    CsrMatrix<300, 300, float, uint16_t>(s).multiply(x, expected);
+    m.multiply(x, y);
+    CHECK(y == expected);
+}
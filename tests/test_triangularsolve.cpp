@@ -0,0 +1,223 @@
+/* Copyright 2023 Ludo Visser
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <stdexcept>
+#include <vector>
+
+#include "csrmatrix.h"
+#include "sparsematrix.h"
+#include "threadpool.h"
+#include "triangularsolve.h"
+
+
+//! Lower triangular test matrix with a unit diagonal and up to three dependencies per row.
+/*!
+ * Rows depend on rows far above them as well as close by, which gives levels of very different sizes. With small
+ * integer values, all solves are exact.
+ */
+template <size_t N, typename T>
+static CsrMatrix<N, N, T> lower_matrix()
+{
+    SparseMatrix<N, N, T> s;
+    for (size_t i = 0; i < N; ++i)
+    {
+        s(i, i) = 1;
+        if (i > 0)
+        {
+            s(i, i / 3) = static_cast<T>(i % 2 == 0 ? 1 : -1);
+        }
+        if (i > 1)
+        {
+            s(i, i / 2) = static_cast<T>(i % 3 == 0 ? -1 : 1);
+        }
+        if (i >= 700)
+        {
+            s(i, i - 700) = 1;
+        }
+    }
+    return CsrMatrix<N, N, T>(s);
+}
+
+
+TEST_CASE("level schedule")
+{
+    const SparseMatrix<5, 5, double> s = {
+        { {0, 0}, 1 },
+        { {0, 3}, 2 },
+        { {1, 1}, 3 },
+        { {2, 0}, 4 },
+        { {2, 2}, 5 },
+        { {3, 1}, 6 },
+        { {3, 2}, 7 },
+        { {3, 3}, 8 },
+        { {4, 4}, 9 },
+    };
+    const CsrMatrix<5, 5, double> a(s);
+
+    const LevelSchedule<5> lower(a, Triangle::Lower);
+    CHECK(lower.triangle() == Triangle::Lower);
+    CHECK(lower.allocated() == 9);
+    CHECK(lower.diag() == std::vector<size_t>({0, 2, 4, 7, 8}));
+    CHECK(lower.levels() == 3);
+    CHECK(lower.level_ptr() == std::vector<size_t>({0, 3, 4, 5}));
+    CHECK(lower.rows() == std::vector<size_t>({0, 1, 4, 2, 3}));
+    CHECK(lower.parallelism() == doctest::Approx(5.0 / 3.0));
+
+    // The same matrix, with only the element (0, 3) above the diagonal.
+    const LevelSchedule<5> upper(a, Triangle::Upper);
+    CHECK(upper.triangle() == Triangle::Upper);
+    CHECK(upper.levels() == 2);
+    CHECK(upper.level_ptr() == std::vector<size_t>({0, 4, 5}));
+    CHECK(upper.rows() == std::vector<size_t>({1, 2, 3, 4, 0}));
+
+    // A diagonal matrix is a single level.
+    const CsrMatrix<5, 5, double> d = {
+        { {0, 0}, 1 },
+        { {1, 1}, 1 },
+        { {2, 2}, 1 },
+        { {3, 3}, 1 },
+        { {4, 4}, 1 },
+    };
+    CHECK(LevelSchedule<5>(d, Triangle::Lower).levels() == 1);
+    CHECK(LevelSchedule<5>(d, Triangle::Upper).parallelism() == 5.0);
+
+    const CsrMatrix<5, 5, double> missing = {
+        { {0, 0}, 1 },
+        { {1, 1}, 1 },
+        { {2, 1}, 1 },
+        { {3, 3}, 1 },
+        { {4, 4}, 1 },
+    };
+    REQUIRE_THROWS_AS( LevelSchedule<5>(missing, Triangle::Lower), const std::runtime_error& );
+}
+
+TEST_CASE("triangular solve of a small system")
+{
+    const SparseMatrix<3, 3, double> s = {
+        { {0, 0}, 2 },
+        { {0, 2}, 1 },
+        { {1, 0}, 1 },
+        { {1, 1}, 4 },
+        { {2, 1}, -2 },
+        { {2, 2}, 0.5 },
+    };
+    const CsrMatrix<3, 3, double> a(s);
+
+    // L = [2 0 0; 1 4 0; 0 -2 0.5] and U = [2 0 1; 0 4 0; 0 0 0.5].
+    std::vector<double> x(3);
+    triangular_solve(a, Triangle::Lower, std::vector<double>({2, 5, -1}), x);
+    CHECK(x == std::vector<double>({1, 1, 2}));
+    triangular_solve(a, Triangle::Upper, std::vector<double>({4, 8, 1}), x);
+    CHECK(x == std::vector<double>({1, 2, 2}));
+
+    const CsrMatrix<3, 3, double> missing = {
+        { {0, 0}, 1 },
+        { {1, 0}, 1 },
+        { {2, 2}, 1 },
+    };
+    REQUIRE_THROWS_AS( triangular_solve(missing, Triangle::Lower, x, x), const std::runtime_error& );
+    REQUIRE_THROWS_AS( triangular_solve(missing, Triangle::Upper, x, x), const std::runtime_error& );
+
+    std::vector<double> y(2);
+    REQUIRE_THROWS_AS( triangular_solve(a, Triangle::Lower, x, y), const std::out_of_range& );
+}
+
+TEST_CASE_TEMPLATE("triangular solve", T, int, float, double)
+{
+    const size_t N = 3000;
+    const CsrMatrix<N, N, T> lower = lower_matrix<N, T>();
+    const CsrMatrix<N, N, T> upper = lower.transpose();
+
+    std::vector<T> expected(N);
+    for (size_t i = 0; i < N; ++i)
+    {
+        expected[i] = static_cast<T>(i % 4 + 1);
+    }
+
+    for (const Triangle triangle : {Triangle::Lower, Triangle::Upper})
+    {
+        const CsrMatrix<N, N, T>& a = triangle == Triangle::Lower ? lower : upper;
+        std::vector<T> b(N);
+        a.multiply(expected, b);
+
+        std::vector<T> x(N);
+        triangular_solve(a, triangle, b, x);
+        CHECK(x == expected);
+
+        const LevelSchedule<N> schedule(a, triangle);
+        CHECK(schedule.levels() > 1);
+        CHECK(schedule.parallelism() > 100.0);
+
+        x.assign(N, 0);
+        triangular_solve(a, schedule, b, x);
+        CHECK(x == expected);
+
+        for (const size_t threads : {1, 3, 4})
+        {
+            ThreadPool pool(threads);
+            x.assign(N, 0);
+            triangular_solve(pool, a, schedule, b, x);
+            CHECK(x == expected);
+
+            // In place.
+            x = b;
+            triangular_solve(pool, a, schedule, x.data(), x.data());
+            CHECK(x == expected);
+        }
+
+        // Elements of the other triangle are ignored.
+        const CsrMatrix<N, N, T> full = lower + upper;
+        SparseMatrix<N, N, T> diagonal;
+        for (size_t i = 0; i < N; ++i)
+        {
+            diagonal(i, i) = 1;
+        }
+        const CsrMatrix<N, N, T> both = full - CsrMatrix<N, N, T>(diagonal);
+        x.assign(N, 0);
+        triangular_solve(both, triangle, b, x);
+        CHECK(x == expected);
+    }
+}
+
+TEST_CASE("triangular solve with a reused schedule")
+{
+    const size_t N = 2000;
+    const CsrMatrix<N, N, double> a = lower_matrix<N, double>();
+    const LevelSchedule<N> schedule(a, Triangle::Lower);
+    ThreadPool pool(2);
+
+    // Different values with the same sparsity pattern.
+    const CsrMatrix<N, N, double> b = 2.0 * a;
+    std::vector<double> rhs(N, 1.0);
+    std::vector<double> expected(N);
+    std::vector<double> x(N);
+    triangular_solve(b, Triangle::Lower, rhs, expected);
+    triangular_solve(pool, b, schedule, rhs, x);
+    CHECK(x == expected);
+
+    const CsrMatrix<N, N, double> other = lower_matrix<N, double>().transpose();
+    REQUIRE_THROWS_AS( triangular_solve(pool, lower_matrix<N, double>() + other, schedule, rhs, x),
+                       const std::out_of_range& );
+    std::vector<double> y(N - 1);
+    REQUIRE_THROWS_AS( triangular_solve(a, schedule, rhs, y), const std::out_of_range& );
+    REQUIRE_THROWS_AS( triangular_solve(pool, a, schedule, y, x), const std::out_of_range& );
+}